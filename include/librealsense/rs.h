@@ -9,7 +9,7 @@ extern "C" {
 #endif
 
 #define RS_API_MAJOR_VERSION    1
-#define RS_API_MINOR_VERSION    11
+#define RS_API_MINOR_VERSION    12
 #define RS_API_PATCH_VERSION    0
 
 #define STRINGIFY(arg) #arg
@@ -77,6 +77,8 @@ typedef enum rs_format
     RS_FORMAT_RAW10       , /**< Four 10-bit luminance values encoded into a 5-byte macropixel */
     RS_FORMAT_RAW16       ,
     RS_FORMAT_RAW8        ,
+    RS_FORMAT_Z16_COMPRESSED        , /**< Z16 pixels of the whole frame, losslessly compressed. See rs_decompress_depth */
+    RS_FORMAT_DISPARITY16_COMPRESSED, /**< DISPARITY16 pixels of the whole frame, losslessly compressed. See rs_decompress_depth */
     RS_FORMAT_COUNT
 } rs_format;
 
@@ -195,9 +197,22 @@ typedef enum rs_option
     RS_OPTION_FISHEYE_AUTO_EXPOSURE_ANTIFLICKER_RATE          , /**< Fisheye auto-exposure anti-flicker rate, can be 50 or 60 Hz */
     RS_OPTION_FISHEYE_AUTO_EXPOSURE_PIXEL_SAMPLE_RATE         , /**< In Fisheye auto-exposure sample frame every given number of pixels */
     RS_OPTION_FISHEYE_AUTO_EXPOSURE_SKIP_FRAMES               , /**< In Fisheye auto-exposure sample every given number of frames */
-    RS_OPTION_FRAMES_QUEUE_SIZE                               , /**< Number of frames the user is allowed to keep per stream. Trying to hold-on to more frames will cause frame-drops.*/
+    RS_OPTION_FRAMES_QUEUE_SIZE                               , /**< Number of frames the user is allowed to keep per stream. Trying to hold-on to more frames will cause frame-drops. Queues are sized, and buffers for the frames allocated, when streaming starts, and cannot grow until it restarts*/
     RS_OPTION_HARDWARE_LOGGER_ENABLED                         , /**< Enable / disable fetching log data from the device */
     RS_OPTION_TOTAL_FRAME_DROPS                               , /**< Total number of detected frame drops from all streams */
+    RS_OPTION_ZERO_COPY_ENABLED                               , /**< Enable / disable delivering frames that need no unpacking directly from the capture buffers, without copying. Set before streaming */
+    RS_OPTION_CAPTURE_RING_DEPTH                              , /**< Number of capture buffers per subdevice. Frames delivered without copying may hold all but two of them, less the capture queue size (V4L2 only). Set before streaming */
+    RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE                    , /**< Enable / disable a dedicated capture thread per subdevice (V4L2 only). Set before streaming */
+    RS_OPTION_CAPTURE_THREAD_AFFINITY                         , /**< Bitmask of the CPUs the capture threads may run on, out of CPUs 0 to 52, 0 leaves the affinity unchanged (V4L2 only). Set before streaming */
+    RS_OPTION_CAPTURE_THREAD_PRIORITY                         , /**< SCHED_FIFO priority of the capture threads, 0 keeps the default scheduling policy (V4L2 only). Set before streaming */
+    RS_OPTION_CAPTURE_QUEUE_SIZE                              , /**< Number of captured frames per subdevice that may wait for unpacking, 0 unpacks on the capture thread (V4L2 only). Set before streaming */
+    RS_OPTION_UNPACK_THREADS                                  , /**< Number of worker threads unpacking frames off the capture thread, 0 unpacks on the capture thread. The capture ring grows to give each of them two capture buffers. Not available with libuvc or WMF. Set before streaming */
+    RS_OPTION_UNPACK_ROW_BANDS                                , /**< Number of row bands each frame is split into, to be unpacked in parallel by the unpack worker threads. Set before streaming */
+    RS_OPTION_PROCESSING_THREADS                              , /**< Number of worker threads computing the point cloud and aligned streams in row bands, 0 computes them on the calling thread */
+    RS_OPTION_TIMESTAMPS_MATCHED                              , /**< Total number of frames given the timestamp reported by the motion module */
+    RS_OPTION_TIMESTAMPS_LATE                                 , /**< Total number of frames delivered with their camera timestamp, since no motion module timestamp matched them in time */
+    RS_OPTION_TIMESTAMPS_DROPPED                              , /**< Total number of frames dropped by timestamp correction */
+    RS_OPTION_COMPRESS_RECORDED_DEPTH                         , /**< Enable / disable lossless compression of the depth frames written by rs_start_recording. Set before recording starts */
     RS_OPTION_COUNT,
 
 } rs_option;
@@ -263,6 +278,22 @@ typedef enum rs_timestamp_domain
     RS_TIMESTAMP_DOMAIN_COUNT
 }rs_timestamp_domain;
 
+typedef enum rs_frameset_policy
+{
+    RS_FRAMESET_POLICY_WAIT           , /**< Deliver complete framesets only, waiting for a missing frame for as long as it may still arrive */
+    RS_FRAMESET_POLICY_EMIT_INCOMPLETE, /**< Deliver the frames which matched, once the frameset can no longer be completed */
+    RS_FRAMESET_POLICY_DROP           , /**< Discard framesets which can no longer be completed */
+    RS_FRAMESET_POLICY_COUNT
+}rs_frameset_policy;
+
+typedef enum rs_playback_mode
+{
+    RS_PLAYBACK_MODE_REAL_TIME, /**< Deliver recorded frames and events at the pace at which they were captured */
+    RS_PLAYBACK_MODE_FAST     , /**< Deliver recorded frames and events as fast as the application consumes them */
+    RS_PLAYBACK_MODE_STEPPED  , /**< Deliver recorded frames only when rs_step_playback is called */
+    RS_PLAYBACK_MODE_COUNT
+}rs_playback_mode;
+
 typedef struct rs_intrinsics
 {
     int           width;     /* width of the image in pixels */
@@ -314,6 +345,16 @@ typedef struct rs_motion_data
     float               axes[3];    /* Three [x,y,z] axes; 16 bit data for Gyro [rad/sec], 12 bit for Accelerometer; 2's complement [m/sec^2]*/
 } rs_motion_data;
 
+typedef struct rs_frameset_stats
+{
+    unsigned long long  complete_framesets;   /* framesets delivered with a frame of every stream */
+    unsigned long long  incomplete_framesets; /* framesets delivered with frames missing, see RS_FRAMESET_POLICY_EMIT_INCOMPLETE */
+    unsigned long long  dropped_framesets;    /* framesets discarded, since they could not be completed */
+    unsigned long long  dropped_frames;       /* frames which matched no frameset */
+    double              max_sync_error;       /* largest timestamp difference between two frames of a delivered frameset, in milliseconds */
+    double              mean_sync_error;      /* mean timestamp difference between the first and last frame of the delivered framesets, in milliseconds */
+} rs_frameset_stats;
+
 
 typedef struct rs_context rs_context;
 typedef struct rs_device rs_device;
@@ -322,13 +363,18 @@ typedef struct rs_frameset rs_frameset;
 typedef struct rs_frame_ref rs_frame_ref;
 typedef struct rs_motion_callback rs_motion_callback;
 typedef struct rs_frame_callback rs_frame_callback;
+typedef struct rs_frameset_callback rs_frameset_callback;
 typedef struct rs_timestamp_callback rs_timestamp_callback;
 typedef struct rs_log_callback rs_log_callback;
+typedef struct rs_frame_allocator rs_frame_allocator;
 
 typedef void (*rs_frame_callback_ptr)(rs_device * dev, rs_frame_ref * frame, void * user);
+typedef void (*rs_frameset_callback_ptr)(rs_device * dev, rs_frame_ref ** frames, int count, void * user);
 typedef void (*rs_motion_callback_ptr)(rs_device * , rs_motion_data, void * );
 typedef void (*rs_timestamp_callback_ptr)(rs_device * , rs_timestamp_data, void * );
 typedef void (*rs_log_callback_ptr)(rs_log_severity min_severity, const char * message, void * user);
+typedef void * (*rs_frame_allocate_ptr)(rs_device * dev, rs_stream stream, int size, void * user);
+typedef void (*rs_frame_deallocate_ptr)(rs_device * dev, rs_stream stream, void * buffer, int size, void * user);
 
 rs_context * rs_create_context(int api_version, rs_error ** error);
 void rs_delete_context(rs_context * context, rs_error ** error);
@@ -348,6 +394,16 @@ int rs_get_device_count(const rs_context * context, rs_error ** error);
  */
 rs_device * rs_get_device(rs_context * context, int index, rs_error ** error);
 
+/**
+ * open a capture file written by rs_start_recording as a device, which is appended to the devices of the context
+ * the device reports the calibration of the recorded camera, and delivers the recorded frames through the usual stream, frameset and motion callbacks
+ * the streams which were recorded first are enabled, and other recorded modes may be enabled in their place. camera options are not available
+ * \param[in] filename  the path of the capture file
+ * \param[out] error    if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ * \return              the playback device, owned by the context
+ */
+rs_device * rs_add_playback_device(rs_context * context, const char * filename, rs_error ** error);
+
 /**
  * retrieve a human readable device model string
  * \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
@@ -571,6 +627,115 @@ void rs_enable_motion_tracking_cpp(rs_device * device,
  */
 void rs_set_frame_callback_cpp(rs_device * device, rs_stream stream, rs_frame_callback * callback, rs_error ** error);
 
+/**
+ * set up a callback that will be called with each set of frames whose timestamps match, one frame per stream
+ * all enabled native streams without a frame callback of their own take part, and their frames are no longer available through wait/poll methods
+ * frames match when their timestamps are in the same domain and no further apart than the tolerance of their pair of streams
+ * the callback is called in order from a dedicated thread, with a reference to each frame of the set, and must release each of them with rs_release_frame
+ * must be called before rs_start_device
+ * \param[in] on_frameset  the callback which will receive the frames
+ * \param[in] user         a user data point to be passed to the callback
+ * \param[out] error       if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_set_frameset_callback(rs_device * device, rs_frameset_callback_ptr on_frameset, void * user, rs_error ** error);
+
+/**
+ * set up a callback that will be called with each set of frames whose timestamps match, one frame per stream
+ * all enabled native streams without a frame callback of their own take part, and their frames are no longer available through wait/poll methods
+ * frames match when their timestamps are in the same domain and no further apart than the tolerance of their pair of streams
+ * the callback is called in order from a dedicated thread, with a reference to each frame of the set, and must release each of them with rs_release_frame
+ * (This variant is provided specificly to enable passing lambdas with capture lists safely into the library)
+ * must be called before rs_start_device
+ * \param[in] callback  the callback which will receive the frames
+ * \param[out] error    if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_set_frameset_callback_cpp(rs_device * device, rs_frameset_callback * callback, rs_error ** error);
+
+/**
+ * choose what happens to a frameset which is missing the frame of some stream, RS_FRAMESET_POLICY_WAIT by default
+ * must be called before rs_start_device
+ * \param[in] policy   the policy applied to incomplete framesets
+ * \param[out] error   if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_set_frameset_policy(rs_device * device, rs_frameset_policy policy, rs_error ** error);
+
+/**
+ * set how far apart the timestamps of the frames of two streams may be to belong to the same frameset
+ * by default, the tolerance is half the frame interval of the faster of the two streams
+ * must be called before rs_start_device
+ * \param[in] a             one stream of the pair
+ * \param[in] b             the other stream of the pair
+ * \param[in] milliseconds  the largest timestamp difference allowed, or 0 to restore the default
+ * \param[out] error        if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_set_frameset_tolerance(rs_device * device, rs_stream a, rs_stream b, double milliseconds, rs_error ** error);
+
+/**
+ * retrieve statistics of the frameset matching since the device was last started
+ * \param[out] stats   receives the statistics
+ * \param[out] error   if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_get_frameset_stats(const rs_device * device, rs_frameset_stats * stats, rs_error ** error);
+
+/**
+* provide the memory in which frame images are stored, instead of the library's own heap allocations
+* buffers are recycled between frames, and are returned through deallocate once the library no longer needs them
+* if allocate returns null, the library falls back to its own memory for that frame
+* must be called before rs_start_device, and applies to all native streams
+* buffers of frames still held when the device is deleted are returned afterwards, with a null device pointer
+* \param[in] allocate    routine to be invoked to obtain a buffer of the given size for the given stream
+* \param[in] deallocate  routine to be invoked to return a buffer previously obtained through allocate
+* \param[in] user        a user data point to be passed to both routines
+* \param[out] error      if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_set_frame_allocator(rs_device * device, rs_frame_allocate_ptr allocate, rs_frame_deallocate_ptr deallocate, void * user, rs_error ** error);
+
+/**
+* provide the memory in which frame images are stored, instead of the library's own heap allocations
+* (This variant is provided specificly to enable passing lambdas with capture lists safely into the library)
+* \param[in] allocator  the allocator which will provide and reclaim frame buffers
+* \param[out] error     if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_set_frame_allocator_cpp(rs_device * device, rs_frame_allocator * allocator, rs_error ** error);
+
+/**
+* record the native frames, motion events and timestamp events of the device into a capture file, along with its calibration
+* frames are written from a background thread, and are dropped rather than delaying capture if the disk does not keep up
+* must be called while the device is stopped, and records every time the device is started until rs_stop_recording is called
+* \param[in] filename  the path of the capture file, which is overwritten if it exists
+* \param[out] error    if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_start_recording(rs_device * device, const char * filename, rs_error ** error);
+
+/**
+* finish writing the capture file started by rs_start_recording, and close it
+* must be called while the device is stopped
+* \param[out] error    if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_stop_recording(rs_device * device, rs_error ** error);
+
+/**
+* choose how a playback device paces the recorded frames, RS_PLAYBACK_MODE_REAL_TIME by default. may be changed while streaming
+* \param[in] mode    the pacing of the frames
+* \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_set_playback_mode(rs_device * device, rs_playback_mode mode, rs_error ** error);
+
+/**
+* deliver the next frame of every stream being played back, and return once they have been handed to the pipeline
+* the device must be streaming in RS_PLAYBACK_MODE_STEPPED
+* \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+* \return            1 if any frame was delivered, 0 if the end of the recording was reached
+*/
+int rs_step_playback(rs_device * device, rs_error ** error);
+
+/**
+* move a playback device to the first frame or event captured at or after the given time
+* \param[in] time    milliseconds since the recording was started
+* \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_seek_playback(rs_device * device, double time, rs_error ** error);
+
 /**
 * disable motion-tracking handlers
 */
@@ -662,6 +827,21 @@ void rs_set_device_options(rs_device * device, const rs_option * options, unsign
 */
 void rs_reset_device_options_to_default(rs_device * device, const rs_option* options, int count, rs_error ** error);
 
+/**
+ * begin an options batch, which holds back every option set on the device until rs_commit_device_options_batch, so that options
+ * held in the same camera control, such as the auto exposure or depth control parameters, are written together in one transfer.
+ * Options read while the batch is open return the values in effect before it
+ * \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_begin_device_options_batch(rs_device * device, rs_error ** error);
+
+/**
+ * set every option held back since rs_begin_device_options_batch, in the order they were last set, skipping camera controls whose
+ * value does not change, and close the batch. An option set several times in the batch is only set to its last value
+ * \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ */
+void rs_commit_device_options_batch(rs_device * device, rs_error ** error);
+
 /**
  * retrieve the current value of a single option
  * \param[in] option  the option whose value should be retrieved
@@ -689,11 +869,19 @@ const char * rs_get_device_option_description(rs_device * device, rs_option opti
 void rs_set_device_option(rs_device * device, rs_option option, double value, rs_error ** error);
 
 /**
- * block until new frames are available
+ * block until new frames are available, raising an error if none arrive within 5 seconds
  * \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
  */
 void rs_wait_for_frames(rs_device * device, rs_error ** error);
 
+/**
+ * block until new frames are available, or until the timeout expires
+ * \param[in] timeout_ms  the longest time to wait, in milliseconds. 0 checks for new frames without blocking
+ * \param[out] error      if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+ * \return                1 if new frames are available, 0 if the timeout expired or the device is not streaming
+ */
+int rs_wait_for_frames_timeout(rs_device * device, unsigned int timeout_ms, rs_error ** error);
+
 /**
  * check if new frames are available, without blocking
  * \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
@@ -848,6 +1036,46 @@ rs_stream rs_get_detached_frame_stream_type(const rs_frame_ref * frameset, rs_er
 */
 void rs_send_blob_to_device(rs_device * device, rs_blob_type type, void * data, int size, rs_error ** error);
 
+/**
+* retrieve the largest size that rs_compress_depth may take to compress the given number of 16 bit depth or disparity pixels, which is
+* also the size of the frame buffers of the RS_FORMAT_Z16_COMPRESSED and RS_FORMAT_DISPARITY16_COMPRESSED formats
+* \param[in] pixel_count  the number of pixels to compress
+* \param[out] error       if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+* \return                 the largest size of the compressed image in bytes
+*/
+int rs_get_max_compressed_depth_size(int pixel_count, rs_error ** error);
+
+/**
+* losslessly compress 16 bit depth or disparity pixels, in the same way as the frames of the RS_FORMAT_Z16_COMPRESSED and
+* RS_FORMAT_DISPARITY16_COMPRESSED formats
+* \param[in] pixels           the pixels to compress
+* \param[in] pixel_count      the number of pixels to compress
+* \param[out] compressed      receives the compressed image
+* \param[in] compressed_size  the size of the buffer at compressed, at least rs_get_max_compressed_depth_size(pixel_count) bytes
+* \param[out] error           if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+* \return                     the size of the compressed image in bytes
+*/
+int rs_compress_depth(const void * pixels, int pixel_count, void * compressed, int compressed_size, rs_error ** error);
+
+/**
+* retrieve the size of a compressed depth image, such as a frame of the RS_FORMAT_Z16_COMPRESSED format, which is stored at its start
+* \param[in] compressed       the compressed image
+* \param[in] compressed_size  the number of bytes available at compressed, which may be more than the size of the image
+* \param[out] error           if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+* \return                     the size of the compressed image in bytes
+*/
+int rs_get_compressed_depth_size(const void * compressed, int compressed_size, rs_error ** error);
+
+/**
+* decompress a compressed depth image, such as a frame of the RS_FORMAT_Z16_COMPRESSED or RS_FORMAT_DISPARITY16_COMPRESSED format
+* \param[in] compressed       the compressed image
+* \param[in] compressed_size  the number of bytes available at compressed, which may be more than the size of the image
+* \param[out] pixels          receives the 16 bit pixels
+* \param[in] pixel_count      the number of pixels the image holds, width * height for a frame
+* \param[out] error           if non-null, receives any error that occurs during this call, otherwise, errors are ignored
+*/
+void rs_decompress_depth(const void * compressed, int compressed_size, void * pixels, int pixel_count, rs_error ** error);
+
 /**
 * retrieve the API version from the source code. Evaluate that the value is conformant to the established policies
 * \param[out] error  if non-null, receives any error that occurs during this call, otherwise, errors are ignored
@@ -873,6 +1101,8 @@ const char * rs_blob_type_to_string  (rs_blob_type type);
 const char * rs_camera_info_to_string(rs_camera_info info);
 const char * rs_camera_info_to_string(rs_camera_info info);
 const char * rs_timestamp_domain_to_string(rs_timestamp_domain info);
+const char * rs_frameset_policy_to_string(rs_frameset_policy policy);
+const char * rs_playback_mode_to_string(rs_playback_mode mode);
 
 void rs_log_to_console(rs_log_severity min_severity, rs_error ** error);
 void rs_log_to_file(rs_log_severity min_severity, const char * file_path, rs_error ** error);
@@ -7,6 +7,7 @@
 #include "rsutil.h"
 #include "rscore.hpp"
 #include <cmath>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <sstream>
@@ -65,7 +66,9 @@ namespace rs
         y16         ,
         raw10       ,  ///< Four 10-bit luminance values encoded into a 5-byte macropixel
         raw16       ,  ///< Four 10-bit luminance filled in 16 bit pixel (6 bit unused)
-        raw8
+        raw8        ,
+        z16_compressed        ,  ///< Z16 pixels of the whole frame, losslessly compressed. See rs::decompress_depth
+        disparity16_compressed   ///< DISPARITY16 pixels of the whole frame, losslessly compressed. See rs::decompress_depth
     };
 
     enum class output_buffer_format : int32_t
@@ -157,9 +160,22 @@ namespace rs
         fisheye_color_auto_exposure_rate                , /**< Fisheye auto-exposure anti-flicker rate, can be 50 or 60 Hz */
         fisheye_color_auto_exposure_sample_rate         , /**< In Fisheye auto-exposure sample frame every given number of pixels */
         fisheye_color_auto_exposure_skip_frames         , /**< In Fisheye auto-exposure sample every given number of frames */
-        frames_queue_size                               , /**< Number of frames the user is allowed to keep per stream. Trying to hold-on to more frames will cause frame-drops.*/
+        frames_queue_size                               , /**< Number of frames the user is allowed to keep per stream. Trying to hold-on to more frames will cause frame-drops. Queues are sized, and buffers for the frames allocated, when streaming starts, and cannot grow until it restarts*/
         hardware_logger_enabled                         , /**< Enable / disable fetching log data from the device */
         total_frame_drops                               , /**< Total number of detected frame drops from all streams*/
+        zero_copy_enabled                               , /**< Enable / disable delivering frames that need no unpacking directly from the capture buffers, without copying. Set before streaming */
+        capture_ring_depth                              , /**< Number of capture buffers per subdevice. Frames delivered without copying may hold all but two of them, less the capture queue size (V4L2 only). Set before streaming */
+        capture_thread_per_subdevice                    , /**< Enable / disable a dedicated capture thread per subdevice (V4L2 only). Set before streaming */
+        capture_thread_affinity                         , /**< Bitmask of the CPUs the capture threads may run on, out of CPUs 0 to 52, 0 leaves the affinity unchanged (V4L2 only). Set before streaming */
+        capture_thread_priority                         , /**< SCHED_FIFO priority of the capture threads, 0 keeps the default scheduling policy (V4L2 only). Set before streaming */
+        capture_queue_size                              , /**< Number of captured frames per subdevice that may wait for unpacking, 0 unpacks on the capture thread (V4L2 only). Set before streaming */
+        unpack_threads                                  , /**< Number of worker threads unpacking frames off the capture thread, 0 unpacks on the capture thread. The capture ring grows to give each of them two capture buffers. Not available with libuvc or WMF. Set before streaming */
+        unpack_row_bands                                , /**< Number of row bands each frame is split into, to be unpacked in parallel by the unpack worker threads. Set before streaming */
+        processing_threads                              , /**< Number of worker threads computing the point cloud and aligned streams in row bands, 0 computes them on the calling thread */
+        timestamps_matched                              , /**< Total number of frames given the timestamp reported by the motion module */
+        timestamps_late                                 , /**< Total number of frames delivered with their camera timestamp, since no motion module timestamp matched them in time */
+        timestamps_dropped                              , /**< Total number of frames dropped by timestamp correction */
+        compress_recorded_depth                         , /**< Enable / disable lossless compression of the depth frames written by start_recording. Set before recording starts */
     };
 
     enum class blob_type {
@@ -216,6 +232,20 @@ namespace rs
         microcontroller
     };
 
+    enum class frameset_policy : int32_t
+    {
+        wait           , /**< Deliver complete framesets only, waiting for a missing frame for as long as it may still arrive */
+        emit_incomplete, /**< Deliver the frames which matched, once the frameset can no longer be completed */
+        drop             /**< Discard framesets which can no longer be completed */
+    };
+
+    enum class playback_mode : int32_t
+    {
+        real_time, /**< Deliver recorded frames and events at the pace at which they were captured */
+        fast     , /**< Deliver recorded frames and events as fast as the application consumes them */
+        stepped    /**< Deliver recorded frames only when step_playback is called */
+    };
+
     struct float2 { float x,y; };
     struct float3 { float x,y,z; };
 
@@ -322,6 +352,17 @@ namespace rs
             error::handle(e);
             return (device *)r;
         }
+
+        /// open a capture file written by device::start_recording as a device, which is added to the devices of the context
+        /// \param[in] filename  the path of the capture file
+        /// \return              the playback device, owned by the context
+        device * add_playback_device(const char * filename)
+        {
+            rs_error * e = nullptr;
+            auto r = rs_add_playback_device(handle, filename, &e);
+            error::handle(e);
+            return (device *)r;
+        }
     };  
 
     class motion_callback : public rs_motion_callback
@@ -517,6 +558,43 @@ namespace rs
         void release() override { delete this; }
     };
 
+    class frameset_callback : public rs_frameset_callback
+    {
+        std::function<void(std::vector<frame>)> on_frameset_function;
+    public:
+        explicit frameset_callback(std::function<void(std::vector<frame>)> on_frameset) : on_frameset_function(on_frameset) {}
+
+        void on_frameset(rs_device * device, rs_frame_ref ** frames, int count) override
+        {
+            std::vector<frame> frameset;
+            frameset.reserve(count);
+            for (int i = 0; i < count; ++i) frameset.emplace_back(device, frames[i]);
+            on_frameset_function(std::move(frameset));
+        }
+
+        void release() override { delete this; }
+    };
+
+    class frame_allocator : public rs_frame_allocator
+    {
+        std::function<void *(stream, size_t)> allocate_function;
+        std::function<void(stream, void *, size_t)> deallocate_function;
+    public:
+        frame_allocator(std::function<void *(stream, size_t)> allocate, std::function<void(stream, void *, size_t)> deallocate) : allocate_function(allocate), deallocate_function(deallocate) {}
+
+        void * allocate(rs_stream s, size_t size) override
+        {
+            return allocate_function((stream)s, size);
+        }
+
+        void deallocate(rs_stream s, void * buffer, size_t size) override
+        {
+            deallocate_function((stream)s, buffer, size);
+        }
+
+        void release() override { delete this; }
+    };
+
     class device
     {
         device() = delete;
@@ -772,6 +850,107 @@ namespace rs
             error::handle(e);
         }
 
+        /// sets the callback receiving the frames of all streams without a frame callback of their own, as sets of frames whose timestamps match
+        /// once set, these frames will no longer be available through wait/poll methods. must be called before the device is started
+        /// the callback is invoked in order from a dedicated thread, so that it does not hold up capture
+        /// \param[in] frameset_handler  callback to be invoked with each frameset, holding at most one frame of each stream
+        void set_frameset_callback(std::function<void(std::vector<frame>)> frameset_handler)
+        {
+            rs_error * e = nullptr;
+            rs_set_frameset_callback_cpp((rs_device *)this, new frameset_callback(frameset_handler), &e);
+            error::handle(e);
+        }
+
+        /// choose what happens to a frameset which is missing the frame of some stream. must be called before the device is started
+        /// \param[in] policy  the policy applied to incomplete framesets
+        void set_frameset_policy(frameset_policy policy)
+        {
+            rs_error * e = nullptr;
+            rs_set_frameset_policy((rs_device *)this, (rs_frameset_policy)policy, &e);
+            error::handle(e);
+        }
+
+        /// set how far apart the timestamps of the frames of two streams may be to belong to the same frameset
+        /// by default, the tolerance is half the frame interval of the faster of the two streams. must be called before the device is started
+        /// \param[in] a             one stream of the pair
+        /// \param[in] b             the other stream of the pair
+        /// \param[in] milliseconds  the largest timestamp difference allowed, or 0 to restore the default
+        void set_frameset_tolerance(stream a, stream b, double milliseconds)
+        {
+            rs_error * e = nullptr;
+            rs_set_frameset_tolerance((rs_device *)this, (rs_stream)a, (rs_stream)b, milliseconds, &e);
+            error::handle(e);
+        }
+
+        /// retrieve statistics of the frameset matching since the device was last started
+        /// \return  the number of framesets delivered and dropped, and the timestamp differences within them
+        rs_frameset_stats get_frameset_stats() const
+        {
+            rs_error * e = nullptr;
+            rs_frameset_stats stats;
+            rs_get_frameset_stats((const rs_device *)this, &stats, &e);
+            error::handle(e);
+            return stats;
+        }
+
+        /// provide the memory in which frame images are stored, such as hugepage-backed, NUMA-local or shared memory buffers
+        /// buffers are recycled between frames, and handed back to the deallocate routine once the library no longer needs them
+        /// must be called before the device is started
+        /// \param[in] allocate    routine returning a buffer of the given size for the given stream, or nullptr to let the library allocate it
+        /// \param[in] deallocate  routine reclaiming a buffer previously returned by allocate
+        void set_frame_allocator(std::function<void *(stream, size_t)> allocate, std::function<void(stream, void *, size_t)> deallocate)
+        {
+            rs_error * e = nullptr;
+            rs_set_frame_allocator_cpp((rs_device *)this, new frame_allocator(allocate, deallocate), &e);
+            error::handle(e);
+        }
+
+        /// record native frames, motion events and timestamp events into a capture file, along with the calibration of the device
+        /// must be called while the device is stopped, and records every time it is started until stop_recording is called
+        /// \param[in] filename  the path of the capture file, which is overwritten if it exists
+        void start_recording(const char * filename)
+        {
+            rs_error * e = nullptr;
+            rs_start_recording((rs_device *)this, filename, &e);
+            error::handle(e);
+        }
+
+        /// finish writing the capture file, and close it. must be called while the device is stopped
+        void stop_recording()
+        {
+            rs_error * e = nullptr;
+            rs_stop_recording((rs_device *)this, &e);
+            error::handle(e);
+        }
+
+        /// choose how a playback device paces the recorded frames, playback_mode::real_time by default
+        /// \param[in] mode  the pacing of the frames
+        void set_playback_mode(playback_mode mode)
+        {
+            rs_error * e = nullptr;
+            rs_set_playback_mode((rs_device *)this, (rs_playback_mode)mode, &e);
+            error::handle(e);
+        }
+
+        /// deliver the next frame of every stream being played back, while streaming in playback_mode::stepped
+        /// \return  true if any frame was delivered, false if the end of the recording was reached
+        bool step_playback()
+        {
+            rs_error * e = nullptr;
+            auto r = rs_step_playback((rs_device *)this, &e);
+            error::handle(e);
+            return r != 0;
+        }
+
+        /// move a playback device to the first frame or event captured at or after the given time
+        /// \param[in] time  milliseconds since the recording was started
+        void seek_playback(double time)
+        {
+            rs_error * e = nullptr;
+            rs_seek_playback((rs_device *)this, time, &e);
+            error::handle(e);
+        }
+
         ///// sets the callback for motion module event. provided callback will be called the instant new motion or timestamp event is available. 
         ///// \param[in] stream             the stream 
         ///// \param[in] motion_handler     frame callback to be invoke on every new motion event
@@ -888,6 +1067,23 @@ namespace rs
             error::handle(e);
         }
 
+        /// begin an options batch, which holds back every option set on the device until commit_options_batch, so that options held
+        /// in the same camera control are written together in one transfer
+        void begin_options_batch()
+        {
+            rs_error * e = nullptr;
+            rs_begin_device_options_batch((rs_device *)this, &e);
+            error::handle(e);
+        }
+
+        /// set every option held back since begin_options_batch, in the order they were last set, and close the batch
+        void commit_options_batch()
+        {
+            rs_error * e = nullptr;
+            rs_commit_device_options_batch((rs_device *)this, &e);
+            error::handle(e);
+        }
+
         /// retrieve the current value of a single option
         /// \param[in] option  the option whose value should be retrieved
         /// \return            the value of the option
@@ -929,6 +1125,27 @@ namespace rs
             error::handle(e);
         }
 
+        /// block until new frames are available, or until the timeout expires. unlike wait_for_frames, an expired timeout is not an error
+        /// \param[in] timeout  the shortest time to wait without frames, rounded up to whole milliseconds
+        /// \return             true if new frames are available, false if the timeout expired
+        template<class Rep, class Period> bool wait_for_frames(std::chrono::duration<Rep, Period> timeout)
+        {
+            auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(timeout);
+            if (timeout_ms < timeout) ++timeout_ms;
+            rs_error * e = nullptr;
+            auto r = rs_wait_for_frames_timeout((rs_device *)this, timeout_ms.count() > 0 ? static_cast<unsigned int>(timeout_ms.count()) : 0, &e);
+            error::handle(e);
+            return r != 0;
+        }
+
+        /// block until new frames are available, or until the deadline passes. unlike wait_for_frames, a passed deadline is not an error
+        /// \param[in] deadline  the earliest time to return at without frames, the wait ends up to a millisecond later
+        /// \return              true if new frames are available, false if the deadline passed
+        bool wait_for_frames(std::chrono::steady_clock::time_point deadline)
+        {
+            return wait_for_frames(deadline - std::chrono::steady_clock::now());
+        }
+
         /// check if new frames are available, without blocking
         /// \return  true if new frames are available, false if no new frames have arrived
         bool poll_for_frames()
@@ -1015,6 +1232,8 @@ namespace rs
     inline std::ostream & operator << (std::ostream & o, capabilities capability) { return o << rs_capabilities_to_string((rs_capabilities)capability); }
     inline std::ostream & operator << (std::ostream & o, source src) { return o << rs_source_to_string((rs_source)src); }
     inline std::ostream & operator << (std::ostream & o, event evt) { return o << rs_event_to_string((rs_event_source)evt); }
+    inline std::ostream & operator << (std::ostream & o, frameset_policy policy) { return o << rs_frameset_policy_to_string((rs_frameset_policy)policy); }
+    inline std::ostream & operator << (std::ostream & o, playback_mode mode) { return o << rs_playback_mode_to_string((rs_playback_mode)mode); }
 
 
     enum class log_severity : int32_t
@@ -1062,6 +1281,45 @@ namespace rs
         error::handle(e);
     }
 
+    /// losslessly compress 16 bit depth or disparity pixels, in the same way as the frames of the z16_compressed and disparity16_compressed formats
+    /// \param[in] pixels       the pixels to compress
+    /// \param[in] pixel_count  the number of pixels to compress
+    /// \return                 the compressed image
+    inline std::vector<uint8_t> compress_depth(const uint16_t * pixels, int pixel_count)
+    {
+        rs_error * e = nullptr;
+        std::vector<uint8_t> compressed(rs_get_max_compressed_depth_size(pixel_count, &e));
+        error::handle(e);
+        auto size = rs_compress_depth(pixels, pixel_count, compressed.data(), (int)compressed.size(), &e);
+        error::handle(e);
+        compressed.resize(size);
+        return compressed;
+    }
+
+    /// retrieve the size of a compressed depth image, such as a frame of the z16_compressed format, which is stored at its start
+    /// \param[in] compressed       the compressed image
+    /// \param[in] compressed_size  the number of bytes available at compressed, which may be more than the size of the image
+    /// \return                     the size of the compressed image in bytes
+    inline int get_compressed_depth_size(const void * compressed, int compressed_size)
+    {
+        rs_error * e = nullptr;
+        auto r = rs_get_compressed_depth_size(compressed, compressed_size, &e);
+        error::handle(e);
+        return r;
+    }
+
+    /// decompress a compressed depth image, such as a frame of the z16_compressed or disparity16_compressed format
+    /// \param[in] compressed       the compressed image
+    /// \param[in] compressed_size  the number of bytes available at compressed, which may be more than the size of the image
+    /// \param[out] pixels          receives the 16 bit pixels
+    /// \param[in] pixel_count      the number of pixels the image holds, width * height for a frame
+    inline void decompress_depth(const void * compressed, int compressed_size, uint16_t * pixels, int pixel_count)
+    {
+        rs_error * e = nullptr;
+        rs_decompress_depth(compressed, compressed_size, pixels, pixel_count, &e);
+        error::handle(e);
+    }
+
     // Additional utilities
     inline void apply_depth_control_preset(device * device, int preset) { rs_apply_depth_control_preset((rs_device *)device, preset); }
     inline void apply_ivcam_preset(device * device, rs_ivcam_preset preset) { rs_apply_ivcam_preset((rs_device *)device, preset); }
@@ -79,6 +79,11 @@ struct rs_device
     virtual void                            enable_motion_tracking() = 0;
     virtual void                            set_stream_callback(rs_stream stream, void(*on_frame)(rs_device * device, rs_frame_ref * frame, void * user), void * user) = 0;
     virtual void                            set_stream_callback(rs_stream stream, rs_frame_callback * callback) = 0;
+    virtual void                            set_frameset_callback(void(*on_frameset)(rs_device * device, rs_frame_ref ** frames, int count, void * user), void * user) = 0;
+    virtual void                            set_frameset_callback(rs_frameset_callback * callback) = 0;
+    virtual void                            set_frameset_policy(rs_frameset_policy policy) = 0;
+    virtual void                            set_frameset_tolerance(rs_stream a, rs_stream b, double milliseconds) = 0;
+    virtual rs_frameset_stats               get_frameset_stats() const = 0;
     virtual void                            disable_motion_tracking() = 0;
 
     virtual rs_motion_intrinsics            get_motion_intrinsics() const = 0;
@@ -87,6 +92,13 @@ struct rs_device
     virtual void                            set_motion_callback(rs_motion_callback * callback) = 0;
     virtual void                            set_timestamp_callback(void(*on_event)(rs_device * device, rs_timestamp_data data, void * user), void * user) = 0;
     virtual void                            set_timestamp_callback(rs_timestamp_callback * callback) = 0;
+    virtual void                            set_frame_allocator(rs_frame_allocate_ptr allocate, rs_frame_deallocate_ptr deallocate, void * user) = 0;
+    virtual void                            set_frame_allocator(rs_frame_allocator * allocator) = 0;
+    virtual void                            start_recording(const char * filename) = 0;
+    virtual void                            stop_recording() = 0;
+    virtual void                            set_playback_mode(rs_playback_mode mode) = 0;
+    virtual bool                            step_playback() = 0;
+    virtual void                            seek_playback(double time) = 0;
                                             
     virtual void                            start(rs_source source) = 0;
     virtual void                            stop(rs_source source) = 0;
@@ -98,6 +110,7 @@ struct rs_device
     virtual int                             is_motion_tracking_active() const = 0;
                                             
     virtual void                            wait_all_streams() = 0;
+    virtual bool                            wait_all_streams(unsigned int timeout_ms) = 0;
     virtual bool                            poll_all_streams() = 0;
                                             
     virtual bool                            supports(rs_capabilities capability) const = 0;
@@ -107,6 +120,8 @@ struct rs_device
     virtual void                            get_option_range(rs_option option, double & min, double & max, double & step, double & def) = 0;
     virtual void                            set_options(const rs_option options[], size_t count, const double values[]) = 0;
     virtual void                            get_options(const rs_option options[], size_t count, double values[]) = 0;
+    virtual void                            begin_options_batch() = 0;
+    virtual void                            commit_options_batch() = 0;
     virtual const char *                    get_option_description(rs_option option) const = 0;
 
     virtual void                            release_frame(rs_frame_ref * ref) = 0;
@@ -119,6 +134,7 @@ struct rs_context
 {
     virtual size_t                          get_device_count() const = 0;
     virtual rs_device *                     get_device(int index) const = 0;
+    virtual rs_device *                     add_playback_device(const char * filename) = 0;
     virtual                                 ~rs_context() {}
 };
 
@@ -136,6 +152,13 @@ struct rs_frame_callback
     virtual                                 ~rs_frame_callback() {}
 };
 
+struct rs_frameset_callback
+{
+    virtual void                            on_frameset(rs_device * device, rs_frame_ref ** frames, int count) = 0;
+    virtual void                            release() = 0;
+    virtual                                 ~rs_frameset_callback() {}
+};
+
 struct rs_timestamp_callback
 {
     virtual void                            on_event(rs_timestamp_data data) = 0;
@@ -143,6 +166,14 @@ struct rs_timestamp_callback
     virtual                                 ~rs_timestamp_callback() {}
 };
 
+struct rs_frame_allocator
+{
+    virtual void *                          allocate(rs_stream stream, size_t size) = 0;
+    virtual void                            deallocate(rs_stream stream, void * buffer, size_t size) = 0;
+    virtual void                            release() = 0;
+    virtual                                 ~rs_frame_allocator() {}
+};
+
 struct rs_log_callback
 {
     virtual void                            on_event(rs_log_severity severity, const char * message) = 0;
@@ -4,8 +4,9 @@
 
 using namespace rsimpl;
 
-frame_archive::frame_archive(const std::vector<subdevice_mode_selection>& selection, std::atomic<uint32_t>* in_max_frame_queue_size, std::chrono::high_resolution_clock::time_point capture_started)
-    : max_frame_queue_size(in_max_frame_queue_size), mutex(), capture_started(capture_started)
+frame_archive::frame_archive(const std::vector<subdevice_mode_selection>& selection, std::atomic<uint32_t>* in_max_frame_queue_size, uint32_t frames_in_transit, std::chrono::high_resolution_clock::time_point capture_started)
+    : max_frame_queue_size(in_max_frame_queue_size), user_queue_size(std::max(in_max_frame_queue_size->load(), 1u)), frames_per_stream(user_queue_size + 1 + frames_in_transit), published_frames(0), keep_publishing(true),
+      published_sets(user_queue_size * RS_STREAM_COUNT), detached_refs(user_queue_size * RS_STREAM_COUNT), backbuffer(), capture_started(capture_started)
 {
     // Store the mode selection that pertains to each native stream
     for (auto & mode : selection)
@@ -16,10 +17,17 @@ frame_archive::frame_archive(const std::vector<subdevice_mode_selection>& select
         }
     }
 
-    for(auto s : {RS_STREAM_DEPTH, RS_STREAM_INFRARED, RS_STREAM_INFRARED2, RS_STREAM_COLOR, RS_STREAM_FISHEYE})
+    for (auto & count : published_frames_per_stream)
     {
-        published_frames_per_stream[s] = 0;
+        count = 0;
     }
+
+    // Every frame which may be alive at once keeps its frame object and its buffer in the pools, so that streaming allocates none
+    for (auto & pool : buffer_pools)
+    {
+        pool.reset(new frame_buffer_pool(frames_per_stream));
+    }
+    frame_pool.reserve(frames_per_stream * RS_STREAM_NATIVE_COUNT);
 }
 
 frame_archive::frameset* frame_archive::clone_frameset(frameset* frameset)
@@ -37,31 +45,44 @@ void frame_archive::unpublish_frame(frame* frame)
     if (frame)
     {
         log_frame_callback_end(frame);
-        std::lock_guard<std::recursive_mutex> lock(mutex);
 
         if (is_valid(frame->get_stream_type()))
             --published_frames_per_stream[frame->get_stream_type()];
 
-        freelist.push_back(std::move(*frame));
-        published_frames.deallocate(frame);
-       
+        recycle_frame(frame);
+        count_unpublished_frame();
+    }
+}
+
+void frame_archive::count_unpublished_frame()
+{
+    if (--published_frames == 0)
+    {
+        { std::lock_guard<std::mutex> lock(flush_mutex); } // A flushing thread either saw the count drop, or is already waiting for the notification
+        flushed.notify_all();
     }
 }
 
-frame_archive::frame* frame_archive::publish_frame(frame&& frame)
+// Publishing hands the frame itself to the application, there is nothing to copy or move
+frame_archive::frame* frame_archive::publish_frame(frame* frame)
 {
-    if (is_valid(frame.get_stream_type()) &&
-        published_frames_per_stream[frame.get_stream_type()] >= *max_frame_queue_size)
+    auto stream = frame->get_stream_type();
+    if (is_valid(stream) && published_frames_per_stream[stream] >= std::min(max_frame_queue_size->load(), user_queue_size))
     {
+        recycle_frame(frame);
         return nullptr;
     }
-    auto new_frame = published_frames.allocate();
-    if (new_frame)
+
+    // Count the frame before checking for a flush, so that the flush either refuses the frame here or waits for its release
+    ++published_frames;
+    if (!keep_publishing)
     {
-        if (is_valid(frame.get_stream_type())) ++published_frames_per_stream[frame.get_stream_type()];
-        *new_frame = std::move(frame);
+        recycle_frame(frame);
+        count_unpublished_frame();
+        return nullptr;
     }
-    return new_frame;
+    if (is_valid(stream)) ++published_frames_per_stream[stream];
+    return frame;
 }
 
 frame_archive::frame_ref* frame_archive::detach_frame_ref(frameset* frameset, rs_stream stream)
@@ -84,7 +105,36 @@ frame_archive::frame_ref* frame_archive::clone_frame(frame_ref* frameset)
     return new_ref;
 }
 
-// Allocate a new frame in the backbuffer, potentially recycling a buffer from the freelist
+// Return the memory held by a frame to the buffer pool of its stream, and the frame itself to the frame pool
+void frame_archive::recycle_frame(frame* frame)
+{
+    auto stream = frame->get_stream_type();
+    if (is_valid(stream) && stream < RS_STREAM_NATIVE_COUNT)
+    {
+        buffer_pools[stream]->release(std::move(frame->data));
+    }
+    frame->reset();
+    frame_pool.deallocate(frame);
+}
+
+frame_archive::frame & frame_archive::get_backbuffer(rs_stream stream)
+{
+    if (!backbuffer[stream])
+    {
+        backbuffer[stream] = frame_pool.allocate();
+        backbuffer[stream]->update_owner(this);
+    }
+    return *backbuffer[stream];
+}
+
+frame_archive::frame * frame_archive::detach_backbuffer(rs_stream stream)
+{
+    auto frame = &get_backbuffer(stream);
+    backbuffer[stream] = nullptr;
+    return frame;
+}
+
+// Allocate a new frame in the backbuffer, recycling a buffer from the pool of this stream when possible
 byte * frame_archive::alloc_frame(rs_stream stream, const frame_additional_data& additional_data, bool requires_memory)
 {
     size_t size;
@@ -94,50 +144,43 @@ byte * frame_archive::alloc_frame(rs_stream stream, const frame_additional_data&
 
         size = modes[stream].get_image_size(stream);
     }
-    {
-        std::lock_guard<std::recursive_mutex> guard(mutex);
 
-        if (requires_memory)
-        {
-            // Attempt to obtain a buffer of the appropriate size from the freelist
-            for (auto it = begin(freelist); it != end(freelist); ++it)
-            {
-                if (it->data.size() == size)
-                {
-                    backbuffer[stream] = std::move(*it);
-                    freelist.erase(it);
-                    break;
-                }
-            }
-        }
-
-        // Discard buffers that have been in the freelist for longer than 1s
-        for (auto it = begin(freelist); it != end(freelist);)
-        {
-            if (additional_data.timestamp > it->additional_data.timestamp + 1000) it = freelist.erase(it);
-            else ++it;
-        }
-    }
-    
-    if (requires_memory)
+    // The backbuffer may still hold the buffer of a frame which was never handed over
+    auto & frame = get_backbuffer(stream);
+    auto & data = frame.data;
+    if (!requires_memory || data.size() != size)
     {
-        backbuffer[stream].data.resize(size); // TODO: Allow users to provide a custom allocator for frame buffers
+        buffer_pools[stream]->release(std::move(data));
+        data = requires_memory ? buffer_pools[stream]->acquire(size) : frame_buffer();
     }
-    backbuffer[stream].update_owner(this);
-    backbuffer[stream].additional_data = additional_data;
-    return backbuffer[stream].data.data();
+
+    frame.additional_data = additional_data;
+    return data.data();
+}
+
+byte * frame_archive::alloc_frame(rs_stream stream, const frame_additional_data& additional_data, frame_buffer && data)
+{
+    auto & frame = get_backbuffer(stream);
+    buffer_pools[stream]->release(std::move(frame.data));
+    frame.data = std::move(data);
+    frame.additional_data = additional_data;
+    return frame.data.data();
 }
 
 void frame_archive::attach_continuation(rs_stream stream, frame_continuation&& continuation)
 {
-    backbuffer[stream].attach_continuation(std::move(continuation));
+    get_backbuffer(stream).attach_continuation(std::move(continuation));
 }
 
 frame_archive::frame_ref* frame_archive::track_frame(rs_stream stream)
 {
-    std::unique_lock<std::recursive_mutex> lock(mutex);
+    return track_frame(detach_backbuffer(stream));
+}
 
-    auto published_frame = backbuffer[stream].publish();
+// Safe to call from the threads of several streams at once, publishing only touches the thread safe pools and counters
+frame_archive::frame_ref* frame_archive::track_frame(frame * frame)
+{
+    auto published_frame = frame->publish();
     if (published_frame)
     {
         frame_ref new_ref(published_frame); // allocate new frame_ref to ref-counter the now published frame
@@ -149,13 +192,26 @@ frame_archive::frame_ref* frame_archive::track_frame(rs_stream stream)
 
 void frame_archive::flush()
 {
-    published_frames.stop_allocation();
+    for (auto s : { RS_STREAM_DEPTH, RS_STREAM_COLOR, RS_STREAM_INFRARED, RS_STREAM_INFRARED2, RS_STREAM_FISHEYE })
+    {
+        if (!is_stream_enabled(s)) continue;
+        auto stats = buffer_pools[s]->get_stats();
+        LOG_INFO("Frame buffer pool for " << s << ": " << stats.hits << " hits, " << stats.misses << " misses, " << stats.allocations << " allocations");
+    }
+
+    keep_publishing = false;
     published_sets.stop_allocation();
     detached_refs.stop_allocation();
 
     // wait until user is done with all the stuff he chose to borrow
     detached_refs.wait_until_empty();
-    published_frames.wait_until_empty();
+    {
+        std::unique_lock<std::mutex> lock(flush_mutex);
+        if (!flushed.wait_for(lock, std::chrono::hours(1000), [this]() { return published_frames == 0; })) // for some reason passing std::chrono::duration::max makes it return instantly
+        {
+            throw std::runtime_error("Could not flush one of the user controlled objects!");
+        }
+    }
     published_sets.wait_until_empty();
 }
 
@@ -171,7 +227,15 @@ void frame_archive::frame::release()
 
 frame_archive::frame* frame_archive::frame::publish()
 {
-    return owner->publish_frame(std::move(*this));
+    return owner->publish_frame(this);
+}
+
+void frame_archive::frame::reset()
+{
+    attach_continuation(frame_continuation()); // Runs the continuation, which hands a zero-copy capture buffer back to the driver
+    data = frame_buffer();
+    additional_data = frame_additional_data();
+    ref_count = 0;
 }
 
 frame_archive::frame_ref frame_archive::frameset::detach_ref(rs_stream stream)
@@ -179,9 +243,9 @@ frame_archive::frame_ref frame_archive::frameset::detach_ref(rs_stream stream)
     return std::move(buffer[stream]);
 }
 
-void frame_archive::frameset::place_frame(rs_stream stream, frame&& new_frame)
+void frame_archive::frameset::place_frame(rs_stream stream, frame * new_frame)
 {
-    auto published_frame = new_frame.publish();
+    auto published_frame = new_frame->publish();
     if (published_frame)
     {
         frame_ref new_ref(published_frame); // allocate new frame_ref to ref-counter the now published frame
@@ -284,21 +348,12 @@ double frame_archive::frame::get_frame_metadata(rs_frame_metadata frame_metadata
     if (!supports_frame_metadata(frame_metadata))
         throw std::logic_error("unsupported metadata type");
 
-    switch (frame_metadata)
-    {
-        case RS_FRAME_METADATA_ACTUAL_EXPOSURE:
-            return additional_data.exposure_value;
-            break;
-        default:
-            throw std::logic_error("unsupported metadata type");
-            break;
-    }
+    return additional_data.metadata[frame_metadata];
 }
 
 bool frame_archive::frame::supports_frame_metadata(rs_frame_metadata frame_metadata) const
 {
-    for (auto & md : additional_data.supported_metadata_vector) if (md == frame_metadata) return true;
-    return false;
+    return frame_metadata >= 0 && frame_metadata < RS_FRAME_METADATA_COUNT && (additional_data.supported_metadata >> frame_metadata & 1);
 }
 
 const byte* frame_archive::frame::get_frame_data() const
@@ -18,7 +18,6 @@ namespace rsimpl
         struct frame_additional_data
         {
             double timestamp = 0;
-            double exposure_value = 0;
             unsigned long long frame_number = 0;
             long long system_time = 0;
             int width = 0;
@@ -31,7 +30,8 @@ namespace rsimpl
             rs_stream stream_type = RS_STREAM_COUNT;
             rs_timestamp_domain timestamp_domain = RS_TIMESTAMP_DOMAIN_CAMERA;
             int pad = 0;
-            std::vector<rs_frame_metadata> supported_metadata_vector;
+            uint32_t supported_metadata = 0;                    // Bit (1 << metadata) is set for each value of metadata that holds
+            double metadata[RS_FRAME_METADATA_COUNT] = {};
             std::chrono::high_resolution_clock::time_point frame_callback_started {};
 
             frame_additional_data(){};
@@ -39,7 +39,7 @@ namespace rsimpl
             frame_additional_data(double in_timestamp, unsigned long long in_frame_number, long long in_system_time, 
                 int in_width, int in_height, int in_fps, 
                 int in_stride_x, int in_stride_y, int in_bpp, 
-                const rs_format in_format, rs_stream in_stream_type, int in_pad, std::vector<rs_frame_metadata> in_supported_metadata_vector, double in_exposure_value)
+                const rs_format in_format, rs_stream in_stream_type, int in_pad, uint32_t in_supported_metadata, double in_exposure_value)
                 : timestamp(in_timestamp),
                   frame_number(in_frame_number),
                   system_time(in_system_time),
@@ -52,42 +52,28 @@ namespace rsimpl
                   format(in_format),
                   stream_type(in_stream_type),
                   pad(in_pad),
-                  supported_metadata_vector(in_supported_metadata_vector),
-                  exposure_value(in_exposure_value) {}
+                  supported_metadata(in_supported_metadata)
+            {
+                metadata[RS_FRAME_METADATA_ACTUAL_EXPOSURE] = in_exposure_value;
+            }
         };
 
-        // Define a movable but explicitly noncopyable buffer type to hold our frame data
-        struct frame : frame_interface
+        // Holds the data of a frame. Frames live in the frame pool of their archive, on cache lines of their own, and never
+        // move: the backbuffer, the queues, the timestamp corrector and the application all hand them over by pointer.
+        struct alignas(RS_CACHE_LINE_SIZE) frame : frame_interface
         {
         private:
-            // TODO: check boost::intrusive_ptr or an alternative
             std::atomic<int> ref_count; // the reference count is on how many times this placeholder has been observed (not lifetime, not content)
             frame_archive * owner; // pointer to the owner to be returned to by last observe
             frame_continuation on_release;
 
         public:
-            std::vector<byte> data;
+            frame_buffer data;
             frame_additional_data additional_data;
 
             explicit frame() : ref_count(0), owner(nullptr), on_release(){}
             frame(const frame & r) = delete;
-            frame(frame && r) 
-                : ref_count(r.ref_count.exchange(0)), 
-                  owner(r.owner), on_release() 
-            {
-                *this = std::move(r); // TODO: This is not very safe, refactor later
-            }
-
             frame & operator=(const frame & r) = delete;
-            frame& operator=(frame&& r)
-            {
-                data = move(r.data);
-                owner = r.owner;
-                ref_count = r.ref_count.exchange(0);
-                on_release = std::move(r.on_release);
-                additional_data = std::move(r.additional_data);
-                return *this;
-            }
 
             ~frame() { on_release.reset(); }
 
@@ -115,6 +101,7 @@ namespace rsimpl
             void release();
             frame* publish();
             void update_owner(frame_archive * new_owner) { owner = new_owner; }
+            void reset(); // Runs the continuation and clears the frame, once its buffer was recycled
             void attach_continuation(frame_continuation&& continuation) { on_release = std::move(continuation); }
             void disable_continuation() { on_release.reset(); }
         };
@@ -186,7 +173,7 @@ namespace rsimpl
         public:
 
             frame_ref detach_ref(rs_stream stream);
-            void place_frame(rs_stream stream, frame&& new_frame);
+            void place_frame(rs_stream stream, frame * new_frame); // Takes over the frame
 
             const rs_frame_ref * get_frame(rs_stream stream) const
             {
@@ -211,20 +198,32 @@ namespace rsimpl
         subdevice_mode_selection modes[RS_STREAM_NATIVE_COUNT];
         
         std::atomic<uint32_t>* max_frame_queue_size;
+        uint32_t user_queue_size;               // Frames the user may hold per stream, which the pools below were sized for when the archive was created
+        uint32_t frames_per_stream;             // Frames of a stream that may be alive at once: held by the user, in the backbuffer, or in transit to the user
         std::atomic<uint32_t> published_frames_per_stream[RS_STREAM_COUNT];
-        small_heap<frame, RS_USER_QUEUE_SIZE*RS_STREAM_COUNT> published_frames;
-        small_heap<frameset, RS_USER_QUEUE_SIZE*RS_STREAM_COUNT> published_sets;
-        small_heap<frame_ref, RS_USER_QUEUE_SIZE*RS_STREAM_COUNT> detached_refs;
-        
+        std::atomic<int> published_frames;
+        std::atomic<bool> keep_publishing;
+        std::mutex flush_mutex;
+        std::condition_variable flushed;        // Notified once the last published frame is released
+        object_pool<frame, RS_FRAME_POOL_BLOCK_SIZE> frame_pool;
+        small_heap<frameset> published_sets;
+        small_heap<frame_ref> detached_refs;
+        std::unique_ptr<frame_buffer_pool> buffer_pools[RS_STREAM_NATIVE_COUNT];
+
+        void count_unpublished_frame();
 
     protected:
-        frame backbuffer[RS_STREAM_NATIVE_COUNT]; // recieve frame here
-        std::vector<frame> freelist; // return frames here
-        std::recursive_mutex mutex;
+        frame * backbuffer[RS_STREAM_NATIVE_COUNT]; // recieve frame here, taken from the frame pool on demand
         std::chrono::high_resolution_clock::time_point capture_started;
 
+        frame & get_backbuffer(rs_stream stream);
+        frame * detach_backbuffer(rs_stream stream); // The caller takes over the frame, and publishes or recycles it
+
     public:
-        frame_archive(const std::vector<subdevice_mode_selection> & selection, std::atomic<uint32_t>* max_frame_queue_size, std::chrono::high_resolution_clock::time_point capture_started = std::chrono::high_resolution_clock::now());
+        // The pools for the frames, framesets and frame references handed to the user are sized for the current max_frame_queue_size.
+        // Later changes to it may lower the number of frames the user may hold, but not raise it beyond what the pools were sized for.
+        // frames_in_transit counts the frames per stream which are neither held by the user nor in the backbuffer, but on their way to the user.
+        frame_archive(const std::vector<subdevice_mode_selection> & selection, std::atomic<uint32_t>* max_frame_queue_size, uint32_t frames_in_transit, std::chrono::high_resolution_clock::time_point capture_started = std::chrono::high_resolution_clock::now());
 
         // Safe to call from any thread
         bool is_stream_enabled(rs_stream stream) const { return modes[stream].mode.pf.fourcc != 0; }
@@ -237,18 +236,28 @@ namespace rsimpl
         frameset * clone_frameset(frameset * frameset);
 
         void unpublish_frame(frame * frame);
-        frame * publish_frame(frame && frame);
+        frame * publish_frame(frame * frame); // Takes over the frame, and recycles it if it cannot be published
 
         frame_ref * detach_frame_ref(frameset * frameset, rs_stream stream);
         frame_ref * clone_frame(frame_ref * frameset);
+        void recycle_frame(frame * frame);
         void release_frame_ref(frame_ref * ref)
         {
             detached_refs.deallocate(ref);
         }
 
         // Frame callback thread API
+        void reserve_frame_buffers(rs_stream stream, size_t size, int count, std::shared_ptr<rs_frame_allocator> allocator) { buffer_pools[stream]->reserve(stream, size, count, std::move(allocator)); }
+        buffer_pool_stats get_frame_buffer_stats(rs_stream stream) const { return buffer_pools[stream]->get_stats(); }
+        size_t get_frame_pool_capacity() { return frame_pool.capacity(); }
+        uint32_t get_user_queue_size() const { return user_queue_size; }
+        uint32_t get_frames_per_stream() const { return frames_per_stream; }
         byte * alloc_frame(rs_stream stream, const frame_additional_data& additional_data, bool requires_memory);
+        byte * alloc_frame(rs_stream stream, const frame_additional_data& additional_data, frame_buffer && data); // Takes over a buffer which was filled in advance
+        frame_buffer acquire_frame_buffer(rs_stream stream) { return buffer_pools[stream]->acquire(modes[stream].get_image_size(stream)); } // Safe to call from any thread
+        void release_frame_buffer(rs_stream stream, frame_buffer buffer) { buffer_pools[stream]->release(std::move(buffer)); } // Safe to call from any thread
         frame_ref * track_frame(rs_stream stream);
+        frame_ref * track_frame(frame * frame); // Takes over the frame
         void attach_continuation(rs_stream stream, frame_continuation&& continuation);
         void log_frame_callback_end(frame* frame);
         void log_callback_start(frame_ref* frame_ref, std::chrono::high_resolution_clock::time_point capture_start_time);
@@ -0,0 +1,142 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#ifndef LIBREALSENSE_CAPTURE_FILE_H
+#define LIBREALSENSE_CAPTURE_FILE_H
+
+#include "types.h"
+
+#include <cstring>
+
+namespace rsimpl
+{
+    // Layout of the capture files written by the recorder. A capture file is a sequence of chunks. Each chunk starts on a CHUNK_ALIGNMENT
+    // byte boundary with a chunk_header, followed by a fixed size record describing it, and its payload at header_size bytes from the start
+    // of the chunk, so that a mapped file can be walked and its frames unpacked in place. Values are stored in the byte order of the host.
+    //
+    // The file starts with a file_header chunk, followed by the device_info chunk holding the calibration of the camera. Every start of
+    // streaming writes a stream_config chunk, followed by the video_frame (or compressed_video_frame), motion_event and timestamp_event
+    // chunks captured. Closing the file appends an index chunk listing every chunk after the device info, and a trailer chunk pointing back
+    // at it. A recording which was cut short has no trailer, and can be indexed by walking its chunks.
+    namespace capture_file
+    {
+        const uint32_t MAGIC           = 'RSCF';
+        const uint32_t VERSION         = 1;
+        const uint64_t CHUNK_ALIGNMENT = 64;
+
+        enum class chunk_type : uint32_t
+        {
+            file_header,
+            device_info,        // Payload is a serialized static_device_info, see recorder::record_device_info
+            stream_config,      // Payload is the serialized mode selections and stream requests, see recorder::record_stream_config
+            video_frame,        // Payload is a native frame, exactly as the backend delivered it
+            motion_event,
+            timestamp_event,
+            index,              // Payload is an array of index_entry
+            trailer,
+            compressed_video_frame  // Record is a video_frame, payload is a native 16 bit depth frame compressed by the depth codec, see depth-codec.h
+        };
+
+        #pragma pack(push, 1)
+        struct chunk_header
+        {
+            chunk_type type;
+            uint32_t header_size;                   // Offset of the payload from the start of the chunk, a multiple of CHUNK_ALIGNMENT
+            uint64_t payload_size;
+        };
+
+        struct file_header { uint32_t magic, version; };
+        struct device_info { double capture_time; };
+        struct stream_config { double capture_time; };
+        struct video_frame { int32_t subdevice; uint32_t fourcc; int32_t width, height; uint64_t frame_number, frame_counter; double timestamp, system_time, capture_time; }; // Timestamp and counter as read from the frame
+        struct motion_event { double timestamp; int32_t source; uint32_t is_valid; uint64_t frame_number; float axes[3]; double capture_time; };
+        struct timestamp_event { double timestamp; int32_t source; uint64_t frame_number; double capture_time; };
+        struct index_entry { uint64_t offset; chunk_type type; int32_t subdevice; double capture_time; }; // Subdevice is -1 for all but video frames
+        struct index_table { uint64_t entry_count; };
+        struct trailer { uint64_t index_offset, index_size; uint32_t magic; };
+        #pragma pack(pop)
+
+        inline uint64_t align(uint64_t size) { return (size + CHUNK_ALIGNMENT - 1) & ~(CHUNK_ALIGNMENT - 1); }
+        template<class RECORD> uint32_t get_header_size() { return static_cast<uint32_t>(align(sizeof(chunk_header) + sizeof(RECORD))); }
+        template<class RECORD> uint64_t get_chunk_size(uint64_t payload_size) { return get_header_size<RECORD>() + align(payload_size); }
+
+        // Appends the variable length payloads of the device_info and stream_config chunks, field by field, so that they do not depend on struct padding
+        class serializer
+        {
+            std::vector<uint8_t> & buffer;
+        public:
+            explicit serializer(std::vector<uint8_t> & buffer) : buffer(buffer) {}
+
+            template<class T> void write_pod(const T & value)
+            {
+                auto p = reinterpret_cast<const uint8_t *>(&value);
+                buffer.insert(buffer.end(), p, p + sizeof(T));
+            }
+            void write(int32_t value) { write_pod(value); }
+            void write(uint32_t value) { write_pod(value); }
+            void write(float value) { write_pod(value); }
+            void write(double value) { write_pod(value); }
+            void write(const std::string & value) { write(static_cast<uint32_t>(value.size())); buffer.insert(buffer.end(), value.begin(), value.end()); }
+            void write(const rs_intrinsics & value) { write_pod(value); }
+            void write(const stream_request & value)
+            {
+                write(static_cast<int32_t>(value.enabled));
+                write(value.width);
+                write(value.height);
+                write(static_cast<int32_t>(value.format));
+                write(value.fps);
+                write(static_cast<int32_t>(value.output_format));
+            }
+            template<class T> void write(const std::vector<T> & values) { write(static_cast<uint32_t>(values.size())); for (auto & v : values) write(v); }
+        };
+
+        // Reads back the payloads written by serializer, throwing if they end early
+        class deserializer
+        {
+            const uint8_t * data, * end;
+
+            void require(size_t size) const { if (static_cast<size_t>(end - data) < size) throw std::runtime_error("capture file is truncated or corrupted"); }
+        public:
+            deserializer(const void * data, size_t size) : data(static_cast<const uint8_t *>(data)), end(static_cast<const uint8_t *>(data) + size) {}
+
+            template<class T> void read_pod(T & value)
+            {
+                require(sizeof(T));
+                memcpy(&value, data, sizeof(T));
+                data += sizeof(T);
+            }
+            template<class T> T read() { T value; read(value); return value; }
+            void read(int32_t & value) { read_pod(value); }
+            void read(uint32_t & value) { read_pod(value); }
+            void read(float & value) { read_pod(value); }
+            void read(double & value) { read_pod(value); }
+            void read(std::string & value)
+            {
+                auto size = read<uint32_t>();
+                require(size);
+                value.assign(reinterpret_cast<const char *>(data), size);
+                data += size;
+            }
+            void read(rs_intrinsics & value) { read_pod(value); }
+            void read(stream_request & value)
+            {
+                value.enabled = read<int32_t>() != 0;
+                read(value.width);
+                read(value.height);
+                value.format = static_cast<rs_format>(read<int32_t>());
+                read(value.fps);
+                value.output_format = static_cast<rs_output_buffer_format>(read<int32_t>());
+            }
+            template<class T> void read(std::vector<T> & values)
+            {
+                auto count = read<uint32_t>();
+                require(count); // Every item takes at least a byte, which bounds the count of a corrupted file
+                values.resize(count);
+                for (auto & v : values) read(v);
+            }
+        };
+    }
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include "sr300.h"
 #include "zr300.h"
 #include "lr200_mm.h"
+#include "playback.h"
 #include "uvc.h"
 #include "context.h"
 
@@ -132,3 +133,10 @@ rs_device* rs_context_base::get_device(int index) const
 {
     return devices[index].get();
 }
+
+rs_device* rs_context_base::add_playback_device(const char * filename)
+{
+    auto device = rsimpl::make_playback_device(filename);
+    devices.push_back(device);
+    return device.get();
+}
@@ -21,6 +21,7 @@ struct rs_context_base : rs_context
 
     size_t                                          get_device_count() const override;
     rs_device *                                     get_device(int index) const override;
+    rs_device *                                     add_playback_device(const char * filename) override;
 private:
     static int                                      ref_count;
     static std::mutex                               instance_lock;
@@ -0,0 +1,260 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#include "depth-codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RS_DEPTH_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h> // For _BitScanReverse
+#endif
+
+using namespace rsimpl;
+using namespace rsimpl::depth_codec;
+
+// A control byte with the high bit set stands for a run of up to 128 blocks, any other holds the number of bit planes of one block
+const byte RUN_FLAG       = 0x80;
+const int  MAX_RUN_BLOCKS = 128;
+
+static int get_bit_width(unsigned int value)
+{
+    assert(value != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return static_cast<int>(index) + 1;
+#else
+    return 32 - __builtin_clz(value);
+#endif
+}
+
+static void write_plane(byte * & out, int plane)
+{
+    const uint16_t p = static_cast<uint16_t>(plane);
+    memcpy(out, &p, sizeof(p));
+    out += sizeof(p);
+}
+
+static uint16_t read_plane(const byte * in)
+{
+    uint16_t p;
+    memcpy(&p, in, sizeof(p));
+    return p;
+}
+
+header depth_codec::read_header(const byte * data, size_t size)
+{
+    header h;
+    if (size < sizeof(h)) throw std::runtime_error("compressed depth image is truncated");
+    memcpy(&h, data, sizeof(h));
+    if (h.magic != MAGIC) throw std::runtime_error("not a compressed depth image");
+    if (h.size < sizeof(h) || h.size > size) throw std::runtime_error("compressed depth image is truncated");
+    return h;
+}
+
+size_t depth_codec::get_max_size(int pixel_count)
+{
+    const size_t blocks = (static_cast<size_t>(std::max(pixel_count, 0)) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return sizeof(header) + blocks * (1 + BLOCK_SIZE * sizeof(uint16_t));
+}
+
+encoder::encoder(byte * dest) : begin(dest), out(dest + sizeof(header)), pixel_count(0), last(0), pending(), pending_count(0), run(0) {}
+
+void encoder::write_run()
+{
+    for (; run > 0; run -= MAX_RUN_BLOCKS) *out++ = static_cast<byte>(RUN_FLAG | (std::min(run, MAX_RUN_BLOCKS) - 1));
+    run = 0;
+}
+
+void encoder::encode_block(const uint16_t * pixels)
+{
+#ifdef RS_DEPTH_CODEC_SSE2
+    // Differences to the pixel before, zigzag coded
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + 8));
+    const __m128i da = _mm_sub_epi16(a, _mm_or_si128(_mm_slli_si128(a, 2), _mm_cvtsi32_si128(last)));
+    const __m128i db = _mm_sub_epi16(b, _mm_or_si128(_mm_slli_si128(b, 2), _mm_srli_si128(a, 14)));
+    const __m128i za = _mm_xor_si128(_mm_slli_epi16(da, 1), _mm_srai_epi16(da, 15));
+    const __m128i zb = _mm_xor_si128(_mm_slli_epi16(db, 1), _mm_srai_epi16(db, 15));
+
+    __m128i bits = _mm_or_si128(za, zb);
+    bits = _mm_or_si128(bits, _mm_srli_si128(bits, 8));
+    bits = _mm_or_si128(bits, _mm_srli_si128(bits, 4));
+    bits = _mm_or_si128(bits, _mm_srli_si128(bits, 2));
+    const unsigned int any_bits = _mm_cvtsi128_si32(bits) & 0xffff;
+#else
+    uint16_t z[BLOCK_SIZE];
+    unsigned int any_bits = 0;
+    for (int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        const uint16_t d = static_cast<uint16_t>(pixels[i] - (i ? pixels[i - 1] : last));
+        z[i] = static_cast<uint16_t>((d << 1) ^ (d & 0x8000 ? 0xffff : 0));
+        any_bits |= z[i];
+    }
+#endif
+
+    last = pixels[BLOCK_SIZE - 1];
+    if (!any_bits)
+    {
+        ++run;
+        return;
+    }
+    write_run();
+    const int width = get_bit_width(any_bits);
+    *out++ = static_cast<byte>(width);
+
+#ifdef RS_DEPTH_CODEC_SSE2
+    // Shifting bit j of every byte into its sign bit lets movemask gather bit plane j of 16 differences at once
+    const __m128i low_bytes = _mm_set1_epi16(0xff);
+    const __m128i lo = _mm_packus_epi16(_mm_and_si128(za, low_bytes), _mm_and_si128(zb, low_bytes));
+    for (int j = 0; j < std::min(width, 8); ++j) write_plane(out, _mm_movemask_epi8(_mm_sll_epi16(lo, _mm_cvtsi32_si128(7 - j))));
+    if (width > 8)
+    {
+        const __m128i hi = _mm_packus_epi16(_mm_srli_epi16(za, 8), _mm_srli_epi16(zb, 8));
+        for (int j = 8; j < width; ++j) write_plane(out, _mm_movemask_epi8(_mm_sll_epi16(hi, _mm_cvtsi32_si128(15 - j))));
+    }
+#else
+    for (int j = 0; j < width; ++j)
+    {
+        int plane = 0;
+        for (int i = 0; i < BLOCK_SIZE; ++i) plane |= ((z[i] >> j) & 1) << i;
+        write_plane(out, plane);
+    }
+#endif
+}
+
+void encoder::append(const uint16_t * pixels, int count)
+{
+    if (count <= 0) return;
+    pixel_count += count;
+    if (pending_count)
+    {
+        const int n = std::min(count, BLOCK_SIZE - pending_count);
+        memcpy(pending + pending_count, pixels, n * sizeof(uint16_t));
+        pending_count += n;
+        pixels += n;
+        count -= n;
+        if (pending_count < BLOCK_SIZE) return;
+        encode_block(pending);
+        pending_count = 0;
+    }
+    for (; count >= BLOCK_SIZE; count -= BLOCK_SIZE, pixels += BLOCK_SIZE) encode_block(pixels);
+    memcpy(pending, pixels, count * sizeof(uint16_t));
+    pending_count = count;
+}
+
+size_t encoder::finish()
+{
+    if (pending_count)
+    {
+        // Padding the last block with its last pixel adds no bits to its bit planes
+        std::fill(pending + pending_count, pending + BLOCK_SIZE, pending[pending_count - 1]);
+        encode_block(pending);
+        pending_count = 0;
+    }
+    write_run();
+
+    const header h = { MAGIC, pixel_count, static_cast<uint32_t>(out - begin) };
+    memcpy(begin, &h, sizeof(h));
+    return out - begin;
+}
+
+size_t depth_codec::compress(byte * dest, const uint16_t * pixels, int pixel_count)
+{
+    encoder e(dest);
+    e.append(pixels, pixel_count);
+    return e.finish();
+}
+
+size_t depth_codec::get_compressed_size(const byte * data, size_t size)
+{
+    return read_header(data, size).size;
+}
+
+static void decode_block(uint16_t * pixels, const byte * in, int width, uint16_t & last)
+{
+#ifdef RS_DEPTH_CODEC_SSE2
+    // Broadcast every bit plane, and gather from the highest plane down the bit of each pixel into the differences shifted up by one
+    const __m128i select_a = _mm_setr_epi16(1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7);
+    const __m128i select_b = _mm_setr_epi16(1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, static_cast<short>(1 << 15));
+    __m128i za = _mm_setzero_si128(), zb = _mm_setzero_si128();
+    for (int j = width - 1; j >= 0; --j)
+    {
+        const __m128i plane = _mm_set1_epi16(static_cast<short>(read_plane(in + j * sizeof(uint16_t))));
+        za = _mm_sub_epi16(_mm_add_epi16(za, za), _mm_cmpeq_epi16(_mm_and_si128(plane, select_a), select_a));
+        zb = _mm_sub_epi16(_mm_add_epi16(zb, zb), _mm_cmpeq_epi16(_mm_and_si128(plane, select_b), select_b));
+    }
+
+    // Undo the zigzag coding, and add up the differences from the pixel before the block
+    const __m128i one = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+    __m128i a = _mm_xor_si128(_mm_srli_epi16(za, 1), _mm_sub_epi16(zero, _mm_and_si128(za, one)));
+    __m128i b = _mm_xor_si128(_mm_srli_epi16(zb, 1), _mm_sub_epi16(zero, _mm_and_si128(zb, one)));
+    a = _mm_add_epi16(a, _mm_slli_si128(a, 2));
+    b = _mm_add_epi16(b, _mm_slli_si128(b, 2));
+    a = _mm_add_epi16(a, _mm_slli_si128(a, 4));
+    b = _mm_add_epi16(b, _mm_slli_si128(b, 4));
+    a = _mm_add_epi16(a, _mm_slli_si128(a, 8));
+    b = _mm_add_epi16(b, _mm_slli_si128(b, 8));
+    a = _mm_add_epi16(a, _mm_set1_epi16(static_cast<short>(last)));
+    b = _mm_add_epi16(b, _mm_shuffle_epi32(_mm_shufflehi_epi16(a, 0xff), 0xff));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + 8), b);
+    last = static_cast<uint16_t>(_mm_extract_epi16(b, 7));
+#else
+    uint16_t z[BLOCK_SIZE] = {};
+    for (int j = 0; j < width; ++j)
+    {
+        const int plane = read_plane(in + j * sizeof(uint16_t));
+        for (int i = 0; i < BLOCK_SIZE; ++i) z[i] |= ((plane >> i) & 1) << j;
+    }
+    for (int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        last = static_cast<uint16_t>(last + ((z[i] >> 1) ^ (z[i] & 1 ? 0xffff : 0)));
+        pixels[i] = last;
+    }
+#endif
+}
+
+void depth_codec::decompress(uint16_t * pixels, int pixel_count, const byte * data, size_t size)
+{
+    const auto h = read_header(data, size);
+    if (pixel_count < 0 || h.pixel_count != static_cast<uint32_t>(pixel_count)) throw std::runtime_error(to_string() << "compressed depth image holds " << h.pixel_count << " pixels, not " << pixel_count);
+
+    const byte * in = data + sizeof(h), * const end = data + h.size;
+    uint16_t last = 0;
+    for (int remaining = pixel_count; remaining > 0; )
+    {
+        if (in == end) throw std::runtime_error("compressed depth image is corrupted");
+        const byte control = *in++;
+        if (control & RUN_FLAG)
+        {
+            // Only the last block of the image may be partial
+            const int run_pixels = ((control & ~RUN_FLAG) + 1) * BLOCK_SIZE;
+            if (run_pixels - remaining >= BLOCK_SIZE) throw std::runtime_error("compressed depth image is corrupted");
+            const int count = std::min(run_pixels, remaining);
+            std::fill(pixels, pixels + count, last);
+            pixels += count;
+            remaining -= count;
+            continue;
+        }
+
+        const int width = control;
+        if (width < 1 || width > 16 || end - in < width * static_cast<int>(sizeof(uint16_t))) throw std::runtime_error("compressed depth image is corrupted");
+        if (remaining >= BLOCK_SIZE) decode_block(pixels, in, width, last);
+        else
+        {
+            uint16_t block[BLOCK_SIZE];
+            decode_block(block, in, width, last);
+            memcpy(pixels, block, remaining * sizeof(uint16_t));
+        }
+        in += width * sizeof(uint16_t);
+        pixels += std::min(remaining, BLOCK_SIZE);
+        remaining -= std::min(remaining, BLOCK_SIZE);
+    }
+    if (in != end) throw std::runtime_error("compressed depth image is corrupted");
+}
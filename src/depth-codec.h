@@ -0,0 +1,63 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#ifndef LIBREALSENSE_DEPTH_CODEC_H
+#define LIBREALSENSE_DEPTH_CODEC_H
+
+#include "types.h"
+
+namespace rsimpl
+{
+    // Lossless codec for 16 bit depth and disparity images. Every pixel is predicted by the pixel before it, and the differences, wrapped to
+    // 16 bits and zigzag coded so that small negative differences become small values, are coded in blocks of BLOCK_SIZE pixels. A block
+    // of pixels which all repeat the pixel before them, such as the zero pixels of an invalid region, only counts towards a run of such
+    // blocks. Any other block is stored as the bit planes of its differences, as many as its largest difference needs, so that smooth
+    // surfaces take a few bits per pixel. Bit planes are gathered and scattered 16 pixels at a time with SSE2 on x86.
+    //
+    // A compressed image is a header, followed by a control byte for every block or run of blocks, each followed by the bit planes of its
+    // block. Values are stored in the byte order of the host.
+    namespace depth_codec
+    {
+        const uint32_t MAGIC      = 'RSDZ';
+        const int      BLOCK_SIZE = 16;
+
+        #pragma pack(push, 1)
+        struct header { uint32_t magic, pixel_count, size; }; // Size counts every byte of the compressed image, the header included
+        #pragma pack(pop)
+
+        // The largest size of a compressed image of the given number of pixels, slightly more than the uncompressed image
+        size_t get_max_size(int pixel_count);
+
+        // Compresses an image handed over in any number of pieces, such as one row at a time, into a buffer of at least get_max_size bytes
+        class encoder
+        {
+            byte * const begin;
+            byte * out;
+            uint32_t pixel_count;
+            uint16_t last;                          // The pixel before the next block
+            uint16_t pending[BLOCK_SIZE];           // Pixels which do not fill a block yet
+            int pending_count;
+            int run;                                // Blocks repeating the pixel before them, not written yet
+
+            void encode_block(const uint16_t * pixels);
+            void write_run();
+        public:
+            explicit encoder(byte * dest);
+
+            void append(const uint16_t * pixels, int count);
+            size_t finish(); // Returns the size of the compressed image
+        };
+
+        size_t compress(byte * dest, const uint16_t * pixels, int pixel_count);
+
+        // Return the header or the size of the compressed image at data, of which size bytes are available, and throw if it is not one
+        header read_header(const byte * data, size_t size);
+        size_t get_compressed_size(const byte * data, size_t size);
+
+        // Throws if the compressed image does not hold exactly pixel_count pixels, or is corrupted
+        void decompress(uint16_t * pixels, int pixel_count, const byte * data, size_t size);
+    }
+}
+
+#endif
@@ -6,8 +6,11 @@
 #include "motion-module.h"
 #include "hw-monitor.h"
 #include "image.h"
+#include "thread-pool.h"
+#include "recorder.h"
 
 #include <array>
+#include <cmath>
 #include <algorithm>
 #include <sstream>
 #include <iostream>
@@ -15,15 +18,30 @@
 using namespace rsimpl;
 using namespace rsimpl::motion_module;
 
-const int MAX_FRAME_QUEUE_SIZE = 30;
+const int DEFAULT_FRAME_QUEUE_SIZE = 30;
+const int MAX_FRAME_QUEUE_SIZE     = 1024;
 const int MAX_EVENT_QUEUE_SIZE = 400;
 const int MAX_EVENT_TINE_OUT   = 30;
+const int DEFAULT_CAPTURE_RING_DEPTH = 4;
+const int MAX_CAPTURE_RING_DEPTH     = 32;
+const int DRIVER_RESERVED_BUFFERS    = 2;  // Capture buffers that zero-copy frames may never hold, so that the driver can keep streaming
+const int DEFAULT_CAPTURE_QUEUE_SIZE = 1;
+const int MAX_CAPTURE_QUEUE_SIZE     = 16;
+const int MAX_CAPTURE_THREAD_PRIORITY = 99;
+const uint64_t MAX_CAPTURE_THREAD_AFFINITY = (1ull << 53) - 1; // CPUs 0 to 52, all that an option value of type double holds exactly
+const int MAX_UNPACK_THREADS         = 16;
+const int MAX_UNPACK_ROW_BANDS       = 16;
+const int MAX_UNPACK_JOBS_PER_THREAD = 2;
+const int MAX_PROCESSING_THREADS     = 16;
 
 rs_device_base::rs_device_base(std::shared_ptr<rsimpl::uvc::device> device, const rsimpl::static_device_info & info, calibration_validator validator) : device(device), config(info),
     depth(config, RS_STREAM_DEPTH, validator), color(config, RS_STREAM_COLOR, validator), infrared(config, RS_STREAM_INFRARED, validator), infrared2(config, RS_STREAM_INFRARED2, validator), fisheye(config, RS_STREAM_FISHEYE, validator),
     points(depth), rect_color(color), color_to_depth(color, depth), depth_to_color(depth, color), depth_to_rect_color(depth, rect_color), infrared2_to_depth(infrared2,depth), depth_to_infrared2(depth,infrared2),
-    capturing(false), data_acquisition_active(false), max_publish_list_size(MAX_FRAME_QUEUE_SIZE), event_queue_size(MAX_EVENT_QUEUE_SIZE), events_timeout(MAX_EVENT_TINE_OUT),
-    usb_port_id(""), motion_module_ready(false), keep_fw_logger_alive(false), frames_drops_counter(0)
+    capturing(false), data_acquisition_active(false), max_publish_list_size(DEFAULT_FRAME_QUEUE_SIZE), event_queue_size(MAX_EVENT_QUEUE_SIZE), events_timeout(MAX_EVENT_TINE_OUT),
+    zero_copy_enabled(0), capture_ring_depth(DEFAULT_CAPTURE_RING_DEPTH),
+    capture_thread_per_subdevice(0), capture_thread_affinity(0), capture_thread_priority(0), capture_queue_size(DEFAULT_CAPTURE_QUEUE_SIZE),
+    unpack_threads(0), unpack_row_bands(1), processing_threads(0), compress_recorded_depth(0),
+    usb_port_id(""), options_batch_open(false), motion_module_ready(false), keep_fw_logger_alive(false), frames_drops_counter(0)
 {
     streams[RS_STREAM_DEPTH    ] = native_streams[RS_STREAM_DEPTH]     = &depth;
     streams[RS_STREAM_COLOR    ] = native_streams[RS_STREAM_COLOR]     = &color;
@@ -51,6 +69,7 @@ rs_device_base::~rs_device_base()
             stop_fw_logger();
     }
     catch (...) {}
+    if (auto allocator = dynamic_cast<frame_allocator *>(config.frame_allocator.get())) allocator->detach_device();
 }
 
 bool rs_device_base::supports_option(rs_option option) const 
@@ -122,6 +141,126 @@ void rs_device_base::set_stream_callback(rs_stream stream, rs_frame_callback* ca
     config.callbacks[stream] = frame_callback_ptr(callback);
 }
 
+void rs_device_base::set_frameset_callback(void(*on_frameset)(rs_device * device, rs_frame_ref ** frames, int count, void * user), void * user)
+{
+    set_frameset_callback(new frameset_callback(this, on_frameset, user));
+}
+
+void rs_device_base::set_frameset_callback(rs_frameset_callback * callback)
+{
+    if (capturing)
+    {
+        callback->release();
+        throw std::runtime_error("cannot set frameset callback while streaming");
+    }
+
+    config.frameset_callback = std::shared_ptr<rs_frameset_callback>(callback, [](rs_frameset_callback * c) { c->release(); });
+}
+
+void rs_device_base::set_frameset_policy(rs_frameset_policy policy)
+{
+    if (capturing) throw std::runtime_error("cannot set frameset policy while streaming");
+    config.frameset_policy = policy;
+}
+
+void rs_device_base::set_frameset_tolerance(rs_stream a, rs_stream b, double milliseconds)
+{
+    if (capturing) throw std::runtime_error("cannot set frameset tolerance while streaming");
+    config.frameset_tolerances[a][b] = config.frameset_tolerances[b][a] = milliseconds;
+}
+
+rs_frameset_stats rs_device_base::get_frameset_stats() const
+{
+    return framesets ? framesets->get_stats() : rs_frameset_stats();
+}
+
+void rs_device_base::set_frame_allocator(rs_frame_allocate_ptr allocate, rs_frame_deallocate_ptr deallocate, void * user)
+{
+    set_frame_allocator(new frame_allocator(this, allocate, deallocate, user));
+}
+
+void rs_device_base::set_frame_allocator(rs_frame_allocator * allocator)
+{
+    if (capturing)
+    {
+        allocator->release();
+        throw std::runtime_error("cannot set frame allocator while streaming");
+    }
+
+    config.frame_allocator = std::shared_ptr<rs_frame_allocator>(allocator, [](rs_frame_allocator * a) { a->release(); });
+}
+
+void rs_device_base::start_recording(const char * filename)
+{
+    if (capturing || data_acquisition_active) throw std::runtime_error("cannot start recording while the device is streaming");
+    if (recording) throw std::runtime_error("the device is already recording");
+
+    // Motion calibration is only available on devices with a motion module
+    std::vector<rs_capabilities> capabilities;
+    for (int i = 0; i < RS_CAPABILITIES_COUNT; ++i) if (supports(rs_capabilities(i))) capabilities.push_back(rs_capabilities(i));
+    rs_motion_intrinsics motion_intrinsics;
+    rs_extrinsics motion_extrinsics[RS_STREAM_NATIVE_COUNT];
+    auto has_motion_calibration = supports(RS_CAPABILITIES_MOTION_EVENTS);
+    if (has_motion_calibration) try
+    {
+        motion_intrinsics = get_motion_intrinsics();
+        for (int i = 0; i < RS_STREAM_NATIVE_COUNT; ++i) motion_extrinsics[i] = get_motion_extrinsics_from(rs_stream(i));
+    }
+    catch (const std::exception & e)
+    {
+        LOG_WARNING("Recording without motion calibration: " << e.what());
+        has_motion_calibration = false;
+    }
+
+    auto r = std::make_shared<rsimpl::recorder>(filename, DEFAULT_RECORDER_QUEUE_BYTES, compress_recorded_depth != 0);
+    r->record_device_info(config.info, capabilities, has_motion_calibration ? &motion_intrinsics : nullptr, has_motion_calibration ? motion_extrinsics : nullptr);
+    recording = r;
+}
+
+void rs_device_base::stop_recording()
+{
+    if (capturing || data_acquisition_active) throw std::runtime_error("cannot stop recording while the device is streaming");
+    if (!recording) throw std::runtime_error("the device is not recording");
+    auto r = std::move(recording);
+    r->close();
+}
+
+void rs_device_base::set_playback_mode(rs_playback_mode /*mode*/)
+{
+    throw std::runtime_error("not a playback device");
+}
+
+bool rs_device_base::step_playback()
+{
+    throw std::runtime_error("not a playback device");
+}
+
+void rs_device_base::seek_playback(double /*time*/)
+{
+    throw std::runtime_error("not a playback device");
+}
+
+// The video channels of the camera. Playback overrides these to serve recorded frames instead.
+void rs_device_base::open_video_channel(const subdevice_mode & mode, uvc::video_channel_callback callback)
+{
+    set_subdevice_mode(*device, mode.subdevice, mode.native_dims.x, mode.native_dims.y, mode.pf.fourcc, mode.fps, callback);
+}
+
+void rs_device_base::start_video_channels(const uvc::capture_settings & settings)
+{
+    start_streaming(*device, settings);
+}
+
+void rs_device_base::stop_video_channels()
+{
+    stop_streaming(*device);
+}
+
+bool rs_device_base::video_channels_support_zero_copy() const
+{
+    return supports_zero_copy(*device);
+}
+
 void rs_device_base::enable_motion_tracking()
 {
     if (data_acquisition_active) throw std::runtime_error("motion-tracking cannot be reconfigured after having called rs_start_device()");
@@ -149,13 +288,14 @@ void rs_device_base::start_motion_tracking()
     if (data_acquisition_active) throw std::runtime_error("cannot restart data acquisition without stopping first");
 
     auto parser = std::make_shared<motion_module_parser>();
+    auto recording = this->recording;
 
     // Activate data polling handler
     if (config.data_request.enabled)
     {
         // TODO -replace hard-coded value 3 which stands for fisheye subdevice   
         set_subdevice_data_channel_handler(*device, 3,
-            [this, parser](const unsigned char * data, const int size) mutable
+            [this, parser, recording](const unsigned char * data, const int size) mutable
         {
             if (motion_module_ready)    //  Flush all received data before MM is fully operational 
             {
@@ -165,6 +305,12 @@ void rs_device_base::start_motion_tracking()
                 // Handle events by user-provided handlers
                 for (auto & entry : events)
                 {
+                    if (recording)
+                    {
+                        for (int i = 0; i < entry.imu_entries_num; i++) recording->record_motion(entry.imu_packets[i]);
+                        for (int i = 0; i < entry.non_imu_entries_num; i++) recording->record_timestamp(entry.non_imu_packets[i]);
+                    }
+
                     // Handle Motion data packets
                     if (config.motion_callback)
                         for (int i = 0; i < entry.imu_entries_num; i++)
@@ -331,13 +477,151 @@ struct drops_status
     unsigned long long prev_frame_counter = 0;
 };
 
+struct unpack_stage;
+
+// A captured frame on its way through the unpack worker pool. Jobs are recycled by their stage rather than allocated per frame.
+struct unpack_job
+{
+    frame_archive::frame_additional_data frames_data[RS_STREAM_NATIVE_COUNT];
+    std::vector<frame_buffer> buffers;
+    std::vector<byte *> dest;
+    frame_continuation release_raw;         // Releases the capture buffer once unpacked, or travels with the frame if no unpacking is needed
+    const byte * source;
+    uint64_t ticket;
+    bool requires_processing;
+    std::atomic<int> pending_bands;
+    std::atomic<bool> failed;
+    std::shared_ptr<unpack_stage> stage;    // Keeps the stage alive while the job is in flight
+    std::vector<uint16_t> compressed_row;   // Reused by every frame the job unpacks into a compressed output
+
+    unpack_job() : source(nullptr), ticket(0), requires_processing(false), pending_bands(0), failed(false) {}
+};
+
+// Unpacks the frames of one subdevice on the worker pool, and delivers them in capture order. The tasks handed to the pool and
+// to the sequencer carry no more than a job and a band, which std::function stores without allocating.
+struct unpack_stage : std::enable_shared_from_this<unpack_stage>
+{
+    std::shared_ptr<thread_pool> pool;
+    ordered_dispatcher sequencer;
+    const subdevice_mode_selection mode;
+    int bands, band_rows;
+    const int max_pending_jobs;
+    std::atomic<int> pending_jobs;
+    std::shared_ptr<std::atomic<int>> held_buffers;
+    std::function<void(unpack_job &)> deliver; // Hands the frames of a job over to the archive, or its buffers back if unpacking failed
+    object_pool<unpack_job, MAX_UNPACK_JOBS_PER_THREAD> jobs;
+
+    unpack_stage(std::shared_ptr<thread_pool> pool, const subdevice_mode_selection & mode, int row_bands, std::shared_ptr<std::atomic<int>> held_buffers)
+        : pool(std::move(pool)), mode(mode), max_pending_jobs(this->pool->get_thread_count() * MAX_UNPACK_JOBS_PER_THREAD), pending_jobs(0), held_buffers(std::move(held_buffers))
+    {
+        // Split frames into bands of whole rows, a multiple of 16 rows each to keep the vectorized unpackers on full blocks
+        auto rows = mode.get_unpacked_height();
+        bands = mode.can_unpack_rows() ? std::max(1, row_bands) : 1;
+        band_rows = ((rows + bands - 1) / bands + 15) / 16 * 16;
+        bands = (rows + band_rows - 1) / band_rows;
+        jobs.reserve(max_pending_jobs);
+    }
+
+    // Returns null once max_pending_jobs are in flight
+    unpack_job * acquire_job()
+    {
+        if (pending_jobs.load() >= max_pending_jobs) return nullptr;
+        pending_jobs.fetch_add(1);
+        auto job = jobs.allocate();
+        job->stage = shared_from_this();
+        job->ticket = sequencer.issue_ticket();
+        return job;
+    }
+
+    void unpack_on_workers(unpack_job * job)
+    {
+        held_buffers->fetch_add(1);
+        job->pending_bands = bands;
+        for (int band = 0; band < bands; ++band) pool->submit([job, band]() { job->stage->unpack_band(job, band); });
+    }
+
+    void unpack_now(unpack_job * job)
+    {
+        try
+        {
+            mode.unpack(job->dest.data(), job->source, &job->compressed_row);
+        }
+        catch (const std::exception & e)
+        {
+            LOG_ERROR("Unpacking failed: " << e.what());
+            job->failed = true;
+        }
+        job->release_raw();
+        complete(job);
+    }
+
+    void unpack_band(unpack_job * job, int band)
+    {
+        try
+        {
+            mode.unpack(job->dest.data(), job->source, band * band_rows, band_rows, &job->compressed_row);
+        }
+        catch (const std::exception & e)
+        {
+            LOG_ERROR("Unpacking failed: " << e.what());
+            job->failed = true;
+        }
+
+        if (job->pending_bands.fetch_sub(1) == 1)
+        {
+            auto stage = job->stage; // The sequencer may run the delivery right away, which recycles the job
+            job->release_raw(); // The capture buffer goes back to the driver before the frame is delivered
+            held_buffers->fetch_sub(1);
+            complete(job);
+        }
+    }
+
+    void complete(unpack_job * job) { sequencer.complete(job->ticket, [job]() { job->stage->finish(job); }); }
+
+    void finish(unpack_job * job)
+    {
+        pending_jobs.fetch_sub(1);
+        deliver(*job);
+
+        job->buffers.clear();
+        job->dest.clear();
+        job->release_raw = frame_continuation();
+        job->source = nullptr;
+        job->failed = false;
+        auto stage = std::move(job->stage); // Never the last reference while the sequencer runs this, see unpack_band
+        jobs.deallocate(job);
+    }
+};
+
+capture_buffer_budget::capture_buffer_budget(int requested_ring_depth, int requested_queue_size, int unpack_threads)
+    : unpack_jobs(unpack_threads * MAX_UNPACK_JOBS_PER_THREAD), ring_depth(requested_ring_depth), queue_size(requested_queue_size)
+{
+    if (unpack_jobs > 0) ring_depth = std::min(std::max(ring_depth, unpack_jobs + DRIVER_RESERVED_BUFFERS + queue_size), MAX_CAPTURE_RING_DEPTH);
+
+    // Buffers waiting in the backend's hand-off queue are not returned to the driver either, so the queue must leave at least one buffer for frames to hold
+    auto max_queue_size = ring_depth - DRIVER_RESERVED_BUFFERS - 1;
+    if (queue_size > max_queue_size)
+    {
+        LOG_WARNING("A capture queue size of " << queue_size << " leaves no capture buffers for frames to hold with a ring depth of " << ring_depth << ", using " << max_queue_size);
+        queue_size = max_queue_size;
+    }
+    max_held_buffers = ring_depth - DRIVER_RESERVED_BUFFERS - queue_size;
+}
+
 void rs_device_base::start_video_streaming(bool is_mipi)
 {
     if(capturing) throw std::runtime_error("cannot restart device without first stopping device");
 
     auto capture_start_time = std::chrono::high_resolution_clock::now();
     auto selected_modes = config.select_modes();
-    auto archive = std::make_shared<syncronizing_archive>(selected_modes, select_key_stream(selected_modes), &max_publish_list_size, &event_queue_size, &events_timeout, capture_start_time);
+
+    // Unpacking can only move off the capture thread if the backend keeps each capture buffer valid until it is released
+    unpack_pool.reset();
+    if (unpack_threads > 0 && video_channels_support_zero_copy()) unpack_pool = std::make_shared<thread_pool>(unpack_threads);
+    const capture_buffer_budget budget(static_cast<int>(capture_ring_depth), static_cast<int>(capture_queue_size), unpack_pool ? unpack_pool->get_thread_count() : 0);
+    auto frames_being_unpacked = static_cast<uint32_t>(budget.unpack_jobs);
+
+    auto archive = std::make_shared<syncronizing_archive>(selected_modes, select_key_stream(selected_modes), &max_publish_list_size, &event_queue_size, &events_timeout, &timestamp_stats, capture_start_time, frames_being_unpacked);
 
     for(auto & s : native_streams) {
         if (s->get_stream_type() == RS_STREAM_FISHEYE) {
@@ -347,6 +631,63 @@ void rs_device_base::start_video_streaming(bool is_mipi)
         }
         s->archive.reset(); // Starting capture invalidates the current stream info, if any exists from previous capture
     }
+
+    // Match the frames of the streams without a frame callback of their own into framesets, if the application asked for them
+    framesets.reset();
+    if (config.frameset_callback)
+    {
+        int framerates[RS_STREAM_NATIVE_COUNT] = {};
+        for (auto & mode_selection : selected_modes) for (auto & output : mode_selection.get_outputs()) framerates[output.first] = mode_selection.get_framerate();
+        if (config.requests[RS_STREAM_FISHEYE].enabled && !framerates[RS_STREAM_FISHEYE]) framerates[RS_STREAM_FISHEYE] = 30; // Captured through the motion module
+
+        std::vector<rs_stream> synchronized;
+        for (int i = 0; i < RS_STREAM_NATIVE_COUNT; ++i) if (framerates[i] && !config.callbacks[i]) synchronized.push_back(rs_stream(i));
+        if (!synchronized.empty())
+        {
+            // By default, a frame matches the closest frame of a faster stream, and no other
+            double tolerances[RS_STREAM_NATIVE_COUNT][RS_STREAM_NATIVE_COUNT] = {};
+            for (auto a : synchronized) for (auto b : synchronized)
+                tolerances[a][b] = config.frameset_tolerances[a][b] > 0 ? config.frameset_tolerances[a][b] : 500.0 / std::max(framerates[a], framerates[b]);
+
+            // The slowest stream paces the framesets
+            auto key_stream = *std::min_element(synchronized.begin(), synchronized.end(), [&](rs_stream a, rs_stream b) { return framerates[a] < framerates[b]; });
+            auto callback = config.frameset_callback;
+            std::weak_ptr<syncronizing_archive> weak_archive = archive;
+            framesets = std::make_shared<frameset_synchronizer>(synchronized, key_stream, tolerances, config.frameset_policy,
+                [this, callback](std::vector<rs_frame_ref *> & frames) { callback->on_frameset(this, frames.data(), static_cast<int>(frames.size())); },
+                [weak_archive](rs_frame_ref * frame)
+                {
+                    if (auto archive = weak_archive.lock()) archive->release_frame_ref(static_cast<frame_archive::frame_ref *>(frame));
+                });
+            archive->set_frameset_synchronizer(framesets);
+        }
+    }
+
+    // Frames continue from the timestamp corrector to the user callbacks, the frameset synchronizer, or the wait_for_frames queues.
+    // Set up once per stream, so that dispatching a frame does not build a delivery function for it.
+    std::weak_ptr<syncronizing_archive> delivering_archive = archive; // The archive holds on to these functions
+    for (int i = 0; i < RS_STREAM_NATIVE_COUNT; ++i)
+    {
+        auto stream = rs_stream(i);
+        archive->set_frame_delivery(stream, [this, delivering_archive, stream, capture_start_time](frame_archive::frame * frame)
+        {
+            // Released while the archive is being destroyed, the frame is not delivered but goes back to the pools
+            auto archive = delivering_archive.lock();
+            if (!archive) return false;
+
+            if (config.callbacks[stream] || archive->synchronizes(stream))
+            {
+                auto frame_ref = archive->track_frame(frame);
+                if (frame_ref) deliver_frame(archive, stream, frame_ref, capture_start_time);
+            }
+            else
+            {
+                // Commit the frame to the archive
+                archive->commit_frame(stream, frame);
+            }
+            return true;
+        });
+    }
     auto timestamp_readers = create_frame_timestamp_readers();
 
     // Satisfy stream_requests as necessary for each subdevice, calling set_mode and
@@ -354,6 +695,14 @@ void rs_device_base::start_video_streaming(bool is_mipi)
 
     for(auto mode_selection : selected_modes)
     {
+        // Fill the frame buffer pools with a buffer for each frame the user may hold and the backbuffer, so that holding up to RS_OPTION_FRAMES_QUEUE_SIZE frames never allocates.
+        // Passthrough streams are served from the capture buffers directly.
+        auto preallocated_buffers = (mode_selection.requires_processing() || mode_selection.mode.subdevice == 3) ? static_cast<int>(archive->get_user_queue_size() + 1) : 0;
+        for(auto & output : mode_selection.get_outputs())
+        {
+            archive->reserve_frame_buffers(output.first, mode_selection.get_image_size(output.first), preallocated_buffers, config.frame_allocator);
+        }
+
         if(mode_selection.mode.subdevice == 3) {
             continue;
         }
@@ -376,13 +725,55 @@ void rs_device_base::start_video_streaming(bool is_mipi)
         }     
 
         std::shared_ptr<drops_status> frame_drops_status(new drops_status{});
+
+        // Frames that need no unpacking can be handed out straight from the capture buffers. A frame held that way keeps its buffer
+        // from the driver, so once too many are held, further frames are copied out instead.
+        auto backend_zero_copy = video_channels_support_zero_copy();
+        auto native_zero_copy = mode_selection.supports_zero_copy();
+        auto allow_zero_copy = !mode_selection.requires_processing() || (zero_copy_enabled && native_zero_copy && backend_zero_copy);
+        auto max_held_buffers = budget.max_held_buffers;
+        std::shared_ptr<std::atomic<int>> held_buffers(new std::atomic<int>(0));
+
+        // Every frame of a subdevice passes through one stage, so that frames unpacked in parallel are still delivered in order
+        std::shared_ptr<unpack_stage> stage;
+        if (unpack_pool)
+        {
+            stage = std::make_shared<unpack_stage>(unpack_pool, mode_selection, unpack_row_bands, held_buffers);
+            stage->deliver = [this, archive, streams](unpack_job & job)
+            {
+                if (job.failed)
+                {
+                    for (size_t i = 0; i < job.buffers.size(); ++i) archive->release_frame_buffer(streams[i], std::move(job.buffers[i]));
+                    return;
+                }
+                for (size_t i = 0; i < streams.size(); ++i)
+                {
+                    if (job.requires_processing) archive->alloc_frame(streams[i], job.frames_data[i], std::move(job.buffers[i]));
+                    else archive->alloc_frame(streams[i], job.frames_data[i], false);
+                }
+                dispatch_frames(archive, streams, job.requires_processing ? nullptr : &job.release_raw);
+            };
+        }
+        auto recording = this->recording;
+        auto native_size = mode_selection.mode.pf.get_image_size(mode_selection.mode.native_dims.x, mode_selection.mode.native_dims.y);
+        std::vector<uint16_t> compressed_row; // Reused by every frame the capture thread unpacks into a compressed output
+
         // Initialize the subdevice and set it to the selected mode
-        set_subdevice_mode(*device, mode_selection.mode.subdevice, mode_selection.mode.native_dims.x, mode_selection.mode.native_dims.y, mode_selection.mode.pf.fourcc, mode_selection.mode.fps, 
-            [this, mode_selection, archive, timestamp_reader, streams, capture_start_time, frame_drops_status](const void * frame, std::function<void()> continuation) mutable
+        open_video_channel(mode_selection.mode,
+            [this, mode_selection, archive, timestamp_reader, streams, capture_start_time, frame_drops_status, allow_zero_copy, native_zero_copy, backend_zero_copy, max_held_buffers, held_buffers,
+             stage, recording, native_size, compressed_row](const void * frame, std::function<void()> continuation) mutable
         {
             auto now = std::chrono::system_clock::now().time_since_epoch();
             auto sys_time = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
             static int drops = 0;
+
+            auto zero_copy = allow_zero_copy;
+            if (zero_copy && native_zero_copy && backend_zero_copy && held_buffers->load() >= max_held_buffers) zero_copy = false;
+            if (zero_copy)
+            {
+                held_buffers->fetch_add(1);
+                continuation = [continuation, held_buffers]() { held_buffers->fetch_sub(1); continuation(); };
+            }
             frame_continuation release_and_enqueue(continuation, frame);
             // Ignore any frames which appear corrupted or invalid
             if (!timestamp_reader->validate_frame(mode_selection.mode, frame)) return;
@@ -394,7 +785,11 @@ void rs_device_base::start_video_streaming(bool is_mipi)
             if(frame_counter == 0) {
                 return;
             }
-            auto requires_processing = mode_selection.requires_processing();
+
+            // Record the native frame as the camera sent it, along with what was read from it, so that playback does not need the camera's own readers
+            if (recording) recording->record_frame(mode_selection.mode.subdevice, mode_selection.mode.pf.fourcc, mode_selection.mode.native_dims.x, mode_selection.mode.native_dims.y,
+                                                   frame, native_size, timestamp, frame_counter);
+            auto requires_processing = !zero_copy;
 
             double exposure_value[1] = {};
             if (streams[0] == rs_stream::RS_STREAM_FISHEYE)
@@ -415,7 +810,6 @@ void rs_device_base::start_video_streaming(bool is_mipi)
             auto width = mode_selection.get_width();
             auto height = mode_selection.get_height();
             auto fps = mode_selection.get_framerate();
-            std::vector<byte *> dest;
 
             auto stride_x = mode_selection.get_stride_x();
             auto stride_y = mode_selection.get_stride_y();
@@ -433,10 +827,14 @@ void rs_device_base::start_video_streaming(bool is_mipi)
                 frame_drops_status->prev_frame_counter = frame_counter;
             }
 
-            for (auto & output : mode_selection.get_outputs())
+            // Built on the stack, so that capturing a frame does not touch the heap
+            frame_archive::frame_additional_data frames_data[RS_STREAM_NATIVE_COUNT];
+            const auto & outputs = mode_selection.get_outputs();
+            for (size_t i = 0; i < outputs.size(); ++i)
             {
+                auto & output = outputs[i];
                 auto bpp = get_image_bpp(output.second);
-                frame_archive::frame_additional_data additional_data( timestamp,
+                frames_data[i] = frame_archive::frame_additional_data( timestamp,
                     frame_counter,
                     sys_time,
                     width,
@@ -448,59 +846,79 @@ void rs_device_base::start_video_streaming(bool is_mipi)
                     output.second,
                     output.first,
                     mode_selection.pad_crop,
-                    config.info.supported_metadata_vector,
+                    config.info.supported_metadata,
                     exposure_value[0]);
+            }
 
-                // Obtain buffers for unpacking the frame
-                dest.push_back(archive->alloc_frame(output.first, additional_data, requires_processing));
+            if (!stage)
+            {
+                byte * dest[RS_STREAM_NATIVE_COUNT];
+                for (size_t i = 0; i < outputs.size(); ++i)
+                {
+                    // Obtain buffers for unpacking the frame
+                    dest[i] = archive->alloc_frame(streams[i], frames_data[i], requires_processing);
+                }
 
-                if(!archive->correct_timestamp(output.first)) {
-                    archive->release_frame_ref(archive->track_frame(output.first));
-                    return;
+                // Unpack the frame
+                if (requires_processing)
+                {
+                    mode_selection.unpack(dest, reinterpret_cast<const byte *>(frame), &compressed_row);
                 }
 
+                dispatch_frames(archive, streams, requires_processing ? nullptr : &release_and_enqueue);
+                return;
             }
-            // Unpack the frame
-            if (requires_processing)
+
+            // Otherwise unpack on the worker pool, and deliver the frames of this subdevice in capture order once they are ready
+            auto job = stage->acquire_job();
+            if (!job)
             {
-                mode_selection.unpack(dest.data(), reinterpret_cast<const byte *>(frame));
+                // Delivering the frame right away would overtake the frames still in flight, so it is dropped like a frame the camera lost
+                frames_drops_counter.fetch_add(1);
+                LOG_WARNING("Unpack workers are behind, dropping frame " << frame_counter << " of " << rsimpl::get_string(streams[0]));
+                return;
             }
-
-            // If any frame callbacks were specified, dispatch them now
-            for (size_t i = 0; i < dest.size(); ++i)
+            std::copy(frames_data, frames_data + outputs.size(), job->frames_data);
+            job->release_raw = std::move(release_and_enqueue);
+            job->requires_processing = requires_processing;
+            if (!requires_processing)
             {
-                if (!requires_processing)
-                {
-                    archive->attach_continuation(streams[i], std::move(release_and_enqueue));
-                }
+                stage->complete(job);
+                return;
+            }
 
-                if (config.callbacks[streams[i]])
-                {
-                    auto frame_ref = archive->track_frame(streams[i]);
-                    if (frame_ref)
-                    {
-                        frame_ref->update_frame_callback_start_ts(std::chrono::high_resolution_clock::now());
-                        frame_ref->log_callback_start(capture_start_time);
-                        on_before_callback(streams[i], frame_ref, archive);
-                        (*config.callbacks[streams[i]])->on_frame(this, frame_ref);
-                    }
-                }
-                else
-                {
-                    // Commit the frame to the archive
-                    archive->commit_frame(streams[i]);
-                }
+            for (auto stream : streams)
+            {
+                job->buffers.push_back(archive->acquire_frame_buffer(stream));
+                job->dest.push_back(job->buffers.back().data());
             }
+            job->source = reinterpret_cast<const byte *>(frame);
+
+            // A job holds its capture buffer until it is unpacked, just like a frame held without copying. Once no buffer can be spared,
+            // the frame is unpacked on the capture thread instead, which returns its buffer to the driver before the next one is captured.
+            if (held_buffers->load() >= max_held_buffers) stage->unpack_now(job);
+            else stage->unpack_on_workers(job);
         });
 
     }
     
     this->archive = archive;
     on_before_start(selected_modes);
+    controls.clear(); // on_before_start rewrites controls, and starting the streams may reset more of them
+    if (recording) recording->record_stream_config(selected_modes, config.requests, config.depth_scale); // After on_before_start, which settles the depth scale
     if  (config.requests[RS_STREAM_FISHEYE].enabled) {
          enable_fisheye_stream();
     }
-    start_streaming(*device, config.info.num_libuvc_transfer_buffers);
+    uvc::capture_settings settings;
+    settings.num_transfer_bufs = config.info.num_libuvc_transfer_buffers;
+    settings.ring_depth = budget.ring_depth;
+    settings.thread_per_subdevice = capture_thread_per_subdevice != 0;
+    settings.cpu_affinity = capture_thread_affinity;
+    settings.thread_priority = capture_thread_priority;
+    settings.handoff_queue_size = budget.queue_size;
+    std::weak_ptr<syncronizing_archive> weak_archive = archive;
+    settings.on_error = [weak_archive](const std::string & message) { if (auto archive = weak_archive.lock()) archive->report_capture_error(message); };
+    start_video_channels(settings);
     capture_started = std::chrono::high_resolution_clock::now();
     capturing = true;
 }
@@ -508,9 +926,37 @@ void rs_device_base::start_video_streaming(bool is_mipi)
 void rs_device_base::stop_video_streaming()
 {
     if(!capturing) throw std::runtime_error("cannot stop device without first starting device");
-    stop_streaming(*device);
+    stop_video_channels();
+    if (unpack_pool)
+    {
+        unpack_pool->wait_idle();
+        unpack_pool.reset();
+    }
     archive->flush();
     capturing = false;
+    controls.clear();
+}
+
+// Hand the frames placed in the archive backbuffers to the user callbacks, the frameset synchronizer, or commit them for wait_for_frames, once their timestamps are corrected
+void rs_device_base::dispatch_frames(const std::shared_ptr<syncronizing_archive> & archive, const std::vector<rs_stream> & streams, frame_continuation * passthrough_release)
+{
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        if (passthrough_release)
+        {
+            archive->attach_continuation(streams[i], std::move(*passthrough_release));
+        }
+        archive->correct_timestamp(streams[i]);
+    }
+}
+
+void rs_device_base::deliver_frame(const std::shared_ptr<syncronizing_archive> & archive, rs_stream stream, frame_archive::frame_ref * frame_ref, std::chrono::high_resolution_clock::time_point capture_start_time)
+{
+    frame_ref->update_frame_callback_start_ts(std::chrono::high_resolution_clock::now());
+    frame_ref->log_callback_start(capture_start_time);
+    on_before_callback(stream, frame_ref, archive);
+    if (config.callbacks[stream]) (*config.callbacks[stream])->on_frame(this, frame_ref);
+    else archive->add_to_frameset(frame_ref);
 }
 
 void rs_device_base::wait_all_streams()
@@ -521,6 +967,13 @@ void rs_device_base::wait_all_streams()
     archive->wait_for_frames();
 }
 
+bool rs_device_base::wait_all_streams(unsigned int timeout_ms)
+{
+    if(!capturing) return false;
+    if(!archive) return false;
+    return archive->wait_for_frames(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms));
+}
+
 bool rs_device_base::poll_all_streams()
 {
     if(!capturing) return false;
@@ -542,7 +995,17 @@ rs_frame_ref* ::rs_device_base::clone_frame(rs_frame_ref* frame)
 
 void rs_device_base::update_device_info(rsimpl::static_device_info& info)
 {
-    info.options.push_back({ RS_OPTION_FRAMES_QUEUE_SIZE,     1, MAX_FRAME_QUEUE_SIZE,      1, MAX_FRAME_QUEUE_SIZE });
+    info.options.push_back({ RS_OPTION_FRAMES_QUEUE_SIZE,     1, MAX_FRAME_QUEUE_SIZE,      1, DEFAULT_FRAME_QUEUE_SIZE });
+    info.options.push_back({ RS_OPTION_ZERO_COPY_ENABLED,     0, 1,                         1, 0 });
+    info.options.push_back({ RS_OPTION_CAPTURE_RING_DEPTH,    DRIVER_RESERVED_BUFFERS + 1, MAX_CAPTURE_RING_DEPTH, 1, DEFAULT_CAPTURE_RING_DEPTH });
+    info.options.push_back({ RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE, 0, 1,                  1, 0 });
+    info.options.push_back({ RS_OPTION_CAPTURE_THREAD_AFFINITY,      0, static_cast<double>(MAX_CAPTURE_THREAD_AFFINITY), 1, 0 });
+    info.options.push_back({ RS_OPTION_CAPTURE_THREAD_PRIORITY,      0, MAX_CAPTURE_THREAD_PRIORITY, 1, 0 });
+    info.options.push_back({ RS_OPTION_CAPTURE_QUEUE_SIZE,           0, MAX_CAPTURE_QUEUE_SIZE, 1, DEFAULT_CAPTURE_QUEUE_SIZE });
+    info.options.push_back({ RS_OPTION_UNPACK_THREADS,               0, MAX_UNPACK_THREADS,   1, 0 });
+    info.options.push_back({ RS_OPTION_UNPACK_ROW_BANDS,             1, MAX_UNPACK_ROW_BANDS, 1, 1 });
+    info.options.push_back({ RS_OPTION_PROCESSING_THREADS,           0, MAX_PROCESSING_THREADS, 1, 0 });
+    info.options.push_back({ RS_OPTION_COMPRESS_RECORDED_DEPTH,      0, 1,                    1, 0 });
 }
 
 const char * rs_device_base::get_option_description(rs_option option) const
@@ -609,7 +1072,7 @@ const char * rs_device_base::get_option_description(rs_option option) const
     case RS_OPTION_FISHEYE_GAIN                                    : return "Fisheye image gain";
     case RS_OPTION_FISHEYE_STROBE                                  : return "Enables / disables fisheye strobe. When enabled this will align timestamps to common clock-domain with the motion events";
     case RS_OPTION_FISHEYE_EXTERNAL_TRIGGER                        : return "Enables / disables fisheye external trigger mode. When enabled fisheye image will be aquired in-sync with the depth image";
-    case RS_OPTION_FRAMES_QUEUE_SIZE                               : return "Number of frames the user is allowed to keep per stream. Trying to hold-on to more frames will cause frame-drops.";
+    case RS_OPTION_FRAMES_QUEUE_SIZE                               : return "Number of frames the user is allowed to keep per stream. Trying to hold-on to more frames will cause frame-drops. Queues are sized, and buffers for the frames allocated, when streaming starts, and cannot grow until it restarts";
     case RS_OPTION_FISHEYE_ENABLE_AUTO_EXPOSURE                    : return "Enable / disable fisheye auto-exposure";
     case RS_OPTION_FISHEYE_AUTO_EXPOSURE_MODE                      : return "0 - static auto-exposure, 1 - anti-flicker auto-exposure, 2 - hybrid";
     case RS_OPTION_FISHEYE_AUTO_EXPOSURE_ANTIFLICKER_RATE          : return "Fisheye auto-exposure anti-flicker rate, can be 50 or 60 Hz";
@@ -617,6 +1080,19 @@ const char * rs_device_base::get_option_description(rs_option option) const
     case RS_OPTION_FISHEYE_AUTO_EXPOSURE_SKIP_FRAMES               : return "In Fisheye auto-exposure sample every given number of frames";
     case RS_OPTION_HARDWARE_LOGGER_ENABLED                         : return "Enables / disables fetching diagnostic information from hardware (and writting the results to log)";
     case RS_OPTION_TOTAL_FRAME_DROPS                               : return "Total number of detected frame drops from all streams";
+    case RS_OPTION_ZERO_COPY_ENABLED                               : return "Enable / disable delivering frames that need no unpacking directly from the capture buffers, without copying. Set before streaming";
+    case RS_OPTION_CAPTURE_RING_DEPTH                              : return "Number of capture buffers per subdevice. Frames delivered without copying may hold all but two of them, less the capture queue size (V4L2 only). Set before streaming";
+    case RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE                    : return "Enable / disable a dedicated capture thread per subdevice (V4L2 only). Set before streaming";
+    case RS_OPTION_CAPTURE_THREAD_AFFINITY                         : return "Bitmask of the CPUs the capture threads may run on, out of CPUs 0 to 52, 0 leaves the affinity unchanged (V4L2 only). Set before streaming";
+    case RS_OPTION_CAPTURE_THREAD_PRIORITY                         : return "SCHED_FIFO priority of the capture threads, 0 keeps the default scheduling policy (V4L2 only). Set before streaming";
+    case RS_OPTION_CAPTURE_QUEUE_SIZE                              : return "Number of captured frames per subdevice that may wait for unpacking, 0 unpacks on the capture thread (V4L2 only). Set before streaming";
+    case RS_OPTION_UNPACK_THREADS                                  : return "Number of worker threads unpacking frames off the capture thread, 0 unpacks on the capture thread. The capture ring grows to give each of them two capture buffers. Not available with libuvc or WMF. Set before streaming";
+    case RS_OPTION_UNPACK_ROW_BANDS                                : return "Number of row bands each frame is split into, to be unpacked in parallel by the unpack worker threads. Set before streaming";
+    case RS_OPTION_PROCESSING_THREADS                              : return "Number of worker threads computing the point cloud and aligned streams in row bands, 0 computes them on the calling thread";
+    case RS_OPTION_TIMESTAMPS_MATCHED                              : return "Total number of frames given the timestamp reported by the motion module";
+    case RS_OPTION_TIMESTAMPS_LATE                                 : return "Total number of frames delivered with their camera timestamp, since no motion module timestamp matched them in time";
+    case RS_OPTION_TIMESTAMPS_DROPPED                              : return "Total number of frames dropped by timestamp correction";
+    case RS_OPTION_COMPRESS_RECORDED_DEPTH                         : return "Enable / disable lossless compression of the depth frames written by rs_start_recording. Set before recording starts";
     default: return rs_option_to_string(option);
     }
 }
@@ -681,16 +1157,71 @@ void rs_device_base::get_option_range(rs_option option, double & min, double & m
 
 void rs_device_base::set_options(const rs_option options[], size_t count, const double values[])
 {
+    if (defer_options(options, count, values)) return;
+
     for (size_t i = 0; i < count; ++i)
     {
         switch (options[i])
         {
         case  RS_OPTION_FRAMES_QUEUE_SIZE:
+            if (values[i] < 1 || values[i] > MAX_FRAME_QUEUE_SIZE) throw std::logic_error(to_string() << "frames queue size must be between 1 and " << MAX_FRAME_QUEUE_SIZE);
             max_publish_list_size = (uint32_t)values[i];
             break;
         case RS_OPTION_TOTAL_FRAME_DROPS:
             frames_drops_counter = (uint32_t)values[i];
             break;
+        case RS_OPTION_TIMESTAMPS_MATCHED:
+            timestamp_stats.matched = (uint32_t)values[i];
+            break;
+        case RS_OPTION_TIMESTAMPS_LATE:
+            timestamp_stats.late = (uint32_t)values[i];
+            break;
+        case RS_OPTION_TIMESTAMPS_DROPPED:
+            timestamp_stats.dropped = (uint32_t)values[i];
+            break;
+        case RS_OPTION_ZERO_COPY_ENABLED:
+            zero_copy_enabled = values[i] != 0;
+            break;
+        case RS_OPTION_CAPTURE_RING_DEPTH:
+            if (values[i] <= DRIVER_RESERVED_BUFFERS || values[i] > MAX_CAPTURE_RING_DEPTH) throw std::logic_error(to_string() << "capture ring depth must be between " << DRIVER_RESERVED_BUFFERS + 1 << " and " << MAX_CAPTURE_RING_DEPTH);
+            capture_ring_depth = (uint32_t)values[i];
+            break;
+        case RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE:
+            capture_thread_per_subdevice = values[i] != 0;
+            break;
+        case RS_OPTION_CAPTURE_THREAD_AFFINITY:
+            if (values[i] < 0 || values[i] > static_cast<double>(MAX_CAPTURE_THREAD_AFFINITY) || values[i] != std::floor(values[i])) throw std::logic_error(to_string() << "capture thread affinity must be a bitmask of CPUs 0 to 52");
+            capture_thread_affinity = (uint64_t)values[i];
+            break;
+        case RS_OPTION_CAPTURE_THREAD_PRIORITY:
+            if (values[i] < 0 || values[i] > MAX_CAPTURE_THREAD_PRIORITY) throw std::logic_error(to_string() << "capture thread priority must be between 0 and " << MAX_CAPTURE_THREAD_PRIORITY);
+            capture_thread_priority = (uint32_t)values[i];
+            break;
+        case RS_OPTION_CAPTURE_QUEUE_SIZE:
+            if (values[i] < 0 || values[i] > MAX_CAPTURE_QUEUE_SIZE) throw std::logic_error(to_string() << "capture queue size must be between 0 and " << MAX_CAPTURE_QUEUE_SIZE);
+            capture_queue_size = (uint32_t)values[i];
+            break;
+        case RS_OPTION_UNPACK_THREADS:
+            if (values[i] < 0 || values[i] > MAX_UNPACK_THREADS) throw std::logic_error(to_string() << "unpack threads must be between 0 and " << MAX_UNPACK_THREADS);
+            unpack_threads = (uint32_t)values[i];
+            break;
+        case RS_OPTION_UNPACK_ROW_BANDS:
+            if (values[i] < 1 || values[i] > MAX_UNPACK_ROW_BANDS) throw std::logic_error(to_string() << "unpack row bands must be between 1 and " << MAX_UNPACK_ROW_BANDS);
+            unpack_row_bands = (uint32_t)values[i];
+            break;
+        case RS_OPTION_PROCESSING_THREADS:
+            if (values[i] < 0 || values[i] > MAX_PROCESSING_THREADS) throw std::logic_error(to_string() << "processing threads must be between 0 and " << MAX_PROCESSING_THREADS);
+            if (processing_threads != (uint32_t)values[i])
+            {
+                processing_threads = (uint32_t)values[i];
+                processing_pool = processing_threads ? std::make_shared<thread_pool>(processing_threads) : nullptr;
+                points.set_thread_pool(processing_pool);
+                for (auto s : { &color_to_depth, &depth_to_color, &depth_to_rect_color, &infrared2_to_depth, &depth_to_infrared2 }) s->set_thread_pool(processing_pool);
+            }
+            break;
+        case RS_OPTION_COMPRESS_RECORDED_DEPTH:
+            compress_recorded_depth = values[i] != 0;
+            break;
         default:
             LOG_WARNING("Cannot set " << options[i] << " to " << values[i] << " on " << get_name());
             throw std::logic_error("Option unsupported");
@@ -699,6 +1230,47 @@ void rs_device_base::set_options(const rs_option options[], size_t count, const
     }
 }
 
+bool rs_device_base::defer_options(const rs_option options[], size_t count, const double values[])
+{
+    std::lock_guard<std::mutex> lock(options_batch_mutex);
+    if (!options_batch_open) return false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // Only the last value set to an option is sent, in the place of the last set, so that enabling or disabling auto modes keeps its order
+        auto it = std::find(batched_options.begin(), batched_options.end(), options[i]);
+        if (it != batched_options.end())
+        {
+            batched_values.erase(batched_values.begin() + (it - batched_options.begin()));
+            batched_options.erase(it);
+        }
+        batched_options.push_back(options[i]);
+        batched_values.push_back(values[i]);
+    }
+    return true;
+}
+
+void rs_device_base::begin_options_batch()
+{
+    std::lock_guard<std::mutex> lock(options_batch_mutex);
+    if (options_batch_open) throw std::logic_error("an options batch is already open");
+    options_batch_open = true;
+}
+
+// Sends the batched options in a single set_options call, which writes every structure-valued control it touches once
+void rs_device_base::commit_options_batch()
+{
+    std::vector<rs_option> options;
+    std::vector<double> values;
+    {
+        std::lock_guard<std::mutex> lock(options_batch_mutex);
+        if (!options_batch_open) throw std::logic_error("no options batch is open");
+        options_batch_open = false;
+        options.swap(batched_options);
+        values.swap(batched_values);
+    }
+    if (!options.empty()) set_options(options.data(), options.size(), values.data());
+}
+
 void rs_device_base::get_options(const rs_option options[], size_t count, double values[])
 {
     for (size_t i = 0; i < count; ++i)
@@ -711,6 +1283,45 @@ void rs_device_base::get_options(const rs_option options[], size_t count, double
         case  RS_OPTION_TOTAL_FRAME_DROPS:
             values[i] = frames_drops_counter;
             break;
+        case RS_OPTION_TIMESTAMPS_MATCHED:
+            values[i] = timestamp_stats.matched;
+            break;
+        case RS_OPTION_TIMESTAMPS_LATE:
+            values[i] = timestamp_stats.late;
+            break;
+        case RS_OPTION_TIMESTAMPS_DROPPED:
+            values[i] = timestamp_stats.dropped;
+            break;
+        case RS_OPTION_ZERO_COPY_ENABLED:
+            values[i] = zero_copy_enabled;
+            break;
+        case RS_OPTION_CAPTURE_RING_DEPTH:
+            values[i] = capture_ring_depth;
+            break;
+        case RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE:
+            values[i] = capture_thread_per_subdevice;
+            break;
+        case RS_OPTION_CAPTURE_THREAD_AFFINITY:
+            values[i] = static_cast<double>(capture_thread_affinity);
+            break;
+        case RS_OPTION_CAPTURE_THREAD_PRIORITY:
+            values[i] = capture_thread_priority;
+            break;
+        case RS_OPTION_CAPTURE_QUEUE_SIZE:
+            values[i] = capture_queue_size;
+            break;
+        case RS_OPTION_UNPACK_THREADS:
+            values[i] = unpack_threads;
+            break;
+        case RS_OPTION_UNPACK_ROW_BANDS:
+            values[i] = unpack_row_bands;
+            break;
+        case RS_OPTION_PROCESSING_THREADS:
+            values[i] = processing_threads;
+            break;
+        case RS_OPTION_COMPRESS_RECORDED_DEPTH:
+            values[i] = compress_recorded_depth;
+            break;
         default:
             LOG_WARNING("Cannot get " << options[i] << " on " << get_name());
             throw std::logic_error("Option unsupported");
@@ -758,6 +1369,7 @@ const char * rs_device_base::get_usb_port_id() const
         imu_data.axes[2] = frame->z;
         
 
+        if (recording) recording->record_motion(imu_data);
         config.motion_callback->on_event(imu_data);
 
 
@@ -777,38 +1389,39 @@ void rs_device_base::fisheyeCallback(motion::MotionFisheyeFrame* frame) {
         return;
     }
 
-        frame_archive::frame_additional_data additional_data( (frame->header.timestamp)/1000000.0,
-            frame->header.seq-3,
+        auto timestamp = frame->header.timestamp/1000000.0;
+        if (recording) recording->record_frame(3, pf_raw8.fourcc, frame->width, frame->height, frame->data, frame->width*frame->height, timestamp, frame->header.seq-3);
+        commit_fisheye_frame(frame->data, frame->width, frame->height, timestamp, frame->header.seq-3, frame->exposure);
+        motion_device->returnFisheyeBuffer(frame);
+    }
+
+    // Copies a fisheye image into the archive and hands it on, for the motion module and for playback alike
+    void rs_device_base::commit_fisheye_frame(const void * data, int width, int height, double timestamp, unsigned long long frame_number, double exposure)
+    {
+        frame_archive::frame_additional_data additional_data( timestamp,
+            frame_number,
             0,
-            frame->width,
-            frame->height,
+            width,
+            height,
             30,
-            frame->width,
+            width,
             0,
             8,
             RS_FORMAT_Y8,
             RS_STREAM_FISHEYE,
             0,
-            config.info.supported_metadata_vector,
-            frame->exposure);
+            config.info.supported_metadata,
+            exposure);
 
         additional_data.timestamp_domain = RS_TIMESTAMP_DOMAIN_MICROCONTROLLER;
         byte* frameData = archive->alloc_frame(RS_STREAM_FISHEYE, additional_data, true); // Sergey: this allocates object for the frame
 
-        memcpy(frameData,frame->data,frame->width*frame->height);
+        memcpy(frameData,data,width*height);
 
-        motion_device->returnFisheyeBuffer(frame);
-
-        if (config.callbacks[RS_STREAM_FISHEYE])
+        if (config.callbacks[RS_STREAM_FISHEYE] || archive->synchronizes(RS_STREAM_FISHEYE))
         {
             auto frame_ref = archive->track_frame(RS_STREAM_FISHEYE);
-            if (frame_ref)
-            {
-                 frame_ref->update_frame_callback_start_ts(std::chrono::high_resolution_clock::now());
-                 frame_ref->log_callback_start(std::chrono::high_resolution_clock::now());
-                on_before_callback(RS_STREAM_FISHEYE, frame_ref, archive);
-                (*config.callbacks[RS_STREAM_FISHEYE])->on_frame(this, frame_ref);
-            }
+            if (frame_ref) deliver_frame(archive, RS_STREAM_FISHEYE, frame_ref, std::chrono::high_resolution_clock::now());
         }
         else
         {
@@ -822,7 +1435,9 @@ void rs_device_base::fisheyeCallback(motion::MotionFisheyeFrame* frame) {
         if(frame->header.type == motion::MOTION_SOURCE_DEPTH) {
             if(frame->header.seq < 5)
                 return;
-            archive->on_timestamp({frame->header.timestamp/1000000.0,RS_EVENT_IMU_DEPTH_CAM,frame->header.seq-3});
+            rs_timestamp_data timestamp = {frame->header.timestamp/1000000.0,RS_EVENT_IMU_DEPTH_CAM,frame->header.seq-3};
+            if (recording) recording->record_timestamp(timestamp);
+            archive->on_timestamp(timestamp);
         }
     }
     void rs_device_base::notifyCallback(uint32_t status, uint8_t *buf, uint32_t size) {
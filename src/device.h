@@ -7,8 +7,12 @@
 
 #include "uvc.h"
 #include "stream.h"
+#include "sync.h"
 #include <chrono>
+#include <cstring>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <motion/MotionAPI-slim.h>
 #include <iostream>
@@ -39,6 +43,56 @@ namespace rsimpl
 
     template<class T, class R, class W> struct_interface<T, R, W> make_struct_interface(R r, W w) { return{ r,w }; }
 
+    // Remembers the last value read from or written to controls which only change when the host changes them, so that reading them again
+    // takes no USB transfer, and writing back the value the camera already holds is skipped. Values are keyed by their option, or by the
+    // first option held by a structure-valued control. Controls which the camera may change on its own, such as exposure under auto
+    // exposure, must not be cached, and the device clears the cache whenever streaming starts or stops, as the firmware may reset controls
+    class control_cache
+    {
+        std::map<rs_option, std::vector<byte>> values;
+        mutable std::mutex mutex;
+
+        template<class T> bool find(rs_option key, T & value) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = values.find(key);
+            if (it == values.end() || it->second.size() != sizeof(T)) return false;
+            memcpy(&value, it->second.data(), sizeof(T));
+            return true;
+        }
+        template<class T> void store(rs_option key, const T & value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto bytes = reinterpret_cast<const byte *>(&value);
+            values[key].assign(bytes, bytes + sizeof(T));
+        }
+    public:
+        template<class R> auto read(rs_option key, R reader) -> decltype(reader())
+        {
+            decltype(reader()) value;
+            if (!find(key, value))
+            {
+                value = reader();
+                store(key, value);
+            }
+            return value;
+        }
+
+        // The writer may adjust the value before sending it, and the value it leaves behind is the one cached
+        template<class T, class W> void write(rs_option key, T & value, W writer)
+        {
+            T cached;
+            if (find(key, cached) && !memcmp(&cached, &value, sizeof(T))) return;
+            invalidate(key); // The camera holds an unknown value if the write fails
+            writer(value);
+            store(key, value);
+        }
+
+        bool contains(rs_option key) const { std::lock_guard<std::mutex> lock(mutex); return values.count(key) != 0; }
+        void invalidate(rs_option key) { std::lock_guard<std::mutex> lock(mutex); values.erase(key); }
+        void clear() { std::lock_guard<std::mutex> lock(mutex); values.clear(); }
+    };
+
     template <typename T>
     class wraparound_mechanism
     {
@@ -85,11 +139,26 @@ namespace rsimpl
         virtual unsigned long long get_frame_counter(const subdevice_mode & mode, const void * frame) = 0;
     };
 
+    // Splits the capture ring between the buffers the driver keeps, the backend's hand-off queue, and the buffers held out of it by frames
+    // delivered without copying or waiting for the unpack workers. The ring grows to give every unpack job in flight a buffer of its own.
+    struct capture_buffer_budget
+    {
+        int unpack_jobs;        // Frames the unpack workers may have in flight at once
+        int ring_depth;
+        int queue_size;
+        int max_held_buffers;
+
+        capture_buffer_budget(int requested_ring_depth, int requested_queue_size, int unpack_threads);
+    };
+
 
     namespace motion_module
     {
         struct motion_module_parser;
     }
+
+    class thread_pool;
+    class recorder;
 }
 
 struct rs_device_base : rs_device,  motion::MotionDeviceListner
@@ -114,12 +183,32 @@ protected:
     std::atomic<uint32_t>                       max_publish_list_size;
     std::atomic<uint32_t>                       event_queue_size;
     std::atomic<uint32_t>                       events_timeout;
+    std::atomic<uint32_t>                       zero_copy_enabled;
+    std::atomic<uint32_t>                       capture_ring_depth;
+    std::atomic<uint32_t>                       capture_thread_per_subdevice;
+    std::atomic<uint64_t>                       capture_thread_affinity;
+    std::atomic<uint32_t>                       capture_thread_priority;
+    std::atomic<uint32_t>                       capture_queue_size;
+    std::atomic<uint32_t>                       unpack_threads;
+    std::atomic<uint32_t>                       unpack_row_bands;
+    std::shared_ptr<rsimpl::thread_pool>        unpack_pool;
+    std::atomic<uint32_t>                       processing_threads;
+    std::atomic<uint32_t>                       compress_recorded_depth;
+    std::shared_ptr<rsimpl::thread_pool>        processing_pool;
     std::shared_ptr<rsimpl::syncronizing_archive> archive;
+    std::shared_ptr<rsimpl::frameset_synchronizer> framesets;
 
     mutable std::string                         usb_port_id;
     mutable std::mutex                          usb_port_mutex;
 
     std::shared_ptr<std::thread>                fw_logger;
+    std::shared_ptr<rsimpl::recorder>           recording;              // Set while recording, which only changes while the device is stopped
+
+    rsimpl::control_cache                       controls;
+    std::mutex                                  options_batch_mutex;
+    bool                                        options_batch_open;     // Set between begin_options_batch and commit_options_batch
+    std::vector<rs_option>                      batched_options;
+    std::vector<double>                         batched_values;
 
 protected:
     const rsimpl::uvc::device &                 get_device() const { return *device; }
@@ -130,14 +219,28 @@ protected:
     virtual void                                start_motion_tracking();
     virtual void                                stop_motion_tracking();
 
+    virtual void                                open_video_channel(const rsimpl::subdevice_mode & mode, rsimpl::uvc::video_channel_callback callback);
+    virtual void                                start_video_channels(const rsimpl::uvc::capture_settings & settings);
+    virtual void                                stop_video_channels();
+    virtual bool                                video_channels_support_zero_copy() const;
+
+    void                                        dispatch_frames(const std::shared_ptr<rsimpl::syncronizing_archive> & archive, const std::vector<rs_stream> & streams,
+                                                                rsimpl::frame_continuation * passthrough_release);
+    void                                        deliver_frame(const std::shared_ptr<rsimpl::syncronizing_archive> & archive, rs_stream stream, rsimpl::frame_archive::frame_ref * frame_ref,
+                                                              std::chrono::high_resolution_clock::time_point capture_start_time);
+    void                                        commit_fisheye_frame(const void * data, int width, int height, double timestamp, unsigned long long frame_number, double exposure);
     virtual void                                disable_auto_option(int subdevice, rs_option auto_opt);
     virtual void                                on_before_callback(rs_stream, rs_frame_ref *, std::shared_ptr<rsimpl::frame_archive>) { }
 
+    // Holds back the options while a batch is open, and returns whether it did. Every set_options override starts with it
+    bool                                        defer_options(const rs_option options[], size_t count, const double values[]);
+
     bool                                        motion_module_ready;
     bool                                        fisheye_started = false;
     std::atomic<bool>                           keep_fw_logger_alive;
     
     std::atomic<int>                            frames_drops_counter;
+    rsimpl::timestamp_correction_stats          timestamp_stats;
 
 public:
     rs_device_base(std::shared_ptr<rsimpl::uvc::device> device, const rsimpl::static_device_info & info, rsimpl::calibration_validator validator = rsimpl::calibration_validator());
@@ -161,12 +264,24 @@ public:
     void                                        enable_motion_tracking() override;
     void                                        set_stream_callback(rs_stream stream, void(*on_frame)(rs_device * device, rs_frame_ref * frame, void * user), void * user) override;
     void                                        set_stream_callback(rs_stream stream, rs_frame_callback * callback) override;
+    void                                        set_frameset_callback(void(*on_frameset)(rs_device * device, rs_frame_ref ** frames, int count, void * user), void * user) override;
+    void                                        set_frameset_callback(rs_frameset_callback * callback) override;
+    void                                        set_frameset_policy(rs_frameset_policy policy) override;
+    void                                        set_frameset_tolerance(rs_stream a, rs_stream b, double milliseconds) override;
+    rs_frameset_stats                           get_frameset_stats() const override;
     void                                        disable_motion_tracking() override;
 
     void                                        set_motion_callback(rs_motion_callback * callback) override;
     void                                        set_motion_callback(void(*on_event)(rs_device * device, rs_motion_data data, void * user), void * user) override;
     void                                        set_timestamp_callback(void(*on_event)(rs_device * device, rs_timestamp_data data, void * user), void * user) override;
     void                                        set_timestamp_callback(rs_timestamp_callback * callback) override;
+    void                                        set_frame_allocator(rs_frame_allocate_ptr allocate, rs_frame_deallocate_ptr deallocate, void * user) override;
+    void                                        set_frame_allocator(rs_frame_allocator * allocator) override;
+    void                                        start_recording(const char * filename) override;
+    void                                        stop_recording() override;
+    void                                        set_playback_mode(rs_playback_mode mode) override;
+    bool                                        step_playback() override;
+    void                                        seek_playback(double time) override;
 
     virtual void                                start(rs_source source) override;
     virtual void                                stop(rs_source source) override;
@@ -178,6 +293,7 @@ public:
     int                                         is_motion_tracking_active() const override { return data_acquisition_active; }
 
     void                                        wait_all_streams() override;
+    bool                                        wait_all_streams(unsigned int timeout_ms) override;
     bool                                        poll_all_streams() override;
 
     virtual bool                                supports(rs_capabilities capability) const override;
@@ -187,6 +303,8 @@ public:
     virtual void                                get_option_range(rs_option option, double & min, double & max, double & step, double & def) override;
     virtual void                                set_options(const rs_option options[], size_t count, const double values[]) override;
     virtual void                                get_options(const rs_option options[], size_t count, double values[])override;
+    void                                        begin_options_batch() override;
+    void                                        commit_options_batch() override;
     virtual void                                on_before_start(const std::vector<rsimpl::subdevice_mode_selection> & selected_modes) = 0;
     virtual rs_stream                           select_key_stream(const std::vector<rsimpl::subdevice_mode_selection> & selected_modes) = 0;
     virtual std::vector<std::shared_ptr<rsimpl::frame_timestamp_reader>> 
@@ -3,6 +3,7 @@
 
 #include <climits>
 #include <algorithm>
+#include <functional>
 #include <iomanip>      // for std::put_time
 
 #include "image.h"
@@ -107,15 +108,34 @@ namespace rsimpl
         params.exposure_bottom_edge = bottom;
     }
 
+    // XU controls which only change when the host changes them are read and written through the control cache of the device. A structure-valued
+    // control is keyed by the first option it holds, and the options set together in one call or options batch take a single write of it
+    template<class T> struct_interface<T, std::function<T()>, std::function<void(T &)>> make_cached_struct_interface(control_cache & cache, rs_option key, std::function<T()> reader, std::function<void(T &)> writer)
+    {
+        return{ [&cache, key, reader]() { return cache.read(key, reader); }, [&cache, key, writer](T & value) { cache.write(key, value, writer); } };
+    }
+
+    template<class T> T read_cached_control(control_cache & cache, rs_option key, const uvc::device & dev, T (*getter)(const uvc::device &))
+    {
+        return cache.read(key, [&dev, getter]() { return getter(dev); });
+    }
+
+    template<class T> void write_cached_control(control_cache & cache, rs_option key, uvc::device & dev, void (*setter)(uvc::device &, T), T value)
+    {
+        cache.write(key, value, [&dev, setter](T v) { setter(dev, v); });
+    }
+
     void ds_device::set_options(const rs_option options[], size_t count, const double values[])
     {
+        if (defer_options(options, count, values)) return;
+
         std::vector<rs_option>  base_opt;
         std::vector<double>     base_opt_val;
 
         auto & dev = get_device();
-        auto minmax_writer = make_struct_interface<ds::range    >([&dev]() { return ds::get_min_max_depth(dev);           }, [&dev](ds::range     v) { ds::set_min_max_depth(dev,v);           });
-        auto disp_writer   = make_struct_interface<ds::disp_mode>([&dev]() { return ds::get_disparity_mode(dev);          }, [&dev](ds::disp_mode v) { ds::set_disparity_mode(dev,v);          });
-        auto ae_writer = make_struct_interface<ds::ae_params>(
+        auto minmax_writer = make_cached_struct_interface<ds::range    >(controls, RS_OPTION_R200_DEPTH_CLAMP_MIN,    [&dev]() { return ds::get_min_max_depth(dev);  }, [&dev](ds::range     & v) { ds::set_min_max_depth(dev,v);  });
+        auto disp_writer   = make_cached_struct_interface<ds::disp_mode>(controls, RS_OPTION_R200_DISPARITY_MULTIPLIER, [&dev]() { return ds::get_disparity_mode(dev); }, [&dev](ds::disp_mode & v) { ds::set_disparity_mode(dev,v); });
+        auto ae_writer = make_cached_struct_interface<ds::ae_params>(controls, RS_OPTION_R200_AUTO_EXPOSURE_MEAN_INTENSITY_SET_POINT,
             [&dev, this]() { 
                 auto ae = ds::get_lr_auto_exposure_params(dev, get_ae_range_vec());
                 correct_lr_auto_exposure_params(this, ae);
@@ -126,7 +146,7 @@ namespace rsimpl
                 ds::set_lr_auto_exposure_params(dev, v); 
             }
         );
-        auto dc_writer     = make_struct_interface<ds::dc_params>([&dev]() { return ds::get_depth_params(dev);            }, [&dev](ds::dc_params v) { ds::set_depth_params(dev,v);            });
+        auto dc_writer     = make_cached_struct_interface<ds::dc_params>(controls, RS_OPTION_R200_DEPTH_CONTROL_ESTIMATE_MEDIAN_DECREMENT, [&dev]() { return ds::get_depth_params(dev); }, [&dev](ds::dc_params & v) { ds::set_depth_params(dev,v); });
 
         for (size_t i = 0; i<count; ++i)
         {
@@ -147,18 +167,23 @@ namespace rsimpl
             switch(options[i])
             {
 
-            case RS_OPTION_R200_LR_AUTO_EXPOSURE_ENABLED:                   ds::set_lr_exposure_mode(get_device(), static_cast<uint8_t>(values[i])); break;
-            case RS_OPTION_R200_LR_GAIN:                                    ds::set_lr_gain(get_device(), {get_lr_framerate(), static_cast<uint32_t>(values[i])}); break; // TODO: May need to set this on start if framerate changes
-            case RS_OPTION_R200_LR_EXPOSURE:                                ds::set_lr_exposure(get_device(), {get_lr_framerate(), static_cast<uint32_t>(values[i])}); break; // TODO: May need to set this on start if framerate changes
+            case RS_OPTION_R200_LR_AUTO_EXPOSURE_ENABLED:                   write_cached_control(controls, options[i], dev, ds::set_lr_exposure_mode, static_cast<uint8_t>(values[i])); break;
+
+            // Manual gain and exposure turn off auto exposure, which takes no transfer once it is known to be off
+            case RS_OPTION_R200_LR_GAIN:                                    write_cached_control(controls, RS_OPTION_R200_LR_AUTO_EXPOSURE_ENABLED, dev, ds::set_lr_exposure_mode, uint8_t(0));
+                ds::set_lr_gain(dev, {get_lr_framerate(), static_cast<uint32_t>(values[i])}); break; // TODO: May need to set this on start if framerate changes
+            case RS_OPTION_R200_LR_EXPOSURE:                                write_cached_control(controls, RS_OPTION_R200_LR_AUTO_EXPOSURE_ENABLED, dev, ds::set_lr_exposure_mode, uint8_t(0));
+                ds::set_lr_exposure(dev, {get_lr_framerate(), static_cast<uint32_t>(values[i])}); break; // TODO: May need to set this on start if framerate changes
             case RS_OPTION_R200_EMITTER_ENABLED:                            ds::set_emitter_state(get_device(), !!values[i]); break;
-            case RS_OPTION_R200_DEPTH_UNITS:                                ds::set_depth_units(get_device(), static_cast<uint32_t>(values[i]));
+            case RS_OPTION_R200_DEPTH_UNITS:                                write_cached_control(controls, options[i], dev, ds::set_depth_units, static_cast<uint32_t>(values[i]));
+                controls.invalidate(RS_OPTION_R200_DEPTH_CLAMP_MIN); // The clamp is held in depth units
                 on_update_depth_units(static_cast<uint32_t>(values[i])); break;
 
             case RS_OPTION_R200_DEPTH_CLAMP_MIN:                            minmax_writer.set(&ds::range::min, values[i]); break;
             case RS_OPTION_R200_DEPTH_CLAMP_MAX:                            minmax_writer.set(&ds::range::max, values[i]); break;
 
             case RS_OPTION_R200_DISPARITY_MULTIPLIER:                       disp_writer.set(&ds::disp_mode::disparity_multiplier, values[i]); break;
-            case RS_OPTION_R200_DISPARITY_SHIFT:                            ds::set_disparity_shift(get_device(), static_cast<uint32_t>(values[i])); break;
+            case RS_OPTION_R200_DISPARITY_SHIFT:                            write_cached_control(controls, options[i], dev, ds::set_disparity_shift, static_cast<uint32_t>(values[i])); break;
 
             case RS_OPTION_R200_AUTO_EXPOSURE_MEAN_INTENSITY_SET_POINT:     ae_writer.set(&ds::ae_params::mean_intensity_set_point, values[i]); break;
             case RS_OPTION_R200_AUTO_EXPOSURE_BRIGHT_RATIO_SET_POINT:       ae_writer.set(&ds::ae_params::bright_ratio_set_point,   values[i]); break;
@@ -204,9 +229,9 @@ namespace rsimpl
         std::vector<double>     base_opt_val;
 
         auto & dev = get_device();
-        auto minmax_reader = make_struct_interface<ds::range    >([&dev]() { return ds::get_min_max_depth(dev);           }, [&dev](ds::range     v) { ds::set_min_max_depth(dev,v);           });
-        auto disp_reader   = make_struct_interface<ds::disp_mode>([&dev]() { return ds::get_disparity_mode(dev);          }, [&dev](ds::disp_mode v) { ds::set_disparity_mode(dev,v);          });
-        auto ae_reader = make_struct_interface<ds::ae_params>(
+        auto minmax_reader = make_cached_struct_interface<ds::range    >(controls, RS_OPTION_R200_DEPTH_CLAMP_MIN,    [&dev]() { return ds::get_min_max_depth(dev);  }, [&dev](ds::range     & v) { ds::set_min_max_depth(dev,v);  });
+        auto disp_reader   = make_cached_struct_interface<ds::disp_mode>(controls, RS_OPTION_R200_DISPARITY_MULTIPLIER, [&dev]() { return ds::get_disparity_mode(dev); }, [&dev](ds::disp_mode & v) { ds::set_disparity_mode(dev,v); });
+        auto ae_reader = make_cached_struct_interface<ds::ae_params>(controls, RS_OPTION_R200_AUTO_EXPOSURE_MEAN_INTENSITY_SET_POINT,
             [&dev, this]() { 
                 auto ae = ds::get_lr_auto_exposure_params(dev, get_ae_range_vec());
                 correct_lr_auto_exposure_params(this, ae);
@@ -217,7 +242,7 @@ namespace rsimpl
                 ds::set_lr_auto_exposure_params(dev, v); 
             }
         );
-        auto dc_reader     = make_struct_interface<ds::dc_params>([&dev]() { return ds::get_depth_params(dev);            }, [&dev](ds::dc_params v) { ds::set_depth_params(dev,v);            });
+        auto dc_reader     = make_cached_struct_interface<ds::dc_params>(controls, RS_OPTION_R200_DEPTH_CONTROL_ESTIMATE_MEDIAN_DECREMENT, [&dev]() { return ds::get_depth_params(dev); }, [&dev](ds::dc_params & v) { ds::set_depth_params(dev,v); });
 
         for (size_t i = 0; i<count; ++i)
         {
@@ -231,7 +256,7 @@ namespace rsimpl
             switch(options[i])
             {
 
-            case RS_OPTION_R200_LR_AUTO_EXPOSURE_ENABLED:                   values[i] = ds::get_lr_exposure_mode(get_device()); break;
+            case RS_OPTION_R200_LR_AUTO_EXPOSURE_ENABLED:                   values[i] = read_cached_control(controls, options[i], dev, ds::get_lr_exposure_mode); break;
 
             case RS_OPTION_R200_LR_GAIN: // Gain is framerate dependent
                 ds::set_lr_gain_discovery(get_device(), {get_lr_framerate(), 0, 0, 0, 0});
@@ -245,13 +270,13 @@ namespace rsimpl
                 values[i] = ds::get_emitter_state(get_device(), is_capturing(), get_stream_interface(RS_STREAM_DEPTH).is_enabled());
                 break;
 
-            case RS_OPTION_R200_DEPTH_UNITS:                                values[i] = ds::get_depth_units(dev);  break;
+            case RS_OPTION_R200_DEPTH_UNITS:                                values[i] = read_cached_control(controls, options[i], dev, ds::get_depth_units); break;
 
             case RS_OPTION_R200_DEPTH_CLAMP_MIN:                            values[i] = minmax_reader.get(&ds::range::min); break;
             case RS_OPTION_R200_DEPTH_CLAMP_MAX:                            values[i] = minmax_reader.get(&ds::range::max); break;
 
             case RS_OPTION_R200_DISPARITY_MULTIPLIER:                       values[i] = disp_reader.get(&ds::disp_mode::disparity_multiplier); break;
-            case RS_OPTION_R200_DISPARITY_SHIFT:                            values[i] = ds::get_disparity_shift(dev); break;
+            case RS_OPTION_R200_DISPARITY_SHIFT:                            values[i] = read_cached_control(controls, options[i], dev, ds::get_disparity_shift); break;
 
             case RS_OPTION_R200_AUTO_EXPOSURE_MEAN_INTENSITY_SET_POINT:     values[i] = ae_reader.get(&ds::ae_params::mean_intensity_set_point); break;
             case RS_OPTION_R200_AUTO_EXPOSURE_BRIGHT_RATIO_SET_POINT:       values[i] = ae_reader.get(&ds::ae_params::bright_ratio_set_point  ); break;
@@ -285,8 +310,8 @@ namespace rsimpl
         }
 
         // Merge the local data with values obtained by base class
-        for (auto i : base_opt_index)
-            values[i] = base_opt_val[i];
+        for (size_t j = 0; j < base_opt_index.size(); ++j)
+            values[base_opt_index[j]] = base_opt_val[j];
     }
 
     void ds_device::stop(rs_source source)
@@ -416,8 +416,8 @@ namespace rsimpl
         inline void         set_disparity_shift         (uvc::device & device, uint32_t shift)      { xu_write(device, lr_xu, control::disparity_shift, shift); }
         inline void         set_lr_exposure_discovery   (uvc::device & device, discovery disc)      { xu_write(device, lr_xu, control::lr_exposure_discovery, disc); }
         inline void         set_lr_gain_discovery       (uvc::device & device, discovery disc)      { xu_write(device, lr_xu, control::lr_gain_discovery, disc); }
-        inline void         set_lr_exposure             (uvc::device & device, rate_value exposure) { if (get_lr_exposure_mode(device)) set_lr_exposure_mode(device,0); xu_write(device, lr_xu, control::lr_exposure, exposure);}
-        inline void         set_lr_gain                 (uvc::device & device, rate_value gain)     { if (get_lr_exposure_mode(device)) set_lr_exposure_mode(device,0); xu_write(device, lr_xu, control::lr_gain, gain);}
+        inline void         set_lr_exposure             (uvc::device & device, rate_value exposure) { xu_write(device, lr_xu, control::lr_exposure, exposure); } // Only takes effect while auto exposure is off
+        inline void         set_lr_gain                 (uvc::device & device, rate_value gain)     { xu_write(device, lr_xu, control::lr_gain, gain); } // Only takes effect while auto exposure is off
 
 
         #pragma pack(push, 1)
@@ -205,6 +205,8 @@ namespace rsimpl
 
     void f200_camera::set_options(const rs_option options[], size_t count, const double values[])
     {
+        if (defer_options(options, count, values)) return;
+
         std::vector<rs_option>  base_opt;
         std::vector<double>     base_opt_val;
 
@@ -258,8 +260,8 @@ namespace rsimpl
         }
 
         // Merge the local data with values obtained by base class
-        for (auto i : base_opt_index)
-            values[i] = base_opt_val[i];
+        for (size_t j = 0; j < base_opt_index.size(); ++j)
+            values[base_opt_index[j]] = base_opt_val[j];
     }
 
     std::shared_ptr<rs_device> make_f200_device(std::shared_ptr<uvc::device> device)
@@ -0,0 +1,111 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// AVX2 pixel converters, compiled for AVX2 regardless of the project wide instruction set and only called once cpuid reports support
+
+#include "image.h"
+
+#ifdef RS_X86_SIMD_DISPATCH
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "image-simd.h"
+
+namespace rsimpl
+{
+    struct avx2_ops
+    {
+        typedef __m256i vec;
+        static const int lanes = 2;
+
+        // Lane 0 receives pixels 0-7 and 8-15, lane 1 receives pixels 16-23 and 24-31
+        static void load_pixels(const byte * s, vec & s0, vec & s1)
+        {
+            vec a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+            vec b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s) + 1);
+            s0 = _mm256_permute2x128_si256(a, b, 0x20);
+            s1 = _mm256_permute2x128_si256(a, b, 0x31);
+        }
+
+        static void store_lanes(byte * & d, const vec * v, int count)
+        {
+            for(int i = 0; i < count; ++i, d += 16) _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm256_castsi256_si128(v[i]));
+            for(int i = 0; i < count; ++i, d += 16) _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm256_extracti128_si256(v[i], 1));
+        }
+
+        static vec load_lanes(const byte * s, int stride)
+        {
+            return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s))), _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + stride)), 1);
+        }
+        static void store(byte * d, vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), v); }
+        static void store_low_halves(byte * d, vec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08))); }
+
+        static vec setr_epi8(char b0, char b1, char b2, char b3, char b4, char b5, char b6, char b7, char b8, char b9, char b10, char b11, char b12, char b13, char b14, char b15)
+        {
+            return _mm256_broadcastsi128_si256(_mm_setr_epi8(b0, b1, b2, b3, b4, b5, b6, b7, b8, b9, b10, b11, b12, b13, b14, b15));
+        }
+        static vec set1_epi8(char a) { return _mm256_set1_epi8(a); }
+        static vec set1_epi16(short a) { return _mm256_set1_epi16(a); }
+        static vec shuffle_epi8(vec a, vec b) { return _mm256_shuffle_epi8(a, b); }
+        static vec unpacklo_epi8(vec a, vec b) { return _mm256_unpacklo_epi8(a, b); }
+        static vec unpackhi_epi8(vec a, vec b) { return _mm256_unpackhi_epi8(a, b); }
+        static vec unpacklo_epi16(vec a, vec b) { return _mm256_unpacklo_epi16(a, b); }
+        static vec unpackhi_epi16(vec a, vec b) { return _mm256_unpackhi_epi16(a, b); }
+        static vec unpackhi_epi32(vec a, vec b) { return _mm256_unpackhi_epi32(a, b); }
+        static vec unpacklo_epi64(vec a, vec b) { return _mm256_unpacklo_epi64(a, b); }
+        static vec packus_epi16(vec a, vec b) { return _mm256_packus_epi16(a, b); }
+        static vec and_si(vec a, vec b) { return _mm256_and_si256(a, b); }
+        static vec or_si(vec a, vec b) { return _mm256_or_si256(a, b); }
+        static vec subs_epi16(vec a, vec b) { return _mm256_subs_epi16(a, b); }
+        static vec add_epi16(vec a, vec b) { return _mm256_add_epi16(a, b); }
+        static vec sub_epi16(vec a, vec b) { return _mm256_sub_epi16(a, b); }
+        static vec mulhi_epi16(vec a, vec b) { return _mm256_mulhi_epi16(a, b); }
+        static vec min_epi16(vec a, vec b) { return _mm256_min_epi16(a, b); }
+        static vec max_epi16(vec a, vec b) { return _mm256_max_epi16(a, b); }
+        template<int N> static vec slli_epi16(vec a) { return _mm256_slli_epi16(a, N); }
+        template<int N> static vec srli_epi16(vec a) { return _mm256_srli_epi16(a, N); }
+        template<int N> static vec alignr_epi8(vec a, vec b) { return _mm256_alignr_epi8(a, b, N); }
+    };
+
+    template<rs_format FORMAT> static int unpack_yuy2_avx2_kernel(byte * d, const byte * s, int n) { return unpack_yuy2_lanes<avx2_ops, FORMAT>(d, s, n); }
+    static int split_y8i_avx2_kernel(byte * a, byte * b, const byte * s, int n) { return split_y8i_lanes<avx2_ops>(a, b, s, n); }
+    static int split_y12i_avx2_kernel(byte * a, byte * b, const byte * s, int n) { return split_y12i_lanes<avx2_ops>(a, b, s, n); }
+    static int split_f200_inzi_y8_avx2_kernel(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_lanes<avx2_ops, false>(a, b, s, n); }
+    static int split_f200_inzi_y16_avx2_kernel(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_lanes<avx2_ops, true>(a, b, s, n); }
+    static int unpack_y8_from_y16_10_avx2_kernel(byte * d, const byte * s, int n) { return unpack_y8_from_y16_10_lanes<avx2_ops>(d, s, n); }
+    static int unpack_y16_from_y16_10_avx2_kernel(byte * d, const byte * s, int n) { return unpack_y16_from_y16_10_lanes<avx2_ops>(d, s, n); }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+namespace rsimpl
+{
+    template<rs_format FORMAT> int unpack_yuy2_avx2(byte * d, const byte * s, int n) { return unpack_yuy2_avx2_kernel<FORMAT>(d, s, n); }
+
+    template int unpack_yuy2_avx2<RS_FORMAT_Y8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx2<RS_FORMAT_Y16>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx2<RS_FORMAT_RGB8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx2<RS_FORMAT_RGBA8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx2<RS_FORMAT_BGR8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx2<RS_FORMAT_BGRA8>(byte * d, const byte * s, int n);
+
+    int split_y8i_avx2(byte * a, byte * b, const byte * s, int n) { return split_y8i_avx2_kernel(a, b, s, n); }
+    int split_y12i_avx2(byte * a, byte * b, const byte * s, int n) { return split_y12i_avx2_kernel(a, b, s, n); }
+    int split_f200_inzi_y8_avx2(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_y8_avx2_kernel(a, b, s, n); }
+    int split_f200_inzi_y16_avx2(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_y16_avx2_kernel(a, b, s, n); }
+    int unpack_y8_from_y16_10_avx2(byte * d, const byte * s, int n) { return unpack_y8_from_y16_10_avx2_kernel(d, s, n); }
+    int unpack_y16_from_y16_10_avx2(byte * d, const byte * s, int n) { return unpack_y16_from_y16_10_avx2_kernel(d, s, n); }
+}
+
+#endif
@@ -0,0 +1,125 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// AVX-512BW pixel converters, compiled for AVX-512BW regardless of the project wide instruction set and only called once cpuid reports support
+
+#include "image.h"
+
+#ifdef RS_X86_SIMD_DISPATCH_AVX512
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+// GCC implements several AVX-512 intrinsics on top of deliberately undefined registers, which -Wall reports once they are inlined here
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "image-simd.h"
+
+namespace rsimpl
+{
+    struct avx512_ops
+    {
+        typedef __m512i vec;
+        static const int lanes = 4;
+
+        // Lane i receives pixels 16i to 16i+7 and 16i+8 to 16i+15
+        static void load_pixels(const byte * s, vec & s0, vec & s1)
+        {
+            vec a = _mm512_loadu_si512(s);
+            vec b = _mm512_loadu_si512(s + 64);
+            s0 = _mm512_permutex2var_epi64(a, _mm512_setr_epi64(0, 1, 4, 5, 8, 9, 12, 13), b);
+            s1 = _mm512_permutex2var_epi64(a, _mm512_setr_epi64(2, 3, 6, 7, 10, 11, 14, 15), b);
+        }
+
+        template<int LANE> static void store_lane(byte * & d, const vec * v, int count)
+        {
+            for(int i = 0; i < count; ++i, d += 16) _mm_storeu_si128(reinterpret_cast<__m128i *>(d), _mm512_extracti32x4_epi32(v[i], LANE));
+        }
+        static void store_lanes(byte * & d, const vec * v, int count)
+        {
+            store_lane<0>(d, v, count);
+            store_lane<1>(d, v, count);
+            store_lane<2>(d, v, count);
+            store_lane<3>(d, v, count);
+        }
+
+        static vec load_lanes(const byte * s, int stride)
+        {
+            vec v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s)));
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + stride)), 1);
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + stride * 2)), 2);
+            return _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + stride * 3)), 3);
+        }
+        static void store(byte * d, vec v) { _mm512_storeu_si512(d, v); }
+        static void store_low_halves(byte * d, vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), _mm512_castsi512_si256(_mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 0, 0, 0, 0), v))); }
+
+        static vec setr_epi8(char b0, char b1, char b2, char b3, char b4, char b5, char b6, char b7, char b8, char b9, char b10, char b11, char b12, char b13, char b14, char b15)
+        {
+            return _mm512_broadcast_i32x4(_mm_setr_epi8(b0, b1, b2, b3, b4, b5, b6, b7, b8, b9, b10, b11, b12, b13, b14, b15));
+        }
+        static vec set1_epi8(char a) { return _mm512_set1_epi8(a); }
+        static vec set1_epi16(short a) { return _mm512_set1_epi16(a); }
+        static vec shuffle_epi8(vec a, vec b) { return _mm512_shuffle_epi8(a, b); }
+        static vec unpacklo_epi8(vec a, vec b) { return _mm512_unpacklo_epi8(a, b); }
+        static vec unpackhi_epi8(vec a, vec b) { return _mm512_unpackhi_epi8(a, b); }
+        static vec unpacklo_epi16(vec a, vec b) { return _mm512_unpacklo_epi16(a, b); }
+        static vec unpackhi_epi16(vec a, vec b) { return _mm512_unpackhi_epi16(a, b); }
+        static vec unpackhi_epi32(vec a, vec b) { return _mm512_unpackhi_epi32(a, b); }
+        static vec unpacklo_epi64(vec a, vec b) { return _mm512_unpacklo_epi64(a, b); }
+        static vec packus_epi16(vec a, vec b) { return _mm512_packus_epi16(a, b); }
+        static vec and_si(vec a, vec b) { return _mm512_and_si512(a, b); }
+        static vec or_si(vec a, vec b) { return _mm512_or_si512(a, b); }
+        static vec subs_epi16(vec a, vec b) { return _mm512_subs_epi16(a, b); }
+        static vec add_epi16(vec a, vec b) { return _mm512_add_epi16(a, b); }
+        static vec sub_epi16(vec a, vec b) { return _mm512_sub_epi16(a, b); }
+        static vec mulhi_epi16(vec a, vec b) { return _mm512_mulhi_epi16(a, b); }
+        static vec min_epi16(vec a, vec b) { return _mm512_min_epi16(a, b); }
+        static vec max_epi16(vec a, vec b) { return _mm512_max_epi16(a, b); }
+        template<int N> static vec slli_epi16(vec a) { return _mm512_slli_epi16(a, N); }
+        template<int N> static vec srli_epi16(vec a) { return _mm512_srli_epi16(a, N); }
+        template<int N> static vec alignr_epi8(vec a, vec b) { return _mm512_alignr_epi8(a, b, N); }
+    };
+
+    template<rs_format FORMAT> static int unpack_yuy2_avx512_kernel(byte * d, const byte * s, int n) { return unpack_yuy2_lanes<avx512_ops, FORMAT>(d, s, n); }
+    static int split_y8i_avx512_kernel(byte * a, byte * b, const byte * s, int n) { return split_y8i_lanes<avx512_ops>(a, b, s, n); }
+    static int split_y12i_avx512_kernel(byte * a, byte * b, const byte * s, int n) { return split_y12i_lanes<avx512_ops>(a, b, s, n); }
+    static int split_f200_inzi_y8_avx512_kernel(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_lanes<avx512_ops, false>(a, b, s, n); }
+    static int split_f200_inzi_y16_avx512_kernel(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_lanes<avx512_ops, true>(a, b, s, n); }
+    static int unpack_y8_from_y16_10_avx512_kernel(byte * d, const byte * s, int n) { return unpack_y8_from_y16_10_lanes<avx512_ops>(d, s, n); }
+    static int unpack_y16_from_y16_10_avx512_kernel(byte * d, const byte * s, int n) { return unpack_y16_from_y16_10_lanes<avx512_ops>(d, s, n); }
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+namespace rsimpl
+{
+    template<rs_format FORMAT> int unpack_yuy2_avx512(byte * d, const byte * s, int n) { return unpack_yuy2_avx512_kernel<FORMAT>(d, s, n); }
+
+    template int unpack_yuy2_avx512<RS_FORMAT_Y8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx512<RS_FORMAT_Y16>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx512<RS_FORMAT_RGB8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx512<RS_FORMAT_RGBA8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx512<RS_FORMAT_BGR8>(byte * d, const byte * s, int n);
+    template int unpack_yuy2_avx512<RS_FORMAT_BGRA8>(byte * d, const byte * s, int n);
+
+    int split_y8i_avx512(byte * a, byte * b, const byte * s, int n) { return split_y8i_avx512_kernel(a, b, s, n); }
+    int split_y12i_avx512(byte * a, byte * b, const byte * s, int n) { return split_y12i_avx512_kernel(a, b, s, n); }
+    int split_f200_inzi_y8_avx512(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_y8_avx512_kernel(a, b, s, n); }
+    int split_f200_inzi_y16_avx512(byte * a, byte * b, const byte * s, int n) { return split_f200_inzi_y16_avx512_kernel(a, b, s, n); }
+    int unpack_y8_from_y16_10_avx512(byte * d, const byte * s, int n) { return unpack_y8_from_y16_10_avx512_kernel(d, s, n); }
+    int unpack_y16_from_y16_10_avx512(byte * d, const byte * s, int n) { return unpack_y16_from_y16_10_avx512_kernel(d, s, n); }
+}
+
+#endif
@@ -0,0 +1,238 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// Instruction set independent body of the vectorized converters. Each including translation unit supplies an OPS type wrapping
+// the intrinsics of one instruction set, and must include this header in a region compiled for that instruction set.
+
+#pragma once
+#ifndef LIBREALSENSE_IMAGE_SIMD_H
+#define LIBREALSENSE_IMAGE_SIMD_H
+
+namespace rsimpl
+{
+    // OPS::vec holds OPS::lanes independent 128-bit lanes. All operations except the loads and stores act within a lane, with the
+    // semantics of the SSE instruction of the same name, so every lane converts its own group of pixels. Every converter returns
+    // the number of pixels converted, the caller converts the remaining pixels that do not fill all lanes.
+    //
+    // load_pixels(s, s0, s1) fills lane i of s0 and s1 with the two 16 byte halves of the 32 bytes at s + i * 32.
+    // load_lanes(s, stride) fills lane i with the 16 bytes at s + i * stride, store(d, v) writes all lanes to consecutive memory,
+    // store_low_halves(d, v) writes the low 8 bytes of every lane to consecutive memory, store_lanes(d, v, count) writes lane 0
+    // of each of the count registers, then lane 1 of each, and so on.
+
+    // YUY2: 16 pixels per lane
+    template<class OPS, rs_format FORMAT> int unpack_yuy2_lanes(byte * d, const byte * s, int n)
+    {
+        typedef typename OPS::vec vec;
+        const int pixels_per_iteration = 16 * OPS::lanes;
+
+        const vec zero = OPS::set1_epi8(0);
+        const vec n100 = OPS::set1_epi16(100 << 4);
+        const vec n208 = OPS::set1_epi16(208 << 4);
+        const vec n298 = OPS::set1_epi16(298 << 4);
+        const vec n409 = OPS::set1_epi16(409 << 4);
+        const vec n516 = OPS::set1_epi16(516 << 4);
+        const vec evens_odds = OPS::setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+        const vec evens_odd1s_odd3s = OPS::setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 5, 9, 13, 3, 7, 11, 15); // to get yyyyyyyyuuuuvvvv
+
+        int converted = 0;
+        for(; n - converted >= pixels_per_iteration; converted += pixels_per_iteration, s += pixels_per_iteration * 2)
+        {
+            // Load 8 YUY2 pixels into each lane of two registers
+            vec s0, s1;
+            OPS::load_pixels(s, s0, s1);
+
+            if(FORMAT == RS_FORMAT_Y8)
+            {
+                // Gather the Y components of both registers and output 16 pixels (16 bytes) per lane
+                vec y[1] = { OPS::unpacklo_epi64(OPS::shuffle_epi8(s0, evens_odds), OPS::shuffle_epi8(s1, evens_odds)) };
+                OPS::store_lanes(d, y, 1);
+                continue;
+            }
+
+            // Shuffle all Y components to the low order bytes of the register, and all U/V components to the high order bytes
+            vec yyyyyyyyuuuuvvvv0 = OPS::shuffle_epi8(s0, evens_odd1s_odd3s);
+            vec yyyyyyyyuuuuvvvv8 = OPS::shuffle_epi8(s1, evens_odd1s_odd3s);
+
+            // Retrieve all 16 Y components as 16-bit values (8 components per register)
+            vec y16__0_7 = OPS::unpacklo_epi8(yyyyyyyyuuuuvvvv0, zero);
+            vec y16__8_F = OPS::unpacklo_epi8(yyyyyyyyuuuuvvvv8, zero);
+
+            if(FORMAT == RS_FORMAT_Y16)
+            {
+                // Output 16 pixels (32 bytes) per lane
+                vec y[2] = { OPS::template slli_epi16<8>(y16__0_7), OPS::template slli_epi16<8>(y16__8_F) };
+                OPS::store_lanes(d, y, 2);
+                continue;
+            }
+
+            // Retrieve all 16 U and V components as 16-bit values (8 components per register)
+            vec uv = OPS::unpackhi_epi32(yyyyyyyyuuuuvvvv0, yyyyyyyyuuuuvvvv8); // uuuuuuuuvvvvvvvv
+            vec u = OPS::unpacklo_epi8(uv, uv);                                 // uu uu uu uu uu uu uu uu  u's duplicated
+            vec v = OPS::unpackhi_epi8(uv, uv);                                 // vv vv vv vv vv vv vv vv
+            vec u16__0_7 = OPS::unpacklo_epi8(u, zero);
+            vec u16__8_F = OPS::unpackhi_epi8(u, zero);
+            vec v16__0_7 = OPS::unpacklo_epi8(v, zero);
+            vec v16__8_F = OPS::unpackhi_epi8(v, zero);
+
+            // Compute R, G, B values for first 8 pixels
+            vec c16__0_7 = OPS::template slli_epi16<4>(OPS::subs_epi16(y16__0_7, OPS::set1_epi16(16)));
+            vec d16__0_7 = OPS::template slli_epi16<4>(OPS::subs_epi16(u16__0_7, OPS::set1_epi16(128)));
+            vec e16__0_7 = OPS::template slli_epi16<4>(OPS::subs_epi16(v16__0_7, OPS::set1_epi16(128)));
+            vec r16__0_7 = OPS::min_epi16(OPS::set1_epi16(255), OPS::max_epi16(zero, OPS::add_epi16(OPS::mulhi_epi16(c16__0_7, n298), OPS::mulhi_epi16(e16__0_7, n409))));
+            vec g16__0_7 = OPS::min_epi16(OPS::set1_epi16(255), OPS::max_epi16(zero, OPS::sub_epi16(OPS::sub_epi16(OPS::mulhi_epi16(c16__0_7, n298), OPS::mulhi_epi16(d16__0_7, n100)), OPS::mulhi_epi16(e16__0_7, n208))));
+            vec b16__0_7 = OPS::min_epi16(OPS::set1_epi16(255), OPS::max_epi16(zero, OPS::add_epi16(OPS::mulhi_epi16(c16__0_7, n298), OPS::mulhi_epi16(d16__0_7, n516))));
+
+            // Compute R, G, B values for second 8 pixels
+            vec c16__8_F = OPS::template slli_epi16<4>(OPS::subs_epi16(y16__8_F, OPS::set1_epi16(16)));
+            vec d16__8_F = OPS::template slli_epi16<4>(OPS::subs_epi16(u16__8_F, OPS::set1_epi16(128)));
+            vec e16__8_F = OPS::template slli_epi16<4>(OPS::subs_epi16(v16__8_F, OPS::set1_epi16(128)));
+            vec r16__8_F = OPS::min_epi16(OPS::set1_epi16(255), OPS::max_epi16(zero, OPS::add_epi16(OPS::mulhi_epi16(c16__8_F, n298), OPS::mulhi_epi16(e16__8_F, n409))));
+            vec g16__8_F = OPS::min_epi16(OPS::set1_epi16(255), OPS::max_epi16(zero, OPS::sub_epi16(OPS::sub_epi16(OPS::mulhi_epi16(c16__8_F, n298), OPS::mulhi_epi16(d16__8_F, n100)), OPS::mulhi_epi16(e16__8_F, n208))));
+            vec b16__8_F = OPS::min_epi16(OPS::set1_epi16(255), OPS::max_epi16(zero, OPS::add_epi16(OPS::mulhi_epi16(c16__8_F, n298), OPS::mulhi_epi16(d16__8_F, n516))));
+
+            // Interleave the separate channels into four registers storing four pixels each, in (R, G, B, A) or (B, G, R, A) order
+            const bool bgr = FORMAT == RS_FORMAT_BGR8 || FORMAT == RS_FORMAT_BGRA8;
+            vec first__0_7 = bgr ? b16__0_7 : r16__0_7, last__0_7 = bgr ? r16__0_7 : b16__0_7;
+            vec first__8_F = bgr ? b16__8_F : r16__8_F, last__8_F = bgr ? r16__8_F : b16__8_F;
+
+            vec xg8__0_7 = OPS::unpacklo_epi8(OPS::shuffle_epi8(first__0_7, evens_odds), OPS::shuffle_epi8(g16__0_7, evens_odds));
+            vec xa8__0_7 = OPS::unpacklo_epi8(OPS::shuffle_epi8(last__0_7, evens_odds), OPS::set1_epi8(-1));
+            vec xg8__8_F = OPS::unpacklo_epi8(OPS::shuffle_epi8(first__8_F, evens_odds), OPS::shuffle_epi8(g16__8_F, evens_odds));
+            vec xa8__8_F = OPS::unpacklo_epi8(OPS::shuffle_epi8(last__8_F, evens_odds), OPS::set1_epi8(-1));
+            vec pixels[4] = {
+                OPS::unpacklo_epi16(xg8__0_7, xa8__0_7),
+                OPS::unpackhi_epi16(xg8__0_7, xa8__0_7),
+                OPS::unpacklo_epi16(xg8__8_F, xa8__8_F),
+                OPS::unpackhi_epi16(xg8__8_F, xa8__8_F)
+            };
+
+            if(FORMAT == RS_FORMAT_RGBA8 || FORMAT == RS_FORMAT_BGRA8)
+            {
+                // Store 16 pixels (64 bytes) per lane
+                OPS::store_lanes(d, pixels, 4);
+            }
+
+            if(FORMAT == RS_FORMAT_RGB8 || FORMAT == RS_FORMAT_BGR8)
+            {
+                // Shuffle rgb triples to the start and end of each register
+                vec rgb0 = OPS::shuffle_epi8(pixels[0], OPS::setr_epi8(  3, 7, 11, 15,   0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14));
+                vec rgb1 = OPS::shuffle_epi8(pixels[1], OPS::setr_epi8(0, 1, 2, 4,   3, 7, 11, 15,   5, 6, 8, 9, 10, 12, 13, 14));
+                vec rgb2 = OPS::shuffle_epi8(pixels[2], OPS::setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,   3, 7, 11, 15,   10, 12, 13, 14));
+                vec rgb3 = OPS::shuffle_epi8(pixels[3], OPS::setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,   3, 7, 11, 15  ));
+
+                // Align registers and store 16 pixels (48 bytes) per lane
+                vec rgb[3] = { OPS::template alignr_epi8<4>(rgb1, rgb0), OPS::template alignr_epi8<8>(rgb2, rgb1), OPS::template alignr_epi8<12>(rgb3, rgb2) };
+                OPS::store_lanes(d, rgb, 3);
+            }
+        }
+        return converted;
+    }
+
+    // Y8I: 16 pixels of interleaved 8-bit left and right values per lane
+    template<class OPS> int split_y8i_lanes(byte * l, byte * r, const byte * s, int n)
+    {
+        typedef typename OPS::vec vec;
+        const int pixels_per_iteration = 16 * OPS::lanes;
+        const vec low_bytes = OPS::set1_epi16(0x00ff);
+
+        int converted = 0;
+        for(; n - converted >= pixels_per_iteration; converted += pixels_per_iteration, s += pixels_per_iteration * 2)
+        {
+            vec s0, s1;
+            OPS::load_pixels(s, s0, s1);
+            OPS::store(l, OPS::packus_epi16(OPS::and_si(s0, low_bytes), OPS::and_si(s1, low_bytes)));
+            OPS::store(r, OPS::packus_epi16(OPS::template srli_epi16<8>(s0), OPS::template srli_epi16<8>(s1)));
+            l += pixels_per_iteration;
+            r += pixels_per_iteration;
+        }
+        return converted;
+    }
+
+    // Gathers the 16-bit little endian words starting at bytes 0, 3, 6, ... 21 (plus OFFSET) of the 24 bytes split over lo (bytes 0-15)
+    // and hi (bytes 8-23) of every lane, which is where the fields of 8 consecutive three byte pixels live
+    template<class OPS, int OFFSET> typename OPS::vec gather_words_of_triples(typename OPS::vec lo, typename OPS::vec hi)
+    {
+        return OPS::or_si(OPS::shuffle_epi8(lo, OPS::setr_epi8(OFFSET + 0, OFFSET + 1, OFFSET + 3, OFFSET + 4, OFFSET + 6, OFFSET + 7, OFFSET + 9, OFFSET + 10, -1, -1, -1, -1, -1, -1, -1, -1)),
+                          OPS::shuffle_epi8(hi, OPS::setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, OFFSET + 4, OFFSET + 5, OFFSET + 7, OFFSET + 8, OFFSET + 10, OFFSET + 11, OFFSET + 13, OFFSET + 14)));
+    }
+
+    // Y12I: 8 pixels of packed 12-bit right and left values (rl, rh | ll << 4, lh) per lane, widened the same way as the generic converter
+    template<class OPS> int split_y12i_lanes(byte * l, byte * r, const byte * s, int n)
+    {
+        typedef typename OPS::vec vec;
+        const int pixels_per_iteration = 8 * OPS::lanes;
+
+        int converted = 0;
+        for(; n - converted >= pixels_per_iteration; converted += pixels_per_iteration, s += pixels_per_iteration * 3)
+        {
+            vec lo = OPS::load_lanes(s, 24), hi = OPS::load_lanes(s + 8, 24);
+            vec r12 = OPS::and_si(gather_words_of_triples<OPS, 0>(lo, hi), OPS::set1_epi16(0x0fff));
+            vec l12 = OPS::template srli_epi16<4>(gather_words_of_triples<OPS, 1>(lo, hi));
+            OPS::store(l, OPS::or_si(OPS::template slli_epi16<6>(l12), OPS::template srli_epi16<4>(l12)));
+            OPS::store(r, OPS::or_si(OPS::template slli_epi16<6>(r12), OPS::template srli_epi16<4>(r12)));
+            l += pixels_per_iteration * 2;
+            r += pixels_per_iteration * 2;
+        }
+        return converted;
+    }
+
+    // F200 INZI: 8 pixels of 16-bit depth followed by 8-bit infrared per lane, infrared output as Y8 or replicated into Y16
+    template<class OPS, bool Y16> int split_f200_inzi_lanes(byte * z, byte * y, const byte * s, int n)
+    {
+        typedef typename OPS::vec vec;
+        const int pixels_per_iteration = 8 * OPS::lanes;
+
+        int converted = 0;
+        for(; n - converted >= pixels_per_iteration; converted += pixels_per_iteration, s += pixels_per_iteration * 3)
+        {
+            vec lo = OPS::load_lanes(s, 24), hi = OPS::load_lanes(s + 8, 24);
+            OPS::store(z, gather_words_of_triples<OPS, 0>(lo, hi));
+            z += pixels_per_iteration * 2;
+            if(Y16)
+            {
+                OPS::store(y, OPS::or_si(OPS::shuffle_epi8(lo, OPS::setr_epi8(2, 2, 5, 5, 8, 8, 11, 11, 14, 14, -1, -1, -1, -1, -1, -1)),
+                                         OPS::shuffle_epi8(hi, OPS::setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, 9, 12, 12, 15, 15))));
+                y += pixels_per_iteration * 2;
+            }
+            else
+            {
+                OPS::store_low_halves(y, OPS::or_si(OPS::shuffle_epi8(lo, OPS::setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                                    OPS::shuffle_epi8(hi, OPS::setr_epi8(-1, -1, -1, -1, -1, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1))));
+                y += pixels_per_iteration;
+            }
+        }
+        return converted;
+    }
+
+    // 10-bit infrared in 16-bit words to Y8, keeping the low byte of each word shifted right by two like the generic converter
+    template<class OPS> int unpack_y8_from_y16_10_lanes(byte * d, const byte * s, int n)
+    {
+        typedef typename OPS::vec vec;
+        const int pixels_per_iteration = 16 * OPS::lanes;
+        const vec low_bytes = OPS::set1_epi16(0x00ff);
+
+        int converted = 0;
+        for(; n - converted >= pixels_per_iteration; converted += pixels_per_iteration, s += pixels_per_iteration * 2, d += pixels_per_iteration)
+        {
+            vec s0, s1;
+            OPS::load_pixels(s, s0, s1);
+            OPS::store(d, OPS::packus_epi16(OPS::and_si(OPS::template srli_epi16<2>(s0), low_bytes), OPS::and_si(OPS::template srli_epi16<2>(s1), low_bytes)));
+        }
+        return converted;
+    }
+
+    // 10-bit infrared in 16-bit words to Y16
+    template<class OPS> int unpack_y16_from_y16_10_lanes(byte * d, const byte * s, int n)
+    {
+        const int pixels_per_iteration = 8 * OPS::lanes;
+
+        int converted = 0;
+        for(; n - converted >= pixels_per_iteration; converted += pixels_per_iteration, s += pixels_per_iteration * 2, d += pixels_per_iteration * 2)
+        {
+            OPS::store(d, OPS::template slli_epi16<6>(OPS::load_lanes(s, 16)));
+        }
+        return converted;
+    }
+}
+
+#endif
@@ -2,6 +2,7 @@
 // Copyright(c) 2015 Intel Corporation. All Rights Reserved.
 
 #include "image.h"
+#include "depth-codec.h"
 #include "../include/librealsense/rsutil.h" // For projection/deprojection logic
 
 #include <cstring> // For memcpy
@@ -11,6 +12,22 @@
 #ifdef __SSSE3__
 #include <tmmintrin.h> // For SSE3 intrinsic used in unpack_yuy2_sse
 #endif
+#include "image-simd.h"
+
+#if defined(__SSSE3__) || (defined(_MSC_VER) && defined(RS_X86_SIMD_DISPATCH))
+#define RS_SSSE3_DISPATCH
+#ifdef _MSC_VER
+#include <intrin.h> // For __cpuidex and _xgetbv
+#include <tmmintrin.h>
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RS_NEON_DISPATCH
+#include <arm_neon.h>
+#endif
+#if defined(RS_X86_SIMD_DISPATCH) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
 
 #pragma pack(push, 1) // All structs in this file are assumed to be byte-packed
 namespace rsimpl
@@ -24,9 +41,25 @@ namespace rsimpl
     {
         if (format == RS_FORMAT_YUYV) assert(width % 2 == 0);
         if (format == RS_FORMAT_RAW10) assert(width % 4 == 0);
+        if (is_compressed_format(format)) return depth_codec::get_max_size(width * height);
         return width * height * get_image_bpp(format) / 8;
     }
 
+    bool is_compressed_format(rs_format format)
+    {
+        return format == RS_FORMAT_Z16_COMPRESSED || format == RS_FORMAT_DISPARITY16_COMPRESSED;
+    }
+
+    rs_format get_uncompressed_format(rs_format format)
+    {
+        switch (format)
+        {
+        case RS_FORMAT_Z16_COMPRESSED: return RS_FORMAT_Z16;
+        case RS_FORMAT_DISPARITY16_COMPRESSED: return RS_FORMAT_DISPARITY16;
+        default: return format;
+        }
+    }
+
     int get_image_bpp(rs_format format)
     {
         switch (format)
@@ -44,9 +77,141 @@ namespace rsimpl
         case RS_FORMAT_RAW10: return 10;
         case RS_FORMAT_RAW16: return 16;
         case RS_FORMAT_RAW8: return 8;
+        case RS_FORMAT_Z16_COMPRESSED: return 16; // Before compression
+        case RS_FORMAT_DISPARITY16_COMPRESSED: return 16;
         default: assert(false); return 0;
         }
     }
+    /////////////////////////////////
+    // Instruction set dispatching //
+    /////////////////////////////////
+
+#ifdef RS_SSSE3_DISPATCH
+    struct sse_ops
+    {
+        typedef __m128i vec;
+        static const int lanes = 1;
+
+        static void load_pixels(const byte * s, vec & s0, vec & s1)
+        {
+            s0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            s1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s) + 1);
+        }
+        static void store_lanes(byte * & d, const vec * v, int count)
+        {
+            for(int i = 0; i < count; ++i, d += 16) _mm_storeu_si128(reinterpret_cast<__m128i *>(d), v[i]);
+        }
+        static vec load_lanes(const byte * s, int) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(s)); }
+        static void store(byte * d, vec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(d), v); }
+        static void store_low_halves(byte * d, vec v) { _mm_storel_epi64(reinterpret_cast<__m128i *>(d), v); }
+
+        static vec setr_epi8(char b0, char b1, char b2, char b3, char b4, char b5, char b6, char b7, char b8, char b9, char b10, char b11, char b12, char b13, char b14, char b15)
+        {
+            return _mm_setr_epi8(b0, b1, b2, b3, b4, b5, b6, b7, b8, b9, b10, b11, b12, b13, b14, b15);
+        }
+        static vec set1_epi8(char a) { return _mm_set1_epi8(a); }
+        static vec set1_epi16(short a) { return _mm_set1_epi16(a); }
+        static vec shuffle_epi8(vec a, vec b) { return _mm_shuffle_epi8(a, b); }
+        static vec unpacklo_epi8(vec a, vec b) { return _mm_unpacklo_epi8(a, b); }
+        static vec unpackhi_epi8(vec a, vec b) { return _mm_unpackhi_epi8(a, b); }
+        static vec unpacklo_epi16(vec a, vec b) { return _mm_unpacklo_epi16(a, b); }
+        static vec unpackhi_epi16(vec a, vec b) { return _mm_unpackhi_epi16(a, b); }
+        static vec unpackhi_epi32(vec a, vec b) { return _mm_unpackhi_epi32(a, b); }
+        static vec unpacklo_epi64(vec a, vec b) { return _mm_unpacklo_epi64(a, b); }
+        static vec packus_epi16(vec a, vec b) { return _mm_packus_epi16(a, b); }
+        static vec and_si(vec a, vec b) { return _mm_and_si128(a, b); }
+        static vec or_si(vec a, vec b) { return _mm_or_si128(a, b); }
+        static vec subs_epi16(vec a, vec b) { return _mm_subs_epi16(a, b); }
+        static vec add_epi16(vec a, vec b) { return _mm_add_epi16(a, b); }
+        static vec sub_epi16(vec a, vec b) { return _mm_sub_epi16(a, b); }
+        static vec mulhi_epi16(vec a, vec b) { return _mm_mulhi_epi16(a, b); }
+        static vec min_epi16(vec a, vec b) { return _mm_min_epi16(a, b); }
+        static vec max_epi16(vec a, vec b) { return _mm_max_epi16(a, b); }
+        template<int N> static vec slli_epi16(vec a) { return _mm_slli_epi16(a, N); }
+        template<int N> static vec srli_epi16(vec a) { return _mm_srli_epi16(a, N); }
+        template<int N> static vec alignr_epi8(vec a, vec b) { return _mm_alignr_epi8(a, b, N); }
+    };
+#endif
+
+    // Instruction sets usable for the vectorized converters, queried once from cpuid
+    struct cpu_features
+    {
+        bool ssse3, avx2, avx512bw;
+    };
+
+    static cpu_features detect_cpu_features()
+    {
+        cpu_features features = {};
+#ifdef RS_X86_SIMD_DISPATCH
+        unsigned int leaf1[4] = {}, leaf7[4] = {};
+        unsigned long long xcr0 = 0;
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0);
+        const int max_leaf = regs[0];
+        __cpuidex(regs, 1, 0); for(int i = 0; i < 4; ++i) leaf1[i] = regs[i];
+        if(max_leaf >= 7) { __cpuidex(regs, 7, 0); for(int i = 0; i < 4; ++i) leaf7[i] = regs[i]; }
+        if(leaf1[2] & (1u << 27)) xcr0 = _xgetbv(0);
+#else
+        const unsigned int max_leaf = __get_cpuid_max(0, nullptr);
+        if(max_leaf >= 1) __cpuid_count(1, 0, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+        if(max_leaf >= 7) __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+        if(leaf1[2] & (1u << 27)) // OSXSAVE, without it XGETBV is not available
+        {
+            unsigned int eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+        }
+#endif
+        const bool os_saves_ymm = (xcr0 & 0x06) == 0x06, os_saves_zmm = (xcr0 & 0xe6) == 0xe6;
+        features.ssse3 = (leaf1[2] & (1u << 9)) != 0;
+        features.avx2 = os_saves_ymm && (leaf1[2] & (1u << 28)) && (leaf7[1] & (1u << 5));
+        features.avx512bw = features.avx2 && os_saves_zmm && (leaf7[1] & (1u << 16)) && (leaf7[1] & (1u << 30));
+        LOG_INFO("Pixel conversion CPU features: SSSE3 " << features.ssse3 << ", AVX2 " << features.avx2 << ", AVX-512BW " << features.avx512bw);
+#endif
+        return features;
+    }
+
+    static const cpu_features & get_cpu_features()
+    {
+        static const cpu_features features = detect_cpu_features();
+        return features;
+    }
+
+    // Picks the widest of the given vectorized converters usable on this CPU, any of which is null when not part of this build.
+    // A null result means that only the generic converter applies.
+    template<class KERNEL> KERNEL select_kernel(KERNEL avx512bw, KERNEL avx2, KERNEL ssse3, KERNEL neon)
+    {
+        auto & features = get_cpu_features();
+        if(avx512bw && features.avx512bw) return avx512bw;
+        if(avx2 && features.avx2) return avx2;
+        if(ssse3 && features.ssse3) return ssse3;
+        return neon;
+    }
+
+#ifdef RS_X86_SIMD_DISPATCH_AVX512
+#define RS_AVX512_KERNEL(...) &__VA_ARGS__
+#else
+#define RS_AVX512_KERNEL(...) nullptr
+#endif
+#ifdef RS_X86_SIMD_DISPATCH
+#define RS_AVX2_KERNEL(...) &__VA_ARGS__
+#else
+#define RS_AVX2_KERNEL(...) nullptr
+#endif
+#ifdef RS_SSSE3_DISPATCH
+#define RS_SSSE3_KERNEL(...) &__VA_ARGS__
+#else
+#define RS_SSSE3_KERNEL(...) nullptr
+#endif
+#ifdef RS_NEON_DISPATCH
+#define RS_NEON_KERNEL(...) &__VA_ARGS__
+#else
+#define RS_NEON_KERNEL(...) nullptr
+#endif
+
+    typedef int (* split_kernel)(byte * a, byte * b, const byte * s, int n);
+
     //////////////////////////////
     // Naive unpacking routines //
     //////////////////////////////
@@ -68,8 +233,25 @@ namespace rsimpl
     }
 
     void unpack_y16_from_y8    (byte * const d[], const byte * s, int n) { unpack_pixels(d, n, reinterpret_cast<const uint8_t  *>(s), [](uint8_t  pixel) -> uint16_t { return pixel | pixel << 8; }); }
-    void unpack_y16_from_y16_10(byte * const d[], const byte * s, int n) { unpack_pixels(d, n, reinterpret_cast<const uint16_t *>(s), [](uint16_t pixel) -> uint16_t { return pixel << 6; }); }
-    void unpack_y8_from_y16_10 (byte * const d[], const byte * s, int n) { unpack_pixels(d, n, reinterpret_cast<const uint16_t *>(s), [](uint16_t pixel) -> uint8_t  { return pixel >> 2; }); }
+
+    void unpack_y16_from_y16_10(byte * const d[], const byte * s, int n)
+    {
+        static const unpack_kernel kernel = select_kernel<unpack_kernel>(RS_AVX512_KERNEL(unpack_y16_from_y16_10_avx512), RS_AVX2_KERNEL(unpack_y16_from_y16_10_avx2),
+                                                                         RS_SSSE3_KERNEL(unpack_y16_from_y16_10_lanes<sse_ops>), nullptr);
+        const int converted = kernel ? kernel(d[0], s, n) : 0;
+        byte * const rest[] = { d[0] + converted * 2 };
+        unpack_pixels(rest, n - converted, reinterpret_cast<const uint16_t *>(s) + converted, [](uint16_t pixel) -> uint16_t { return pixel << 6; });
+    }
+
+    void unpack_y8_from_y16_10(byte * const d[], const byte * s, int n)
+    {
+        static const unpack_kernel kernel = select_kernel<unpack_kernel>(RS_AVX512_KERNEL(unpack_y8_from_y16_10_avx512), RS_AVX2_KERNEL(unpack_y8_from_y16_10_avx2),
+                                                                         RS_SSSE3_KERNEL(unpack_y8_from_y16_10_lanes<sse_ops>), nullptr);
+        const int converted = kernel ? kernel(d[0], s, n) : 0;
+        byte * const rest[] = { d[0] + converted };
+        unpack_pixels(rest, n - converted, reinterpret_cast<const uint16_t *>(s) + converted, [](uint16_t pixel) -> uint8_t { return pixel >> 2; });
+    }
+
     void unpack_rw10_from_rw8 (byte *  const d[], const byte * s, int n)
     {
 #ifdef __SSSE3__
@@ -105,307 +287,158 @@ namespace rsimpl
     // YUY2 unpacking routines //
     /////////////////////////////
     
-    // This templated function unpacks YUY2 into Y8/Y16/RGB8/RGBA8/BGR8/BGRA8, depending on the compile-time parameter FORMAT.
-    // It is expected that all branching outside of the loop control variable will be removed due to constant-folding.
-    template<rs_format FORMAT> void unpack_yuy2(byte * const d [], const byte * s, int n)
+    // Generic converter, also used for the pixels left over by the vectorized converters. The arithmetic matches the vectorized
+    // converters exactly, (k * x) >> 8 being what multiplying x << 4 by k << 4 and keeping the high 16 bits computes.
+    inline int yuy2_term(int x, int k) { return (x * k) >> 8; }
+    inline byte clamp_to_byte(int x) { return static_cast<byte>(std::min(std::max(x, 0), 255)); }
+
+    template<rs_format FORMAT> void unpack_yuy2_scalar(byte * d, const byte * s, int n)
     {
-        assert(n % 16 == 0); // All currently supported color resolutions are multiples of 16 pixels. Could easily extend support to other resolutions by copying final n<16 pixels into a zero-padded buffer and recursively calling self for final iteration.
-#ifdef __SSSE3__
-        auto src = reinterpret_cast<const __m128i *>(s);
-        auto dst = reinterpret_cast<__m128i *>(d[0]);
-        for(; n; n -= 16)
+        for(; n > 0; n -= 2, s += 4)
         {
-            const __m128i zero = _mm_set1_epi8(0);
-            const __m128i n100 = _mm_set1_epi16(100 << 4);
-            const __m128i n208 = _mm_set1_epi16(208 << 4);
-            const __m128i n298 = _mm_set1_epi16(298 << 4);
-            const __m128i n409 = _mm_set1_epi16(409 << 4);
-            const __m128i n516 = _mm_set1_epi16(516 << 4);
-            const __m128i evens_odds = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);            
-
-            // Load 8 YUY2 pixels each into two 16-byte registers
-            __m128i s0 = _mm_loadu_si128(src++);
-            __m128i s1 = _mm_loadu_si128(src++);
-
-            if(FORMAT == RS_FORMAT_Y8)
-            {   
-                // Align all Y components and output 16 pixels (16 bytes) at once
-                __m128i y0 = _mm_shuffle_epi8(s0, _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15,   0, 2, 4, 6, 8, 10, 12, 14));
-                __m128i y1 = _mm_shuffle_epi8(s1, _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14,   1, 3, 5, 7, 9, 11, 13, 15));
-                _mm_storeu_si128(dst++, _mm_alignr_epi8(y0, y1, 8));
-                continue;
-            }
-
-            // Shuffle all Y components to the low order bytes of the register, and all U/V components to the high order bytes
-            const __m128i evens_odd1s_odd3s = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 5, 9, 13, 3, 7, 11, 15); // to get yyyyyyyyuuuuvvvv
-            __m128i yyyyyyyyuuuuvvvv0 = _mm_shuffle_epi8(s0, evens_odd1s_odd3s);
-            __m128i yyyyyyyyuuuuvvvv8 = _mm_shuffle_epi8(s1, evens_odd1s_odd3s);
-
-            // Retrieve all 16 Y components as 16-bit values (8 components per register))
-            __m128i y16__0_7 = _mm_unpacklo_epi8(yyyyyyyyuuuuvvvv0, zero);         // convert to 16 bit
-            __m128i y16__8_F = _mm_unpacklo_epi8(yyyyyyyyuuuuvvvv8, zero);         // convert to 16 bit
-
-            if(FORMAT == RS_FORMAT_Y16)
-            {      
-                // Output 16 pixels (32 bytes) at once
-                _mm_storeu_si128(dst++, _mm_slli_epi16(y16__0_7, 8));
-                _mm_storeu_si128(dst++, _mm_slli_epi16(y16__8_F, 8));
-                continue;
-            }
-
-            // Retrieve all 16 U and V components as 16-bit values (8 components per register)
-            __m128i uv = _mm_unpackhi_epi32(yyyyyyyyuuuuvvvv0, yyyyyyyyuuuuvvvv8); // uuuuuuuuvvvvvvvv
-            __m128i u = _mm_unpacklo_epi8(uv, uv);                                 //  uu uu uu uu uu uu uu uu  u's duplicated
-            __m128i v = _mm_unpackhi_epi8(uv, uv);                                 //  vv vv vv vv vv vv vv vv            
-            __m128i u16__0_7 = _mm_unpacklo_epi8(u, zero);                         // convert to 16 bit
-            __m128i u16__8_F = _mm_unpackhi_epi8(u, zero);                         // convert to 16 bit
-            __m128i v16__0_7 = _mm_unpacklo_epi8(v, zero);                         // convert to 16 bit
-            __m128i v16__8_F = _mm_unpackhi_epi8(v, zero);                         // convert to 16 bit
-
-            // Compute R, G, B values for first 8 pixels
-            __m128i c16__0_7 = _mm_slli_epi16(_mm_subs_epi16(y16__0_7, _mm_set1_epi16(16)), 4);
-            __m128i d16__0_7 = _mm_slli_epi16(_mm_subs_epi16(u16__0_7, _mm_set1_epi16(128)), 4); // perhaps could have done these u,v to d,e before the duplication
-            __m128i e16__0_7 = _mm_slli_epi16(_mm_subs_epi16(v16__0_7, _mm_set1_epi16(128)), 4);
-            __m128i r16__0_7 = _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(zero, ((_mm_add_epi16(_mm_mulhi_epi16(c16__0_7, n298), _mm_mulhi_epi16(e16__0_7, n409))))));                                                 // (298 * c + 409 * e + 128) ; //
-            __m128i g16__0_7 = _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(zero, ((_mm_sub_epi16(_mm_sub_epi16(_mm_mulhi_epi16(c16__0_7, n298), _mm_mulhi_epi16(d16__0_7, n100)), _mm_mulhi_epi16(e16__0_7, n208)))))); // (298 * c - 100 * d - 208 * e + 128)
-            __m128i b16__0_7 = _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(zero, ((_mm_add_epi16(_mm_mulhi_epi16(c16__0_7, n298), _mm_mulhi_epi16(d16__0_7, n516))))));                                                 // clampbyte((298 * c + 516 * d + 128) >> 8);
-
-            // Compute R, G, B values for second 8 pixels
-            __m128i c16__8_F = _mm_slli_epi16(_mm_subs_epi16(y16__8_F, _mm_set1_epi16(16)), 4);
-            __m128i d16__8_F = _mm_slli_epi16(_mm_subs_epi16(u16__8_F, _mm_set1_epi16(128)), 4); // perhaps could have done these u,v to d,e before the duplication
-            __m128i e16__8_F = _mm_slli_epi16(_mm_subs_epi16(v16__8_F, _mm_set1_epi16(128)), 4);           
-            __m128i r16__8_F = _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(zero, ((_mm_add_epi16(_mm_mulhi_epi16(c16__8_F, n298), _mm_mulhi_epi16(e16__8_F, n409))))));                                                 // (298 * c + 409 * e + 128) ; //
-            __m128i g16__8_F = _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(zero, ((_mm_sub_epi16(_mm_sub_epi16(_mm_mulhi_epi16(c16__8_F, n298), _mm_mulhi_epi16(d16__8_F, n100)), _mm_mulhi_epi16(e16__8_F, n208)))))); // (298 * c - 100 * d - 208 * e + 128)
-            __m128i b16__8_F = _mm_min_epi16(_mm_set1_epi16(255), _mm_max_epi16(zero, ((_mm_add_epi16(_mm_mulhi_epi16(c16__8_F, n298), _mm_mulhi_epi16(d16__8_F, n516))))));                                                 // clampbyte((298 * c + 516 * d + 128) >> 8);
-
-            if (FORMAT == RS_FORMAT_RGB8 || FORMAT == RS_FORMAT_RGBA8)
+            const int e = s[3] - 128, dd = s[1] - 128;
+            for(int i = 0; i < 2; ++i)
             {
-                // Shuffle separate R, G, B values into four registers storing four pixels each in (R, G, B, A) order
-                __m128i rg8__0_7 = _mm_unpacklo_epi8(_mm_shuffle_epi8(r16__0_7, evens_odds), _mm_shuffle_epi8(g16__0_7, evens_odds)); // hi to take the odds which are the upper bytes we care about
-                __m128i ba8__0_7 = _mm_unpacklo_epi8(_mm_shuffle_epi8(b16__0_7, evens_odds), _mm_set1_epi8(-1));
-                __m128i rgba_0_3 = _mm_unpacklo_epi16(rg8__0_7, ba8__0_7);
-                __m128i rgba_4_7 = _mm_unpackhi_epi16(rg8__0_7, ba8__0_7);
-
-                __m128i rg8__8_F = _mm_unpacklo_epi8(_mm_shuffle_epi8(r16__8_F, evens_odds), _mm_shuffle_epi8(g16__8_F, evens_odds)); // hi to take the odds which are the upper bytes we care about
-                __m128i ba8__8_F = _mm_unpacklo_epi8(_mm_shuffle_epi8(b16__8_F, evens_odds), _mm_set1_epi8(-1));
-                __m128i rgba_8_B = _mm_unpacklo_epi16(rg8__8_F, ba8__8_F);
-                __m128i rgba_C_F = _mm_unpackhi_epi16(rg8__8_F, ba8__8_F);
-
-                if(FORMAT == RS_FORMAT_RGBA8)
-                {
-                    // Store 16 pixels (64 bytes) at once
-                    _mm_storeu_si128(dst++, rgba_0_3);
-                    _mm_storeu_si128(dst++, rgba_4_7);
-                    _mm_storeu_si128(dst++, rgba_8_B);
-                    _mm_storeu_si128(dst++, rgba_C_F);
-                }
-
-                if(FORMAT == RS_FORMAT_RGB8)
-                {
-                    // Shuffle rgb triples to the start and end of each register
-                    __m128i rgb0 = _mm_shuffle_epi8(rgba_0_3, _mm_setr_epi8(  3, 7, 11, 15,   0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14));
-                    __m128i rgb1 = _mm_shuffle_epi8(rgba_4_7, _mm_setr_epi8(0, 1, 2, 4,   3, 7, 11, 15,   5, 6, 8, 9, 10, 12, 13, 14));
-                    __m128i rgb2 = _mm_shuffle_epi8(rgba_8_B, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,   3, 7, 11, 15,   10, 12, 13, 14));
-                    __m128i rgb3 = _mm_shuffle_epi8(rgba_C_F, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,   3, 7, 11, 15  ));
-
-                    // Align registers and store 16 pixels (48 bytes) at once
-                    _mm_storeu_si128(dst++, _mm_alignr_epi8(rgb1, rgb0, 4));
-                    _mm_storeu_si128(dst++, _mm_alignr_epi8(rgb2, rgb1, 8));
-                    _mm_storeu_si128(dst++, _mm_alignr_epi8(rgb3, rgb2, 12));                
-                }
+                const byte y = s[i * 2];
+                if(FORMAT == RS_FORMAT_Y8) { *d++ = y; continue; }
+                if(FORMAT == RS_FORMAT_Y16) { *d++ = 0; *d++ = y; continue; }
+
+                const int c = yuy2_term(y - 16, 298);
+                const byte r = clamp_to_byte(c + yuy2_term(e, 409));
+                const byte g = clamp_to_byte(c - yuy2_term(dd, 100) - yuy2_term(e, 208));
+                const byte b = clamp_to_byte(c + yuy2_term(dd, 516));
+                const bool bgr = FORMAT == RS_FORMAT_BGR8 || FORMAT == RS_FORMAT_BGRA8;
+                *d++ = bgr ? b : r;
+                *d++ = g;
+                *d++ = bgr ? r : b;
+                if(FORMAT == RS_FORMAT_RGBA8 || FORMAT == RS_FORMAT_BGRA8) *d++ = 255;
             }
+        }
+    }
 
-            if (FORMAT == RS_FORMAT_BGR8 || FORMAT == RS_FORMAT_BGRA8)
-            {
-                // Shuffle separate R, G, B values into four registers storing four pixels each in (B, G, R, A) order
-                __m128i bg8__0_7 = _mm_unpacklo_epi8(_mm_shuffle_epi8(b16__0_7, evens_odds), _mm_shuffle_epi8(g16__0_7, evens_odds)); // hi to take the odds which are the upper bytes we care about
-                __m128i ra8__0_7 = _mm_unpacklo_epi8(_mm_shuffle_epi8(r16__0_7, evens_odds), _mm_set1_epi8(-1));
-                __m128i bgra_0_3 = _mm_unpacklo_epi16(bg8__0_7, ra8__0_7);
-                __m128i bgra_4_7 = _mm_unpackhi_epi16(bg8__0_7, ra8__0_7);
-
-                __m128i bg8__8_F = _mm_unpacklo_epi8(_mm_shuffle_epi8(b16__8_F, evens_odds), _mm_shuffle_epi8(g16__8_F, evens_odds)); // hi to take the odds which are the upper bytes we care about
-                __m128i ra8__8_F = _mm_unpacklo_epi8(_mm_shuffle_epi8(r16__8_F, evens_odds), _mm_set1_epi8(-1));
-                __m128i bgra_8_B = _mm_unpacklo_epi16(bg8__8_F, ra8__8_F);
-                __m128i bgra_C_F = _mm_unpackhi_epi16(bg8__8_F, ra8__8_F);
-
-                if(FORMAT == RS_FORMAT_BGRA8)
-                {
-                    // Store 16 pixels (64 bytes) at once
-                    _mm_storeu_si128(dst++, bgra_0_3);
-                    _mm_storeu_si128(dst++, bgra_4_7);
-                    _mm_storeu_si128(dst++, bgra_8_B);
-                    _mm_storeu_si128(dst++, bgra_C_F);
-                }
+#ifdef RS_NEON_DISPATCH
+    // (k * x) >> 8 for eight 16-bit lanes, widening so that the intermediate product cannot overflow
+    inline int16x8_t yuy2_term(int16x8_t x, int16_t k)
+    {
+        return vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(x), k), 8), vshrn_n_s32(vmull_n_s16(vget_high_s16(x), k), 8));
+    }
+    inline int16x8_t widen_and_offset(uint8x8_t x, int16_t offset) { return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(x)), vdupq_n_s16(offset)); }
+    inline uint8x16_t interleave(uint8x8_t evens, uint8x8_t odds) { uint8x8x2_t z = vzip_u8(evens, odds); return vcombine_u8(z.val[0], z.val[1]); }
 
-                if(FORMAT == RS_FORMAT_BGR8)
-                {
-                    // Shuffle rgb triples to the start and end of each register
-                    __m128i bgr0 = _mm_shuffle_epi8(bgra_0_3, _mm_setr_epi8(  3, 7, 11, 15,   0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14));
-                    __m128i bgr1 = _mm_shuffle_epi8(bgra_4_7, _mm_setr_epi8(0, 1, 2, 4,   3, 7, 11, 15,   5, 6, 8, 9, 10, 12, 13, 14));
-                    __m128i bgr2 = _mm_shuffle_epi8(bgra_8_B, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,   3, 7, 11, 15,   10, 12, 13, 14));
-                    __m128i bgr3 = _mm_shuffle_epi8(bgra_C_F, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,   3, 7, 11, 15  ));
-
-                    // Align registers and store 16 pixels (48 bytes) at once
-                    _mm_storeu_si128(dst++, _mm_alignr_epi8(bgr1, bgr0, 4));
-                    _mm_storeu_si128(dst++, _mm_alignr_epi8(bgr2, bgr1, 8));
-                    _mm_storeu_si128(dst++, _mm_alignr_epi8(bgr3, bgr2, 12));                
-                }
-            }
-        }    
-#else  // Generic code for when SSSE3 is not available.
-        auto src = reinterpret_cast<const uint8_t *>(s);
-        auto dst = reinterpret_cast<uint8_t *>(d[0]);
-        for(; n; n -= 16, src += 32)
+    template<rs_format FORMAT> int unpack_yuy2_neon(byte * d, const byte * s, int n)
+    {
+        int converted = 0;
+        for(; n - converted >= 16; converted += 16, s += 32)
         {
+            // De-interleave 8 macropixels into even Y, U, odd Y and V components
+            const uint8x8x4_t yuyv = vld4_u8(s);
             if(FORMAT == RS_FORMAT_Y8)
             {
-                uint8_t out[16] = {
-                    src[ 0], src[ 2], src[ 4], src[ 6],
-                    src[ 8], src[10], src[12], src[14],
-                    src[16], src[18], src[20], src[22],
-                    src[24], src[26], src[28], src[30],
-                };
-                memcpy(dst, out, sizeof out);
-                dst += sizeof out;
+                vst1q_u8(d, interleave(yuyv.val[0], yuyv.val[2]));
+                d += 16;
                 continue;
             }
-
             if(FORMAT == RS_FORMAT_Y16)
             {
-                // Y16 is little-endian.  We output Y << 8.
-                uint8_t out[32] = {
-                    0, src[ 0], 0, src[ 2], 0, src[ 4], 0, src[ 6],
-                    0, src[ 8], 0, src[10], 0, src[12], 0, src[14],
-                    0, src[16], 0, src[18], 0, src[20], 0, src[22],
-                    0, src[24], 0, src[26], 0, src[28], 0, src[30],
-                };
-                memcpy(dst, out, sizeof out);
-                dst += sizeof out;
+                uint8x16x2_t y16 = {{ vdupq_n_u8(0), interleave(yuyv.val[0], yuyv.val[2]) }};
+                vst2q_u8(d, y16);
+                d += 32;
                 continue;
             }
 
-            int16_t y[16] = {
-                src[ 0], src[ 2], src[ 4], src[ 6],
-                src[ 8], src[10], src[12], src[14],
-                src[16], src[18], src[20], src[22],
-                src[24], src[26], src[28], src[30],
-            }, u[16] = {
-                src[ 1], src[ 1], src[ 5], src[ 5],
-                src[ 9], src[ 9], src[13], src[13],
-                src[17], src[17], src[21], src[21],
-                src[25], src[25], src[29], src[29],
-            }, v[16] = {
-                src[ 3], src[ 3], src[ 7], src[ 7],
-                src[11], src[11], src[15], src[15],
-                src[19], src[19], src[23], src[23],
-                src[27], src[27], src[31], src[31],
-            };
-
-            uint8_t r[16], g[16], b[16];
-            for(int i = 0; i < 16; i++)
+            const int16x8_t dd = widen_and_offset(yuyv.val[1], 128), e = widen_and_offset(yuyv.val[3], 128);
+            const int16x8_t rv = yuy2_term(e, 409), gu = vaddq_s16(yuy2_term(dd, 100), yuy2_term(e, 208)), bu = yuy2_term(dd, 516);
+            uint8x8_t r[2], g[2], b[2];
+            for(int i = 0; i < 2; ++i)
             {
-                int32_t c = y[i] - 16;
-                int32_t d = u[i] - 128;
-                int32_t e = v[i] - 128;
-
-                int32_t t;
-                #define clamp(x)  ((t=(x)) > 255 ? 255 : t < 0 ? 0 : t)
-                r[i] = clamp((298 * c           + 409 * e + 128) >> 8);
-                g[i] = clamp((298 * c - 100 * d - 409 * e + 128) >> 8);
-                b[i] = clamp((298 * c + 516 * d           + 128) >> 8);
-                #undef clamp
+                const int16x8_t c = yuy2_term(widen_and_offset(yuyv.val[i * 2], 16), 298);
+                r[i] = vqmovun_s16(vaddq_s16(c, rv));
+                g[i] = vqmovun_s16(vsubq_s16(c, gu));
+                b[i] = vqmovun_s16(vaddq_s16(c, bu));
             }
 
-            if(FORMAT == RS_FORMAT_RGB8)
+            const bool bgr = FORMAT == RS_FORMAT_BGR8 || FORMAT == RS_FORMAT_BGRA8;
+            const uint8x16_t first = bgr ? interleave(b[0], b[1]) : interleave(r[0], r[1]);
+            const uint8x16_t last = bgr ? interleave(r[0], r[1]) : interleave(b[0], b[1]);
+            if(FORMAT == RS_FORMAT_RGBA8 || FORMAT == RS_FORMAT_BGRA8)
             {
-                uint8_t out[16*3] = {
-                    r[ 0], g[ 0], b[ 0], r[ 1], g[ 1], b[ 1],
-                    r[ 2], g[ 2], b[ 2], r[ 3], g[ 3], b[ 3],
-                    r[ 4], g[ 4], b[ 4], r[ 5], g[ 5], b[ 5],
-                    r[ 6], g[ 6], b[ 6], r[ 7], g[ 7], b[ 7],
-                    r[ 8], g[ 8], b[ 8], r[ 9], g[ 9], b[ 9],
-                    r[10], g[10], b[10], r[11], g[11], b[11],
-                    r[12], g[12], b[12], r[13], g[13], b[13],
-                    r[14], g[14], b[14], r[15], g[15], b[15],
-                };
-                memcpy(dst, out, sizeof out);
-                dst += sizeof out;
-                continue;
+                uint8x16x4_t pixels = {{ first, interleave(g[0], g[1]), last, vdupq_n_u8(255) }};
+                vst4q_u8(d, pixels);
+                d += 64;
             }
-
-            if(FORMAT == RS_FORMAT_BGR8)
+            if(FORMAT == RS_FORMAT_RGB8 || FORMAT == RS_FORMAT_BGR8)
             {
-                uint8_t out[16*3] = {
-                    b[ 0], g[ 0], r[ 0], b[ 1], g[ 1], r[ 1],
-                    b[ 2], g[ 2], r[ 2], b[ 3], g[ 3], r[ 3],
-                    b[ 4], g[ 4], r[ 4], b[ 5], g[ 5], r[ 5],
-                    b[ 6], g[ 6], r[ 6], b[ 7], g[ 7], r[ 7],
-                    b[ 8], g[ 8], r[ 8], b[ 9], g[ 9], r[ 9],
-                    b[10], g[10], r[10], b[11], g[11], r[11],
-                    b[12], g[12], r[12], b[13], g[13], r[13],
-                    b[14], g[14], r[14], b[15], g[15], r[15],
-                };
-                memcpy(dst, out, sizeof out);
-                dst += sizeof out;
-                continue;
+                uint8x16x3_t pixels = {{ first, interleave(g[0], g[1]), last }};
+                vst3q_u8(d, pixels);
+                d += 48;
             }
+        }
+        return converted;
+    }
+#endif
 
-            if(FORMAT == RS_FORMAT_RGBA8)
-            {
-                uint8_t out[16*4] = {
-                    r[ 0], g[ 0], b[ 0], 255, r[ 1], g[ 1], b[ 1], 255,
-                    r[ 2], g[ 2], b[ 2], 255, r[ 3], g[ 3], b[ 3], 255,
-                    r[ 4], g[ 4], b[ 4], 255, r[ 5], g[ 5], b[ 5], 255,
-                    r[ 6], g[ 6], b[ 6], 255, r[ 7], g[ 7], b[ 7], 255,
-                    r[ 8], g[ 8], b[ 8], 255, r[ 9], g[ 9], b[ 9], 255,
-                    r[10], g[10], b[10], 255, r[11], g[11], b[11], 255,
-                    r[12], g[12], b[12], 255, r[13], g[13], b[13], 255,
-                    r[14], g[14], b[14], 255, r[15], g[15], b[15], 255,
-                };
-                memcpy(dst, out, sizeof out);
-                dst += sizeof out;
-                continue;
-            }
+    // This templated function unpacks YUY2 into Y8/Y16/RGB8/RGBA8/BGR8/BGRA8, depending on the compile-time parameter FORMAT.
+    // The bulk of the pixels go through the converter selected for this CPU on first use, the remainder through the generic converter.
+    template<rs_format FORMAT> void unpack_yuy2(byte * const d [], const byte * s, int n)
+    {
+        assert(n % 2 == 0); // Each YUY2 macropixel holds two pixels
+        static const unpack_kernel kernel = select_kernel<unpack_kernel>(RS_AVX512_KERNEL(unpack_yuy2_avx512<FORMAT>), RS_AVX2_KERNEL(unpack_yuy2_avx2<FORMAT>),
+                                                                         RS_SSSE3_KERNEL(unpack_yuy2_lanes<sse_ops, FORMAT>), RS_NEON_KERNEL(unpack_yuy2_neon<FORMAT>));
+        const int converted = kernel ? kernel(d[0], s, n) : 0;
+        unpack_yuy2_scalar<FORMAT>(d[0] + converted * get_image_bpp(FORMAT) / 8, s + converted * 2, n - converted);
+    }
 
-            if(FORMAT == RS_FORMAT_BGRA8)
-            {
-                uint8_t out[16*4] = {
-                    b[ 0], g[ 0], r[ 0], 255, b[ 1], g[ 1], r[ 1], 255,
-                    b[ 2], g[ 2], r[ 2], 255, b[ 3], g[ 3], r[ 3], 255,
-                    b[ 4], g[ 4], r[ 4], 255, b[ 5], g[ 5], r[ 5], 255,
-                    b[ 6], g[ 6], r[ 6], 255, b[ 7], g[ 7], r[ 7], 255,
-                    b[ 8], g[ 8], r[ 8], 255, b[ 9], g[ 9], r[ 9], 255,
-                    b[10], g[10], r[10], 255, b[11], g[11], r[11], 255,
-                    b[12], g[12], r[12], 255, b[13], g[13], r[13], 255,
-                    b[14], g[14], r[14], 255, b[15], g[15], r[15], 255,
-                };
-                memcpy(dst, out, sizeof out);
-                dst += sizeof out;
-                continue;
-            }
+    template<rs_format FORMAT> static std::vector<std::pair<std::string, unpack_kernel>> list_yuy2_kernels()
+    {
+        auto & features = get_cpu_features();
+        std::vector<std::pair<std::string, unpack_kernel>> kernels;
+        auto add = [&kernels](const char * name, unpack_kernel kernel, bool supported) { if(kernel && supported) kernels.push_back({ name, kernel }); };
+        add("AVX-512BW", RS_AVX512_KERNEL(unpack_yuy2_avx512<FORMAT>), features.avx512bw);
+        add("AVX2", RS_AVX2_KERNEL(unpack_yuy2_avx2<FORMAT>), features.avx2);
+        add("SSSE3", RS_SSSE3_KERNEL(unpack_yuy2_lanes<sse_ops, FORMAT>), features.ssse3);
+        add("NEON", RS_NEON_KERNEL(unpack_yuy2_neon<FORMAT>), true);
+        return kernels;
+    }
+
+    std::vector<std::pair<std::string, unpack_kernel>> get_yuy2_kernels(rs_format format)
+    {
+        switch(format)
+        {
+        case RS_FORMAT_RGB8: return list_yuy2_kernels<RS_FORMAT_RGB8>();
+        case RS_FORMAT_RGBA8: return list_yuy2_kernels<RS_FORMAT_RGBA8>();
+        case RS_FORMAT_BGR8: return list_yuy2_kernels<RS_FORMAT_BGR8>();
+        case RS_FORMAT_BGRA8: return list_yuy2_kernels<RS_FORMAT_BGRA8>();
+        default: return {};
         }
-#endif
     }
     
     //////////////////////////////////////
     // 2-in-1 format splitting routines //
     //////////////////////////////////////
 
-    template<class SOURCE, class SPLIT_A, class SPLIT_B> void split_frame(byte * const dest[], int count, const SOURCE * source, SPLIT_A split_a, SPLIT_B split_b)
+    // Splits pixels [first, count) with the generic per pixel functions, the pixels before first having been split by a vectorized converter
+    template<class SOURCE, class SPLIT_A, class SPLIT_B> void split_frame(byte * const dest[], int first, int count, const SOURCE * source, SPLIT_A split_a, SPLIT_B split_b)
     {
-        auto a = reinterpret_cast<decltype(split_a(SOURCE())) *>(dest[0]);
-        auto b = reinterpret_cast<decltype(split_b(SOURCE())) *>(dest[1]);
-        for(int i=0; i<count; ++i)
+        auto a = reinterpret_cast<decltype(split_a(SOURCE())) *>(dest[0]) + first;
+        auto b = reinterpret_cast<decltype(split_b(SOURCE())) *>(dest[1]) + first;
+        source += first;
+        for(int i=first; i<count; ++i)
         {
             *a++ = split_a(*source);
             *b++ = split_b(*source++);
         }    
     }
 
+    template<class SOURCE, class SPLIT_A, class SPLIT_B> void split_frame(byte * const dest[], int count, const SOURCE * source, split_kernel kernel, SPLIT_A split_a, SPLIT_B split_b)
+    {
+        split_frame(dest, kernel ? kernel(dest[0], dest[1], reinterpret_cast<const byte *>(source), count) : 0, count, source, split_a, split_b);
+    }
+
     struct y8i_pixel { uint8_t l, r; };
     void unpack_y8_y8_from_y8i(byte * const dest[], const byte * source, int count)
     {
-        split_frame(dest, count, reinterpret_cast<const y8i_pixel *>(source),
+        static const split_kernel kernel = select_kernel<split_kernel>(RS_AVX512_KERNEL(split_y8i_avx512), RS_AVX2_KERNEL(split_y8i_avx2), RS_SSSE3_KERNEL(split_y8i_lanes<sse_ops>), nullptr);
+        split_frame(dest, count, reinterpret_cast<const y8i_pixel *>(source), kernel,
             [](const y8i_pixel & p) -> uint8_t { return p.l; },
             [](const y8i_pixel & p) -> uint8_t { return p.r; });
     }
@@ -413,7 +446,8 @@ namespace rsimpl
     struct y12i_pixel { uint8_t rl : 8, rh : 4, ll : 4, lh : 8; int l() const { return lh << 4 | ll; } int r() const { return rh << 8 | rl; } };
     void unpack_y16_y16_from_y12i_10(byte * const dest[], const byte * source, int count)
     {
-        split_frame(dest, count, reinterpret_cast<const y12i_pixel *>(source),
+        static const split_kernel kernel = select_kernel<split_kernel>(RS_AVX512_KERNEL(split_y12i_avx512), RS_AVX2_KERNEL(split_y12i_avx2), RS_SSSE3_KERNEL(split_y12i_lanes<sse_ops>), nullptr);
+        split_frame(dest, count, reinterpret_cast<const y12i_pixel *>(source), kernel,
             [](const y12i_pixel & p) -> uint16_t { return p.l() << 6 | p.l() >> 4; },  // We want to convert 10-bit data to 16-bit data
             [](const y12i_pixel & p) -> uint16_t { return p.r() << 6 | p.r() >> 4; }); // Multiply by 64 1/16 to efficiently approximate 65535/1023
     }
@@ -421,32 +455,33 @@ namespace rsimpl
     struct f200_inzi_pixel { uint16_t z16; uint8_t y8; };
     void unpack_z16_y8_from_f200_inzi(byte * const dest[], const byte * source, int count)
     {
-        split_frame(dest, count, reinterpret_cast<const f200_inzi_pixel *>(source),
+        static const split_kernel kernel = select_kernel<split_kernel>(RS_AVX512_KERNEL(split_f200_inzi_y8_avx512), RS_AVX2_KERNEL(split_f200_inzi_y8_avx2), RS_SSSE3_KERNEL(split_f200_inzi_lanes<sse_ops, false>), nullptr);
+        split_frame(dest, count, reinterpret_cast<const f200_inzi_pixel *>(source), kernel,
             [](const f200_inzi_pixel & p) -> uint16_t { return p.z16; },
             [](const f200_inzi_pixel & p) -> uint8_t { return p.y8; });
     }
 
     void unpack_z16_y16_from_f200_inzi(byte * const dest[], const byte * source, int count)
     {
-        split_frame(dest, count, reinterpret_cast<const f200_inzi_pixel *>(source),
+        static const split_kernel kernel = select_kernel<split_kernel>(RS_AVX512_KERNEL(split_f200_inzi_y16_avx512), RS_AVX2_KERNEL(split_f200_inzi_y16_avx2), RS_SSSE3_KERNEL(split_f200_inzi_lanes<sse_ops, true>), nullptr);
+        split_frame(dest, count, reinterpret_cast<const f200_inzi_pixel *>(source), kernel,
             [](const f200_inzi_pixel & p) -> uint16_t { return p.z16; },
             [](const f200_inzi_pixel & p) -> uint16_t { return p.y8 | p.y8 << 8; });
     }
 
+    // SR300 INZI is planar, infrared followed by depth, so only the infrared plane needs converting
     void unpack_z16_y8_from_sr300_inzi(byte * const dest[], const byte * source, int count)
     {
-        auto in = reinterpret_cast<const uint16_t *>(source);
-        auto out_ir = reinterpret_cast<uint8_t *>(dest[1]);            
-        for(int i=0; i<count; ++i) *out_ir++ = *in++ >> 2;
-        memcpy(dest[0], in, count*2);
+        byte * const ir[] = { dest[1] };
+        unpack_y8_from_y16_10(ir, source, count);
+        memcpy(dest[0], source + count * 2, count*2);
     }
 
     void unpack_z16_y16_from_sr300_inzi (byte * const dest[], const byte * source, int count)
     {
-        auto in = reinterpret_cast<const uint16_t *>(source);
-        auto out_ir = reinterpret_cast<uint16_t *>(dest[1]);
-        for(int i=0; i<count; ++i) *out_ir++ = *in++ << 6;
-        memcpy(dest[0], in, count*2);
+        byte * const ir[] = { dest[1] };
+        unpack_y16_from_y16_10(ir, source, count);
+        memcpy(dest[0], source + count * 2, count*2);
     }
 
 #pragma GCC diagnostic push
@@ -470,8 +505,11 @@ namespace rsimpl
     const native_pixel_format pf_y8i        = { 'Y8I ', 1, 2,{  { true,  &unpack_y8_y8_from_y8i,            { { RS_STREAM_INFRARED, RS_FORMAT_Y8 },{ RS_STREAM_INFRARED2, RS_FORMAT_Y8 } } } } };
     const native_pixel_format pf_y12i       = { 'Y12I', 1, 3,{  { true,  &unpack_y16_y16_from_y12i_10,      { { RS_STREAM_INFRARED, RS_FORMAT_Y16 },{ RS_STREAM_INFRARED2, RS_FORMAT_Y16 } } } } };
     const native_pixel_format pf_z16        = { 'Z16 ', 1, 2,{  { false, &copy_pixels<2>,                   { { RS_STREAM_DEPTH,    RS_FORMAT_Z16 } } },
-                                                                { false, &copy_pixels<2>,                   { { RS_STREAM_DEPTH,    RS_FORMAT_DISPARITY16 } } } } };
-    const native_pixel_format pf_invz       = { 'INVZ', 1, 2, { { false, &copy_pixels<2>,                   { { RS_STREAM_DEPTH, RS_FORMAT_Z16 } } } } };
+                                                                { false, &copy_pixels<2>,                   { { RS_STREAM_DEPTH,    RS_FORMAT_DISPARITY16 } } },
+                                                                { true,  &copy_pixels<2>,                   { { RS_STREAM_DEPTH,    RS_FORMAT_Z16_COMPRESSED } } },
+                                                                { true,  &copy_pixels<2>,                   { { RS_STREAM_DEPTH,    RS_FORMAT_DISPARITY16_COMPRESSED } } } } };
+    const native_pixel_format pf_invz       = { 'INVZ', 1, 2, { { false, &copy_pixels<2>,                   { { RS_STREAM_DEPTH, RS_FORMAT_Z16 } } },
+                                                                { true,  &copy_pixels<2>,                   { { RS_STREAM_DEPTH, RS_FORMAT_Z16_COMPRESSED } } } } };
     const native_pixel_format pf_f200_invi  = { 'INVI', 1, 1, { { false, &copy_pixels<1>,                   { { RS_STREAM_INFRARED, RS_FORMAT_Y8 } } },
                                                                 { true,  &unpack_y16_from_y8,               { { RS_STREAM_INFRARED, RS_FORMAT_Y16 } } } } };
     const native_pixel_format pf_f200_inzi  = { 'INZI', 1, 3,{  { true,  &unpack_z16_y8_from_f200_inzi,     { { RS_STREAM_DEPTH,    RS_FORMAT_Z16 },{ RS_STREAM_INFRARED, RS_FORMAT_Y8 } } },
@@ -486,120 +524,293 @@ namespace rsimpl
     // Deprojection //
     //////////////////
 
-    template<class MAP_DEPTH> void deproject_depth(float * points, const rs_intrinsics & intrin, const uint16_t * depth, MAP_DEPTH map_depth)
+    std::vector<float> compute_deprojection_table(const rs_intrinsics & intrin)
     {
+        std::vector<float> table(intrin.width * intrin.height * 3);
+        auto ray = table.data();
         for(int y=0; y<intrin.height; ++y)
         {
-            for(int x=0; x<intrin.width; ++x)
+            for(int x=0; x<intrin.width; ++x, ray += 3)
             {
                 const float pixel[] = { (float) x, (float) y};
-                rs_deproject_pixel_to_point(points, &intrin, pixel, map_depth(*depth++));
-                points += 3;                
+                rs_deproject_pixel_to_point(ray, &intrin, pixel, 1);
             }
-        }    
+        }
+        return table;
+    }
+
+    // Multiplies the rays of pixel_count pixels by the depth of each, which yields the same values as rs_deproject_pixel_to_point
+    template<class MAP_DEPTH> void deproject_depth(float * points, const float * rays, const uint16_t * depth, int pixel_count, MAP_DEPTH map_depth)
+    {
+        int i = 0;
+#ifdef __SSSE3__
+        // Four pixels make up three registers of interleaved coordinates, so each depth is broadcast over its three lanes
+        for(; i + 4 <= pixel_count; i += 4, rays += 12, points += 12)
+        {
+            const __m128 d = _mm_setr_ps(map_depth(depth[i]), map_depth(depth[i+1]), map_depth(depth[i+2]), map_depth(depth[i+3]));
+            _mm_storeu_ps(points + 0, _mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(1,0,0,0)), _mm_loadu_ps(rays + 0)));
+            _mm_storeu_ps(points + 4, _mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(2,2,1,1)), _mm_loadu_ps(rays + 4)));
+            _mm_storeu_ps(points + 8, _mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(3,3,3,2)), _mm_loadu_ps(rays + 8)));
+        }
+#endif
+        for(; i < pixel_count; ++i, rays += 3, points += 3)
+        {
+            const float d = map_depth(depth[i]);
+            points[0] = d * rays[0];
+            points[1] = d * rays[1];
+            points[2] = d * rays[2];
+        }
+    }
+
+    void deproject_z(float * points, const std::vector<float> & deprojection_table, const uint16_t * z_pixels, float z_scale, int first_pixel, int pixel_count)
+    {
+        deproject_depth(points + first_pixel * 3, deprojection_table.data() + first_pixel * 3, z_pixels + first_pixel, pixel_count, [z_scale](uint16_t z) { return z_scale * z; });
+    }
+
+    void deproject_disparity(float * points, const std::vector<float> & deprojection_table, const uint16_t * disparity_pixels, float disparity_scale, int first_pixel, int pixel_count)
+    {
+        deproject_depth(points + first_pixel * 3, deprojection_table.data() + first_pixel * 3, disparity_pixels + first_pixel, pixel_count, [disparity_scale](uint16_t disparity) { return disparity_scale / disparity; });
     }
 
     void deproject_z(float * points, const rs_intrinsics & z_intrin, const uint16_t * z_pixels, float z_scale)
     {
-        deproject_depth(points, z_intrin, z_pixels, [z_scale](uint16_t z) { return z_scale * z; });
+        deproject_z(points, compute_deprojection_table(z_intrin), z_pixels, z_scale, 0, z_intrin.width * z_intrin.height);
     }
 
     void deproject_disparity(float * points, const rs_intrinsics & disparity_intrin, const uint16_t * disparity_pixels, float disparity_scale)
     {
-        deproject_depth(points, disparity_intrin, disparity_pixels, [disparity_scale](uint16_t disparity) { return disparity_scale / disparity; });
+        deproject_disparity(points, compute_deprojection_table(disparity_intrin), disparity_pixels, disparity_scale, 0, disparity_intrin.width * disparity_intrin.height);
     }
 
     /////////////////////
     // Image alignment //
     /////////////////////
 
-    template<class GET_DEPTH, class TRANSFER_PIXEL> void align_images(const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin, GET_DEPTH get_depth, TRANSFER_PIXEL transfer_pixel)
+    std::vector<float> compute_alignment_table(const rs_intrinsics & depth_intrin)
     {
-        // Iterate over the pixels of the depth image    
-#pragma omp parallel for schedule(dynamic)
-        for(int depth_y = 0; depth_y < depth_intrin.height; ++depth_y)
+        const int corners_per_row = depth_intrin.width + 1, corner_count = corners_per_row * (depth_intrin.height + 1);
+        std::vector<float> table(corner_count * 2);
+        for(int y=0; y<=depth_intrin.height; ++y)
+        {
+            for(int x=0; x<=depth_intrin.width; ++x)
+            {
+                const float corner[] = {x-0.5f, y-0.5f};
+                float ray[3];
+                rs_deproject_pixel_to_point(ray, &depth_intrin, corner, 1);
+                table[y * corners_per_row + x] = ray[0];
+                table[corner_count + y * corners_per_row + x] = ray[1];
+            }
+        }
+        return table;
+    }
+
+    // Maps count pixel corners at the given depths onto the other image, with the same arithmetic as rs_transform_point_to_point and rs_project_point_to_pixel
+    static void project_corners(int * other_x, int * other_y, const float * depth, const float * ray_x, const float * ray_y, int count, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin)
+    {
+        int i = 0;
+#ifdef __SSSE3__
+        const float * r = depth_to_other.rotation, * t = depth_to_other.translation, * c = other_intrin.coeffs;
+        const bool distorted = other_intrin.model == RS_DISTORTION_MODIFIED_BROWN_CONRADY;
+        for(; i + 4 <= count; i += 4)
+        {
+            const __m128 d = _mm_loadu_ps(depth + i), px = _mm_mul_ps(d, _mm_loadu_ps(ray_x + i)), py = _mm_mul_ps(d, _mm_loadu_ps(ray_y + i));
+            auto transform = [&](int row) { return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[row]), px), _mm_mul_ps(_mm_set1_ps(r[row+3]), py)), _mm_mul_ps(_mm_set1_ps(r[row+6]), d)), _mm_set1_ps(t[row])); };
+            const __m128 oz = transform(2);
+            __m128 x = _mm_div_ps(transform(0), oz), y = _mm_div_ps(transform(1), oz);
+            if(distorted)
+            {
+                const __m128 r2 = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), two = _mm_set1_ps(2);
+                const __m128 f = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_set1_ps(1), _mm_mul_ps(_mm_set1_ps(c[0]), r2)), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(c[1]), r2), r2)), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(c[4]), r2), r2), r2));
+                x = _mm_mul_ps(x, f);
+                y = _mm_mul_ps(y, f);
+                const __m128 dx = _mm_add_ps(_mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2*c[2]), x), y)), _mm_mul_ps(_mm_set1_ps(c[3]), _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(two, x), x))));
+                const __m128 dy = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2*c[3]), x), y)), _mm_mul_ps(_mm_set1_ps(c[2]), _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(two, y), y))));
+                x = dx;
+                y = dy;
+            }
+            const __m128 half = _mm_set1_ps(0.5f);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(other_x + i), _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(other_intrin.fx)), _mm_set1_ps(other_intrin.ppx)), half)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(other_y + i), _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(other_intrin.fy)), _mm_set1_ps(other_intrin.ppy)), half)));
+        }
+#endif
+        for(; i < count; ++i)
         {
-            int depth_pixel_index = depth_y * depth_intrin.width;
-            for(int depth_x = 0; depth_x < depth_intrin.width; ++depth_x, ++depth_pixel_index)
+            const float depth_point[] = {depth[i] * ray_x[i], depth[i] * ray_y[i], depth[i]};
+            float other_point[3], other_pixel[2];
+            rs_transform_point_to_point(other_point, &depth_to_other, depth_point);
+            rs_project_point_to_pixel(other_pixel, &other_intrin, other_point);
+            other_x[i] = static_cast<int>(other_pixel[0] + 0.5f);
+            other_y[i] = static_cast<int>(other_pixel[1] + 0.5f);
+        }
+    }
+
+    // Calls visit_rectangle(depth_pixel_index, other_x0, other_y0, other_x1, other_y1) with the rectangle of other pixels covered by every depth pixel that lands inside the other image
+    template<class GET_DEPTH, class VISIT_RECTANGLE> void for_each_pixel_rectangle(const std::vector<float> & alignment_table, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin,
+                                                                                   int first_row, int row_count, GET_DEPTH get_depth, VISIT_RECTANGLE visit_rectangle)
+    {
+        const int corners_per_row = depth_intrin.width + 1, corner_count = corners_per_row * (depth_intrin.height + 1);
+        const float * ray_x = alignment_table.data(), * ray_y = ray_x + corner_count;
+
+        // Iterate over the pixels of the depth image in runs short enough to keep their projected corners on the stack
+        const int run_length = 64;
+        float depth[run_length];
+        int other_x0[run_length], other_y0[run_length], other_x1[run_length], other_y1[run_length];
+        for(int depth_y = first_row; depth_y < first_row + row_count; ++depth_y)
+        {
+            for(int run_x = 0; run_x < depth_intrin.width; run_x += run_length)
             {
-                // Skip over depth pixels with the value of zero, we have no depth data so we will not write anything into our aligned images
-                if(float depth = get_depth(depth_pixel_index))
+                const int count = std::min(run_length, depth_intrin.width - run_x), first_pixel_index = depth_y * depth_intrin.width + run_x;
+                for(int i = 0; i < count; ++i) depth[i] = get_depth(first_pixel_index + i);
+
+                // Map the top-left and bottom-right corners of the depth pixels onto the other image
+                const int top_left = depth_y * corners_per_row + run_x, bottom_right = top_left + corners_per_row + 1;
+                project_corners(other_x0, other_y0, depth, ray_x + top_left, ray_y + top_left, count, depth_to_other, other_intrin);
+                project_corners(other_x1, other_y1, depth, ray_x + bottom_right, ray_y + bottom_right, count, depth_to_other, other_intrin);
+
+                for(int i = 0; i < count; ++i)
                 {
-                    // Map the top-left corner of the depth pixel onto the other image
-                    float depth_pixel[2] = {depth_x-0.5f, depth_y-0.5f}, depth_point[3], other_point[3], other_pixel[2];
-                    rs_deproject_pixel_to_point(depth_point, &depth_intrin, depth_pixel, depth);
-                    rs_transform_point_to_point(other_point, &depth_to_other, depth_point);
-                    rs_project_point_to_pixel(other_pixel, &other_intrin, other_point);
-                    const int other_x0 = static_cast<int>(other_pixel[0] + 0.5f);
-                    const int other_y0 = static_cast<int>(other_pixel[1] + 0.5f);
-
-                    // Map the bottom-right corner of the depth pixel onto the other image
-                    depth_pixel[0] = depth_x+0.5f; depth_pixel[1] = depth_y+0.5f;
-                    rs_deproject_pixel_to_point(depth_point, &depth_intrin, depth_pixel, depth);
-                    rs_transform_point_to_point(other_point, &depth_to_other, depth_point);
-                    rs_project_point_to_pixel(other_pixel, &other_intrin, other_point);
-                    const int other_x1 = static_cast<int>(other_pixel[0] + 0.5f);
-                    const int other_y1 = static_cast<int>(other_pixel[1] + 0.5f);
-
-                    if(other_x0 < 0 || other_y0 < 0 || other_x1 >= other_intrin.width || other_y1 >= other_intrin.height) continue;
-
-                    // Transfer between the depth pixels and the pixels inside the rectangle on the other image
-                    for(int y=other_y0; y<=other_y1; ++y) for(int x=other_x0; x<=other_x1; ++x) transfer_pixel(depth_pixel_index, y * other_intrin.width + x);
+                    // Skip over depth pixels with the value of zero, we have no depth data so we will not write anything into our aligned images
+                    if(!depth[i] || other_x0[i] < 0 || other_y0[i] < 0 || other_x1[i] >= other_intrin.width || other_y1[i] >= other_intrin.height) continue;
+                    visit_rectangle(first_pixel_index + i, other_x0[i], other_y0[i], other_x1[i], other_y1[i]);
                 }
             }
-        }    
+        }
+    }
+
+    template<class GET_DEPTH, class TRANSFER_PIXEL> void align_images(const std::vector<float> & alignment_table, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin,
+                                                                      int first_row, int row_count, GET_DEPTH get_depth, TRANSFER_PIXEL transfer_pixel)
+    {
+        // Transfer between the depth pixels and the pixels inside the rectangle on the other image
+        for_each_pixel_rectangle(alignment_table, depth_intrin, depth_to_other, other_intrin, first_row, row_count, get_depth, [&transfer_pixel, &other_intrin](int depth_pixel_index, int x0, int y0, int x1, int y1)
+        {
+            for(int y=y0; y<=y1; ++y) for(int x=x0; x<=x1; ++x) transfer_pixel(depth_pixel_index, y * other_intrin.width + x);
+        });
+    }
+
+    void pixel_rectangles::resize(const rs_intrinsics & depth_intrin)
+    {
+        bounds.resize(depth_intrin.width * depth_intrin.height * 4);
+        row_bounds.resize(depth_intrin.height * 2);
+    }
+
+    template<class GET_DEPTH> void find_pixel_rectangles(pixel_rectangles & rectangles, const std::vector<float> & alignment_table, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin,
+                                                         int first_row, int row_count, GET_DEPTH get_depth)
+    {
+        // Rectangles start out empty, with x0 > x1, and rows cover no other rows until a rectangle is found in them
+        for(int depth_y = first_row; depth_y < first_row + row_count; ++depth_y)
+        {
+            for(int i = depth_y * depth_intrin.width * 4, n = i + depth_intrin.width * 4; i < n; i += 4) { rectangles.bounds[i] = 1; rectangles.bounds[i + 2] = 0; }
+            rectangles.row_bounds[depth_y * 2] = static_cast<int16_t>(other_intrin.height);
+            rectangles.row_bounds[depth_y * 2 + 1] = -1;
+        }
+
+        for_each_pixel_rectangle(alignment_table, depth_intrin, depth_to_other, other_intrin, first_row, row_count, get_depth, [&rectangles, &depth_intrin](int depth_pixel_index, int x0, int y0, int x1, int y1)
+        {
+            int16_t * b = &rectangles.bounds[depth_pixel_index * 4], * row = &rectangles.row_bounds[depth_pixel_index / depth_intrin.width * 2];
+            b[0] = static_cast<int16_t>(x0);
+            b[1] = static_cast<int16_t>(y0);
+            b[2] = static_cast<int16_t>(x1);
+            b[3] = static_cast<int16_t>(y1);
+            row[0] = std::min(row[0], b[1]);
+            row[1] = std::max(row[1], b[3]);
+        });
+    }
+
+    // Visits the depth pixels in the same order as align_images, but only transfers onto rows first_row to first_row + row_count - 1 of the other image
+    template<class TRANSFER_PIXEL> void transfer_pixel_rectangles(const pixel_rectangles & rectangles, const rs_intrinsics & depth_intrin, const rs_intrinsics & other_intrin, int first_row, int row_count, TRANSFER_PIXEL transfer_pixel)
+    {
+        const int last_row = first_row + row_count - 1;
+        for(int depth_y = 0; depth_y < depth_intrin.height; ++depth_y)
+        {
+            if(rectangles.row_bounds[depth_y * 2] > last_row || rectangles.row_bounds[depth_y * 2 + 1] < first_row) continue;
+            for(int depth_pixel_index = depth_y * depth_intrin.width, n = depth_pixel_index + depth_intrin.width; depth_pixel_index < n; ++depth_pixel_index)
+            {
+                const int16_t * b = &rectangles.bounds[depth_pixel_index * 4];
+                if(b[0] > b[2]) continue;
+                for(int y = std::max<int>(b[1], first_row), y1 = std::min<int>(b[3], last_row); y <= y1; ++y) for(int x = b[0]; x <= b[2]; ++x) transfer_pixel(depth_pixel_index, y * other_intrin.width + x);
+            }
+        }
+    }
+
+    void find_z_rectangles(pixel_rectangles & rectangles, const std::vector<float> & alignment_table, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, int first_row, int row_count)
+    {
+        find_pixel_rectangles(rectangles, alignment_table, z_intrin, z_to_other, other_intrin, first_row, row_count, [z_pixels, z_scale](int z_pixel_index) { return z_scale * z_pixels[z_pixel_index]; });
+    }
+
+    void find_disparity_rectangles(pixel_rectangles & rectangles, const std::vector<float> & alignment_table, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin, int first_row, int row_count)
+    {
+        find_pixel_rectangles(rectangles, alignment_table, disparity_intrin, disparity_to_other, other_intrin, first_row, row_count, [disparity_pixels, disparity_scale](int disparity_pixel_index) { return disparity_scale / disparity_pixels[disparity_pixel_index]; });
+    }
+
+    static void transfer_z(uint16_t * out_z, const uint16_t * z_pixels, int z_pixel_index, int other_pixel_index)
+    {
+        out_z[other_pixel_index] = out_z[other_pixel_index] ? std::min(out_z[other_pixel_index],z_pixels[z_pixel_index]) : z_pixels[z_pixel_index];
+    }
+
+    void align_z_to_other(byte * z_aligned_to_other, const pixel_rectangles & rectangles, const uint16_t * z_pixels, const rs_intrinsics & z_intrin, const rs_intrinsics & other_intrin, int first_row, int row_count)
+    {
+        auto out_z = (uint16_t *)(z_aligned_to_other);
+        transfer_pixel_rectangles(rectangles, z_intrin, other_intrin, first_row, row_count,
+            [out_z, z_pixels](int z_pixel_index, int other_pixel_index) { transfer_z(out_z, z_pixels, z_pixel_index, other_pixel_index); });
+    }
+
+    void align_disparity_to_other(byte * disparity_aligned_to_other, const pixel_rectangles & rectangles, const uint16_t * disparity_pixels, const rs_intrinsics & disparity_intrin, const rs_intrinsics & other_intrin, int first_row, int row_count)
+    {
+        auto out_disparity = (uint16_t *)(disparity_aligned_to_other);
+        transfer_pixel_rectangles(rectangles, disparity_intrin, other_intrin, first_row, row_count,
+            [out_disparity, disparity_pixels](int disparity_pixel_index, int other_pixel_index) { out_disparity[other_pixel_index] = disparity_pixels[disparity_pixel_index]; });
     }
 
-    void align_z_to_other(byte * z_aligned_to_other, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin)
+    void align_z_to_other(byte * z_aligned_to_other, const std::vector<float> & alignment_table, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin)
     {
         auto out_z = (uint16_t *)(z_aligned_to_other);
-        align_images(z_intrin, z_to_other, other_intrin, 
+        align_images(alignment_table, z_intrin, z_to_other, other_intrin, 0, z_intrin.height,
             [z_pixels, z_scale](int z_pixel_index) { return z_scale * z_pixels[z_pixel_index]; },
-            [out_z, z_pixels](int z_pixel_index, int other_pixel_index) { out_z[other_pixel_index] = out_z[other_pixel_index] ? std::min(out_z[other_pixel_index],z_pixels[z_pixel_index]) : z_pixels[z_pixel_index]; });
+            [out_z, z_pixels](int z_pixel_index, int other_pixel_index) { transfer_z(out_z, z_pixels, z_pixel_index, other_pixel_index); });
     }
 
-    void align_disparity_to_other(byte * disparity_aligned_to_other, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin)
+    void align_disparity_to_other(byte * disparity_aligned_to_other, const std::vector<float> & alignment_table, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin)
     {
         auto out_disparity = (uint16_t *)(disparity_aligned_to_other);
-        align_images(disparity_intrin, disparity_to_other, other_intrin, 
+        align_images(alignment_table, disparity_intrin, disparity_to_other, other_intrin, 0, disparity_intrin.height,
             [disparity_pixels, disparity_scale](int disparity_pixel_index) { return disparity_scale / disparity_pixels[disparity_pixel_index]; },
             [out_disparity, disparity_pixels](int disparity_pixel_index, int other_pixel_index) { out_disparity[other_pixel_index] = disparity_pixels[disparity_pixel_index]; });
     }
 
     template<int N> struct bytes { char b[N]; };
-    template<int N, class GET_DEPTH> void align_other_to_depth_bytes(byte * other_aligned_to_depth, GET_DEPTH get_depth, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels)
+    template<int N, class GET_DEPTH> void align_other_to_depth_bytes(byte * other_aligned_to_depth, const std::vector<float> & alignment_table, GET_DEPTH get_depth, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, int first_row, int row_count)
     {
         auto in_other = (const bytes<N> *)(other_pixels);
         auto out_other = (bytes<N> *)(other_aligned_to_depth);
-        align_images(depth_intrin, depth_to_other, other_intrin, get_depth,
+        align_images(alignment_table, depth_intrin, depth_to_other, other_intrin, first_row, row_count, get_depth,
             [out_other, in_other](int depth_pixel_index, int other_pixel_index) { out_other[depth_pixel_index] = in_other[other_pixel_index]; });
     }
 
-    template<class GET_DEPTH> void align_other_to_depth(byte * other_aligned_to_depth, GET_DEPTH get_depth, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format)
+    template<class GET_DEPTH> void align_other_to_depth(byte * other_aligned_to_depth, const std::vector<float> & alignment_table, GET_DEPTH get_depth, const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format, int first_row, int row_count)
     {
         switch(other_format)
         {
         case RS_FORMAT_Y8: 
-            align_other_to_depth_bytes<1>(other_aligned_to_depth, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels); break;
+            align_other_to_depth_bytes<1>(other_aligned_to_depth, alignment_table, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels, first_row, row_count); break;
         case RS_FORMAT_Y16: case RS_FORMAT_Z16: 
-            align_other_to_depth_bytes<2>(other_aligned_to_depth, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels); break;
+            align_other_to_depth_bytes<2>(other_aligned_to_depth, alignment_table, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels, first_row, row_count); break;
         case RS_FORMAT_RGB8: case RS_FORMAT_BGR8: 
-            align_other_to_depth_bytes<3>(other_aligned_to_depth, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels); break;
+            align_other_to_depth_bytes<3>(other_aligned_to_depth, alignment_table, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels, first_row, row_count); break;
         case RS_FORMAT_RGBA8: case RS_FORMAT_BGRA8: 
-            align_other_to_depth_bytes<4>(other_aligned_to_depth, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels); break;
+            align_other_to_depth_bytes<4>(other_aligned_to_depth, alignment_table, get_depth, depth_intrin, depth_to_other, other_intrin, other_pixels, first_row, row_count); break;
         default: 
             assert(false); // NOTE: rs_align_other_to_depth_bytes<2>(...) is not appropriate for RS_FORMAT_YUYV/RS_FORMAT_RAW10 images, no logic prevents U/V channels from being written to one another
         }
     }
 
-    void align_other_to_z(byte * other_aligned_to_z, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format)
+    void align_other_to_z(byte * other_aligned_to_z, const std::vector<float> & alignment_table, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format, int first_row, int row_count)
     {
-        align_other_to_depth(other_aligned_to_z, [z_pixels, z_scale](int z_pixel_index) { return z_scale * z_pixels[z_pixel_index]; }, z_intrin, z_to_other, other_intrin, other_pixels, other_format);
+        align_other_to_depth(other_aligned_to_z, alignment_table, [z_pixels, z_scale](int z_pixel_index) { return z_scale * z_pixels[z_pixel_index]; }, z_intrin, z_to_other, other_intrin, other_pixels, other_format, first_row, row_count);
     }
 
-    void align_other_to_disparity(byte * other_aligned_to_disparity, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format)
+    void align_other_to_disparity(byte * other_aligned_to_disparity, const std::vector<float> & alignment_table, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format, int first_row, int row_count)
     {
-        align_other_to_depth(other_aligned_to_disparity, [disparity_pixels, disparity_scale](int disparity_pixel_index) { return disparity_scale / disparity_pixels[disparity_pixel_index]; }, disparity_intrin, disparity_to_other, other_intrin, other_pixels, other_format);
+        align_other_to_depth(other_aligned_to_disparity, alignment_table, [disparity_pixels, disparity_scale](int disparity_pixel_index) { return disparity_scale / disparity_pixels[disparity_pixel_index]; }, disparity_intrin, disparity_to_other, other_intrin, other_pixels, other_format, first_row, row_count);
     }
 
     /////////////////////////
@@ -610,7 +821,7 @@ namespace rsimpl
     {   
         std::vector<int> rectification_table;
         rectification_table.resize(rect_intrin.width * rect_intrin.height);
-        align_images(rect_intrin, rect_to_unrect, unrect_intrin, [](int) { return 1.0f; },
+        align_images(compute_alignment_table(rect_intrin), rect_intrin, rect_to_unrect, unrect_intrin, 0, rect_intrin.height, [](int) { return 1.0f; },
             [&rectification_table](int rect_pixel_index, int unrect_pixel_index) { rectification_table[rect_pixel_index] = unrect_pixel_index; });
         return rectification_table;
     }
@@ -7,26 +7,93 @@
 
 #include "types.h"
 
+// x86 builds carry AVX2 and AVX-512BW converters compiled in their own translation units, selected at runtime from cpuid
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RS_X86_SIMD_DISPATCH
+#if !defined(_MSC_VER) || _MSC_VER >= 1910 // AVX-512 intrinsics require Visual Studio 2017
+#define RS_X86_SIMD_DISPATCH_AVX512
+#endif
+#endif
+
 namespace rsimpl
 {
 
     size_t           get_image_size                 (int width, int height, rs_format format);
     int              get_image_bpp                  (rs_format format);
+    bool             is_compressed_format           (rs_format format);         // Depth compressed by the depth codec, see depth-codec.h
+    rs_format        get_uncompressed_format        (rs_format format);
+
+    // Whole image deprojection, which builds the table below on every call. Only the tests use it, streams keep their table.
     void             deproject_z                    (float * points, const rs_intrinsics & z_intrin, const uint16_t * z_pixels, float z_scale);
     void             deproject_disparity            (float * points, const rs_intrinsics & disparity_intrin, const uint16_t * disparity_pixels, float disparity_scale);
 
-    void             align_z_to_other               (byte * z_aligned_to_other, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, 
+    // Deprojection through a table holding the (x, y, 1) direction of the ray through every pixel, so that a point is its depth times the
+    // table entry. Converts pixel_count pixels starting at first_pixel, so that callers can split the work.
+    std::vector<float> compute_deprojection_table   (const rs_intrinsics & intrin);
+    void             deproject_z                    (float * points, const std::vector<float> & deprojection_table, const uint16_t * z_pixels, float z_scale, int first_pixel, int pixel_count);
+    void             deproject_disparity            (float * points, const std::vector<float> & deprojection_table, const uint16_t * disparity_pixels, float disparity_scale, int first_pixel, int pixel_count);
+
+    // Alignment through a table holding the x and y coordinates of the (x, y, 1) rays through the (width + 1) * (height + 1) pixel corners
+    // of the depth image, all x coordinates first. The other image is aligned to depth one band of depth rows at a time, so that callers
+    // can split the work.
+    std::vector<float> compute_alignment_table      (const rs_intrinsics & depth_intrin);
+    void             align_z_to_other               (byte * z_aligned_to_other, const std::vector<float> & alignment_table, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, 
                                                      const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin);
-    void             align_disparity_to_other       (byte * disparity_aligned_to_other, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, 
+    void             align_disparity_to_other       (byte * disparity_aligned_to_other, const std::vector<float> & alignment_table, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, 
                                                      const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin);
-    void             align_other_to_z               (byte * other_aligned_to_z, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, 
-                                                     const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format);
-    void             align_other_to_disparity       (byte * other_aligned_to_disparity, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, 
-                                                     const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format);
+    void             align_other_to_z               (byte * other_aligned_to_z, const std::vector<float> & alignment_table, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, 
+                                                     const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format, int first_row, int row_count);
+    void             align_other_to_disparity       (byte * other_aligned_to_disparity, const std::vector<float> & alignment_table, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin, 
+                                                     const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin, const byte * other_pixels, rs_format other_format, int first_row, int row_count);
+
+    // Alignment of depth onto another image in two passes that can each be split over threads. The first finds the rectangle of other
+    // pixels covered by each depth pixel, one band of depth rows at a time. The second writes those rectangles into one band of rows of
+    // the other image, in the same order as the single pass alignment, so that the result does not depend on how the work was split.
+    struct pixel_rectangles
+    {
+        std::vector<int16_t> bounds;        // x0, y0, x1, y1 of the rectangle covered by each depth pixel, x0 > x1 if it covers none
+        std::vector<int16_t> row_bounds;    // Lowest y0 and highest y1 over each row of depth pixels
+        void resize(const rs_intrinsics & depth_intrin);
+    };
+    void             find_z_rectangles              (pixel_rectangles & rectangles, const std::vector<float> & alignment_table, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin,
+                                                     const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, int first_row, int row_count);
+    void             find_disparity_rectangles      (pixel_rectangles & rectangles, const std::vector<float> & alignment_table, const uint16_t * disparity_pixels, float disparity_scale, const rs_intrinsics & disparity_intrin,
+                                                     const rs_extrinsics & disparity_to_other, const rs_intrinsics & other_intrin, int first_row, int row_count);
+    void             align_z_to_other               (byte * z_aligned_to_other, const pixel_rectangles & rectangles, const uint16_t * z_pixels, const rs_intrinsics & z_intrin,
+                                                     const rs_intrinsics & other_intrin, int first_row, int row_count);
+    void             align_disparity_to_other       (byte * disparity_aligned_to_other, const pixel_rectangles & rectangles, const uint16_t * disparity_pixels, const rs_intrinsics & disparity_intrin,
+                                                     const rs_intrinsics & other_intrin, int first_row, int row_count);
 
     std::vector<int> compute_rectification_table    (const rs_intrinsics & rect_intrin, const rs_extrinsics & rect_to_unrect, const rs_intrinsics & unrect_intrin);
     void             rectify_image                  (uint8_t * rect_pixels, const std::vector<int> & rectification_table, const uint8_t * unrect_pixels, rs_format format);
 
+    // Vectorized converters take the pixel count and return how many of the leading pixels they converted, the rest being left to the generic converter
+    typedef int (* unpack_kernel)(byte * d, const byte * s, int n);
+
+    // Every vectorized YUY2 to RGB8/RGBA8/BGR8/BGRA8 converter of this build which this CPU can run, named after its instruction set.
+    // unpack_yuy2 only ever uses the widest of them, so this lets each be checked against the generic converter.
+    std::vector<std::pair<std::string, unpack_kernel>> get_yuy2_kernels(rs_format format);
+
+#ifdef RS_X86_SIMD_DISPATCH
+    // Convert as many whole groups of pixels as fill every lane of an AVX2 or AVX-512BW register, returning the number of pixels converted
+    template<rs_format FORMAT> int unpack_yuy2_avx2(byte * d, const byte * s, int n);
+    int              split_y8i_avx2                 (byte * l, byte * r, const byte * s, int n);
+    int              split_y12i_avx2                (byte * l, byte * r, const byte * s, int n);
+    int              split_f200_inzi_y8_avx2        (byte * z, byte * y, const byte * s, int n);
+    int              split_f200_inzi_y16_avx2       (byte * z, byte * y, const byte * s, int n);
+    int              unpack_y8_from_y16_10_avx2     (byte * d, const byte * s, int n);
+    int              unpack_y16_from_y16_10_avx2    (byte * d, const byte * s, int n);
+#endif
+#ifdef RS_X86_SIMD_DISPATCH_AVX512
+    template<rs_format FORMAT> int unpack_yuy2_avx512(byte * d, const byte * s, int n);
+    int              split_y8i_avx512               (byte * l, byte * r, const byte * s, int n);
+    int              split_y12i_avx512              (byte * l, byte * r, const byte * s, int n);
+    int              split_f200_inzi_y8_avx512      (byte * z, byte * y, const byte * s, int n);
+    int              split_f200_inzi_y16_avx512     (byte * z, byte * y, const byte * s, int n);
+    int              unpack_y8_from_y16_10_avx512   (byte * d, const byte * s, int n);
+    int              unpack_y16_from_y16_10_avx512  (byte * d, const byte * s, int n);
+#endif
+
     extern const native_pixel_format pf_raw8;       // Four 8 bit luminance
     extern const native_pixel_format pf_rw10;       // Four 10 bit luminance values in one 40 bit macropixel
     extern const native_pixel_format pf_rw16;       // 10 bit in 16 bit WORD with 6 bit unused
@@ -96,6 +96,8 @@ namespace rsimpl
 
     void iv_camera::set_options(const rs_option options[], size_t count, const double values[])
     {
+        if (defer_options(options, count, values)) return;
+
         std::vector<rs_option>  base_opt;
         std::vector<double>     base_opt_val;
 
@@ -171,8 +173,8 @@ namespace rsimpl
         }
 
         // Merge the local data with values obtained by base class
-        for (auto i : base_opt_index)
-            values[i] = base_opt_val[i];
+        for (size_t j = 0; j < base_opt_index.size(); ++j)
+            values[base_opt_index[j]] = base_opt_val[j];
     }
 
     // TODO: This may need to be modified for thread safety
@@ -40,6 +40,8 @@ namespace rsimpl
     }
     void lr200_mm_camera::set_options(const rs_option options[], size_t count, const double values[])
     {
+        if (defer_options(options, count, values)) return;
+
         std::vector<rs_option>  base_opt;
         std::vector<double>     base_opt_val;
 
@@ -97,7 +99,7 @@ namespace rsimpl
             case RS_OPTION_HARDWARE_LOGGER_ENABLED:                   break; 
 
                 // Default will be handled by parent implementation
-            default: base_opt.push_back(options[i]); base_opt_val.push_back(i); break;
+            default: base_opt.push_back(options[i]); base_opt_index.push_back(i); break;
             }
         }
 
@@ -109,8 +111,8 @@ namespace rsimpl
         }
 
         // Merge the local data with values obtained by base class
-        for (auto i : base_opt_index)
-            values[i] = base_opt_val[i];
+        for (size_t j = 0; j < base_opt_index.size(); ++j)
+            values[base_opt_index[j]] = base_opt_val[j];
     }
     void lr200_mm_camera::initialize_motion() {
 
@@ -428,7 +430,7 @@ namespace rsimpl
         info.capabilities_vector.push_back({ RS_CAPABILITIES_FISH_EYE, { 1, 15, 5, 0 }, firmware_version::any(), RS_CAMERA_INFO_MOTION_MODULE_FIRMWARE_VERSION });
         info.capabilities_vector.push_back({ RS_CAPABILITIES_MOTION_EVENTS, { 1, 15, 5, 0 }, firmware_version::any(), RS_CAMERA_INFO_MOTION_MODULE_FIRMWARE_VERSION });
         info.camera_info[RS_CAMERA_INFO_MOTION_MODULE_FIRMWARE_VERSION] = "14.0.2";
-        info.supported_metadata_vector.push_back(RS_FRAME_METADATA_ACTUAL_EXPOSURE);
+        info.supported_metadata |= 1 << RS_FRAME_METADATA_ACTUAL_EXPOSURE;
         info.subdevice_modes.push_back({ 2,{ 1920, 1080 }, pf_rw16, 30,  fisheye_intrinsic.calib.fe_intrinsic,{ cam_info.calibration.modesThird[0][0] },{ 0 } });
 
         return std::make_shared<lr200_mm_camera>(device, info,fisheye_intrinsic);
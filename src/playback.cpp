@@ -0,0 +1,560 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#include "playback.h"
+#include "image.h"
+#include "depth-codec.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace rsimpl;
+using namespace rsimpl::capture_file;
+
+#ifdef _WIN32
+mapped_file::mapped_file(const std::string & filename) : data(nullptr), size(0)
+{
+    auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error(to_string() << "cannot open " << filename << " for playback");
+    LARGE_INTEGER file_size = {};
+    auto mapping = GetFileSizeEx(file, &file_size) && file_size.QuadPart ? CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file); // The mapping holds on to the file, and the view to the mapping
+    if (!mapping) throw std::runtime_error(to_string() << "cannot map " << filename << " for playback");
+    data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (!data) throw std::runtime_error(to_string() << "cannot map " << filename << " for playback");
+    size = static_cast<size_t>(file_size.QuadPart);
+}
+
+mapped_file::~mapped_file()
+{
+    UnmapViewOfFile(data);
+}
+#else
+mapped_file::mapped_file(const std::string & filename) : data(nullptr), size(0)
+{
+    auto fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error(to_string() << "cannot open " << filename << " for playback");
+    struct stat file_stat = {};
+    auto mapping = fstat(fd, &file_stat) == 0 && file_stat.st_size > 0 ? mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // The mapping holds on to the file
+    if (mapping == MAP_FAILED) throw std::runtime_error(to_string() << "cannot map " << filename << " for playback");
+    data = static_cast<const uint8_t *>(mapping);
+    size = static_cast<size_t>(file_stat.st_size);
+}
+
+mapped_file::~mapped_file()
+{
+    munmap(const_cast<uint8_t *>(data), size);
+}
+#endif
+
+// The native formats a recording may refer to, told apart by their fourcc, plane count and pixel size
+static const native_pixel_format * const recorded_formats[] = { &pf_raw8, &pf_rw10, &pf_rw16, &pf_yuy2, &pf_y8, &pf_y8i, &pf_y16, &pf_y12i, &pf_z16, &pf_invz,
+                                                                &pf_f200_invi, &pf_f200_inzi, &pf_sr300_invi, &pf_sr300_inzi };
+
+static const native_pixel_format & find_pixel_format(uint32_t fourcc, int plane_count, size_t bytes_per_pixel)
+{
+    for (auto pf : recorded_formats) if (pf->fourcc == fourcc && pf->plane_count == plane_count && pf->bytes_per_pixel == bytes_per_pixel) return *pf;
+    throw std::runtime_error(to_string() << "capture file uses an unknown native format 0x" << std::hex << fourcc);
+}
+
+static void read_device_info(capture_contents & contents, const uint8_t * payload, size_t payload_size)
+{
+    deserializer d(payload, payload_size);
+    auto & info = contents.info;
+    d.read(info.name);
+    d.read(info.serial);
+    d.read(info.firmware_version);
+    d.read(info.nominal_depth_scale);
+    d.read(info.supported_metadata);
+    for (auto & subdevice : info.stream_subdevices) d.read(subdevice);
+    for (auto & subdevice : info.data_subdevices) d.read(subdevice);
+    for (auto & pose : info.stream_poses) d.read_pod(pose);
+
+    for (auto count = d.read<uint32_t>(); count; --count)
+    {
+        subdevice_mode mode;
+        d.read(mode.subdevice);
+        d.read(mode.native_dims.x);
+        d.read(mode.native_dims.y);
+        auto fourcc = d.read<uint32_t>();
+        auto plane_count = d.read<int32_t>();
+        auto bytes_per_pixel = d.read<uint32_t>();
+        mode.pf = find_pixel_format(fourcc, plane_count, bytes_per_pixel);
+        d.read(mode.fps);
+        d.read(mode.native_intrinsics);
+        d.read(mode.rect_modes);
+        d.read(mode.pad_crop_options);
+        if (mode.subdevice < 0 || mode.subdevice >= RS_STREAM_NATIVE_COUNT) throw std::runtime_error("capture file is truncated or corrupted");
+        info.subdevice_modes.push_back(mode);
+    }
+    for (auto & stream_presets : info.presets) for (auto & preset : stream_presets) d.read(preset);
+
+    // The controls of the camera cannot be played back, so only the options of the library itself are offered
+    for (auto count = d.read<uint32_t>(); count; --count)
+    {
+        d.read<int32_t>();
+        for (int i = 0; i < 4; ++i) d.read<double>();
+    }
+    rs_device_base::update_device_info(info);
+
+    for (auto count = d.read<uint32_t>(); count; --count) info.capabilities_vector.push_back(supported_capability(static_cast<rs_capabilities>(d.read<int32_t>())));
+    for (auto count = d.read<uint32_t>(); count; --count)
+    {
+        auto key = static_cast<rs_camera_info>(d.read<int32_t>());
+        d.read(info.camera_info[key]);
+    }
+
+    auto has_motion_intrinsics = d.read<int32_t>() != 0;
+    if (has_motion_intrinsics) d.read_pod(contents.motion_intrinsics);
+    auto has_motion_extrinsics = d.read<int32_t>() != 0;
+    if (has_motion_extrinsics) for (auto & extrinsics : contents.motion_extrinsics) d.read_pod(extrinsics);
+    contents.has_motion_calibration = has_motion_intrinsics && has_motion_extrinsics;
+}
+
+static bool read_index(capture_contents & contents)
+{
+    const auto file_size = contents.file->get_size();
+    const auto trailer_size = get_chunk_size<trailer>(0);
+    if (file_size < trailer_size) return false;
+    auto trailer_chunk = contents.get_chunk(file_size - trailer_size, sizeof(trailer));
+    if (!trailer_chunk || trailer_chunk->type != chunk_type::trailer) return false;
+    auto t = contents.get_record<trailer>(trailer_chunk);
+    if (t.magic != MAGIC) return false;
+
+    auto index_chunk = contents.get_chunk(t.index_offset, sizeof(index_table));
+    if (!index_chunk || index_chunk->type != chunk_type::index || index_chunk->payload_size != t.index_size) return false;
+    auto table = contents.get_record<index_table>(index_chunk);
+    if (table.entry_count * sizeof(index_entry) != t.index_size) return false;
+    contents.index = reinterpret_cast<const index_entry *>(contents.get_payload(index_chunk));
+    contents.index_size = static_cast<size_t>(table.entry_count);
+    return true;
+}
+
+// Indexes a recording which was cut short, up to the first chunk which was not completely written
+static void walk_chunks(capture_contents & contents, uint64_t offset)
+{
+    for (const chunk_header * chunk; (chunk = contents.get_chunk(offset, 0)) != nullptr; offset += chunk->header_size + align(chunk->payload_size))
+    {
+        index_entry entry = { offset, chunk->type, -1, 0 };
+        if (chunk->type == chunk_type::stream_config && contents.get_chunk(offset, sizeof(stream_config))) entry.capture_time = contents.get_record<stream_config>(chunk).capture_time;
+        else if (chunk->type == chunk_type::motion_event && contents.get_chunk(offset, sizeof(motion_event))) entry.capture_time = contents.get_record<motion_event>(chunk).capture_time;
+        else if (chunk->type == chunk_type::timestamp_event && contents.get_chunk(offset, sizeof(timestamp_event))) entry.capture_time = contents.get_record<timestamp_event>(chunk).capture_time;
+        else if ((chunk->type == chunk_type::video_frame || chunk->type == chunk_type::compressed_video_frame) && contents.get_chunk(offset, sizeof(video_frame)))
+        {
+            auto record = contents.get_record<video_frame>(chunk);
+            entry.subdevice = record.subdevice;
+            entry.capture_time = record.capture_time;
+        }
+        else break;
+        contents.walked_index.push_back(entry);
+    }
+    contents.index = contents.walked_index.data();
+    contents.index_size = contents.walked_index.size();
+}
+
+capture_contents::capture_contents(const std::string & filename) : file(std::make_shared<mapped_file>(filename)), index(nullptr), index_size(0), has_motion_calibration(false),
+    motion_intrinsics(), motion_extrinsics(), requests(), depth_scale(0), recorded_subdevices(0)
+{
+    auto header_chunk = get_chunk(0, sizeof(file_header));
+    if (!header_chunk || header_chunk->type != chunk_type::file_header || get_record<file_header>(header_chunk).magic != MAGIC) throw std::runtime_error(to_string() << filename << " is not a capture file");
+    auto version = get_record<file_header>(header_chunk).version;
+    if (version != VERSION) throw std::runtime_error(to_string() << filename << " was written in version " << version << " of the capture format, only version " << VERSION << " can be played back");
+
+    auto info_offset = header_chunk->header_size + align(header_chunk->payload_size);
+    auto info_chunk = get_chunk(info_offset, sizeof(device_info));
+    if (!info_chunk || info_chunk->type != chunk_type::device_info) throw std::runtime_error(to_string() << filename << " does not describe the recorded device");
+    read_device_info(*this, get_payload(info_chunk), static_cast<size_t>(info_chunk->payload_size));
+    depth_scale = info.nominal_depth_scale;
+
+    if (!read_index(*this))
+    {
+        walk_chunks(*this, info_offset + info_chunk->header_size + align(info_chunk->payload_size));
+        LOG_WARNING(filename << " has no index, the recording was cut short after " << index_size << " chunks");
+    }
+
+    bool found_stream_config = false;
+    for (size_t i = 0; i < index_size; ++i)
+    {
+        if ((index[i].type == chunk_type::video_frame || index[i].type == chunk_type::compressed_video_frame) && index[i].subdevice >= 0 && index[i].subdevice < RS_STREAM_NATIVE_COUNT) recorded_subdevices |= 1 << index[i].subdevice;
+        if (index[i].type != chunk_type::stream_config || found_stream_config) continue;
+        if (auto chunk = get_chunk(index[i].offset, sizeof(stream_config)))
+        {
+            deserializer d(get_payload(chunk), static_cast<size_t>(chunk->payload_size));
+            d.read(depth_scale);
+            for (auto & request : requests) d.read(request);
+            found_stream_config = true;
+        }
+    }
+}
+
+const chunk_header * capture_contents::get_chunk(uint64_t offset, size_t record_size) const
+{
+    const uint64_t file_size = file->get_size();
+    if (offset % CHUNK_ALIGNMENT || offset > file_size || file_size - offset < sizeof(chunk_header)) return nullptr;
+    auto chunk = reinterpret_cast<const chunk_header *>(file->get_data() + offset);
+    if (chunk->header_size < sizeof(chunk_header) + record_size || chunk->header_size > file_size - offset || chunk->payload_size > file_size - offset - chunk->header_size) return nullptr;
+    return chunk;
+}
+
+size_t capture_contents::find(double capture_time) const
+{
+    // The index follows the order in which chunks were written, which is also the order of their capture times, up to the scheduling of the capture threads
+    return std::lower_bound(index, index + index_size, capture_time, [](const index_entry & entry, double time) { return entry.capture_time < time; }) - index;
+}
+
+// Played back frames carry the timestamp and counter which were read from them when they were recorded, in the record preceding them in the file.
+// Decompressed frames are preceded by a copy of the chunk header and record.
+struct recorded_timestamp_reader : frame_timestamp_reader
+{
+    static video_frame get_record(const void * frame)
+    {
+        video_frame record;
+        memcpy(&record, static_cast<const uint8_t *>(frame) - get_header_size<video_frame>() + sizeof(chunk_header), sizeof(record));
+        return record;
+    }
+
+    bool validate_frame(const subdevice_mode & /*mode*/, const void * /*frame*/) override { return true; }
+    double get_frame_timestamp(const subdevice_mode & /*mode*/, const void * frame) override { return get_record(frame).timestamp; }
+    unsigned long long get_frame_counter(const subdevice_mode & /*mode*/, const void * frame) override { return get_record(frame).frame_counter; }
+};
+
+playback_device::playback_device(std::unique_ptr<capture_contents> contents) : rs_device_base(nullptr, contents->info), contents(std::move(contents)),
+    decompressed_frames(std::make_shared<decompression_buffers>()), playing_motion(false), playing_fisheye(false),
+    playback_mode(RS_PLAYBACK_MODE_REAL_TIME), position(0), stopping(false), interrupted(false), pacing_reset(true), pacing_origin(0), step_requested(false), step_delivered(false),
+    playing_subdevices(0), step_pending_subdevices(0)
+{
+    // Start out with the streams which were recorded first
+    for (int i = 0; i < RS_STREAM_NATIVE_COUNT; ++i) if (this->contents->requests[i].enabled) config.requests[i] = this->contents->requests[i];
+}
+
+playback_device::~playback_device()
+{
+    // The base class would stop the device through its own video channels
+    try
+    {
+        if (capturing) stop(RS_SOURCE_VIDEO);
+        if (data_acquisition_active) stop(RS_SOURCE_MOTION_TRACKING);
+    }
+    catch (...) {}
+}
+
+void playback_device::set_playback_mode(rs_playback_mode mode)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        playback_mode = mode;
+        pacing_reset = interrupted = true;
+    }
+    cv.notify_all();
+}
+
+bool playback_device::step_playback()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!capturing) throw std::runtime_error("cannot step playback before the device is started");
+    if (playback_mode != RS_PLAYBACK_MODE_STEPPED) throw std::runtime_error("cannot step playback unless the playback mode is RS_PLAYBACK_MODE_STEPPED");
+    if (step_requested) throw std::runtime_error("playback is already stepping");
+
+    step_requested = true;
+    step_delivered = false;
+    step_pending_subdevices = playing_subdevices;
+    cv.notify_all();
+    cv.wait(lock, [this]() { return !step_requested; });
+    return step_delivered;
+}
+
+void playback_device::seek_playback(double time)
+{
+    if (!(time >= 0)) throw std::runtime_error("cannot seek before the start of the recording");
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        position = contents->find(time);
+        pacing_reset = interrupted = true;
+    }
+    cv.notify_all();
+}
+
+rs_motion_intrinsics playback_device::get_motion_intrinsics() const
+{
+    if (!contents->has_motion_calibration) return rs_device_base::get_motion_intrinsics();
+    return contents->motion_intrinsics;
+}
+
+rs_extrinsics playback_device::get_motion_extrinsics_from(rs_stream from) const
+{
+    if (!contents->has_motion_calibration || from >= RS_STREAM_NATIVE_COUNT) return rs_device_base::get_motion_extrinsics_from(from);
+    return contents->motion_extrinsics[from];
+}
+
+bool playback_device::supports_option(rs_option option) const
+{
+    return !uvc::is_pu_control(option) && rs_device_base::supports_option(option);
+}
+
+void playback_device::get_option_range(rs_option option, double & min, double & max, double & step, double & def)
+{
+    if (uvc::is_pu_control(option)) throw std::logic_error(to_string() << option << " is not available during playback");
+    rs_device_base::get_option_range(option, min, max, step, def);
+}
+
+void playback_device::start_fw_logger(char /*fw_log_op_code*/, int /*grab_rate_in_ms*/, std::timed_mutex & /*logger_mutex*/)
+{
+    throw std::logic_error("the firmware logger is not available during playback");
+}
+
+void playback_device::stop_fw_logger()
+{
+    throw std::logic_error("the firmware logger is not available during playback");
+}
+
+void playback_device::on_before_start(const std::vector<subdevice_mode_selection> & /*selected_modes*/)
+{
+    config.depth_scale = contents->depth_scale;
+}
+
+rs_stream playback_device::select_key_stream(const std::vector<subdevice_mode_selection> & selected_modes)
+{
+    int fps[RS_STREAM_NATIVE_COUNT] = {}, max_fps = 0;
+    for (const auto & m : selected_modes)
+    {
+        for (const auto & output : m.get_outputs())
+        {
+            fps[output.first] = m.mode.fps;
+            max_fps = std::max(max_fps, m.mode.fps);
+        }
+    }
+
+    // Select the stream running at the fastest framerate, as the cameras do
+    for (auto s : { RS_STREAM_DEPTH, RS_STREAM_COLOR, RS_STREAM_INFRARED2, RS_STREAM_INFRARED })
+    {
+        if (fps[s] == max_fps) return s;
+    }
+    return RS_STREAM_DEPTH;
+}
+
+std::vector<std::shared_ptr<frame_timestamp_reader>> playback_device::create_frame_timestamp_readers() const
+{
+    return std::vector<std::shared_ptr<frame_timestamp_reader>>(RS_STREAM_NATIVE_COUNT, std::make_shared<recorded_timestamp_reader>());
+}
+
+void playback_device::open_video_channel(const subdevice_mode & mode, uvc::video_channel_callback callback)
+{
+    if (channels.size() <= static_cast<size_t>(mode.subdevice)) channels.resize(mode.subdevice + 1);
+    channels[mode.subdevice] = { mode, callback };
+}
+
+void playback_device::start_video_channels(const uvc::capture_settings & /*settings*/)
+{
+    int subdevices = 0;
+    for (size_t i = 0; i < channels.size(); ++i) if (channels[i].callback) subdevices |= 1 << i;
+    if (playing_fisheye && config.info.stream_subdevices[RS_STREAM_FISHEYE] >= 0) subdevices |= 1 << config.info.stream_subdevices[RS_STREAM_FISHEYE];
+    if (subdevices & ~contents->recorded_subdevices) LOG_WARNING("Some of the enabled streams were not recorded, and will not deliver any frames");
+
+    // Playback carries on from where it was stopped, or from where seek_playback moved it
+    std::lock_guard<std::mutex> lock(mutex);
+    playing_subdevices = subdevices & contents->recorded_subdevices;
+    stopping = false;
+    pacing_reset = true;
+    player = std::thread([this]() { play(); });
+}
+
+void playback_device::stop_video_channels()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (player.joinable()) player.join();
+    channels.clear();
+    playing_fisheye = false;
+}
+
+void playback_device::start_motion_tracking()
+{
+    if (data_acquisition_active) throw std::runtime_error("cannot restart data acquisition without stopping first");
+
+    // Recorded motion and timestamp events are delivered by the playback thread, along with the frames
+    playing_motion = config.data_request.enabled;
+    data_acquisition_active = true;
+}
+
+void playback_device::stop_motion_tracking()
+{
+    if (!data_acquisition_active) throw std::runtime_error("cannot stop data acquisition - is already stopped");
+    playing_motion = false;
+    data_acquisition_active = false;
+}
+
+void playback_device::play()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        interrupted = false;
+        if (position >= contents->index_size)
+        {
+            // The end of the recording completes any step, and playback waits to be moved elsewhere
+            if (step_requested)
+            {
+                step_requested = false;
+                cv.notify_all();
+            }
+            cv.wait(lock, [this]() { return stopping || interrupted || step_requested; });
+            continue;
+        }
+
+        const auto & entry = contents->index[position];
+        if (playback_mode == RS_PLAYBACK_MODE_STEPPED && !step_requested)
+        {
+            cv.wait(lock, [this]() { return stopping || interrupted || step_requested; });
+            continue;
+        }
+        if (playback_mode == RS_PLAYBACK_MODE_REAL_TIME)
+        {
+            if (pacing_reset)
+            {
+                pacing_start = std::chrono::steady_clock::now();
+                pacing_origin = entry.capture_time;
+                pacing_reset = false;
+            }
+            auto due = pacing_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(entry.capture_time - pacing_origin));
+            if (cv.wait_until(lock, due, [this]() { return stopping || interrupted; })) continue;
+        }
+        else pacing_reset = true;
+
+        ++position;
+        lock.unlock();
+        auto subdevice = play_entry(entry);
+        lock.lock();
+
+        // A step delivers a frame of every subdevice being played back
+        if (step_requested && subdevice >= 0)
+        {
+            step_delivered = true;
+            step_pending_subdevices &= ~(1 << subdevice);
+            if (!step_pending_subdevices)
+            {
+                step_requested = false;
+                cv.notify_all();
+            }
+        }
+    }
+
+    // Release a step waiting on the playback thread
+    step_requested = false;
+    cv.notify_all();
+}
+
+int playback_device::play_entry(const index_entry & entry)
+{
+    switch (entry.type)
+    {
+    case chunk_type::video_frame:
+    case chunk_type::compressed_video_frame:
+    {
+        // The timestamp reader finds the record at a fixed distance before the frame
+        auto chunk = contents->get_chunk(entry.offset, sizeof(video_frame));
+        if (!chunk || chunk->type != entry.type || chunk->header_size != get_header_size<video_frame>()) break;
+        auto record = contents->get_record<video_frame>(chunk);
+        auto frame = contents->get_payload(chunk);
+
+        if (playing_fisheye && record.subdevice == config.info.stream_subdevices[RS_STREAM_FISHEYE])
+        {
+            if (record.fourcc != pf_raw8.fourcc || static_cast<uint64_t>(record.width) * record.height > chunk->payload_size) break;
+            commit_fisheye_frame(frame, record.width, record.height, record.timestamp, record.frame_counter, 0);
+            return record.subdevice;
+        }
+
+        // Frames recorded in another mode than the one being played are skipped
+        if (record.subdevice < 0 || static_cast<size_t>(record.subdevice) >= channels.size()) break;
+        auto & channel = channels[record.subdevice];
+        if (!channel.callback || record.fourcc != channel.mode.pf.fourcc || record.width != channel.mode.native_dims.x || record.height != channel.mode.native_dims.y) break;
+        const auto image_size = channel.mode.pf.get_image_size(record.width, record.height);
+        if (chunk->type == chunk_type::video_frame)
+        {
+            if (chunk->payload_size < image_size) break;
+
+            // Frames are unpacked straight from the mapping, which they keep alive until they are released
+            auto file = contents->file;
+            channel.callback(frame, [file]() {});
+            return record.subdevice;
+        }
+
+        // Compressed frames hold exactly the native frame, and are decompressed into a buffer behind a copy of the chunk header and record
+        auto pool = decompressed_frames;
+        auto buffer = std::make_shared<std::vector<uint8_t>>();
+        try
+        {
+            auto h = depth_codec::read_header(frame, static_cast<size_t>(chunk->payload_size));
+            if (h.pixel_count * sizeof(uint16_t) != image_size) break;
+            {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                if (!pool->buffers.empty())
+                {
+                    *buffer = std::move(pool->buffers.back());
+                    pool->buffers.pop_back();
+                }
+            }
+            buffer->resize(chunk->header_size + image_size);
+            memcpy(buffer->data(), chunk, chunk->header_size);
+            depth_codec::decompress(reinterpret_cast<uint16_t *>(buffer->data() + chunk->header_size), h.pixel_count, frame, static_cast<size_t>(chunk->payload_size));
+        }
+        catch (const std::exception & e)
+        {
+            LOG_WARNING("Skipping frame " << record.frame_number << " of subdevice " << record.subdevice << ": " << e.what());
+            break;
+        }
+        channel.callback(buffer->data() + chunk->header_size, [pool, buffer]()
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->buffers.push_back(std::move(*buffer));
+        });
+        return record.subdevice;
+    }
+    case chunk_type::motion_event:
+    {
+        auto chunk = contents->get_chunk(entry.offset, sizeof(motion_event));
+        if (!playing_motion || !config.motion_callback || !chunk || chunk->type != chunk_type::motion_event) break;
+        auto record = contents->get_record<motion_event>(chunk);
+        rs_motion_data data;
+        data.timestamp_data = { record.timestamp, static_cast<rs_event_source>(record.source), static_cast<unsigned long long>(record.frame_number) };
+        data.is_valid = record.is_valid;
+        for (int i = 0; i < 3; ++i) data.axes[i] = record.axes[i];
+        config.motion_callback->on_event(data);
+        break;
+    }
+    case chunk_type::timestamp_event:
+    {
+        auto chunk = contents->get_chunk(entry.offset, sizeof(timestamp_event));
+        if (!playing_motion || !chunk || chunk->type != chunk_type::timestamp_event) break;
+        auto record = contents->get_record<timestamp_event>(chunk);
+        rs_timestamp_data data = { record.timestamp, static_cast<rs_event_source>(record.source), static_cast<unsigned long long>(record.frame_number) };
+        if (archive) archive->on_timestamp(data);
+        if (config.timestamp_callback) config.timestamp_callback->on_event(data);
+        break;
+    }
+    default:
+        break;
+    }
+    return -1;
+}
+
+std::shared_ptr<rs_device> rsimpl::make_playback_device(const std::string & filename)
+{
+    std::unique_ptr<capture_contents> contents(new capture_contents(filename));
+    LOG_INFO("Playing back " << contents->info.name << " " << contents->info.serial << " from " << filename << ", with " << contents->index_size << " recorded chunks");
+    return std::make_shared<playback_device>(std::move(contents));
+}
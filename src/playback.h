@@ -0,0 +1,130 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#ifndef LIBREALSENSE_PLAYBACK_H
+#define LIBREALSENSE_PLAYBACK_H
+
+#include "device.h"
+#include "capture-file.h"
+
+#include <condition_variable>
+#include <thread>
+
+namespace rsimpl
+{
+    // A file mapped read-only into memory. Played back frames point into the mapping, and hold on to it until they are released.
+    class mapped_file
+    {
+        const uint8_t * data;
+        size_t size;
+    public:
+        explicit mapped_file(const std::string & filename);
+        ~mapped_file();
+        mapped_file(const mapped_file &) = delete;
+        mapped_file & operator = (const mapped_file &) = delete;
+
+        const uint8_t * get_data() const { return data; }
+        size_t get_size() const { return size; }
+    };
+
+    // The contents of a capture file written by the recorder, see capture-file.h
+    struct capture_contents
+    {
+        std::shared_ptr<mapped_file> file;
+        const capture_file::index_entry * index;            // Points into the file, or into walked_index if the recording has no index
+        size_t index_size;
+        std::vector<capture_file::index_entry> walked_index;
+
+        static_device_info info;
+        bool has_motion_calibration;
+        rs_motion_intrinsics motion_intrinsics;
+        rs_extrinsics motion_extrinsics[RS_STREAM_NATIVE_COUNT];
+        stream_request requests[RS_STREAM_NATIVE_COUNT];    // As requested when streaming first started, if it ever did
+        float depth_scale;
+        int recorded_subdevices;                            // Bit (1 << subdevice) is set for each subdevice with recorded frames
+
+        explicit capture_contents(const std::string & filename);
+        capture_contents(const capture_contents &) = delete;
+        capture_contents & operator = (const capture_contents &) = delete;
+
+        // Returns the chunk at the given offset, or null if its header, record or payload do not fit in the file
+        const capture_file::chunk_header * get_chunk(uint64_t offset, size_t record_size) const;
+        template<class RECORD> RECORD get_record(const capture_file::chunk_header * chunk) const { RECORD r; memcpy(&r, chunk + 1, sizeof(r)); return r; }
+        const uint8_t * get_payload(const capture_file::chunk_header * chunk) const { return reinterpret_cast<const uint8_t *>(chunk) + chunk->header_size; }
+
+        // The position in the index of the first entry captured at or after the given time
+        size_t find(double capture_time) const;
+    };
+
+    // Stands in for the recorded camera, delivering the recorded native frames through the same unpacking, archive and callbacks as a live
+    // device. Frames are handed to the pipeline straight from the mapped file by a playback thread, which paces them by their capture time,
+    // delivers them as fast as they are consumed, or waits for step_playback, depending on the playback mode.
+    class playback_device final : public rs_device_base
+    {
+        struct video_channel
+        {
+            subdevice_mode mode;
+            uvc::video_channel_callback callback;
+        };
+
+        // Buffers of decompressed depth frames, handed back by whichever thread releases the frames
+        struct decompression_buffers
+        {
+            std::mutex mutex;
+            std::vector<std::vector<uint8_t>> buffers;
+        };
+
+        std::unique_ptr<capture_contents> contents;
+        std::vector<video_channel> channels;                // Indexed by subdevice. Only changes while the device is stopped.
+        std::shared_ptr<decompression_buffers> decompressed_frames;
+        std::atomic<bool> playing_motion;
+        bool playing_fisheye;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread player;
+        rs_playback_mode playback_mode;
+        size_t position;                                    // The next entry of the index to play
+        bool stopping, interrupted;                         // Interrupted when the position or mode changes, so that pacing starts over
+        bool pacing_reset;
+        std::chrono::steady_clock::time_point pacing_start;
+        double pacing_origin;
+        bool step_requested, step_delivered;
+        int playing_subdevices, step_pending_subdevices;   // Bit (1 << subdevice) is set for each subdevice being played, and for each still to deliver a frame in the current step
+
+        void play();
+        int play_entry(const capture_file::index_entry & entry); // Returns the subdevice of the frame delivered, or -1
+    public:
+        explicit playback_device(std::unique_ptr<capture_contents> contents);
+        ~playback_device();
+
+        void set_playback_mode(rs_playback_mode mode) override;
+        bool step_playback() override;
+        void seek_playback(double time) override;
+
+        rs_motion_intrinsics get_motion_intrinsics() const override;
+        rs_extrinsics get_motion_extrinsics_from(rs_stream from) const override;
+        bool supports_option(rs_option option) const override;
+        void get_option_range(rs_option option, double & min, double & max, double & step, double & def) override;
+        const char * get_usb_port_id() const override { return "playback"; }
+        void start_fw_logger(char fw_log_op_code, int grab_rate_in_ms, std::timed_mutex & logger_mutex) override;
+        void stop_fw_logger() override;
+
+        void on_before_start(const std::vector<subdevice_mode_selection> & selected_modes) override;
+        rs_stream select_key_stream(const std::vector<subdevice_mode_selection> & selected_modes) override;
+        std::vector<std::shared_ptr<frame_timestamp_reader>> create_frame_timestamp_readers() const override;
+    protected:
+        void open_video_channel(const subdevice_mode & mode, uvc::video_channel_callback callback) override;
+        void start_video_channels(const uvc::capture_settings & settings) override;
+        void stop_video_channels() override;
+        bool video_channels_support_zero_copy() const override { return true; }
+        void start_motion_tracking() override;
+        void stop_motion_tracking() override;
+        void enable_fisheye_stream() override { playing_fisheye = true; }
+    };
+
+    std::shared_ptr<rs_device> make_playback_device(const std::string & filename);
+}
+
+#endif
@@ -0,0 +1,262 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#include "recorder.h"
+#include "depth-codec.h"
+#include "image.h"
+
+using namespace rsimpl;
+using namespace rsimpl::capture_file;
+
+const size_t MAX_SPARE_RECORDER_BUFFERS = 16;
+
+recorder::recorder(const std::string & filename, size_t max_queued_bytes, bool compress_depth) : file(filename, std::ios::binary | std::ios::trunc), file_size(0), write_failed(false),
+    queued_bytes(0), max_queued_bytes(max_queued_bytes), closing(false), compress_depth(compress_depth), start_time(std::chrono::high_resolution_clock::now()), dropped_chunks(0)
+{
+    if (!file) throw std::runtime_error(to_string() << "cannot open " << filename << " for recording");
+    for (auto & n : frame_numbers) n = 0;
+
+    append_chunk(chunk_type::file_header, file_header{ MAGIC, VERSION }, -1, 0, nullptr, 0, true);
+    writer = std::thread([this]() { write_chunks(); });
+}
+
+recorder::~recorder()
+{
+    try { close(); }
+    catch (...) {}
+}
+
+template<class RECORD> void recorder::append_chunk(chunk_type type, const RECORD & record, int subdevice, double capture_time, const void * payload, size_t payload_size, bool required)
+{
+    append_chunk(type, record, subdevice, capture_time, payload_size, [payload, payload_size](uint8_t * dest)
+    {
+        if (payload_size) memcpy(dest, payload, payload_size);
+        return payload_size;
+    }, required);
+}
+
+template<class RECORD, class WRITE_PAYLOAD> void recorder::append_chunk(chunk_type type, const RECORD & record, int subdevice, double capture_time, size_t max_payload_size, WRITE_PAYLOAD write_payload, bool required)
+{
+    // Room is reserved in the queue for the largest payload, and handed back once the payload is written
+    const auto header_size = get_header_size<RECORD>();
+    const auto max_chunk_size = static_cast<size_t>(get_chunk_size<RECORD>(max_payload_size));
+
+    queued_chunk chunk;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closing) return;
+        if (!required && queued_bytes + max_chunk_size > max_queued_bytes)
+        {
+            // The disk is not keeping up. Dropping the chunk keeps the capture thread from waiting for it.
+            if (dropped_chunks++ == 0) LOG_WARNING("Recording falls behind, dropping chunks which do not fit in " << max_queued_bytes << " bytes of queued data");
+            return;
+        }
+        queued_bytes += max_chunk_size;
+        if (!spare_buffers.empty())
+        {
+            chunk.buffer = std::move(spare_buffers.back());
+            spare_buffers.pop_back();
+        }
+    }
+
+    // Assemble the chunk outside of the lock, zeroing the alignment padding so that files are reproducible
+    if (chunk.buffer.size() < max_chunk_size) chunk.buffer.resize(max_chunk_size);
+    auto data = chunk.buffer.data();
+    const uint64_t payload_size = write_payload(data + header_size);
+    assert(payload_size <= max_payload_size);
+    const auto chunk_size = static_cast<size_t>(get_chunk_size<RECORD>(payload_size));
+    chunk.size = chunk_size;
+    const chunk_header header = { type, header_size, payload_size };
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), &record, sizeof(record));
+    memset(data + sizeof(header) + sizeof(record), 0, header_size - sizeof(header) - sizeof(record));
+    memset(data + header_size + payload_size, 0, chunk_size - header_size - payload_size);
+    chunk.entry = { 0, type, subdevice, capture_time };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued_bytes -= max_chunk_size - chunk_size;
+        queue.push_back(std::move(chunk));
+    }
+    cv.notify_one();
+}
+
+void recorder::write_chunks()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        cv.wait(lock, [this]() { return closing || !queue.empty(); });
+        if (queue.empty()) break; // Closing, and everything has been written
+
+        auto chunk = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+
+        if (!write_failed)
+        {
+            if (file.write(reinterpret_cast<const char *>(chunk.buffer.data()), chunk.size))
+            {
+                chunk.entry.offset = file_size;
+                if (chunk.entry.type != chunk_type::file_header && chunk.entry.type != chunk_type::device_info) index.push_back(chunk.entry);
+                file_size += chunk.size;
+            }
+            else
+            {
+                LOG_ERROR("Writing the recording failed after " << file_size << " bytes, the rest of the capture is discarded");
+                write_failed = true;
+            }
+        }
+
+        lock.lock();
+        queued_bytes -= chunk.size;
+        if (spare_buffers.size() < MAX_SPARE_RECORDER_BUFFERS) spare_buffers.push_back(std::move(chunk.buffer));
+    }
+}
+
+void recorder::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closing) return;
+        closing = true;
+    }
+    cv.notify_one();
+    writer.join();
+
+    if (!write_failed)
+    {
+        // The index lists the chunks in file order, followed by a trailer at the very end of the file through which it is found
+        const auto index_offset = file_size;
+        const auto index_size = index.size() * sizeof(index_entry);
+        const chunk_header index_header = { chunk_type::index, get_header_size<capture_file::index_table>(), index_size };
+        const index_table i = { index.size() };
+        std::vector<uint8_t> padding(CHUNK_ALIGNMENT);
+        file.write(reinterpret_cast<const char *>(&index_header), sizeof(index_header));
+        file.write(reinterpret_cast<const char *>(&i), sizeof(i));
+        file.write(reinterpret_cast<const char *>(padding.data()), index_header.header_size - sizeof(index_header) - sizeof(i));
+        file.write(reinterpret_cast<const char *>(index.data()), index_size);
+        file.write(reinterpret_cast<const char *>(padding.data()), align(index_size) - index_size);
+
+        const chunk_header trailer_header = { chunk_type::trailer, get_header_size<trailer>(), 0 };
+        const trailer t = { index_offset, index_size, MAGIC };
+        file.write(reinterpret_cast<const char *>(&trailer_header), sizeof(trailer_header));
+        file.write(reinterpret_cast<const char *>(&t), sizeof(t));
+        file.write(reinterpret_cast<const char *>(padding.data()), trailer_header.header_size - sizeof(trailer_header) - sizeof(t));
+        file.close();
+        if (!file) LOG_ERROR("Writing the index of the recording failed");
+    }
+    if (dropped_chunks) LOG_WARNING("Recording dropped " << dropped_chunks << " chunks which did not fit in the queue");
+}
+
+void recorder::record_device_info(const static_device_info & info, const std::vector<rs_capabilities> & capabilities, const rs_motion_intrinsics * motion_intrinsics, const rs_extrinsics * motion_extrinsics)
+{
+    std::vector<uint8_t> payload;
+    serializer s(payload);
+    s.write(info.name);
+    s.write(info.serial);
+    s.write(info.firmware_version);
+    s.write(info.nominal_depth_scale);
+    s.write(info.supported_metadata);
+    for (auto subdevice : info.stream_subdevices) s.write(subdevice);
+    for (auto subdevice : info.data_subdevices) s.write(subdevice);
+    for (auto & pose : info.stream_poses) s.write_pod(pose);
+
+    s.write(static_cast<uint32_t>(info.subdevice_modes.size()));
+    for (auto & mode : info.subdevice_modes)
+    {
+        s.write(mode.subdevice);
+        s.write(mode.native_dims.x);
+        s.write(mode.native_dims.y);
+        s.write(mode.pf.fourcc);
+        s.write(mode.pf.plane_count);
+        s.write(static_cast<uint32_t>(mode.pf.bytes_per_pixel)); // Tells apart the formats which share a fourcc
+        s.write(mode.fps);
+        s.write(mode.native_intrinsics);
+        s.write(mode.rect_modes);
+        s.write(mode.pad_crop_options);
+    }
+    for (auto & stream_presets : info.presets) for (auto & preset : stream_presets) s.write(preset);
+
+    s.write(static_cast<uint32_t>(info.options.size()));
+    for (auto & o : info.options)
+    {
+        s.write(static_cast<int32_t>(o.option));
+        s.write(o.min);
+        s.write(o.max);
+        s.write(o.step);
+        s.write(o.def);
+    }
+    s.write(static_cast<uint32_t>(capabilities.size()));
+    for (auto c : capabilities) s.write(static_cast<int32_t>(c));
+    s.write(static_cast<uint32_t>(info.camera_info.size()));
+    for (auto & i : info.camera_info)
+    {
+        s.write(static_cast<int32_t>(i.first));
+        s.write(i.second);
+    }
+
+    s.write(static_cast<int32_t>(motion_intrinsics != nullptr));
+    if (motion_intrinsics) s.write_pod(*motion_intrinsics);
+    s.write(static_cast<int32_t>(motion_extrinsics != nullptr));
+    if (motion_extrinsics) for (int i = 0; i < RS_STREAM_NATIVE_COUNT; ++i) s.write_pod(motion_extrinsics[i]);
+
+    auto capture_time = get_capture_time();
+    append_chunk(chunk_type::device_info, capture_file::device_info{ capture_time }, -1, capture_time, payload.data(), payload.size(), true);
+}
+
+void recorder::record_stream_config(const std::vector<subdevice_mode_selection> & selected_modes, const stream_request (&requests)[RS_STREAM_NATIVE_COUNT], float depth_scale)
+{
+    std::vector<uint8_t> payload;
+    serializer s(payload);
+    s.write(depth_scale);
+    for (auto & request : requests) s.write(request);
+    s.write(static_cast<uint32_t>(selected_modes.size()));
+    for (auto & selection : selected_modes)
+    {
+        s.write(selection.mode.subdevice);
+        s.write(selection.mode.native_dims.x);
+        s.write(selection.mode.native_dims.y);
+        s.write(selection.mode.pf.fourcc);
+        s.write(selection.mode.fps);
+        s.write(selection.pad_crop);
+        s.write(static_cast<uint32_t>(selection.unpacker_index));
+        s.write(static_cast<int32_t>(selection.output_format));
+    }
+
+    auto capture_time = get_capture_time();
+    append_chunk(chunk_type::stream_config, stream_config{ capture_time }, -1, capture_time, payload.data(), payload.size(), true);
+}
+
+void recorder::record_frame(int subdevice, uint32_t fourcc, int width, int height, const void * frame, size_t size, double timestamp, unsigned long long frame_counter)
+{
+    if (subdevice < 0 || subdevice >= RS_STREAM_NATIVE_COUNT) throw std::logic_error(to_string() << "cannot record frames of subdevice " << subdevice);
+    auto system_time = std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto capture_time = get_capture_time();
+    const video_frame record = { subdevice, fourcc, width, height, frame_numbers[subdevice]++, frame_counter, timestamp, system_time, capture_time };
+
+    // Depth is compressed on the capture thread, which spreads the work over the subdevices
+    if (compress_depth && (fourcc == pf_z16.fourcc || fourcc == pf_invz.fourcc) && size % sizeof(uint16_t) == 0)
+    {
+        const int pixel_count = static_cast<int>(size / sizeof(uint16_t));
+        append_chunk(chunk_type::compressed_video_frame, record, subdevice, capture_time, depth_codec::get_max_size(pixel_count), [frame, pixel_count](uint8_t * dest)
+        {
+            return depth_codec::compress(dest, static_cast<const uint16_t *>(frame), pixel_count);
+        }, false);
+    }
+    else append_chunk(chunk_type::video_frame, record, subdevice, capture_time, frame, size, false);
+}
+
+void recorder::record_motion(const rs_motion_data & data)
+{
+    auto capture_time = get_capture_time();
+    const motion_event record = { data.timestamp_data.timestamp, data.timestamp_data.source_id, data.is_valid, data.timestamp_data.frame_number, { data.axes[0], data.axes[1], data.axes[2] }, capture_time };
+    append_chunk(chunk_type::motion_event, record, -1, capture_time, nullptr, 0, false);
+}
+
+void recorder::record_timestamp(const rs_timestamp_data & data)
+{
+    auto capture_time = get_capture_time();
+    const timestamp_event record = { data.timestamp, data.source_id, data.frame_number, capture_time };
+    append_chunk(chunk_type::timestamp_event, record, -1, capture_time, nullptr, 0, false);
+}
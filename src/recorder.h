@@ -0,0 +1,77 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#ifndef LIBREALSENSE_RECORDER_H
+#define LIBREALSENSE_RECORDER_H
+
+#include "capture-file.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace rsimpl
+{
+    const size_t DEFAULT_RECORDER_QUEUE_BYTES = 256 << 20;
+
+    // Records the native frames, motion events and timestamp events of a device into a capture file (see capture-file.h). Chunks are
+    // assembled on the threads which produce them and written by a background thread. Chunks waiting to be written may hold at most
+    // max_queued_bytes, and any chunk beyond that is dropped, so that capture never waits on the disk. Depth frames may be compressed
+    // losslessly by the depth codec (see depth-codec.h) before they are queued, which takes a fraction of the disk bandwidth and space.
+    class recorder
+    {
+        struct queued_chunk
+        {
+            std::vector<uint8_t> buffer;            // Kept at its largest size, so that recycled buffers are not cleared for every frame
+            size_t size;
+            capture_file::index_entry entry;
+        };
+
+        std::ofstream file;
+        uint64_t file_size;
+        std::vector<capture_file::index_entry> index;   // Owned by the writer thread until it is joined
+        bool write_failed;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<queued_chunk> queue;
+        std::vector<std::vector<uint8_t>> spare_buffers;
+        size_t queued_bytes, max_queued_bytes;
+        bool closing;
+        std::thread writer;
+        const bool compress_depth;
+
+        const std::chrono::high_resolution_clock::time_point start_time;
+        std::atomic<uint64_t> frame_numbers[RS_STREAM_NATIVE_COUNT];
+        std::atomic<uint64_t> dropped_chunks;
+
+        double get_capture_time() const { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count(); }
+        template<class RECORD> void append_chunk(capture_file::chunk_type type, const RECORD & record, int subdevice, double capture_time, const void * payload, size_t payload_size, bool required);
+        // Write payload stores at most max_payload_size bytes straight into the chunk, and returns how many it stored
+        template<class RECORD, class WRITE_PAYLOAD> void append_chunk(capture_file::chunk_type type, const RECORD & record, int subdevice, double capture_time, size_t max_payload_size, WRITE_PAYLOAD write_payload, bool required);
+        void write_chunks();
+    public:
+        recorder(const std::string & filename, size_t max_queued_bytes = DEFAULT_RECORDER_QUEUE_BYTES, bool compress_depth = false);
+        ~recorder();
+
+        // The calibration and description of the device, which playback needs to stand in for it. Motion intrinsics and extrinsics (one per native stream) may be null.
+        void record_device_info(const static_device_info & info, const std::vector<rs_capabilities> & capabilities, const rs_motion_intrinsics * motion_intrinsics, const rs_extrinsics * motion_extrinsics);
+        void record_stream_config(const std::vector<subdevice_mode_selection> & selected_modes, const stream_request (&requests)[RS_STREAM_NATIVE_COUNT], float depth_scale);
+
+        // Called from the capture threads. Frames carry the timestamp and counter read from them, which playback cannot read without the camera's own readers.
+        void record_frame(int subdevice, uint32_t fourcc, int width, int height, const void * frame, size_t size, double timestamp, unsigned long long frame_counter);
+        void record_motion(const rs_motion_data & data);
+        void record_timestamp(const rs_timestamp_data & data);
+
+        // Writes out the chunks still queued, followed by the index, and closes the file
+        void close();
+        uint64_t get_dropped_chunks() const { return dropped_chunks; }
+    };
+}
+
+#endif
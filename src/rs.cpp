@@ -8,6 +8,7 @@
 #include "device.h"
 #include "sync.h"
 #include "archive.h"
+#include "depth-codec.h"
 
 ////////////////////////
 // API implementation //
@@ -124,6 +125,14 @@ rs_device * rs_get_device(rs_context * context, int index, rs_error ** error) tr
 }
 HANDLE_EXCEPTIONS_AND_RETURN(nullptr, context, index)
 
+rs_device * rs_add_playback_device(rs_context * context, const char * filename, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(context);
+    VALIDATE_NOT_NULL(filename);
+    return context->add_playback_device(filename);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(nullptr, context, filename)
+
 const char * rs_get_device_name(const rs_device * device, rs_error ** error) try
 {
     VALIDATE_NOT_NULL(device);
@@ -320,6 +329,102 @@ void rs_set_frame_callback_cpp(rs_device * device, rs_stream stream, rs_frame_ca
 }
 HANDLE_EXCEPTIONS_AND_RETURN(, device, stream, callback)
 
+void rs_set_frameset_callback(rs_device * device, rs_frameset_callback_ptr on_frameset, void * user, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NOT_NULL(on_frameset);
+    device->set_frameset_callback(on_frameset, user);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, on_frameset, user)
+
+void rs_set_frameset_callback_cpp(rs_device * device, rs_frameset_callback * callback, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NOT_NULL(callback);
+    device->set_frameset_callback(callback);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, callback)
+
+void rs_set_frameset_policy(rs_device * device, rs_frameset_policy policy, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_ENUM(policy);
+    device->set_frameset_policy(policy);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, policy)
+
+void rs_set_frameset_tolerance(rs_device * device, rs_stream a, rs_stream b, double milliseconds, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NATIVE_STREAM(a);
+    VALIDATE_NATIVE_STREAM(b);
+    VALIDATE_RANGE(milliseconds, 0, 1000);
+    device->set_frameset_tolerance(a, b, milliseconds);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, a, b, milliseconds)
+
+void rs_get_frameset_stats(const rs_device * device, rs_frameset_stats * stats, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NOT_NULL(stats);
+    *stats = device->get_frameset_stats();
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, stats)
+
+void rs_set_frame_allocator(rs_device * device, rs_frame_allocate_ptr allocate, rs_frame_deallocate_ptr deallocate, void * user, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NOT_NULL(allocate);
+    VALIDATE_NOT_NULL(deallocate);
+    device->set_frame_allocator(allocate, deallocate, user);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, allocate, deallocate, user)
+
+void rs_set_frame_allocator_cpp(rs_device * device, rs_frame_allocator * allocator, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NOT_NULL(allocator);
+    device->set_frame_allocator(allocator);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, allocator)
+
+void rs_start_recording(rs_device * device, const char * filename, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_NOT_NULL(filename);
+    device->start_recording(filename);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, filename)
+
+void rs_stop_recording(rs_device * device, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    device->stop_recording();
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device)
+
+void rs_set_playback_mode(rs_device * device, rs_playback_mode mode, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    VALIDATE_ENUM(mode);
+    device->set_playback_mode(mode);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, mode)
+
+int rs_step_playback(rs_device * device, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    return device->step_playback() ? 1 : 0;
+}
+HANDLE_EXCEPTIONS_AND_RETURN(0, device)
+
+void rs_seek_playback(rs_device * device, double time, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    device->seek_playback(time);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device, time)
+
 void rs_log_to_callback(rs_log_severity min_severity, rs_log_callback_ptr on_log, void * user, rs_error ** error) try
 {
     VALIDATE_NOT_NULL(on_log);
@@ -431,6 +536,13 @@ void rs_wait_for_frames(rs_device * device, rs_error ** error) try
 }
 HANDLE_EXCEPTIONS_AND_RETURN(, device)
 
+int rs_wait_for_frames_timeout(rs_device * device, unsigned int timeout_ms, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    return device->wait_all_streams(timeout_ms);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(0, device, timeout_ms)
+
 int rs_poll_for_frames(rs_device * device, rs_error ** error) try
 {
     VALIDATE_NOT_NULL(device);
@@ -666,6 +778,20 @@ void rs_reset_device_options_to_default(rs_device * device, const rs_option* opt
 }
 HANDLE_EXCEPTIONS_AND_RETURN(, device, options, count)
 
+void rs_begin_device_options_batch(rs_device * device, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    device->begin_options_batch();
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device)
+
+void rs_commit_device_options_batch(rs_device * device, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(device);
+    device->commit_options_batch();
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, device)
+
 void rs_get_device_options(rs_device * device, const rs_option options[], unsigned int count, double values[], rs_error ** error) try
 {
     VALIDATE_NOT_NULL(device);
@@ -741,6 +867,43 @@ void rs_send_blob_to_device(rs_device * device, rs_blob_type type, void * data,
 }
 HANDLE_EXCEPTIONS_AND_RETURN(, device, type, data, size)
 
+const int MAX_COMPRESSED_DEPTH_PIXELS = 1 << 28; // Keeps the size of a compressed image within an int
+
+int rs_get_max_compressed_depth_size(int pixel_count, rs_error ** error) try
+{
+    VALIDATE_RANGE(pixel_count, 0, MAX_COMPRESSED_DEPTH_PIXELS);
+    return static_cast<int>(rsimpl::depth_codec::get_max_size(pixel_count));
+}
+HANDLE_EXCEPTIONS_AND_RETURN(0, pixel_count)
+
+int rs_compress_depth(const void * pixels, int pixel_count, void * compressed, int compressed_size, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(pixels);
+    VALIDATE_RANGE(pixel_count, 0, MAX_COMPRESSED_DEPTH_PIXELS);
+    VALIDATE_NOT_NULL(compressed);
+    VALIDATE_RANGE(compressed_size, static_cast<int>(rsimpl::depth_codec::get_max_size(pixel_count)), INT_MAX);
+    return static_cast<int>(rsimpl::depth_codec::compress(static_cast<rsimpl::byte *>(compressed), static_cast<const uint16_t *>(pixels), pixel_count));
+}
+HANDLE_EXCEPTIONS_AND_RETURN(0, pixels, pixel_count, compressed, compressed_size)
+
+int rs_get_compressed_depth_size(const void * compressed, int compressed_size, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(compressed);
+    VALIDATE_RANGE(compressed_size, 0, INT_MAX);
+    return static_cast<int>(rsimpl::depth_codec::get_compressed_size(static_cast<const rsimpl::byte *>(compressed), compressed_size));
+}
+HANDLE_EXCEPTIONS_AND_RETURN(0, compressed, compressed_size)
+
+void rs_decompress_depth(const void * compressed, int compressed_size, void * pixels, int pixel_count, rs_error ** error) try
+{
+    VALIDATE_NOT_NULL(compressed);
+    VALIDATE_RANGE(compressed_size, 0, INT_MAX);
+    VALIDATE_NOT_NULL(pixels);
+    VALIDATE_RANGE(pixel_count, 0, MAX_COMPRESSED_DEPTH_PIXELS);
+    rsimpl::depth_codec::decompress(static_cast<uint16_t *>(pixels), pixel_count, static_cast<const rsimpl::byte *>(compressed), compressed_size);
+}
+HANDLE_EXCEPTIONS_AND_RETURN(, compressed, compressed_size, pixels, pixel_count)
+
 
 void rs_free_error(rs_error * error) { if (error) delete error; }
 const char * rs_get_failed_function(const rs_error * error) { return error ? error->function : nullptr; }
@@ -760,6 +923,8 @@ const char * rs_event_to_string(rs_event_source event)   { return rsimpl::get_st
 const char * rs_blob_type_to_string(rs_blob_type type) { return rsimpl::get_string(type); }
 const char * rs_camera_info_to_string(rs_camera_info info) { return rsimpl::get_string(info); }
 const char * rs_timestamp_domain_to_string(rs_timestamp_domain info){ return rsimpl::get_string(info); }
+const char * rs_frameset_policy_to_string(rs_frameset_policy policy) { return rsimpl::get_string(policy); }
+const char * rs_playback_mode_to_string(rs_playback_mode mode) { return rsimpl::get_string(mode); }
 
 void rs_log_to_console(rs_log_severity min_severity, rs_error ** error) try
 {
@@ -160,6 +160,8 @@ namespace rsimpl
 
     void sr300_camera::set_options(const rs_option options[], size_t count, const double values[])
     {
+        if (defer_options(options, count, values)) return;
+
         std::vector<rs_option>  base_opt;
         std::vector<double>     base_opt_val;
 
@@ -243,8 +245,8 @@ namespace rsimpl
         }
 
         // Merge the local data with values obtained by base class
-        for (auto i : base_opt_index)
-            values[i] = base_opt_val[i];
+        for (size_t j = 0; j < base_opt_index.size(); ++j)
+            values[base_opt_index[j]] = base_opt_val[j];
     }
 
     std::shared_ptr<rs_device> make_sr300_device(std::shared_ptr<uvc::device> device)
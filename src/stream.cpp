@@ -4,6 +4,7 @@
 #include "stream.h"
 #include "sync.h"       // For frame_archive
 #include "image.h"      // For image alignment, rectification, and deprojection routines
+#include "thread-pool.h"
 #include <algorithm>    // For sort
 #include <tuple>        // For make_tuple
 
@@ -165,19 +166,40 @@ int native_stream::get_frame_bpp() const
 
 const uint8_t * point_stream::get_frame_data() const
 {
+    if(is_compressed_format(source.get_format())) throw std::runtime_error("cannot deproject a compressed depth image, decompress it with rs_decompress_depth");
     if(image.empty() || number != get_frame_number())
     {
-        image.resize(get_image_size(get_intrinsics().width, get_intrinsics().height, get_format()));
-
-        if(source.get_format() == RS_FORMAT_Z16)
+        const auto intrin = get_intrinsics();
+        image.resize(get_image_size(intrin.width, intrin.height, get_format()));
+        if(deprojection_table.empty() || !(deprojection_intrin == intrin))
         {
-            deproject_z(reinterpret_cast<float *>(image.data()), get_intrinsics(), reinterpret_cast<const uint16_t *>(source.get_frame_data()), get_depth_scale());
+            deprojection_table = compute_deprojection_table(intrin);
+            deprojection_intrin = intrin;
         }
-        else if(source.get_format() == RS_FORMAT_DISPARITY16)
+
+        const auto format = source.get_format();
+        assert((format == RS_FORMAT_Z16 || format == RS_FORMAT_DISPARITY16) && "Cannot deproject image from a non-depth format");
+        auto points = reinterpret_cast<float *>(image.data());
+        auto depth = reinterpret_cast<const uint16_t *>(source.get_frame_data());
+        const float depth_scale = get_depth_scale();
+        auto deproject_rows = [&](int first_row, int row_count)
+        {
+            if(format == RS_FORMAT_Z16) deproject_z(points, deprojection_table, depth, depth_scale, first_row * intrin.width, row_count * intrin.width);
+            else deproject_disparity(points, deprojection_table, depth, depth_scale, first_row * intrin.width, row_count * intrin.width);
+        };
+
+        auto workers = std::atomic_load(&pool);
+        if(workers)
         {
-            deproject_disparity(reinterpret_cast<float *>(image.data()), get_intrinsics(), reinterpret_cast<const uint16_t *>(source.get_frame_data()), get_depth_scale());
+            // Hand each thread a few bands, so that a worker busy elsewhere does not hold up the frame
+            const int bands = std::min(intrin.height, (workers->get_thread_count() + 1) * 4);
+            workers->parallel_for(bands, [&](int band)
+            {
+                const int first_row = intrin.height * band / bands;
+                deproject_rows(first_row, intrin.height * (band + 1) / bands - first_row);
+            });
         }
-        else assert(false && "Cannot deproject image from a non-depth format");
+        else deproject_rows(0, intrin.height);
 
         number = get_frame_number();
     }
@@ -188,6 +210,7 @@ const uint8_t * rectified_stream::get_frame_data() const
 {
     // If source image is already rectified, just return it without doing any work
     if(get_pose() == source.get_pose() && get_intrinsics() == source.get_intrinsics()) return source.get_frame_data();
+    if(is_compressed_format(get_format())) throw std::runtime_error("cannot rectify a compressed depth image");
 
     if(image.empty() || number != get_frame_number())
     {
@@ -201,25 +224,78 @@ const uint8_t * rectified_stream::get_frame_data() const
 
 const uint8_t * aligned_stream::get_frame_data() const
 {
+    if(is_compressed_format(from.get_format()) || is_compressed_format(to.get_format())) throw std::runtime_error("cannot align a compressed depth image, decompress it with rs_decompress_depth");
     if(image.empty() || number != get_frame_number())
     {
         image.resize(get_image_size(get_intrinsics().width, get_intrinsics().height, get_format()));
         memset(image.data(), from.get_format() == RS_FORMAT_DISPARITY16 ? 0xFF : 0x00, image.size());
-        if(from.get_format() == RS_FORMAT_Z16)
+
+        const bool from_depth = from.get_format() == RS_FORMAT_Z16 || from.get_format() == RS_FORMAT_DISPARITY16;
+        const auto depth_intrin = (from_depth ? from : to).get_intrinsics();
+        if(alignment_table.empty() || !(alignment_intrin == depth_intrin))
         {
-            align_z_to_other(image.data(), (const uint16_t *)from.get_frame_data(), from.get_depth_scale(), from.get_intrinsics(), from.get_extrinsics_to(to), to.get_intrinsics());
+            alignment_table = compute_alignment_table(depth_intrin);
+            alignment_intrin = depth_intrin;
         }
-        else if(from.get_format() == RS_FORMAT_DISPARITY16)
+
+        auto workers = std::atomic_load(&pool);
+        if(from_depth && workers)
+        {
+            // Neighbouring depth pixels write overlapping pixels of the other image, so first find what each depth pixel covers, then give
+            // every thread its own band of output rows to write
+            auto depth = (const uint16_t *)from.get_frame_data();
+            const auto depth_to_other = from.get_extrinsics_to(to);
+            const auto other_intrin = to.get_intrinsics();
+            const bool z = from.get_format() == RS_FORMAT_Z16;
+            rectangles.resize(depth_intrin);
+
+            int bands = std::min(depth_intrin.height, (workers->get_thread_count() + 1) * 4);
+            workers->parallel_for(bands, [&](int band)
+            {
+                const int first_row = depth_intrin.height * band / bands, row_count = depth_intrin.height * (band + 1) / bands - first_row;
+                if(z) find_z_rectangles(rectangles, alignment_table, depth, from.get_depth_scale(), depth_intrin, depth_to_other, other_intrin, first_row, row_count);
+                else find_disparity_rectangles(rectangles, alignment_table, depth, from.get_depth_scale(), depth_intrin, depth_to_other, other_intrin, first_row, row_count);
+            });
+
+            bands = std::min(other_intrin.height, (workers->get_thread_count() + 1) * 4);
+            workers->parallel_for(bands, [&](int band)
+            {
+                const int first_row = other_intrin.height * band / bands, row_count = other_intrin.height * (band + 1) / bands - first_row;
+                if(z) align_z_to_other(image.data(), rectangles, depth, depth_intrin, other_intrin, first_row, row_count);
+                else align_disparity_to_other(image.data(), rectangles, depth, depth_intrin, other_intrin, first_row, row_count);
+            });
+        }
+        else if(from.get_format() == RS_FORMAT_Z16)
         {
-            align_disparity_to_other(image.data(), (const uint16_t *)from.get_frame_data(), from.get_depth_scale(), from.get_intrinsics(), from.get_extrinsics_to(to), to.get_intrinsics());
+            align_z_to_other(image.data(), alignment_table, (const uint16_t *)from.get_frame_data(), from.get_depth_scale(), depth_intrin, from.get_extrinsics_to(to), to.get_intrinsics());
         }
-        else if(to.get_format() == RS_FORMAT_Z16)
+        else if(from.get_format() == RS_FORMAT_DISPARITY16)
         {
-            align_other_to_z(image.data(), (const uint16_t *)to.get_frame_data(), to.get_depth_scale(), to.get_intrinsics(), to.get_extrinsics_to(from), from.get_intrinsics(), from.get_frame_data(), from.get_format());
+            align_disparity_to_other(image.data(), alignment_table, (const uint16_t *)from.get_frame_data(), from.get_depth_scale(), depth_intrin, from.get_extrinsics_to(to), to.get_intrinsics());
         }
-        else if(to.get_format() == RS_FORMAT_DISPARITY16)
+        else if(to.get_format() == RS_FORMAT_Z16 || to.get_format() == RS_FORMAT_DISPARITY16)
         {
-            align_other_to_disparity(image.data(), (const uint16_t *)to.get_frame_data(), to.get_depth_scale(), to.get_intrinsics(), to.get_extrinsics_to(from), from.get_intrinsics(), from.get_frame_data(), from.get_format());
+            // Every depth pixel writes only its own output pixel, so bands of rows can be aligned concurrently
+            auto depth = (const uint16_t *)to.get_frame_data();
+            auto other = from.get_frame_data();
+            const auto depth_to_other = to.get_extrinsics_to(from);
+            const auto other_intrin = from.get_intrinsics();
+            auto align_rows = [&](int first_row, int row_count)
+            {
+                if(to.get_format() == RS_FORMAT_Z16) align_other_to_z(image.data(), alignment_table, depth, to.get_depth_scale(), depth_intrin, depth_to_other, other_intrin, other, from.get_format(), first_row, row_count);
+                else align_other_to_disparity(image.data(), alignment_table, depth, to.get_depth_scale(), depth_intrin, depth_to_other, other_intrin, other, from.get_format(), first_row, row_count);
+            };
+
+            if(workers)
+            {
+                const int bands = std::min(depth_intrin.height, (workers->get_thread_count() + 1) * 4);
+                workers->parallel_for(bands, [&](int band)
+                {
+                    const int first_row = depth_intrin.height * band / bands;
+                    align_rows(first_row, depth_intrin.height * (band + 1) / bands - first_row);
+                });
+            }
+            else align_rows(0, depth_intrin.height);
         }
         else assert(false && "Cannot align two images if neither have depth data");
         number = get_frame_number();
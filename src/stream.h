@@ -6,6 +6,7 @@
 #define LIBREALSENSE_STREAM_H
 
 #include "types.h"
+#include "image.h" // For pixel_rectangles
 
 #include <memory> // For shared_ptr
 
@@ -29,6 +30,7 @@ namespace rsimpl
     
     class frame_archive;
     class syncronizing_archive;
+    class thread_pool;
 
     struct native_stream  : public stream_interface
     {
@@ -78,8 +80,13 @@ namespace rsimpl
         const stream_interface &                source;
         mutable std::vector<uint8_t>            image;
         mutable unsigned long long              number;
+        mutable std::vector<float>              deprojection_table;     // Ray through every pixel, rebuilt whenever the source intrinsics change
+        mutable rs_intrinsics                   deprojection_intrin;
+        std::shared_ptr<thread_pool>            pool;                   // Splits deprojection over rows when set. Only accessed through atomic_load/atomic_store, as the option may change it while frames are read
     public:
-        point_stream(const stream_interface & source) :stream_interface(calibration_validator(), RS_STREAM_POINTS), source(source), number() {}
+        point_stream(const stream_interface & source) :stream_interface(calibration_validator(), RS_STREAM_POINTS), source(source), number(), deprojection_intrin() {}
+
+        void                                    set_thread_pool(std::shared_ptr<thread_pool> pool) { std::atomic_store(&this->pool, std::move(pool)); }
 
         pose                                    get_pose() const override { return {{{1,0,0},{0,1,0},{0,0,1}}, source.get_pose().position}; }
         float                                   get_depth_scale() const override { return source.get_depth_scale(); }
@@ -135,8 +142,14 @@ namespace rsimpl
         const stream_interface &                from, & to;
         mutable std::vector<uint8_t>            image;
         mutable unsigned long long              number;
+        mutable std::vector<float>              alignment_table;        // Rays through the depth pixel corners, rebuilt whenever the depth intrinsics change
+        mutable rs_intrinsics                   alignment_intrin;
+        mutable pixel_rectangles                rectangles;             // Scratch space of the two pass alignment of depth onto the other image
+        std::shared_ptr<thread_pool>            pool;                   // Splits alignment over rows when set. Only accessed through atomic_load/atomic_store, as the option may change it while frames are read
     public:
-        aligned_stream(const stream_interface & from, const stream_interface & to) :stream_interface(calibration_validator(), RS_STREAM_COLOR_ALIGNED_TO_DEPTH), from(from), to(to), number() {}
+        aligned_stream(const stream_interface & from, const stream_interface & to) :stream_interface(calibration_validator(), RS_STREAM_COLOR_ALIGNED_TO_DEPTH), from(from), to(to), number(), alignment_intrin() {}
+
+        void                                    set_thread_pool(std::shared_ptr<thread_pool> pool) { std::atomic_store(&this->pool, std::move(pool)); }
 
         pose                                    get_pose() const override { return to.get_pose(); }
         float                                   get_depth_scale() const override { return to.get_depth_scale(); }
@@ -3,32 +3,245 @@
 
 using namespace rsimpl;
 
+frameset_synchronizer::frameset_synchronizer(const std::vector<rs_stream> & streams, rs_stream key_stream, const double (&tolerances)[RS_STREAM_NATIVE_COUNT][RS_STREAM_NATIVE_COUNT],
+                                             rs_frameset_policy policy, frameset_handler on_frameset, frame_release release)
+    : key_stream(key_stream), policy(policy), on_frameset(std::move(on_frameset)), release(std::move(release)), stats(), total_sync_error(0), dispatching(false), stopping(false)
+{
+    for (auto & s : synchronized) s = false;
+    synchronized[key_stream] = true;
+    for (auto s : streams)
+    {
+        if (s == key_stream || synchronized[s]) continue;
+        synchronized[s] = true;
+        other_streams.push_back(s);
+    }
+    std::copy(&tolerances[0][0], &tolerances[0][0] + RS_STREAM_NATIVE_COUNT * RS_STREAM_NATIVE_COUNT, &this->tolerances[0][0]);
+    dispatcher = std::thread([this]() { dispatch_framesets(); });
+}
+
+frameset_synchronizer::~frameset_synchronizer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    dispatcher.join();
+    flush();
+}
+
+void frameset_synchronizer::add(rs_frame_ref * frame)
+{
+    std::vector<rs_frame_ref *> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto stream = frame->get_stream_type();
+        auto & queue = queues[stream];
+        queue.push_back({ frame, frame->get_frame_timestamp(), frame->get_frame_timestamp_domain() });
+        if (queue.size() > max_queued_frames)
+        {
+            discarded.push_back(queue.front().ref);
+            queue.pop_front();
+            if (stream == key_stream) ++stats.dropped_framesets;
+            else ++stats.dropped_frames;
+        }
+        match(discarded);
+    }
+    cv.notify_one();
+    for (auto ref : discarded) release(ref);
+}
+
+// Forms as many framesets as the queued frames allow, starting from the oldest frame of the key stream
+void frameset_synchronizer::match(std::vector<rs_frame_ref *> & discarded)
+{
+    auto & keys = queues[key_stream];
+    while (!keys.empty())
+    {
+        const auto key = keys.front();
+        int chosen[RS_STREAM_NATIVE_COUNT];
+        bool missing = false, waiting = false;
+        for (auto s : other_streams)
+        {
+            auto & queue = queues[s];
+            const auto tolerance = tolerances[key_stream][s];
+
+            // Frames too old to match this key frame are too old for all later key frames as well
+            for (auto it = queue.begin(); it != queue.end();)
+            {
+                if (it->domain != key.domain || it->timestamp >= key.timestamp - tolerance) ++it;
+                else
+                {
+                    discarded.push_back(it->ref);
+                    it = queue.erase(it);
+                    ++stats.dropped_frames;
+                }
+            }
+
+            // Pick the closest frame within the tolerance. Without one, the frame is missing for good once a later frame arrived.
+            chosen[s] = -1;
+            bool later_frame = false;
+            for (int i = 0; i < static_cast<int>(queue.size()); ++i)
+            {
+                if (queue[i].domain != key.domain) continue; // Timestamps of different domains cannot be compared
+                if (queue[i].timestamp > key.timestamp + tolerance) later_frame = true;
+                else if (chosen[s] < 0 || std::fabs(queue[i].timestamp - key.timestamp) < std::fabs(queue[chosen[s]].timestamp - key.timestamp)) chosen[s] = i;
+            }
+            if (chosen[s] < 0)
+            {
+                if (later_frame) missing = true;
+                else waiting = true;
+            }
+        }
+
+        // The frames matched to the key frame must also be close enough to each other, otherwise the one further from the key frame is left out
+        for (size_t i = 0; i < other_streams.size(); ++i)
+        {
+            for (size_t j = i + 1; j < other_streams.size(); ++j)
+            {
+                auto a = other_streams[i], b = other_streams[j];
+                if (chosen[a] < 0 || chosen[b] < 0) continue;
+                auto ta = queues[a][chosen[a]].timestamp, tb = queues[b][chosen[b]].timestamp;
+                if (std::fabs(ta - tb) <= tolerances[a][b]) continue;
+                chosen[std::fabs(ta - key.timestamp) > std::fabs(tb - key.timestamp) ? a : b] = -1;
+                missing = true;
+            }
+        }
+
+        if (missing || waiting)
+        {
+            if (policy == RS_FRAMESET_POLICY_WAIT && !missing) return;
+            if (policy != RS_FRAMESET_POLICY_WAIT && waiting && keys.size() <= max_key_frames_ahead) return;
+        }
+
+        std::vector<rs_frame_ref *> frameset(1, key.ref);
+        double first = key.timestamp, last = key.timestamp;
+        for (auto s : other_streams)
+        {
+            if (chosen[s] < 0) continue;
+            auto it = queues[s].begin() + chosen[s];
+            frameset.push_back(it->ref);
+            first = std::min(first, it->timestamp);
+            last = std::max(last, it->timestamp);
+            queues[s].erase(it);
+        }
+        keys.pop_front();
+
+        const bool complete = !missing && !waiting;
+        if (!complete && policy != RS_FRAMESET_POLICY_EMIT_INCOMPLETE)
+        {
+            discarded.insert(discarded.end(), frameset.begin(), frameset.end());
+            ++stats.dropped_framesets;
+            continue;
+        }
+
+        if (complete) ++stats.complete_framesets;
+        else ++stats.incomplete_framesets;
+        stats.max_sync_error = std::max(stats.max_sync_error, last - first);
+        total_sync_error += last - first;
+        stats.mean_sync_error = total_sync_error / (stats.complete_framesets + stats.incomplete_framesets);
+        ready.push_back(std::move(frameset));
+        if (ready.size() > max_ready_framesets)
+        {
+            discarded.insert(discarded.end(), ready.front().begin(), ready.front().end());
+            ready.pop_front();
+            ++stats.dropped_framesets;
+        }
+    }
+}
+
+void frameset_synchronizer::dispatch_framesets()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        cv.wait(lock, [this]() { return stopping || !ready.empty(); });
+        if (stopping) return;
+
+        // The handler runs without the lock, so that frames keep being matched while it works
+        auto frameset = std::move(ready.front());
+        ready.pop_front();
+        dispatching = true;
+        lock.unlock();
+        try { on_frameset(frameset); }
+        catch (const std::exception & e) { LOG_ERROR("Frameset callback failed: " << e.what()); }
+        catch (...) { LOG_ERROR("Received an exception from frameset callback!"); }
+        lock.lock();
+        dispatching = false;
+        idle.notify_all();
+    }
+}
+
+void frameset_synchronizer::flush()
+{
+    std::vector<rs_frame_ref *> discarded;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (dispatcher.get_id() != std::this_thread::get_id()) idle.wait(lock, [this]() { return !dispatching; }); // The handler may stop the device itself
+        for (auto & frameset : ready) discarded.insert(discarded.end(), frameset.begin(), frameset.end());
+        stats.dropped_framesets += ready.size();
+        ready.clear();
+        for (int s = 0; s < RS_STREAM_NATIVE_COUNT; ++s)
+        {
+            for (auto & frame : queues[s]) discarded.push_back(frame.ref);
+            if (s == key_stream) stats.dropped_framesets += queues[s].size();
+            else stats.dropped_frames += queues[s].size();
+            queues[s].clear();
+        }
+    }
+    for (auto ref : discarded) release(ref);
+}
+
+rs_frameset_stats frameset_synchronizer::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// Frames of a stream which may be on their way to the user at once, besides the one in the backbuffer
+static uint32_t count_frames_in_transit(const std::vector<subdevice_mode_selection> & selection, uint32_t event_queue_size, uint32_t events_timeout, uint32_t frames_being_unpacked)
+{
+    // The timestamp corrector parks frames until their timestamp arrives, which it waits for no longer than events_timeout
+    uint32_t parked_frames = 0;
+    for (auto & mode : selection)
+    {
+        auto arriving_frames = static_cast<uint32_t>((static_cast<uint64_t>(events_timeout) * mode.get_framerate() + 999) / 1000);
+        parked_frames = std::max(parked_frames, std::min(event_queue_size, arriving_frames + 1));
+    }
+
+    // The frameset synchronizer queues frames waiting for a match, and framesets waiting for the dispatch thread, besides the one being dispatched
+    const auto synchronized_frames = static_cast<uint32_t>(frameset_synchronizer::max_queued_frames + frameset_synchronizer::max_ready_framesets + 1);
+
+    return frames_being_unpacked + parked_frames + synchronized_frames + RS_MAX_QUEUED_FRAMES;
+}
+
 syncronizing_archive::syncronizing_archive(const std::vector<subdevice_mode_selection> & selection,
     rs_stream key_stream,
     std::atomic<uint32_t>* max_size,
     std::atomic<uint32_t>* event_queue_size,
     std::atomic<uint32_t>* events_timeout,
-    std::chrono::high_resolution_clock::time_point capture_started)
-    : frame_archive(selection, max_size, capture_started), key_stream(key_stream),
-    ts_corrector(event_queue_size, events_timeout)
+    timestamp_correction_stats* ts_stats,
+    std::chrono::high_resolution_clock::time_point capture_started,
+    uint32_t frames_being_unpacked)
+    : frame_archive(selection, max_size, count_frames_in_transit(selection, event_queue_size->load(), events_timeout->load(), frames_being_unpacked), capture_started), key_stream(key_stream),
+    ts_stats(ts_stats), ts_corrector(event_queue_size, events_timeout, ts_stats)
 {
     // Enumerate all streams we need to keep synchronized with the key stream
     for(auto s : {RS_STREAM_DEPTH, RS_STREAM_INFRARED, RS_STREAM_INFRARED2, RS_STREAM_COLOR, RS_STREAM_FISHEYE})
     {
-        if(is_stream_enabled(s) && s != key_stream) {
+        // Fisheye frames may arrive through the motion module, without a mode of their own
+        if((is_stream_enabled(s) || s == RS_STREAM_FISHEYE) && s != key_stream) {
             other_streams.push_back(s);
         }
-        other_streams.push_back(RS_STREAM_FISHEYE);
     }
 
-    // Allocate an empty image for each stream, and move it to the frontbuffer
+    // Allocate an empty image for each stream, and hand it to the frontbuffer
     // This allows us to assume that get_frame_data/get_frame_timestamp always return valid data
     alloc_frame(key_stream, frame_additional_data(), true);
-    frontbuffer.place_frame(key_stream, std::move(backbuffer[key_stream]));
+    frontbuffer.place_frame(key_stream, detach_backbuffer(key_stream));
     for(auto s : other_streams)
     {
         alloc_frame(s, frame_additional_data(), true);
-        frontbuffer.place_frame(s, std::move(backbuffer[s]));
+        frontbuffer.place_frame(s, detach_backbuffer(s));
     }
 }
 
@@ -72,33 +285,67 @@ long long syncronizing_archive::get_frame_system_time(rs_stream stream) const
     return frontbuffer.get_frame_system_time(stream);
 }
 
+// Block until a frame of the key stream is queued, or the deadline passes
+bool syncronizing_archive::wait_for_key_frame(std::chrono::steady_clock::time_point deadline)
+{
+    const auto ready = [this]() { return !frames[key_stream].empty(); };
+    if(ready()) return true;
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    if(cv.wait_until(lock, deadline, [&]() { return ready() || !capture_error.empty(); }) && ready()) return true;
+    if(!capture_error.empty()) throw std::runtime_error(capture_error);
+    return false;
+}
+
+// Wakes the application thread, whose waits for frames which will never come now throw the error
+void syncronizing_archive::report_capture_error(const std::string & message)
+{
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        capture_error = message;
+    }
+    cv.notify_all();
+}
+
 // Block until the next coherent frameset is available
 void syncronizing_archive::wait_for_frames()
 {
-    std::unique_lock<std::recursive_mutex> lock(mutex);
-    const auto ready = [this]() { return !frames[key_stream].empty(); };
-    if(!ready() && !cv.wait_for(lock, std::chrono::seconds(5), ready)) throw std::runtime_error("Timeout waiting for frames.");
+    if(!wait_for_frames(std::chrono::steady_clock::now() + std::chrono::milliseconds(RS_WAIT_FOR_FRAMES_TIMEOUT))) throw std::runtime_error("Timeout waiting for frames.");
+}
+
+// Block until the next coherent frameset is available and return true, or return false once the deadline passes
+bool syncronizing_archive::wait_for_frames(std::chrono::steady_clock::time_point deadline)
+{
+    if(!wait_for_key_frame(deadline)) return false;
     get_next_frames();
+    return true;
 }
 
 // If a coherent frameset is available, obtain it and return true, otherwise return false immediately
 bool syncronizing_archive::poll_for_frames()
 {
-    // TODO: Implement a user-specifiable timeout for how long to wait before returning false?
-    std::unique_lock<std::recursive_mutex> lock(mutex);
-    if(frames[key_stream].empty()) return false;
+    if(frames[key_stream].empty())
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        if(!capture_error.empty()) throw std::runtime_error(capture_error);
+        return false;
+    }
     get_next_frames();
     return true;
 }
 
 frame_archive::frameset* syncronizing_archive::wait_for_frames_safe()
+{
+    auto result = wait_for_frames_safe(std::chrono::steady_clock::now() + std::chrono::milliseconds(RS_WAIT_FOR_FRAMES_TIMEOUT));
+    if (!result) throw std::runtime_error("Timeout waiting for frames.");
+    return result;
+}
+
+frame_archive::frameset* syncronizing_archive::wait_for_frames_safe(std::chrono::steady_clock::time_point deadline)
 {
     frameset * result = nullptr;
     do
     {
-        std::unique_lock<std::recursive_mutex> lock(mutex);
-        const auto ready = [this]() { return !frames[key_stream].empty(); };
-        if (!ready() && !cv.wait_for(lock, std::chrono::seconds(5), ready)) throw std::runtime_error("Timeout waiting for frames.");
+        if (!wait_for_key_frame(deadline)) return nullptr;
         get_next_frames();
         result = clone_frontbuffer();
     } 
@@ -108,8 +355,6 @@ frame_archive::frameset* syncronizing_archive::wait_for_frames_safe()
 
 bool syncronizing_archive::poll_for_frames_safe(frameset** frameset)
 {
-    // TODO: Implement a user-specifiable timeout for how long to wait before returning false?
-    std::unique_lock<std::recursive_mutex> lock(mutex);
     if (frames[key_stream].empty()) return false;
     get_next_frames();
     auto result = clone_frontbuffer();
@@ -124,6 +369,12 @@ bool syncronizing_archive::poll_for_frames_safe(frameset** frameset)
 // Move frames from the queues to the frontbuffers to form the next coherent frameset
 void syncronizing_archive::get_next_frames()
 {
+    // Producers keep queuing frames meanwhile, they only wait for these locks to drop the oldest frame of a full queue
+    std::unique_lock<std::mutex> locks[RS_STREAM_NATIVE_COUNT];
+    locks[key_stream] = std::unique_lock<std::mutex>(consumer_mutexes[key_stream]);
+    for(auto s : other_streams) locks[s] = std::unique_lock<std::mutex>(consumer_mutexes[s]);
+    cull_frames();
+
     // Always dequeue a frame from the key stream
     dequeue_frame(key_stream);
 
@@ -133,7 +384,7 @@ void syncronizing_archive::get_next_frames()
         if (frames[s].empty())
             continue;
 
-        auto timestamp_of_new_frame = frames[s].front().additional_data.timestamp;
+        auto timestamp_of_new_frame = frames[s].front()->additional_data.timestamp;
         auto timestamp_of_old_frame = frontbuffer.get_frame_timestamp(s);
         auto timestamp_of_key_stream = frontbuffer.get_frame_timestamp(key_stream);
         if ((timestamp_of_new_frame > timestamp_of_key_stream) ||
@@ -144,29 +395,60 @@ void syncronizing_archive::get_next_frames()
     }
 }
 
-// Move a frame from the backbuffer to the back of the queue
+// Hand the frame in the backbuffer to the back of the queue
 void syncronizing_archive::commit_frame(rs_stream stream)
 {
-    std::unique_lock<std::recursive_mutex> lock(mutex);
-    frames[stream].push_back(std::move(backbuffer[stream]));
-    cull_frames();
-    lock.unlock();
-    if(!frames[key_stream].empty()) cv.notify_one();
+    commit_frame(stream, detach_backbuffer(stream));
+}
+
+// Hand a frame released by the timestamp corrector to the back of the queue
+void syncronizing_archive::commit_frame(rs_stream stream, frame * frame)
+{
+    {
+        std::lock_guard<std::mutex> producing(producer_mutexes[stream]);
+        if (!frames[stream].push(std::move(frame)))
+        {
+            // The application fell behind, never keep more than a few frames around in any given stream
+            std::lock_guard<std::mutex> consuming(consumer_mutexes[stream]);
+            if (frames[stream].full()) discard_frame(stream);
+            frames[stream].push(std::move(frame));
+        }
+    }
+    if (stream != key_stream) return;
+    { std::lock_guard<std::mutex> lock(wait_mutex); } // A waiting application thread either saw the frame, or is already waiting for the notification
+    cv.notify_one();
 }
 
 void syncronizing_archive::flush()
 {
+    ts_corrector.flush(); // Frames still waiting for their timestamp are discarded
+    LOG_INFO("Timestamp correction: " << ts_stats->matched << " frames matched, " << ts_stats->late << " late, " << ts_stats->dropped << " dropped");
+    if (framesets)
+    {
+        framesets->flush(); // Frames waiting for a frameset are released before waiting for the application to release its frames
+        auto stats = framesets->get_stats();
+        LOG_INFO("Framesets: " << stats.complete_framesets << " complete, " << stats.incomplete_framesets << " incomplete, " << stats.dropped_framesets << " dropped, "
+                 << stats.dropped_frames << " unmatched frames, sync error " << stats.mean_sync_error << " ms mean, " << stats.max_sync_error << " ms max");
+    }
     frontbuffer.cleanup(); // frontbuffer also holds frame references, since its content is publicly available through get_frame_data
     frame_archive::flush();
 }
 
-bool syncronizing_archive::correct_timestamp(rs_stream stream)
+void syncronizing_archive::correct_timestamp(rs_stream stream)
 {
-    if (is_stream_enabled(stream))
-        {
-           return ts_corrector.correct_timestamp(backbuffer[stream], stream);
-        }
-    return true;
+    auto parked = detach_backbuffer(stream);
+    if (!is_stream_enabled(stream))
+    {
+        if (!deliveries[stream](parked)) recycle_frame(parked);
+        return;
+    }
+
+    // Capturing no more than two pointers, the release function is stored without allocating
+    ts_corrector.correct_timestamp(*parked, stream, [this, parked](bool keep)
+    {
+        if (keep && deliveries[parked->get_stream_type()](parked)) return;
+        recycle_frame(parked); // Also runs the continuation, which hands a zero-copy capture buffer back to the driver
+    });
 }
 
 void syncronizing_archive::on_timestamp(rs_timestamp_data data)
@@ -179,18 +461,9 @@ int syncronizing_archive::get_frame_stride(rs_stream stream) const
     return frontbuffer.get_frame_stride(stream);
 }
 
-// Discard all frames which are older than the most recent coherent frameset
+// Discard all frames which are older than the most recent coherent frameset. Called with the consumer mutexes of all streams held.
 void syncronizing_archive::cull_frames()
 {
-    // Never keep more than four frames around in any given stream, regardless of timestamps
-    for(auto s : {RS_STREAM_DEPTH, RS_STREAM_COLOR, RS_STREAM_INFRARED, RS_STREAM_INFRARED2, RS_STREAM_FISHEYE})
-    {
-        while(frames[s].size() > 4)
-        {
-            discard_frame(s);
-        }
-    }
-
     // Cannot do any culling unless at least one frame is enqueued for each enabled stream    
     if(frames[key_stream].empty()) return;
     for(auto s : other_streams) if(frames[s].empty()) return;
@@ -199,12 +472,12 @@ void syncronizing_archive::cull_frames()
     while(true)
     {
         if(frames[key_stream].size() < 2) break;
-        const double t0 = frames[key_stream][0].additional_data.timestamp, t1 = frames[key_stream][1].additional_data.timestamp;
+        const double t0 = frames[key_stream][0]->additional_data.timestamp, t1 = frames[key_stream][1]->additional_data.timestamp;
 
         bool valid_to_skip = true;
         for(auto s : other_streams)
         {
-            if (std::fabs(t0 - frames[s].back().additional_data.timestamp) < std::fabs(t1 - frames[s].back().additional_data.timestamp))
+            if (std::fabs(t0 - frames[s].back()->additional_data.timestamp) < std::fabs(t1 - frames[s].back()->additional_data.timestamp))
             {
                 valid_to_skip = false;
                 break;
@@ -221,33 +494,33 @@ void syncronizing_archive::cull_frames()
         while(true)
         {
             if(frames[s].size() < 2) break;
-            const double t0 = frames[s][0].additional_data.timestamp, t1 = frames[s][1].additional_data.timestamp;
+            const double t0 = frames[s][0]->additional_data.timestamp, t1 = frames[s][1]->additional_data.timestamp;
 
-            if (std::fabs(t0 - frames[key_stream].front().additional_data.timestamp) < std::fabs(t1 - frames[key_stream].front().additional_data.timestamp)) break;
+            if (std::fabs(t0 - frames[key_stream].front()->additional_data.timestamp) < std::fabs(t1 - frames[key_stream].front()->additional_data.timestamp)) break;
             discard_frame(s);
         }
     }
 }
 
-// Move a single frame from the head of the queue to the front buffer, while recycling the front buffer into the freelist
+// Hand a single frame from the head of the queue to the front buffer, while recycling the front buffer into the buffer pool
 void syncronizing_archive::dequeue_frame(rs_stream stream)
 {
-    auto & frame = frames[stream].front();
+    auto frame = frames[stream].front();
+    frames[stream].pop_front();
     
     // Log callback started
     auto callback_start_time = std::chrono::high_resolution_clock::now();
-    frame.update_frame_callback_start_ts(callback_start_time);
+    frame->update_frame_callback_start_ts(callback_start_time);
     auto ts = std::chrono::duration_cast<std::chrono::milliseconds>(callback_start_time - capture_started).count();
-    LOG_DEBUG("CallbackStarted," << rsimpl::get_string(frame.get_stream_type()) << "," << frame.get_frame_number() << ",DispatchedAt," << ts);
+    LOG_DEBUG("CallbackStarted," << rsimpl::get_string(frame->get_stream_type()) << "," << frame->get_frame_number() << ",DispatchedAt," << ts);
 
-    frontbuffer.place_frame(stream, std::move(frames[stream].front())); // the frame will move to free list once there are no external references to it
-    frames[stream].erase(begin(frames[stream]));
+    frontbuffer.place_frame(stream, frame); // the frame will return to the buffer pool once there are no external references to it
 }
 
-// Move a single frame from the head of the queue directly to the freelist
+// Hand a single frame from the head of the queue directly back to the pools
 void syncronizing_archive::discard_frame(rs_stream stream)
 {
-    std::lock_guard<std::recursive_mutex> guard(mutex);
-    freelist.push_back(std::move(frames[stream].front()));
-    frames[stream].erase(begin(frames[stream]));
+    auto frame = frames[stream].front();
+    frames[stream].pop_front();
+    recycle_frame(frame);
 }
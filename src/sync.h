@@ -7,10 +7,66 @@
 
 #include "archive.h"
 #include <atomic>
+#include <deque>
 #include "timestamps.h"
 
 namespace rsimpl
 {
+    // Matches the frames of several streams into framesets by their timestamps. Two frames may belong to the same frameset
+    // if their timestamps are in the same domain and no further apart than the tolerance of their pair of streams. Each
+    // frameset is built around a frame of the key stream, and waits for the other streams according to the policy.
+    // Frames may be added from any thread. Framesets are handed over in the order of the key stream on a dispatch thread
+    // of their own, so that a slow frameset handler holds up neither capture nor the matching of later frames.
+    class frameset_synchronizer
+    {
+    public:
+        typedef std::function<void(std::vector<rs_frame_ref *> & frames)> frameset_handler;   // Takes ownership of the frames
+        typedef std::function<void(rs_frame_ref * frame)> frame_release;
+
+        static const size_t max_queued_frames = 8;  // Per stream, frames beyond are dropped oldest first
+        static const size_t max_key_frames_ahead = 2; // Framesets stop waiting for a stream once this many newer key frames arrived, unless the policy is to wait
+        static const size_t max_ready_framesets = 4; // Framesets beyond, not yet taken by the dispatch thread, are dropped oldest first
+
+        frameset_synchronizer(const std::vector<rs_stream> & streams, rs_stream key_stream, const double (&tolerances)[RS_STREAM_NATIVE_COUNT][RS_STREAM_NATIVE_COUNT],
+                              rs_frameset_policy policy, frameset_handler on_frameset, frame_release release);
+        ~frameset_synchronizer();
+
+        bool is_synchronized(rs_stream stream) const { return stream < RS_STREAM_NATIVE_COUNT && synchronized[stream]; }
+        void add(rs_frame_ref * frame);
+        void flush(); // Waits for the frameset being handed over, and releases the frames of all others
+        rs_frameset_stats get_stats() const;
+
+    private:
+        struct queued_frame
+        {
+            rs_frame_ref * ref;
+            double timestamp;
+            rs_timestamp_domain domain;
+        };
+
+        void match(std::vector<rs_frame_ref *> & discarded);
+        void dispatch_framesets();
+
+        // This data will be left constant after creation
+        bool synchronized[RS_STREAM_NATIVE_COUNT];
+        rs_stream key_stream;
+        std::vector<rs_stream> other_streams;
+        double tolerances[RS_STREAM_NATIVE_COUNT][RS_STREAM_NATIVE_COUNT];
+        rs_frameset_policy policy;
+        frameset_handler on_frameset;
+        frame_release release;
+
+        // This data will be read and written by all threads, and synchronized with a mutex
+        mutable std::mutex mutex;
+        std::deque<queued_frame> queues[RS_STREAM_NATIVE_COUNT];
+        rs_frameset_stats stats;
+        double total_sync_error;
+        std::deque<std::vector<rs_frame_ref *>> ready;  // Matched framesets, in order, for the dispatch thread to hand over
+        bool dispatching, stopping;
+        std::condition_variable cv, idle;
+        std::thread dispatcher;
+    };
+
     class syncronizing_archive : public frame_archive
     {
     private:
@@ -22,29 +78,42 @@ namespace rsimpl
         // This data will be read and written exclusively from the application thread
         frameset frontbuffer;
 
-        // This data will be read and written by all threads, and synchronized with a mutex
-        std::vector<frame> frames[RS_STREAM_NATIVE_COUNT];
-        std::condition_variable_any cv;
-        
+        // Each stream queues its frames on its own, so that producers of different streams never contend. The application thread
+        // takes frames out under the consumer mutex of their stream, which producers only take to drop the oldest frame of a full queue.
+        spsc_queue<frame *, RS_MAX_QUEUED_FRAMES> frames[RS_STREAM_NATIVE_COUNT];
+        std::mutex producer_mutexes[RS_STREAM_NATIVE_COUNT]; // Serializes the rare concurrent producers of a stream, like the capture and timestamp correction threads
+        std::mutex consumer_mutexes[RS_STREAM_NATIVE_COUNT];
+        std::mutex wait_mutex;
+        std::condition_variable cv;
+        std::string capture_error;      // Set under wait_mutex once capturing has stopped on an error, which waiting for frames then throws
+
+        bool wait_for_key_frame(std::chrono::steady_clock::time_point deadline);
         void get_next_frames();
         void dequeue_frame(rs_stream stream);
         void discard_frame(rs_stream stream);
         void cull_frames();
 
-        timestamp_corrector            ts_corrector;
+        std::shared_ptr<frameset_synchronizer> framesets;
+        std::function<bool(frame *)> deliveries[RS_STREAM_NATIVE_COUNT];
+        timestamp_correction_stats*    ts_stats;
+        timestamp_corrector            ts_corrector; // Declared last, so that it stops releasing frames before the rest of the archive goes away
     public:
         syncronizing_archive(const std::vector<subdevice_mode_selection> & selection, 
             rs_stream key_stream, 
             std::atomic<uint32_t>* max_size,
             std::atomic<uint32_t>* event_queue_size,
             std::atomic<uint32_t>* events_timeout,
-            std::chrono::high_resolution_clock::time_point capture_started = std::chrono::high_resolution_clock::now());
+            timestamp_correction_stats* ts_stats,
+            std::chrono::high_resolution_clock::time_point capture_started = std::chrono::high_resolution_clock::now(),
+            uint32_t frames_being_unpacked = 0); // Frames per stream which worker threads may be unpacking at once
         
-        // Application thread API
+        // Application thread API. The variants taking a deadline return false or nullptr once it passes, the others throw after RS_WAIT_FOR_FRAMES_TIMEOUT.
         void wait_for_frames();
+        bool wait_for_frames(std::chrono::steady_clock::time_point deadline);
         bool poll_for_frames();
 
         frameset * wait_for_frames_safe();
+        frameset * wait_for_frames_safe(std::chrono::steady_clock::time_point deadline);
         bool poll_for_frames_safe(frameset ** frames);
 
         double get_frame_metadata(rs_stream stream, rs_frame_metadata frame_metadata) const;
@@ -60,12 +129,23 @@ namespace rsimpl
 
         // Frame callback thread API
         void commit_frame(rs_stream stream);
+        void commit_frame(rs_stream stream, frame * frame); // Takes over the frame
 
         void flush() override;
+        void report_capture_error(const std::string & message);
 
-        bool correct_timestamp(rs_stream stream);
+        // Sets where the frames of a stream go once their timestamps are corrected, possibly on another thread. Set before capturing.
+        // deliver returns false if it did not take over the frame, which then goes back to the pools.
+        void set_frame_delivery(rs_stream stream, std::function<bool(frame *)> deliver) { deliveries[stream] = std::move(deliver); }
+        // Takes the frame out of the backbuffer and delivers it once its timestamp is corrected
+        void correct_timestamp(rs_stream stream);
         void on_timestamp(rs_timestamp_data data);
 
+        // Frames reaching the archive are matched into framesets once a synchronizer is set, rather than committed for wait_for_frames
+        void set_frameset_synchronizer(std::shared_ptr<frameset_synchronizer> synchronizer) { framesets = std::move(synchronizer); }
+        bool synchronizes(rs_stream stream) const { return framesets && framesets->is_synchronized(stream); }
+        void add_to_frameset(frame_ref * frame) { framesets->add(frame); }
+
     };
 }
 
@@ -0,0 +1,143 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#include "thread-pool.h"
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace rsimpl;
+
+thread_pool::thread_pool(int thread_count) : busy_workers(0), stopping(false)
+{
+    for (int i = 0; i < thread_count; ++i)
+    {
+        workers.push_back(std::thread([this]() { run_worker(); }));
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_available.notify_all();
+    for (auto & worker : workers) worker.join();
+}
+
+void thread_pool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    task_available.notify_one();
+}
+
+void thread_pool::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return tasks.empty() && busy_workers == 0; });
+}
+
+void thread_pool::parallel_for(int count, const std::function<void(int)> & task)
+{
+    struct batch
+    {
+        std::atomic<int> next_index;
+        int remaining;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<batch>();
+    state->next_index = 0;
+    state->remaining = count;
+
+    // Workers and the caller claim indices until none are left, helpers that start after the batch is finished return immediately
+    auto run = [state, count, &task]()
+    {
+        for (int i = state->next_index++; i < count; i = state->next_index++)
+        {
+            std::exception_ptr error;
+            try { task(i); }
+            catch (...) { error = std::current_exception(); }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (error && !state->error) state->error = error;
+            if (--state->remaining == 0) state->done.notify_all();
+        }
+    };
+
+    const int helpers = std::min(count - 1, get_thread_count());
+    for (int i = 0; i < helpers; ++i) submit(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&state]() { return state->remaining == 0; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+void thread_pool::run_worker()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        task_available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+        if (tasks.empty()) return; // Only reached once stopping
+
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        ++busy_workers;
+        lock.unlock();
+
+        try
+        {
+            task();
+        }
+        catch (const std::exception & e)
+        {
+            LOG_ERROR("Worker task failed: " << e.what());
+        }
+
+        lock.lock();
+        if (--busy_workers == 0 && tasks.empty()) idle.notify_all();
+    }
+}
+
+uint64_t ordered_dispatcher::issue_ticket()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return next_ticket++;
+}
+
+void ordered_dispatcher::complete(uint64_t ticket, std::function<void()> completion)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    ready[ticket] = std::move(completion);
+
+    // Whichever thread finds the queue idle drains every completion that has become eligible, so order is kept without blocking
+    if (running) return;
+    running = true;
+    for (auto it = ready.find(next_to_run); it != ready.end(); it = ready.find(next_to_run))
+    {
+        auto next = std::move(it->second);
+        ready.erase(it);
+        ++next_to_run;
+        lock.unlock();
+
+        try
+        {
+            if (next) next();
+        }
+        catch (const std::exception & e)
+        {
+            LOG_ERROR("Ordered completion failed: " << e.what());
+        }
+
+        lock.lock();
+    }
+    running = false;
+}
@@ -0,0 +1,62 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#pragma once
+#ifndef LIBREALSENSE_THREAD_POOL_H
+#define LIBREALSENSE_THREAD_POOL_H
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsimpl
+{
+    // A fixed set of worker threads executing submitted tasks in FIFO order
+    class thread_pool
+    {
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable task_available, idle;
+        int busy_workers;
+        bool stopping;
+
+        void run_worker();
+    public:
+        explicit thread_pool(int thread_count);
+        ~thread_pool(); // Runs all queued tasks before joining the workers
+        thread_pool(const thread_pool &) = delete;
+        thread_pool & operator=(const thread_pool &) = delete;
+
+        int get_thread_count() const { return static_cast<int>(workers.size()); }
+        void submit(std::function<void()> task);
+        void wait_idle(); // Blocks until no task is queued or running
+
+        // Runs task(0) to task(count - 1) on the workers and the calling thread, returning once all have finished. Unlike wait_idle,
+        // this only waits for its own tasks, so several threads may share the pool. The first exception thrown by a task is rethrown.
+        void parallel_for(int count, const std::function<void(int)> & task);
+    };
+
+    // Runs completions in the order their tickets were issued, regardless of the order in which the work finishes.
+    // Completions are never run concurrently, each one runs on the thread that made it eligible.
+    class ordered_dispatcher
+    {
+        std::mutex mutex;
+        uint64_t next_ticket, next_to_run;
+        std::map<uint64_t, std::function<void()>> ready;
+        bool running;
+    public:
+        ordered_dispatcher() : next_ticket(0), next_to_run(0), running(false) {}
+
+        uint64_t issue_ticket();
+        void complete(uint64_t ticket, std::function<void()> completion); // Every issued ticket must be completed, possibly with an empty function
+    };
+}
+
+#endif
@@ -7,99 +7,82 @@ using namespace rsimpl;
 using namespace std;
 
 
-concurrent_queue::concurrent_queue() {
-    for (int i =0; i < RS_STREAM_COUNT; i++) {
-        latest_timestamps[i] = -1;
-    }
-}
-
-void concurrent_queue::push_back_data(rs_timestamp_data data)
-{
-    lock_guard<mutex> lock(mtx);
-
-    data_queue.push_back(data);
-}
-
-bool concurrent_queue::pop_front_data()
-{
-    lock_guard<mutex> lock(mtx);
-
-    if (!data_queue.size())
-        return false;
-
-    data_queue.pop_front();
-
-    return true;
-}
-
-bool concurrent_queue::erase(rs_timestamp_data data)
+timestamp_ring::timestamp_ring()
+    : latest(0)
 {
-    lock_guard<mutex> lock(mtx);
-
-    auto it = find_if(data_queue.begin(), data_queue.end(),
-                      [&](const rs_timestamp_data& element) {
-        return (data.frame_number == element.frame_number);
-    });
-
-    if (it != data_queue.end())
+    for (auto & s : slots)
     {
-        data_queue.erase(it);
-        return true;
+        s.tag = 0;
+        s.timestamp = 0;
     }
-
-    return false;
 }
 
-size_t concurrent_queue::size()
+// Writes the slot like a seqlock, invalidating its tag while the timestamp changes, so that readers never mix a frame
+// number with the timestamp of another frame
+void timestamp_ring::push(const rs_timestamp_data & data)
 {
-    lock_guard<mutex> lock(mtx);
-
-    return data_queue.size();
+    auto & s = slots[data.frame_number & (capacity - 1)];
+    s.tag.store(0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s.timestamp.store(data.timestamp, memory_order_relaxed);
+    s.tag.store(data.frame_number + 1, memory_order_release);
+    latest.store(data.frame_number, memory_order_release);
 }
 
-bool concurrent_queue::correct( frame_interface& frame)
+bool timestamp_ring::find(unsigned long long frame_number, double & timestamp, uint32_t depth) const
 {
-    lock_guard<mutex> lock(mtx);
-
-    auto it = find_if(data_queue.begin(), data_queue.end(),
-                      [&](const rs_timestamp_data& element) {
-        return ((frame.get_frame_number() == element.frame_number));
-    });
-
-
-    if (it != data_queue.end())
-    {
-        if(latest_timestamps[frame.get_stream_type()] != -1 && it->timestamp < latest_timestamps[frame.get_stream_type()]) {
-            std::cout << "dropping in order" << std::endl;
-            return false;
-        }
-        double ts = it->timestamp;
-        frame.set_timestamp(ts);
-        latest_timestamps[frame.get_stream_type()] = ts;
-        return true;
-    }
+    // Frame numbers are compared modulo 2^64, so that lookups keep working across a wraparound of the counter. A counter which
+    // restarts from a lower number makes the timestamps of the frames numbered above it look too old, rather than current.
+    if (latest.load(memory_order_acquire) - frame_number >= min<unsigned long long>(depth, capacity))
+        return false;
 
-    return false;
+    auto & s = slots[frame_number & (capacity - 1)];
+    if (s.tag.load(memory_order_acquire) != frame_number + 1)
+        return false;
+    timestamp = s.timestamp.load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    return s.tag.load(memory_order_relaxed) == frame_number + 1;
 }
 
-timestamp_corrector::timestamp_corrector(std::atomic<uint32_t>* queue_size, std::atomic<uint32_t>* timeout)
-    :event_queue_size(queue_size), events_timeout(timeout)
+timestamp_corrector::timestamp_corrector(std::atomic<uint32_t>* queue_size, std::atomic<uint32_t>* timeout, timestamp_correction_stats* stats)
+    :releasing(false), stopping(false), event_queue_size(queue_size), events_timeout(timeout), stats(stats)
 {
+    for (auto & received : timestamps_received) received = false;
+    for (auto & timestamp : latest_timestamps) timestamp = -1;
+    worker = std::thread([this]() { release_frames(); });
 }
 
 timestamp_corrector::~timestamp_corrector()
 {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+    flush();
 }
 
 void timestamp_corrector::on_timestamp(rs_timestamp_data data)
 {
+    timestamps[data.source_id].push(data); // Visible to lookups right away, parked frames are matched under the lock below
+
     lock_guard<mutex> lock(mtx);
-    if (data_queue[data.source_id].size() <= event_queue_size->load())
-        data_queue[data.source_id].push_back_data(data);
-    if (data_queue[data.source_id].size() > event_queue_size->load())
-        data_queue[data.source_id].pop_front_data();
+    timestamps_received[data.source_id] = true;
 
+    auto & frames = pending[data.source_id];
+    auto matched = frames.equal_range(data.frame_number);
+    if (matched.first == matched.second)
+        return;
 
+    for (auto it = matched.first; it != matched.second; it = frames.erase(it))
+    {
+        // Timestamps arrive in frame order, so frames parked before this one will not be matched anymore
+        release_earlier_frames(frames, it->second.stream, data.frame_number);
+        auto keep = apply_timestamp(*it->second.frame, it->second.stream, data.timestamp);
+        ready.emplace_back(std::move(it->second.release), keep);
+    }
+    cv.notify_one();
 }
 
 void timestamp_corrector::update_source_id(rs_event_source& source_id, const rs_stream stream)
@@ -120,24 +103,150 @@ void timestamp_corrector::update_source_id(rs_event_source& source_id, const rs_
     }
 }
 
-bool timestamp_corrector::correct_timestamp(frame_interface& frame, rs_stream stream)
+// Returns false if the timestamp would take the stream back in time, in which case the frame has to be discarded
+bool timestamp_corrector::apply_timestamp(frame_interface& frame, rs_stream stream, double timestamp)
 {
+    if (latest_timestamps[stream] != -1 && timestamp < latest_timestamps[stream])
+    {
+        LOG_DEBUG("Dropping frame " << frame.get_frame_number() << " of " << stream << ", its timestamp precedes the previous frame");
+        ++stats->dropped;
+        return false;
+    }
 
+    frame.set_timestamp(timestamp);
+    frame.set_timestamp_domain(RS_TIMESTAMP_DOMAIN_MICROCONTROLLER);
+    latest_timestamps[stream] = timestamp;
+    ++stats->matched;
+    return true;
+}
+
+// Queues the frames of a stream which were parked before the given frame number for release with their camera timestamps
+void timestamp_corrector::release_earlier_frames(pending_map & frames, rs_stream stream, unsigned long long frame_number)
+{
+    for (auto it = frames.begin(); it != frames.end() && it->first < frame_number;)
+    {
+        if (it->second.stream != stream)
+        {
+            ++it;
+            continue;
+        }
+        ++stats->late;
+        ready.emplace_back(std::move(it->second.release), true);
+        it = frames.erase(it);
+    }
+}
 
-    bool res = false;
+void timestamp_corrector::correct_timestamp(frame_interface& frame, rs_stream stream, frame_release release)
+{
     rs_event_source source_id;
     update_source_id(source_id, stream);
+    const auto frame_number = frame.get_frame_number();
+    const auto depth = event_queue_size->load();
+    double timestamp;
+    auto found = timestamps[source_id].find(frame_number, timestamp, depth);
+
+    // Look again under the lock if the timestamp was missing, since on_timestamp only matches frames which are already parked
     unique_lock<mutex> lock(mtx);
+    auto & frames = pending[source_id];
+    bool keep = true;
+    if (found || timestamps[source_id].find(frame_number, timestamp, depth))
+    {
+        release_earlier_frames(frames, stream, frame_number);
+        keep = apply_timestamp(frame, stream, timestamp);
+    }
+    else if (timestamps_received[source_id])
+    {
+        // Park the frame until its timestamp arrives, making room by giving up on the oldest frame if too many are waiting
+        if (!frames.empty() && frames.size() >= event_queue_size->load())
+        {
+            ++stats->late;
+            ready.emplace_back(std::move(frames.begin()->second.release), true);
+            frames.erase(frames.begin());
+        }
+        frames.emplace(frame_number, pending_frame{ &frame, stream, std::chrono::steady_clock::now() + std::chrono::milliseconds(events_timeout->load()), std::move(release) });
+        cv.notify_one();
+        return;
+    }
+    else
+    {
+        ++stats->late; // This source never reported a timestamp, there is no point in waiting for one
+    }
 
-    if (!(res = data_queue[source_id].correct(frame)))
+    // Release the frame right away, unless earlier frames are still on their way out through the correction thread
+    if (ready.empty() && !releasing)
     {
-        const auto ready = [&]() { return data_queue[source_id].correct(frame); };
-        res = cv.wait_for(lock,std::chrono::milliseconds(*events_timeout),ready);
+        lock.unlock();
+        release(keep);
+        return;
+    }
+    ready.emplace_back(std::move(release), keep);
+    cv.notify_one();
+}
 
+void timestamp_corrector::release_frames()
+{
+    unique_lock<mutex> lock(mtx);
+    while (true)
+    {
+        // Frames past their deadline stop waiting and keep their camera timestamp
+        const auto now = std::chrono::steady_clock::now();
+        auto next_deadline = std::chrono::steady_clock::time_point::max();
+        for (auto & frames : pending)
+        {
+            for (auto it = frames.begin(); it != frames.end();)
+            {
+                if (it->second.deadline > now)
+                {
+                    next_deadline = std::min(next_deadline, it->second.deadline);
+                    ++it;
+                    continue;
+                }
+                release_earlier_frames(frames, it->second.stream, it->first);
+                ++stats->late;
+                ready.emplace_back(std::move(it->second.release), true);
+                it = frames.erase(it);
+            }
+        }
+
+        if (!ready.empty())
+        {
+            // Frame callbacks run without the lock, so that they may take as long as they need
+            auto batch = std::move(ready);
+            ready.clear();
+            releasing = true;
+            lock.unlock();
+            for (auto & frame : batch)
+            {
+                try { frame.first(frame.second); }
+                catch (const std::exception & e) { LOG_ERROR("Releasing a frame after timestamp correction failed: " << e.what()); }
+            }
+            batch.clear();
+            lock.lock();
+            releasing = false;
+            idle.notify_all();
+            continue;
+        }
+
+        if (stopping) return;
+        if (next_deadline == std::chrono::steady_clock::time_point::max()) cv.wait(lock);
+        else cv.wait_until(lock, next_deadline);
     }
-    if (res) {
-        frame.set_timestamp_domain(RS_TIMESTAMP_DOMAIN_MICROCONTROLLER);
+}
+
+void timestamp_corrector::flush()
+{
+    std::vector<frame_release> discarded;
+    {
+        unique_lock<mutex> lock(mtx);
+        idle.wait(lock, [this]() { return !releasing; });
+        for (auto & frame : ready) discarded.push_back(std::move(frame.first));
+        ready.clear();
+        for (auto & frames : pending)
+        {
+            for (auto & frame : frames) discarded.push_back(std::move(frame.second.release));
+            frames.clear();
+        }
     }
-    return res;
-    
+    stats->dropped += static_cast<uint32_t>(discarded.size());
+    for (auto & release : discarded) release(false);
 }
@@ -3,10 +3,14 @@
 #define LIBREALSENSE_TIMESTAMPS_H
 
 #include "../include/librealsense/rs.h"     // Inherit all type definitions in the public API
-#include <deque>
 #include <condition_variable>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
 
 
 namespace rsimpl
@@ -23,50 +27,88 @@ namespace rsimpl
     };
 
 
-    class concurrent_queue{
+    // Fixed capacity ring of the latest timestamps of an event source, indexed by frame number. A single thread pushes
+    // timestamps, while any thread may look them up without locking. Only the timestamps of the latest depth frame numbers
+    // can be found, with depth capped by the capacity of the ring.
+    class timestamp_ring{
     public:
-        concurrent_queue();
-        void    push_back_data(rs_timestamp_data data);
-        bool    pop_front_data();
-        bool    erase(rs_timestamp_data data);
-        bool    correct(frame_interface& frame);
-        size_t  size();
-
-        private:
-        std::deque<rs_timestamp_data> data_queue;
-        std::mutex mtx;
-        double latest_timestamps[RS_STREAM_COUNT];
+        timestamp_ring();
+        void    push(const rs_timestamp_data & data);
+        bool    find(unsigned long long frame_number, double & timestamp, uint32_t depth) const;
+
+        static const size_t capacity = 512; // A power of two, at least RS_MAX_EVENT_QUEUE_SIZE
+
+    private:
+        struct slot
+        {
+            std::atomic<unsigned long long> tag;    // Frame number plus one, or zero while the slot is being written
+            std::atomic<double> timestamp;
+        };
+        slot slots[capacity];
+        std::atomic<unsigned long long> latest;     // Frame number of the last pushed timestamp
+    };
 
+    // Outcome of timestamp correction, accumulated over the lifetime of a device
+    struct timestamp_correction_stats
+    {
+        std::atomic<uint32_t> matched;  // Frames released with the timestamp reported by the motion module
+        std::atomic<uint32_t> late;     // Frames released with their camera timestamp, since no timestamp matched them before their deadline
+        std::atomic<uint32_t> dropped;  // Frames discarded, since the timestamp they matched was older than the last one of their stream
 
+        timestamp_correction_stats() : matched(0), late(0), dropped(0) {}
     };
 
+    // Hands a parked frame on when called with true, or discards it when called with false
+    typedef std::function<void(bool)> frame_release;
+
     class timestamp_corrector_interface{
     public:
         virtual ~timestamp_corrector_interface() {}
         virtual void on_timestamp(rs_timestamp_data data) = 0;
-        virtual bool correct_timestamp(frame_interface& frame, rs_stream stream) = 0;
+        virtual void correct_timestamp(frame_interface& frame, rs_stream stream, frame_release release) = 0;
         virtual void release() = 0;
     };
 
-
+    // Corrects frame timestamps without blocking the capture thread. A frame whose timestamp has not arrived yet is parked until
+    // on_timestamp delivers it or events_timeout milliseconds pass, and is then released on a thread owned by the corrector.
     class timestamp_corrector : public timestamp_corrector_interface{
     public:
-        timestamp_corrector(std::atomic<uint32_t>* event_queue_size, std::atomic<uint32_t>* events_timeout);
+        timestamp_corrector(std::atomic<uint32_t>* event_queue_size, std::atomic<uint32_t>* events_timeout, timestamp_correction_stats* stats);
         ~timestamp_corrector() override;
         void on_timestamp(rs_timestamp_data data) override;
-        bool correct_timestamp(frame_interface& frame, rs_stream stream) override;
+        void correct_timestamp(frame_interface& frame, rs_stream stream, frame_release release) override; // release must own frame
         void release() override  {delete this;}
 
+        void flush(); // Discards all parked frames, and waits until no frame is being released
+
 
     private:
+        struct pending_frame
+        {
+            frame_interface * frame;
+            rs_stream stream;
+            std::chrono::steady_clock::time_point deadline;
+            frame_release release;
+        };
+        typedef std::multimap<unsigned long long, pending_frame> pending_map;
+
         void update_source_id(rs_event_source& source_id, const rs_stream stream);
+        bool apply_timestamp(frame_interface& frame, rs_stream stream, double timestamp);
+        void release_earlier_frames(pending_map & frames, rs_stream stream, unsigned long long frame_number);
+        void release_frames();
 
         std::mutex mtx;
-        concurrent_queue data_queue[RS_EVENT_SOURCE_COUNT];
-        std::condition_variable cv;
+        timestamp_ring timestamps[RS_EVENT_SOURCE_COUNT];
+        pending_map pending[RS_EVENT_SOURCE_COUNT];                     // Parked frames of each source, keyed by frame number
+        bool timestamps_received[RS_EVENT_SOURCE_COUNT];
+        double latest_timestamps[RS_STREAM_COUNT];
+        std::vector<std::pair<frame_release, bool>> ready;              // Frames to release on the correction thread, in order
+        bool releasing, stopping;
+        std::condition_variable cv, idle;
         std::atomic<uint32_t>* event_queue_size;
         std::atomic<uint32_t>* events_timeout;
-
+        timestamp_correction_stats* stats;
+        std::thread worker;
     };
 
 
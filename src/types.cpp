@@ -4,6 +4,7 @@
 #include "types.h"
 #include "image.h"
 #include "device.h"
+#include "depth-codec.h"
 
 #include <cstring>
 #include <algorithm>
@@ -57,6 +58,8 @@ namespace rsimpl
         CASE(RAW10)
         CASE(RAW16)
         CASE(RAW8)
+        CASE(Z16_COMPRESSED)
+        CASE(DISPARITY16_COMPRESSED)
         default: assert(!is_valid(value)); return unknown;
         }
         #undef CASE
@@ -156,6 +159,19 @@ namespace rsimpl
         CASE(FISHEYE_EXTERNAL_TRIGGER)
         CASE(FRAMES_QUEUE_SIZE)
         CASE(TOTAL_FRAME_DROPS)
+        CASE(ZERO_COPY_ENABLED)
+        CASE(CAPTURE_RING_DEPTH)
+        CASE(CAPTURE_THREAD_PER_SUBDEVICE)
+        CASE(CAPTURE_THREAD_AFFINITY)
+        CASE(CAPTURE_THREAD_PRIORITY)
+        CASE(CAPTURE_QUEUE_SIZE)
+        CASE(UNPACK_THREADS)
+        CASE(UNPACK_ROW_BANDS)
+        CASE(PROCESSING_THREADS)
+        CASE(TIMESTAMPS_MATCHED)
+        CASE(TIMESTAMPS_LATE)
+        CASE(TIMESTAMPS_DROPPED)
+        CASE(COMPRESS_RECORDED_DEPTH)
         CASE(FISHEYE_ENABLE_AUTO_EXPOSURE)
         CASE(FISHEYE_AUTO_EXPOSURE_MODE)
         CASE(FISHEYE_AUTO_EXPOSURE_ANTIFLICKER_RATE)
@@ -272,6 +288,32 @@ namespace rsimpl
         #undef CASE
     }
 
+    const char * get_string(rs_frameset_policy value)
+    {
+        #define CASE(X) case RS_FRAMESET_POLICY_##X: return #X;
+        switch (value)
+        {
+        CASE(WAIT)
+        CASE(EMIT_INCOMPLETE)
+        CASE(DROP)
+        default: assert(!is_valid(value)); return unknown;
+        }
+        #undef CASE
+    }
+
+    const char * get_string(rs_playback_mode value)
+    {
+        #define CASE(X) case RS_PLAYBACK_MODE_##X: return #X;
+        switch (value)
+        {
+        CASE(REAL_TIME)
+        CASE(FAST)
+        CASE(STEPPED)
+        default: assert(!is_valid(value)); return unknown;
+        }
+        #undef CASE
+    }
+
     size_t subdevice_mode_selection::get_image_size(rs_stream stream) const
     {
         return rsimpl::get_image_size(get_width(), get_height(), get_format(stream));
@@ -282,7 +324,18 @@ namespace rsimpl
         output_format = in_output_format;
     }
 
-    void subdevice_mode_selection::unpack(byte * const dest[], const byte * source) const
+    bool subdevice_mode_selection::is_compressed() const
+    {
+        const auto & outputs = get_outputs();
+        return outputs.size() == 1 && is_compressed_format(outputs[0].second);
+    }
+
+    void subdevice_mode_selection::unpack(byte * const dest[], const byte * source, std::vector<uint16_t> * row_buffer) const
+    {
+        unpack(dest, source, 0, get_unpacked_height(), row_buffer);
+    }
+
+    void subdevice_mode_selection::unpack(byte * const dest[], const byte * source, int first_row, int row_count, std::vector<uint16_t> * row_buffer) const
     {
         const int MAX_OUTPUTS = 2;
         const auto & outputs = get_outputs();        
@@ -303,8 +356,40 @@ namespace rsimpl
             if(pad_crop > 0) out[i] += out_stride[i] * pad_crop + rsimpl::get_image_size(pad_crop, 1, outputs[i].second);
         }
 
+        // Skip to the requested band. Planar formats can only be unpacked as a whole.
+        const int unpack_width = get_unpacked_width(), unpack_height = std::min(row_count, get_unpacked_height() - first_row);
+        if(first_row > 0)
+        {
+            assert(can_unpack_rows());
+            in += in_stride * first_row;
+            for(size_t i=0; i<outputs.size(); ++i) out[i] += out_stride[i] * first_row;
+        }
+
+        // Compressed outputs are unpacked one row at a time into a small buffer, padding included, and fed to the depth codec
+        if(is_compressed())
+        {
+            assert(first_row == 0 && unpack_height == get_unpacked_height());
+            const int width = get_width(), height = get_height(), pad = std::max(pad_crop, 0);
+            std::vector<uint16_t> own_row;
+            auto & row = row_buffer ? *row_buffer : own_row;
+            row.assign(width, 0); // Keeps the capacity of a reused buffer
+            byte * row_out[] = { reinterpret_cast<byte *>(row.data() + pad) };
+            depth_codec::encoder encoder(dest[0]);
+            for(int y=0; y<height; ++y)
+            {
+                if(y >= pad && y - pad < unpack_height)
+                {
+                    mode.pf.unpackers[unpacker_index].unpack(row_out, in, unpack_width);
+                    in += in_stride;
+                }
+                else std::fill(row.begin(), row.end(), 0);
+                encoder.append(row.data(), width);
+            }
+            encoder.finish();
+            return;
+        }
+
         // Unpack (potentially a subrect of) the source image into (potentially a subrect of) the destination buffers
-        const int unpack_width = get_unpacked_width(), unpack_height = get_unpacked_height();
         if(mode.native_dims.x == get_width())
         {
             // If not strided, unpack as though it were a single long row
@@ -354,7 +439,7 @@ namespace rsimpl
         return width != 0 && height != 0 && format != RS_FORMAT_ANY && fps != 0;
     }
 
-    static_device_info::static_device_info() : num_libuvc_transfer_buffers(1), nominal_depth_scale(0.001f)
+    static_device_info::static_device_info() : num_libuvc_transfer_buffers(1), nominal_depth_scale(0.001f), supported_metadata(0)
     {
         for(auto & s : stream_subdevices) s = -1;
         for(auto & s : data_subdevices) s = -1;
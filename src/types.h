@@ -24,9 +24,12 @@
 #include <algorithm>
 
 const uint8_t RS_STREAM_NATIVE_COUNT    = 5;
-const int RS_USER_QUEUE_SIZE = 20;
 const int RS_MAX_EVENT_QUEUE_SIZE = 500;
 const int RS_MAX_EVENT_TINE_OUT = 10;
+const int RS_MAX_QUEUED_FRAMES = 4;
+const int RS_WAIT_FOR_FRAMES_TIMEOUT = 5000; // Milliseconds, before wait_for_frames without a timeout of its own gives up
+const int RS_CACHE_LINE_SIZE = 64;
+const int RS_FRAME_POOL_BLOCK_SIZE = 16;
 
 
 namespace rsimpl
@@ -55,6 +58,11 @@ namespace rsimpl
             for (unsigned int i = 0; i < sizeof(T); ++i) reinterpret_cast<char *>(&le_value)[i] = reinterpret_cast<const char *>(&be_value)[sizeof(T) - i - 1];
             return le_value;
         }
+        big_endian & operator = (T le_value)
+        {
+            for (unsigned int i = 0; i < sizeof(T); ++i) reinterpret_cast<char *>(&be_value)[i] = reinterpret_cast<const char *>(&le_value)[sizeof(T) - i - 1];
+            return *this;
+        }
     };
 #pragma pack(pop)
 
@@ -95,6 +103,8 @@ namespace rsimpl
     RS_ENUM_HELPERS(rs_blob_type, BLOB_TYPE)
     RS_ENUM_HELPERS(rs_camera_info, CAMERA_INFO)
     RS_ENUM_HELPERS(rs_timestamp_domain, TIMESTAMP_DOMAIN)
+    RS_ENUM_HELPERS(rs_frameset_policy, FRAMESET_POLICY)
+    RS_ENUM_HELPERS(rs_playback_mode, PLAYBACK_MODE)
     #undef RS_ENUM_HELPERS
 
     ////////////////////////////////////////////
@@ -275,7 +285,7 @@ namespace rsimpl
         std::string serial;                                                 // Serial number of the camera (from USB or from SPI memory)
         float nominal_depth_scale;                                          // Default scale
         std::vector<supported_capability> capabilities_vector;
-        std::vector<rs_frame_metadata> supported_metadata_vector;
+        uint32_t supported_metadata;                                        // Bit (1 << metadata) is set for each rs_frame_metadata the frames carry
         std::map<rs_camera_info, std::string> camera_info;
 
         static_device_info();
@@ -311,18 +321,27 @@ namespace rsimpl
         rs_format get_format(rs_stream stream) const { return get_unpacker().get_format(stream); }
         void set_output_buffer_format(const rs_output_buffer_format in_output_format);
 
-        void unpack(byte * const dest[], const byte * source) const;
+        // A compressed output is unpacked a row at a time into row_buffer, which a caller unpacking frame after frame passes in to reuse
+        void unpack(byte * const dest[], const byte * source, std::vector<uint16_t> * row_buffer = nullptr) const;
+        void unpack(byte * const dest[], const byte * source, int first_row, int row_count, std::vector<uint16_t> * row_buffer = nullptr) const; // Unpack a band of rows, into the full frame buffers in dest
+        bool can_unpack_rows() const { return mode.pf.plane_count == 1 && !is_compressed(); }
+        bool is_compressed() const; // True if the output is compressed by the depth codec, which takes the image as a whole
         int get_unpacked_width() const;
         int get_unpacked_height() const;
 
         bool requires_processing() const { return (output_format == RS_OUTPUT_BUFFER_FORMAT_CONTINUOUS) || (mode.pf.unpackers[unpacker_index].requires_processing); }
+        // True if the native frame already has the continuous layout, so it may be delivered straight from the capture buffer
+        bool supports_zero_copy() const { return !get_unpacker().requires_processing && pad_crop == 0 && get_outputs().size() == 1 && mode.native_dims.x == get_width() && mode.native_dims.y == get_height(); }
 
     };
 
     typedef void(*frame_callback_function_ptr)(rs_device * dev, rs_frame_ref * frame, void * user);
+    typedef void(*frameset_callback_function_ptr)(rs_device * dev, rs_frame_ref ** frames, int count, void * user);
     typedef void(*motion_callback_function_ptr)(rs_device * dev, rs_motion_data data, void * user);
     typedef void(*timestamp_callback_function_ptr)(rs_device * dev, rs_timestamp_data data, void * user);
     typedef void(*log_callback_function_ptr)(rs_log_severity severity, const char * message, void * user);
+    typedef void*(*frame_allocate_function_ptr)(rs_device * dev, rs_stream stream, int size, void * user);
+    typedef void(*frame_deallocate_function_ptr)(rs_device * dev, rs_stream stream, void * buffer, int size, void * user);
 
     class frame_callback : public rs_frame_callback
     {
@@ -346,6 +365,24 @@ namespace rsimpl
         void release() override { delete this; }
     };
 
+    class frameset_callback : public rs_frameset_callback
+    {
+        frameset_callback_function_ptr fptr;
+        void * user;
+        rs_device * device;
+    public:
+        frameset_callback(rs_device * dev, frameset_callback_function_ptr on_frameset, void * user) : fptr(on_frameset), user(user), device(dev) {}
+
+        void on_frameset(rs_device * dev, rs_frame_ref ** frames, int count) override
+        {
+            try { fptr(dev, frames, count, user); } catch (...)
+            {
+                LOG_ERROR("Received an execption from frameset callback!");
+            }
+        }
+        void release() override { delete this; }
+    };
+
     class motion_events_callback : public rs_motion_callback
     {
         motion_callback_function_ptr fptr;
@@ -418,6 +455,21 @@ namespace rsimpl
         void release() override { }
     };
 
+    class frame_allocator : public rs_frame_allocator
+    {
+        frame_allocate_function_ptr allocate_fptr;
+        frame_deallocate_function_ptr deallocate_fptr;
+        void        * user;
+        std::atomic<rs_device *> device; // Frame buffers share the allocator and may outlive the device, which detaches itself when destroyed
+    public:
+        frame_allocator(rs_device * dev, frame_allocate_function_ptr allocate, frame_deallocate_function_ptr deallocate, void * user) : allocate_fptr(allocate), deallocate_fptr(deallocate), user(user), device(dev) {}
+
+        void * allocate(rs_stream stream, size_t size) override { return allocate_fptr(device, stream, static_cast<int>(size), user); }
+        void deallocate(rs_stream stream, void * buffer, size_t size) override { deallocate_fptr(device, stream, buffer, static_cast<int>(size), user); }
+        void release() override { delete this; }
+        void detach_device() { device = nullptr; } // Buffers returned afterwards are handed to deallocate with a null device
+    };
+
     typedef std::unique_ptr<rs_log_callback, void(*)(rs_log_callback*)> log_callback_ptr;
     typedef std::unique_ptr<rs_motion_callback, void(*)(rs_motion_callback*)> motion_callback_ptr;
     typedef std::unique_ptr<rs_timestamp_callback, void(*)(rs_timestamp_callback*)> timestamp_callback_ptr;
@@ -448,11 +500,16 @@ namespace rsimpl
         data_polling_request                data_request;                                           // Modified by enable/disable_events calls
         motion_callback_ptr                 motion_callback{ nullptr, [](rs_motion_callback*){} };  // Modified by set_events_callback calls
         timestamp_callback_ptr              timestamp_callback{ nullptr, [](rs_timestamp_callback*){} };
+        std::shared_ptr<rs_frame_allocator> frame_allocator;                                        // Modified by set_frame_allocator calls, shared with the frame buffers it provided
+        std::shared_ptr<rs_frameset_callback> frameset_callback;                                    // Modified by set_frameset_callback calls, shared with the synchronizer delivering to it
+        rs_frameset_policy                  frameset_policy;                                        // Modified by set_frameset_policy calls
+        double                              frameset_tolerances[RS_STREAM_NATIVE_COUNT][RS_STREAM_NATIVE_COUNT]; // Modified by set_frameset_tolerance calls, 0 for the default tolerance
         float depth_scale;                                              // Scale of depth values
 
-        explicit device_config(const rsimpl::static_device_info & info) : info(info), depth_scale(info.nominal_depth_scale)
+        explicit device_config(const rsimpl::static_device_info & info) : info(info), frameset_policy(RS_FRAMESET_POLICY_WAIT), depth_scale(info.nominal_depth_scale)
         {
             for (auto & req : requests) req = rsimpl::stream_request();
+            for (auto & row : frameset_tolerances) for (auto & tolerance : row) tolerance = 0;
         }
 
         subdevice_mode_selection select_mode(const stream_request(&requests)[RS_STREAM_NATIVE_COUNT], int subdevice_index) const;
@@ -487,69 +544,109 @@ namespace rsimpl
         return (c0 << 24) | (c1 << 16) | (c2 << 8) | c3;
     }
 
-    template<class T, int C>
+    // Lock-free stack of the indices of slots kept by its owner, with its capacity fixed on construction. Its head carries a tag
+    // which changes on every push and pop, so that a thread holding a stale head can never swap it in after the slot was popped
+    // and pushed back meanwhile.
+    class tagged_index_stack
+    {
+        const uint32_t capacity;                        // Also the index of the head while the stack is empty
+        std::unique_ptr<std::atomic<uint32_t>[]> next;  // Index of the slot below each slot on the stack
+        std::atomic<uint64_t> head;                     // Tag in the upper half, index of the top slot in the lower half
+
+        static uint64_t make_head(uint64_t previous, uint32_t index) { return ((previous >> 32) + 1) << 32 | index; }
+
+    public:
+        // A full stack starts out with every index, to be popped in ascending order
+        tagged_index_stack(uint32_t capacity, bool full) : capacity(capacity), next(new std::atomic<uint32_t>[capacity]), head(full ? 0 : capacity)
+        {
+            for (uint32_t i = 0; i < capacity; i++) next[i] = i + 1;
+        }
+        tagged_index_stack(const tagged_index_stack &) = delete;
+        tagged_index_stack & operator=(const tagged_index_stack &) = delete;
+
+        uint32_t get_capacity() const { return capacity; }
+
+        // Returns -1 if the stack is empty
+        int pop()
+        {
+            auto old_head = head.load(std::memory_order_acquire);
+            while (true)
+            {
+                const auto index = static_cast<uint32_t>(old_head);
+                if (index == capacity) return -1;
+                if (head.compare_exchange_weak(old_head, make_head(old_head, next[index].load(std::memory_order_relaxed)), std::memory_order_acq_rel, std::memory_order_acquire)) return index;
+            }
+        }
+
+        void push(uint32_t index)
+        {
+            auto old_head = head.load(std::memory_order_relaxed);
+            do next[index].store(static_cast<uint32_t>(old_head), std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(old_head, make_head(old_head, index), std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    // Heap of objects shared by the capture threads and the application, with its capacity fixed and allocated on construction.
+    // Free slots are kept on a tagged_index_stack. Only stop_allocation/wait_until_empty ever take the mutex.
+    template<class T>
     class small_heap
     {
-        T buffer[C];
-        bool is_free[C];
+        std::unique_ptr<T[]> buffer;
+        tagged_index_stack free_slots;
+        std::atomic<int> size;
+        std::atomic<bool> keep_allocating;
         std::mutex mutex;
-        bool keep_allocating = true;
         std::condition_variable cv;
-        int size = 0;
 
-    public:
-        small_heap()
+        void release_count()
         {
-            for (auto i = 0; i < C; i++)
+            if (--size == 0)
             {
-                is_free[i] = true;
-                buffer[i] = std::move(T());
+                { std::lock_guard<std::mutex> lock(mutex); } // A waiting thread either saw the heap empty, or is already waiting for the notification
+                cv.notify_all();
             }
         }
 
+    public:
+        explicit small_heap(uint32_t capacity) : buffer(new T[capacity]), free_slots(capacity, true), size(0), keep_allocating(true) {}
+        small_heap(const small_heap &) = delete;
+        small_heap & operator=(const small_heap &) = delete;
+
+        uint32_t get_capacity() const { return free_slots.get_capacity(); }
+
         T * allocate()
         {
-            std::unique_lock<std::mutex> lock(mutex);
-            if (!keep_allocating) return nullptr;
+            // Count the item before checking for stop_allocation, so that wait_until_empty either sees it, or allocation sees the stop
+            ++size;
+            if (!keep_allocating)
+            {
+                release_count();
+                return nullptr;
+            }
 
-            for (auto i = 0; i < C; i++)
+            const auto index = free_slots.pop();
+            if (index < 0)
             {
-                if (is_free[i])
-                {
-                    is_free[i] = false;
-                    size++;
-                    return &buffer[i];
-                }
+                release_count();
+                return nullptr;
             }
-            return nullptr;
+            return &buffer[index];
         }
 
         void deallocate(T * item)
         {
-             if (item < buffer || item >= buffer + C)
+            if (item < buffer.get() || item >= buffer.get() + get_capacity())
             {
                 throw std::runtime_error("Trying to return item to a heap that didn't allocate it!");
             }
-            auto i = item - buffer;
+            const auto i = static_cast<uint32_t>(item - buffer.get());
             buffer[i] = std::move(T());
-            
-            {
-                std::unique_lock<std::mutex> lock(mutex);
-
-                is_free[i] = true;
-                size--;
-
-                if (size == 0)
-                {
-                    lock.unlock();
-                    cv.notify_one();
-                }
-            }
+            free_slots.push(i);
+            release_count();
         }
 
         void stop_allocation()
         {
-            std::unique_lock<std::mutex> lock(mutex);
             keep_allocating = false;
         }
 
@@ -568,6 +665,253 @@ namespace rsimpl
         }
     };
 
+    // Pool of objects which keep their address until the pool goes away, so that they can be handed between threads by
+    // pointer. Objects are constructed a block at a time, aligned to their own alignment, and reused rather than destroyed
+    // once deallocated, so that once the pool has grown to the working set, allocation is only a pop from the free list.
+    template<class T, int BLOCK_SIZE>
+    class object_pool
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<byte[]>> blocks;
+        std::vector<T *> free_list;
+
+        static T * get_objects(byte * block)
+        {
+            auto address = reinterpret_cast<uintptr_t>(block);
+            return reinterpret_cast<T *>((address + alignof(T) - 1) / alignof(T) * alignof(T));
+        }
+
+        void grow()
+        {
+            std::unique_ptr<byte[]> block(new byte[sizeof(T) * BLOCK_SIZE + alignof(T) - 1]);
+            auto objects = get_objects(block.get());
+            for (int i = 0; i < BLOCK_SIZE; ++i) new (objects + i) T();
+            blocks.push_back(std::move(block));
+            free_list.reserve(blocks.size() * BLOCK_SIZE); // Deallocation never has to grow the free list
+            for (int i = BLOCK_SIZE; i--; ) free_list.push_back(objects + i);
+        }
+
+    public:
+        object_pool() {}
+        object_pool(const object_pool &) = delete;
+        object_pool & operator=(const object_pool &) = delete;
+        ~object_pool()
+        {
+            for (auto & block : blocks)
+            {
+                auto objects = get_objects(block.get());
+                for (int i = 0; i < BLOCK_SIZE; ++i) objects[i].~T();
+            }
+        }
+
+        T * allocate()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (free_list.empty()) grow();
+            auto item = free_list.back();
+            free_list.pop_back();
+            return item;
+        }
+
+        // The item is handed out again as is, it is up to the caller to reset its state
+        void deallocate(T * item)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_list.push_back(item);
+        }
+
+        // Constructs objects up front, until at least count of them are available without growing the pool
+        void reserve(size_t count)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (blocks.size() * BLOCK_SIZE < count) grow();
+        }
+
+        size_t capacity()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return blocks.size() * BLOCK_SIZE;
+        }
+    };
+
+    // Bounded lock-free queue for one producer thread and one consumer thread. The producer only writes the slot past the
+    // back, and the consumer only the slot at the front, so neither ever waits for the other. Either role may move to
+    // another thread, as long as the handover is synchronized, e.g. by a mutex.
+    template<class T, int C>
+    class spsc_queue
+    {
+        T buffer[C];
+        std::atomic<size_t> head, tail; // Items in [tail, head) are queued. Only the producer advances head, only the consumer advances tail.
+
+    public:
+        spsc_queue() : head(0), tail(0) {}
+
+        // Producer API. Moves the item in and returns true, unless the queue is full.
+        bool push(T && item)
+        {
+            const auto h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) == C) return false;
+            buffer[h % C] = std::move(item);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer API. Items must be moved out before they are popped, since their slot is then handed back to the producer.
+        size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed); }
+        bool empty() const { return size() == 0; }
+        bool full() const { return size() == C; }
+        T & operator[](size_t i) { return buffer[(tail.load(std::memory_order_relaxed) + i) % C]; } // The i-th oldest item
+        T & front() { return (*this)[0]; }
+        T & back() { return (*this)[size() - 1]; }
+        void pop_front() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    };
+
+    struct buffer_pool_stats
+    {
+        unsigned long long hits;        // buffers handed out from the pool
+        unsigned long long misses;      // requests the pool could not satisfy
+        unsigned long long allocations; // fresh buffers allocated, including preallocated ones
+    };
+
+    // Owning, move-only handle to the memory of a single frame, obtained from a user supplied rs_frame_allocator or from the heap
+    class frame_buffer
+    {
+        byte * buffer;
+        size_t buffer_size;
+        rs_stream stream;
+        std::shared_ptr<rs_frame_allocator> allocator; // null when the memory was allocated by the library
+
+        frame_buffer(const frame_buffer &) = delete;
+        frame_buffer & operator=(const frame_buffer &) = delete;
+    public:
+        frame_buffer() : buffer(nullptr), buffer_size(0), stream(RS_STREAM_COUNT) {}
+        frame_buffer(size_t size, rs_stream stream, std::shared_ptr<rs_frame_allocator> user_allocator) : buffer(nullptr), buffer_size(size), stream(stream)
+        {
+            if (user_allocator)
+            {
+                try { buffer = static_cast<byte *>(user_allocator->allocate(stream, size)); }
+                catch (...)
+                {
+                    LOG_ERROR("Received an execption from frame allocator!");
+                }
+                if (buffer)
+                {
+                    memset(buffer, 0, size);
+                    allocator = std::move(user_allocator);
+                }
+                else LOG_WARNING("Frame allocator failed to provide " << size << " bytes, falling back to library memory");
+            }
+            // Buffers start out zeroed, as unpacking leaves the padding of padded modes untouched
+            if (!buffer) buffer = new byte[size]();
+        }
+        frame_buffer(frame_buffer && other) : buffer(other.buffer), buffer_size(other.buffer_size), stream(other.stream), allocator(std::move(other.allocator))
+        {
+            other.buffer = nullptr;
+            other.buffer_size = 0;
+        }
+        frame_buffer & operator=(frame_buffer && other)
+        {
+            if (this != &other)
+            {
+                reset();
+                buffer = other.buffer;
+                buffer_size = other.buffer_size;
+                stream = other.stream;
+                allocator = std::move(other.allocator);
+                other.buffer = nullptr;
+                other.buffer_size = 0;
+            }
+            return *this;
+        }
+        ~frame_buffer() { reset(); }
+
+        void reset()
+        {
+            if (!buffer) return;
+            if (allocator)
+            {
+                try { allocator->deallocate(stream, buffer, buffer_size); }
+                catch (...)
+                {
+                    LOG_ERROR("Received an execption from frame allocator!");
+                }
+                allocator.reset();
+            }
+            else delete[] buffer;
+            buffer = nullptr;
+            buffer_size = 0;
+        }
+
+        byte * data() { return buffer; }
+        const byte * data() const { return buffer; }
+        size_t size() const { return buffer_size; }
+        bool empty() const { return buffer_size == 0; }
+    };
+
+    // Lock-free pool of equally sized frame buffers, shared between the capture thread (acquire) and any thread releasing a frame (release)
+    // Slots holding a buffer and slots available for a returned buffer are kept on two tagged_index_stacks, so both operations are O(1) and never block
+    class frame_buffer_pool
+    {
+        std::unique_ptr<frame_buffer[]> slots;
+        tagged_index_stack full_slots, empty_slots;
+        std::atomic<size_t> buffer_size;
+        rs_stream stream;
+        std::shared_ptr<rs_frame_allocator> allocator;
+        std::atomic<unsigned long long> hits, misses, allocations;
+
+    public:
+        // The pool retains at most capacity buffers, enough for every frame of its stream that may be alive at once
+        explicit frame_buffer_pool(uint32_t capacity) : slots(new frame_buffer[capacity]), full_slots(capacity, false), empty_slots(capacity, true), buffer_size(0), stream(RS_STREAM_COUNT), hits(0), misses(0), allocations(0) {}
+        frame_buffer_pool(const frame_buffer_pool &) = delete;
+        frame_buffer_pool & operator=(const frame_buffer_pool &) = delete;
+
+        uint32_t get_capacity() const { return full_slots.get_capacity(); }
+
+        // Fix the size class and allocator of the pool and fill it with up to count buffers. Not thread safe, call before streaming starts.
+        void reserve(rs_stream buffer_stream, size_t size, int count, std::shared_ptr<rs_frame_allocator> buffer_allocator = nullptr)
+        {
+            stream = buffer_stream;
+            allocator = std::move(buffer_allocator);
+            buffer_size = size;
+            for (auto i = 0; i < count; i++)
+            {
+                ++allocations;
+                release(frame_buffer(size, stream, allocator));
+            }
+        }
+
+        // Obtain a buffer of the requested size, recycling a pooled one whenever possible
+        frame_buffer acquire(size_t size)
+        {
+            if (size == buffer_size)
+            {
+                auto i = full_slots.pop();
+                if (i >= 0)
+                {
+                    auto buffer = std::move(slots[i]);
+                    empty_slots.push(i);
+                    ++hits;
+                    return buffer;
+                }
+            }
+            ++misses;
+            ++allocations;
+            return frame_buffer(size, stream, allocator);
+        }
+
+        // Return a buffer to the pool. Buffers outside of the size class, or in excess of the pool capacity, are simply freed.
+        void release(frame_buffer buffer)
+        {
+            if (buffer.empty() || buffer.size() != buffer_size) return;
+            auto i = empty_slots.pop();
+            if (i < 0) return;
+            slots[i] = std::move(buffer);
+            full_slots.push(i);
+        }
+
+        buffer_pool_stats get_stats() const { return{ hits, misses, allocations }; }
+    };
+
     class frame_continuation
     {
         std::function<void()> continuation;
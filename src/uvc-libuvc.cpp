@@ -248,7 +248,12 @@ namespace rsimpl
             device.subdevices[subdevice_index].set_data_channel_cfg(callback);
         }
 
-        void start_streaming(device & device, int num_transfer_bufs)
+        bool supports_zero_copy(const device & /*device*/)
+        {
+            return false; // libuvc recycles the frame as soon as the callback returns
+        }
+
+        void start_streaming(device & device, const capture_settings & settings)
         {
             for(auto i = 0; i < device.subdevices.size(); i++)
             {
@@ -262,7 +267,7 @@ namespace rsimpl
                     check("uvc_start_streaming", uvc_start_streaming(sub.handle, &sub.ctrl, [](uvc_frame * frame, void * user)
                     {
                         reinterpret_cast<subdevice *>(user)->callback(frame->data, []{});
-                    }, &sub, 0, num_transfer_bufs));
+                    }, &sub, 0, settings.num_transfer_bufs));
                 }
             }
         }
@@ -0,0 +1,787 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+#ifdef RS_USE_SIMULATED_BACKEND
+
+// Simulated cameras, which stand in for UVC hardware so that the whole capture pipeline can be streamed, load tested and profiled without a camera.
+//
+// RS_SIMULATED_DEVICES lists the cameras to emulate, separated by commas, out of r200, lr200, zr300 and sr300 (default: r200).
+// RS_SIMULATED_FRAMES optionally names a directory of raw captures to replay instead of the synthetic images. A capture holds back to back
+// native frames of one mode, and is named after the camera, subdevice, fourcc and resolution, e.g. r200-1-Z16-628x469.raw or sr300-0-YUY2-1920x1080.raw.
+
+#include "uvc.h"
+#include "image.h"
+#include "hw-monitor.h"
+#include "ds-device.h"
+#include "sr300.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+namespace rsimpl
+{
+    namespace uvc
+    {
+        enum class firmware_protocol { ds, ivcam };
+
+        struct camera_profile
+        {
+            const char * name;
+            int pid;
+            firmware_protocol protocol;
+            int subdevice_count;
+            std::vector<const native_pixel_format *> formats; // Native formats the camera streams, looked up by fourcc
+            int depth_units_per_mm;
+        };
+
+        static const std::vector<camera_profile> & get_camera_profiles()
+        {
+            static const std::vector<camera_profile> profiles = {
+                { "r200",  R200_PRODUCT_ID,  firmware_protocol::ds,    3, { &pf_y8, &pf_y8i, &pf_y16, &pf_y12i, &pf_z16, &pf_yuy2, &pf_rw10 }, 1 },
+                { "lr200", LR200_PRODUCT_ID, firmware_protocol::ds,    3, { &pf_y8, &pf_y8i, &pf_y16, &pf_y12i, &pf_z16, &pf_yuy2, &pf_rw16 }, 1 },
+                { "zr300", ZR300_PRODUCT_ID, firmware_protocol::ds,    3, { &pf_y8, &pf_y8i, &pf_y16, &pf_y12i, &pf_z16, &pf_yuy2, &pf_rw16 }, 1 },
+                { "sr300", SR300_PRODUCT_ID, firmware_protocol::ivcam, 2, { &pf_yuy2, &pf_sr300_invi, &pf_invz, &pf_sr300_inzi }, 8 },
+            };
+            return profiles;
+        }
+
+        static std::string fourcc_to_string(uint32_t fourcc)
+        {
+            std::string s = { static_cast<char>(fourcc >> 24), static_cast<char>(fourcc >> 16), static_cast<char>(fourcc >> 8), static_cast<char>(fourcc) };
+            return s.substr(0, s.find_last_not_of(' ') + 1);
+        }
+
+        ////////////////////////
+        // DS firmware layout //
+        ////////////////////////
+
+        const uint32_t DS_SPI_FLASH_SIZE            = 256 * 0x1000;
+        const uint32_t DS_SPI_FLASH_PAGE_SIZE       = 0x100;
+        const uint32_t DS_ADMIN_TABLE_ADDRESS       = 160 * 0x1000;    // First sector after the firmware, holding the addresses of the data sectors
+        const uint32_t DS_CALIBRATION_ADDRESS       = DS_ADMIN_TABLE_ADDRESS + 0x1000;
+        const uint32_t DS_CAMERA_HEAD_OFFSET        = 2048;            // Camera head contents follow the calibration within its sector
+        const uint32_t DS_COMMAND_DOWNLOAD_SPI      = 0x1A;
+        const uint32_t DS_COMMAND_GET_FWREVISION    = 0x21;
+        const uint32_t DS_COMMAND_PEEK              = 0x11;
+        const uint32_t DS_COMMAND_POKE              = 0x12;
+
+        #pragma pack(push, 1)
+        struct ds_command_packet { uint32_t code, modifier, tag, address, value, reserved[59]; };
+
+        // Version 2 calibration block, stored big endian, in the layout ds::read_camera_info() expects
+        struct ds_unrectified_intrinsics { big_endian<float> fx, fy, px, py, k[5]; big_endian<uint32_t> w, h; };
+        struct ds_rectified_intrinsics { big_endian<float> rfx, rfy, rpx, rpy; big_endian<uint32_t> rw, rh; };
+        struct ds_calibration_v2
+        {
+            big_endian<uint32_t> versionNumber;
+            big_endian<uint16_t> numIntrinsicsRight, numIntrinsicsThird, numIntrinsicsPlatform;
+            big_endian<uint16_t> numRectifiedModesLR, numRectifiedModesThird, numRectifiedModesPlatform;
+            ds_unrectified_intrinsics intrinsicsLeft, intrinsicsRight[2], intrinsicsThird[3], intrinsicsPlatform[4];
+            ds_rectified_intrinsics modesLR[2][4], modesThird[2][3][3], modesPlatform[2][4][1];
+            big_endian<float> Rleft[2][9], Rright[2][9], Rthird[2][9], Rplatform[2][9];
+            big_endian<float> B[2], T[2][3], Tplatform[2][3];
+            big_endian<float> Rworld[9], Tworld[3];
+        };
+
+        struct sr300_raw_calibration
+        {
+            uint16_t table_version, table_id;
+            uint32_t data_size, reserved;
+            int crc;
+            ivcam::camera_calib_params params;
+            uint8_t reserved_1[176], reserved_2[148];
+        };
+        #pragma pack(pop)
+
+        static void set_intrinsics(ds_unrectified_intrinsics & u, int w, int h, float px, float py, float f, std::initializer_list<float> k)
+        {
+            u.w = w; u.h = h; u.px = px; u.py = py; u.fx = f; u.fy = f;
+            int i = 0;
+            for (auto c : k) u.k[i++] = c;
+        }
+
+        static void set_intrinsics(ds_rectified_intrinsics & r, int w, int h, float px, float py, float f)
+        {
+            r.rw = w; r.rh = h; r.rpx = px; r.rpy = py; r.rfx = f; r.rfy = f;
+        }
+
+        // A flash image holding the calibration and camera head of a typical DS camera, with the given serial number
+        static std::vector<uint8_t> make_ds_flash(uint32_t serial_number)
+        {
+            std::vector<uint8_t> flash(DS_SPI_FLASH_SIZE, 0xFF);
+
+            const uint32_t admin_table[9] = { DS_CALIBRATION_ADDRESS };
+            memcpy(flash.data() + DS_ADMIN_TABLE_ADDRESS, admin_table, sizeof(admin_table));
+
+            ds_calibration_v2 calib;
+            memset(&calib, 0, sizeof(calib));
+            calib.versionNumber = 2;
+            calib.numIntrinsicsRight = 1;
+            calib.numIntrinsicsThird = 2;
+            calib.numRectifiedModesLR = 3;
+            calib.numRectifiedModesThird = 2;
+            set_intrinsics(calib.intrinsicsLeft, 640, 480, 321.2f, 243.6f, 585.3f, { -0.08f, 0.11f, 0, 0, 0 });
+            set_intrinsics(calib.intrinsicsRight[0], 640, 480, 318.9f, 239.1f, 584.8f, { -0.08f, 0.11f, 0, 0, 0 });
+            set_intrinsics(calib.intrinsicsThird[0], 1920, 1080, 962.7f, 547.3f, 1388.4f, { 0.07f, -0.16f, 0.001f, -0.001f, 0 });
+            set_intrinsics(calib.intrinsicsThird[1], 640, 480, 320.9f, 243.2f, 617.2f, { 0.07f, -0.16f, 0.001f, -0.001f, 0 });
+            set_intrinsics(calib.modesLR[0][0], 640, 480, 320.0f, 240.0f, 582.5f);
+            set_intrinsics(calib.modesLR[0][1], 492, 372, 246.0f, 186.0f, 447.8f);
+            set_intrinsics(calib.modesLR[0][2], 332, 252, 166.0f, 126.0f, 302.2f);
+            set_intrinsics(calib.modesThird[0][0][0], 1920, 1080, 960.0f, 540.0f, 1388.4f);
+            set_intrinsics(calib.modesThird[0][0][1], 1280, 720, 640.0f, 360.0f, 925.6f);
+            set_intrinsics(calib.modesThird[0][1][0], 640, 480, 320.0f, 240.0f, 617.2f);
+            set_intrinsics(calib.modesThird[0][1][1], 320, 240, 160.0f, 120.0f, 308.6f);
+            const float rthird[9] = { 0.99998f, -0.00465f, 0.00395f, 0.00468f, 0.99997f, -0.00676f, -0.00392f, 0.00678f, 0.99997f };
+            for (int i = 0; i < 9; ++i) calib.Rthird[0][i] = rthird[i];
+            calib.T[0][0] = -58.4f; calib.T[0][1] = 0.3f; calib.T[0][2] = -0.6f;
+            calib.B[0] = 70.1f;
+            memcpy(flash.data() + DS_CALIBRATION_ADDRESS, &calib, sizeof(calib));
+
+            ds::ds_head_content head;
+            memset(&head, 0, sizeof(head));
+            head.serial_number = serial_number;
+            head.imager_model_number = 31;
+            head.module_revision_number = 3;
+            head.module_version = 3;
+            head.module_major_version = 3;
+            head.camera_head_contents_version = ds::ds_head_content::DS_HEADER_VERSION_NUMBER;
+            head.camera_head_contents_size_bytes = sizeof(head);
+            head.nominal_baseline = 70;
+            head.nominal_baseline_third_imager = 58;
+            head.build_date = head.calibration_date = 1467331200; // 2016-07-01
+            memcpy(flash.data() + DS_CALIBRATION_ADDRESS + DS_CAMERA_HEAD_OFFSET, &head, sizeof(head));
+            return flash;
+        }
+
+        // The calibration table of a typical SR300, expressed the way the IVCAM firmware reports it
+        static sr300_raw_calibration make_sr300_calibration()
+        {
+            sr300_raw_calibration calib;
+            memset(&calib, 0, sizeof(calib));
+            calib.table_version = 1;
+            calib.data_size = sizeof(calib.params);
+            auto & c = calib.params;
+            c.Rmax = 8191.875f; // Depth units of 1/8 mm
+            c.Kc[0][0] = 1.4843f; c.Kc[0][2] = -0.0300f;
+            c.Kc[1][1] = 1.9817f; c.Kc[1][2] = 0.0238f;
+            c.Kc[2][2] = 1;
+            const float invdist[5] = { 0.13f, 0.16f, 0.004f, 0.002f, 0.01f };
+            for (int i = 0; i < 5; ++i) c.Invdistc[i] = invdist[i];
+            c.Kt[0][0] = 1.0848f; c.Kt[0][2] = 0.0028f; // Color focal lengths and principal point are normalized for a 16:9 image
+            c.Kt[1][1] = 2.5711f; c.Kt[1][2] = 0.0135f;
+            c.Kt[2][2] = 1;
+            const float rt[9] = { 0.99998f, 0.00468f, -0.00392f, -0.00465f, 0.99997f, 0.00678f, 0.00395f, -0.00676f, 0.99997f };
+            memcpy(c.Rt, rt, sizeof(rt));
+            c.Tt[0] = 25.7f; c.Tt[1] = 0.4f; c.Tt[2] = 3.9f;
+            return calib;
+        }
+
+        ////////////////////
+        // Frame sources  //
+        ////////////////////
+
+        // Capture buffers of one subdevice. A buffer belongs to the library until its continuation runs, which may be after streaming stopped.
+        class frame_ring
+        {
+            std::mutex mutex;
+            std::vector<std::vector<uint8_t>> buffers;
+            std::vector<int> free_buffers;
+        public:
+            frame_ring(size_t image_size, int depth) : buffers(depth, std::vector<uint8_t>(image_size))
+            {
+                for (int i = depth - 1; i >= 0; --i) free_buffers.push_back(i);
+            }
+
+            int acquire()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (free_buffers.empty()) return -1;
+                int i = free_buffers.back();
+                free_buffers.pop_back();
+                return i;
+            }
+            void release(int i)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_buffers.push_back(i);
+            }
+            uint8_t * get_buffer(int i) { return buffers[i].data(); }
+        };
+
+        // Renders a still scene in the given native format: a tilted plane with a grid of holes for depth, color bars for YUY2, and noise for
+        // infrared. Every pixel is nonzero except the depth holes, so that IVCAM empty frame detection passes.
+        static std::vector<uint8_t> render_scene(const native_pixel_format & pf, int width, int height, int depth_units_per_mm)
+        {
+            std::vector<uint8_t> image(pf.get_image_size(width, height));
+            auto render_depth = [=](uint16_t * z)
+            {
+                for (int y = 0; y < height; ++y) for (int x = 0; x < width; ++x)
+                    *z++ = ((x >> 4) + (y >> 4)) % 11 ? static_cast<uint16_t>((600 + 3 * x + 2 * y) * depth_units_per_mm) : 0;
+            };
+            uint32_t seed = 0x2545F491;
+            auto render_noise = [&](uint8_t * begin, uint8_t * end) { for (auto p = begin; p != end; ++p) { seed = seed * 1664525 + 1013904223; *p = static_cast<uint8_t>(seed >> 24) | 1; } };
+
+            if (pf.fourcc == pf_z16.fourcc || pf.fourcc == pf_invz.fourcc) render_depth(reinterpret_cast<uint16_t *>(image.data()));
+            else if (pf.fourcc == pf_sr300_inzi.fourcc && pf.plane_count == 2)
+            {
+                render_noise(image.data(), image.data() + image.size() / 2);
+                render_depth(reinterpret_cast<uint16_t *>(image.data() + image.size() / 2));
+            }
+            else if (pf.fourcc == pf_yuy2.fourcc)
+            {
+                const uint8_t bars[8][3] = { { 235, 128, 128 }, { 210, 16, 146 }, { 170, 166, 16 }, { 145, 54, 34 }, { 106, 202, 222 }, { 81, 90, 240 }, { 41, 240, 110 }, { 16, 128, 128 } };
+                auto p = image.data();
+                for (int y = 0; y < height; ++y) for (int x = 0; x < width; x += 2, p += 4)
+                {
+                    auto & bar = bars[x * 8 / width];
+                    p[0] = p[2] = bar[0];
+                    p[1] = bar[1];
+                    p[3] = bar[2];
+                }
+            }
+            else render_noise(image.data(), image.data() + image.size());
+            return image;
+        }
+
+        // Replays raw frames from a capture file, rewinding at its end
+        class capture_file
+        {
+            std::ifstream file;
+            size_t frame_size;
+        public:
+            capture_file(const std::string & path, size_t frame_size) : file(path, std::ios::binary), frame_size(frame_size)
+            {
+                if (!file) return;
+                file.seekg(0, std::ios::end);
+                if (static_cast<size_t>(file.tellg()) < frame_size)
+                {
+                    LOG_WARNING(path << " is shorter than one " << frame_size << " byte frame, rendering synthetic frames instead");
+                    file.close();
+                }
+                file.seekg(0);
+            }
+
+            bool is_open() const { return file.is_open(); }
+            void read_frame(uint8_t * frame)
+            {
+                if (!file.read(reinterpret_cast<char *>(frame), frame_size))
+                {
+                    file.clear();
+                    file.seekg(0);
+                    file.read(reinterpret_cast<char *>(frame), frame_size);
+                }
+            }
+        };
+
+        ///////////////////
+        // Device state  //
+        ///////////////////
+
+        struct context {};
+
+        struct subdevice
+        {
+            int width = 0, height = 0, fps = 0;
+            const native_pixel_format * format = nullptr;
+            video_channel_callback callback;
+            data_channel_callback data_callback;
+            std::thread thread;
+            std::atomic<uint64_t> dropped_frames;
+
+            subdevice() : dropped_frames(0) {}
+        };
+
+        struct device
+        {
+            const std::shared_ptr<context> parent;
+            const camera_profile & profile;
+            const int index;
+            std::vector<std::unique_ptr<subdevice>> subdevices;
+
+            // Control state, which the application may access while the streaming threads run
+            mutable std::mutex control_mutex;
+            std::map<std::tuple<int, int, int>, std::vector<uint8_t>> xu_values;   // Keyed by subdevice, unit and control
+            std::map<std::pair<int, rs_option>, int> pu_values;                    // Keyed by subdevice and option
+
+            // DS command/response state
+            std::vector<uint8_t> flash;
+            ds_command_packet pending_response;
+            bool has_pending_response = false;
+            uint32_t spi_address = 0, spi_remaining = 0;
+            std::map<uint32_t, uint32_t> registers;
+
+            // IVCAM hardware monitor state
+            std::vector<uint8_t> monitor_response;
+
+            // Streaming state
+            std::mutex stream_mutex;
+            std::condition_variable stream_stopped;
+            bool streaming = false;
+            std::chrono::high_resolution_clock::time_point stream_start;
+
+            device(std::shared_ptr<context> parent, const camera_profile & profile, int index) : parent(parent), profile(profile), index(index)
+            {
+                for (int i = 0; i < profile.subdevice_count; ++i) subdevices.emplace_back(new subdevice());
+
+                if (profile.protocol == firmware_protocol::ds)
+                {
+                    flash = make_ds_flash(2000000000u + index);
+                    set_xu_default(ds::lr_xu, ds::control::depth_units, uint32_t(1000));
+                    set_xu_default(ds::lr_xu, ds::control::min_max, ds::range{ 0, 0xFFFF });
+                    set_xu_default(ds::lr_xu, ds::control::emitter, uint8_t(1));
+                    set_xu_default(ds::lr_xu, ds::control::depth_params, ds::dc_params::presets[0]);
+                    set_xu_default(ds::lr_xu, ds::control::temperature, ds::temperature{ 38, 20, 45, 60 });
+                    set_xu_default(ds::lr_xu, ds::control::lr_exposure, ds::rate_value{ 60, 164 });
+                    set_xu_default(ds::lr_xu, ds::control::lr_gain, ds::rate_value{ 60, 400 });
+                    set_xu_default(ds::lr_xu, ds::control::lr_autoexposure_parameters, ds::ae_params{ 512, 0, 0, 0, 0, 0, 479, 0, 639 });
+                }
+                else
+                {
+                    set_xu_default(ivcam::depth_xu, IVCAM_DEPTH_LASER_POWER, uint8_t(16));
+                    set_xu_default(ivcam::depth_xu, IVCAM_DEPTH_ACCURACY, uint8_t(1));
+                    set_xu_default(ivcam::depth_xu, IVCAM_DEPTH_MOTION_RANGE, uint8_t(9));
+                    set_xu_default(ivcam::depth_xu, IVCAM_DEPTH_FILTER_OPTION, uint8_t(5));
+                    set_xu_default(ivcam::depth_xu, IVCAM_DEPTH_CONFIDENCE_THRESH, uint8_t(3));
+                }
+            }
+            ~device()
+            {
+                stop_streaming();
+            }
+
+            template<class C, class T> void set_xu_default(const extension_unit & xu, C ctrl, const T & value)
+            {
+                auto & data = xu_values[std::make_tuple(xu.subdevice, xu.unit, static_cast<int>(ctrl))];
+                data.resize(sizeof(T));
+                memcpy(data.data(), &value, sizeof(T));
+            }
+
+            subdevice & get_subdevice(int subdevice_index)
+            {
+                if (subdevice_index < 0 || subdevice_index >= profile.subdevice_count) throw std::runtime_error(to_string() << "simulated " << profile.name << " has no subdevice " << subdevice_index);
+                return *subdevices[subdevice_index];
+            }
+
+            // DS firmware answers commands written to the command/response control, and streams flash pages after a download command
+            void write_command(const void * data, int len)
+            {
+                ds_command_packet c = {};
+                memcpy(&c, data, std::min(len, static_cast<int>(sizeof(c))));
+                pending_response = c;
+                has_pending_response = true;
+                switch (c.code)
+                {
+                case DS_COMMAND_DOWNLOAD_SPI:
+                    if (c.address + c.value > DS_SPI_FLASH_SIZE || c.value % DS_SPI_FLASH_PAGE_SIZE) throw std::runtime_error("simulated SPI flash download out of range");
+                    spi_address = c.address;
+                    spi_remaining = c.value;
+                    break;
+                case DS_COMMAND_GET_FWREVISION:
+                    strcpy(reinterpret_cast<char *>(pending_response.reserved), "1.0.72.06");
+                    pending_response.reserved[4] = 0x17;
+                    break;
+                case DS_COMMAND_PEEK: pending_response.value = registers[c.address]; break;
+                case DS_COMMAND_POKE: registers[c.address] = c.value; break;
+                }
+            }
+            void read_command_response(void * data, int len)
+            {
+                memset(data, 0, len);
+                if (has_pending_response)
+                {
+                    memcpy(data, &pending_response, std::min(len, static_cast<int>(sizeof(pending_response))));
+                    has_pending_response = false;
+                }
+                else if (spi_remaining)
+                {
+                    auto count = std::min(static_cast<uint32_t>(len), std::min(DS_SPI_FLASH_PAGE_SIZE, spi_remaining));
+                    memcpy(data, flash.data() + spi_address, count);
+                    spi_address += DS_SPI_FLASH_PAGE_SIZE;
+                    spi_remaining -= DS_SPI_FLASH_PAGE_SIZE;
+                }
+                else throw std::runtime_error("simulated command/response control has no response pending");
+            }
+
+            // IVCAM firmware echoes the opcode of each hardware monitor command, followed by the data the command reads
+            void write_monitor_command(const uint8_t * data, int len)
+            {
+                uint16_t magic_number = 0;
+                if (len >= static_cast<int>(IVCAM_MONITOR_HEADER_SIZE)) memcpy(&magic_number, data + 2, sizeof(magic_number));
+                if (magic_number != IVCAM_MONITOR_MAGIC_NUMBER) throw std::runtime_error("malformed hardware monitor command");
+                uint32_t opcode;
+                memcpy(&opcode, data + 4, sizeof(opcode));
+                monitor_response.assign(reinterpret_cast<const uint8_t *>(&opcode), reinterpret_cast<const uint8_t *>(&opcode + 1));
+
+                if (opcode == static_cast<uint32_t>(ivcam::fw_cmd::GVD))
+                {
+                    std::vector<uint8_t> gvd(256);
+                    const uint8_t firmware_version[] = { 0, 10, 10, 3 }; // 3.10.10.0
+                    memcpy(gvd.data(), firmware_version, sizeof(firmware_version));
+                    const uint8_t serial[] = { 0x61, 0x12, 0x40, 0x07, static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index) };
+                    memcpy(gvd.data() + 132, serial, sizeof(serial));
+                    monitor_response.insert(monitor_response.end(), gvd.begin(), gvd.end());
+                }
+                else if (opcode == static_cast<uint32_t>(ivcam::fw_cmd::GetCalibrationTable))
+                {
+                    auto calib = make_sr300_calibration();
+                    monitor_response.insert(monitor_response.end(), reinterpret_cast<const uint8_t *>(&calib), reinterpret_cast<const uint8_t *>(&calib + 1));
+                }
+            }
+
+            void start_streaming(const capture_settings & settings);
+            void stop_streaming();
+            void stream_subdevice(subdevice & sub, int subdevice_index, int ring_depth, int color_counter_scale);
+        };
+
+        // Stamps the per frame metadata the library reads back: the dinghy row of DS infrared and depth images, the frame counter in the
+        // pixel LSBs of DS color images, and the rolling timestamp, in units of 10 ns, at the start of IVCAM images
+        static void stamp_frame(const device & dev, int subdevice_index, const subdevice & sub, uint8_t * frame, size_t size, uint32_t frame_count, std::chrono::nanoseconds since_start)
+        {
+            if (dev.profile.protocol == firmware_protocol::ivcam)
+            {
+                auto rolling_timestamp = static_cast<uint32_t>(since_start.count() / 10);
+                memcpy(frame, &rolling_timestamp, sizeof(rolling_timestamp));
+            }
+            else if (subdevice_index == 2)
+            {
+                auto pixels = static_cast<size_t>(sub.width) * sub.height;
+                if (sub.format->bytes_per_pixel != 2 || pixels < 32 || pixels * 2 > size) return;
+                auto data = frame + (pixels - 32) * 2;
+                for (int i = 0; i < 32; ++i, data += 2) *data = (*data & ~1) | ((frame_count >> (i & 1 ? 32 - i : 30 - i)) & 1);
+            }
+            else if (subdevice_index < 2)
+            {
+                const uint32_t magic_numbers[] = { 0x08070605, 0x04030201 };
+                auto offset = sub.format->get_image_size(sub.width, sub.height - 1);
+                if (offset + sizeof(ds::dinghy) > size) return;
+                ds::dinghy dinghy = {};
+                dinghy.magicNumber = magic_numbers[subdevice_index];
+                dinghy.frameCount = frame_count;
+                memcpy(frame + offset, &dinghy, sizeof(dinghy));
+            }
+        }
+
+        // Each subdevice is served by its own thread, as the USB transfers of each endpoint are, which delivers frames at the nominal frame
+        // period. A thread which falls behind skips the frames it missed, and a frame which finds every capture buffer still held by the
+        // library is dropped, as a camera drops frames the host does not read in time.
+        void device::stream_subdevice(subdevice & sub, int subdevice_index, int ring_depth, int color_counter_scale)
+        {
+            const auto size = sub.format->get_image_size(sub.width, sub.height);
+            auto ring = std::make_shared<frame_ring>(size, ring_depth);
+            const auto scene = render_scene(*sub.format, sub.width, sub.height, profile.depth_units_per_mm);
+
+            std::unique_ptr<capture_file> capture;
+            if (auto dir = getenv("RS_SIMULATED_FRAMES"))
+            {
+                std::string path = to_string() << dir << "/" << profile.name << "-" << subdevice_index << "-" << fourcc_to_string(sub.format->fourcc) << "-" << sub.width << "x" << sub.height << ".raw";
+                capture.reset(new capture_file(path, size));
+                if (capture->is_open()) LOG_INFO("Simulated " << profile.name << " subdevice " << subdevice_index << " replays " << path);
+                else capture.reset();
+            }
+
+            const auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::seconds(1)) / sub.fps;
+            std::unique_lock<std::mutex> lock(stream_mutex);
+            for (uint32_t n = 0; ; ++n)
+            {
+                auto due = stream_start + period * n;
+                if (stream_stopped.wait_until(lock, due, [this]() { return !streaming; })) break;
+                lock.unlock();
+
+                auto missed = static_cast<uint32_t>((std::chrono::high_resolution_clock::now() - due) / period);
+                if (missed)
+                {
+                    sub.dropped_frames += missed;
+                    n += missed;
+                    due += period * missed;
+                }
+
+                int buffer = ring->acquire();
+                if (buffer < 0) ++sub.dropped_frames;
+                else
+                {
+                    auto frame = ring->get_buffer(buffer);
+                    if (capture) capture->read_frame(frame);
+                    else memcpy(frame, scene.data(), size);
+                    stamp_frame(*this, subdevice_index, sub, frame, size, (n + 1) * (subdevice_index == 2 ? color_counter_scale : 1), due - stream_start);
+                    sub.callback(frame, [ring, buffer]() { ring->release(buffer); });
+                }
+                lock.lock();
+            }
+            if (sub.dropped_frames) LOG_INFO("Simulated " << profile.name << " subdevice " << subdevice_index << " dropped " << sub.dropped_frames << " frames");
+        }
+
+        void device::start_streaming(const capture_settings & settings)
+        {
+            std::lock_guard<std::mutex> lock(stream_mutex);
+            if (streaming) throw std::logic_error("simulated device is already streaming");
+
+            // The DS color frame counter advances with the left/right/Z frames, which may be faster than color
+            int master_fps = 0;
+            if (subdevices.size() > 1 && subdevices[1]->callback) master_fps = subdevices[1]->fps;
+            else if (subdevices[0]->callback) master_fps = subdevices[0]->fps;
+            auto color_fps = subdevices.size() > 2 ? subdevices[2]->fps : 0;
+            auto color_counter_scale = master_fps && color_fps ? std::max(1, master_fps / color_fps) : 1;
+
+            streaming = true;
+            stream_start = std::chrono::high_resolution_clock::now();
+            auto ring_depth = std::max(settings.ring_depth, 2);
+            for (size_t i = 0; i < subdevices.size(); ++i)
+            {
+                auto & sub = *subdevices[i];
+                if (!sub.callback) continue;
+                sub.dropped_frames = 0;
+                sub.thread = std::thread([this, &sub, i, ring_depth, color_counter_scale]() { stream_subdevice(sub, static_cast<int>(i), ring_depth, color_counter_scale); });
+            }
+        }
+
+        void device::stop_streaming()
+        {
+            {
+                std::lock_guard<std::mutex> lock(stream_mutex);
+                streaming = false;
+            }
+            stream_stopped.notify_all();
+            for (auto & sub : subdevices)
+            {
+                if (sub->thread.joinable()) sub->thread.join();
+                sub->callback = nullptr;
+            }
+        }
+
+        ////////////
+        // device //
+        ////////////
+
+        int get_vendor_id(const device & /*device*/) { return VID_INTEL_CAMERA; }
+        int get_product_id(const device & device) { return device.profile.pid; }
+        bool is_fisheye_present(const device & /*device*/) { return false; } // The ZR300 is simulated without its motion module
+
+        std::string get_usb_port_id(const device & device)
+        {
+            return to_string() << "sim-" << device.index;
+        }
+
+        void get_control(const device & device, const extension_unit & xu, uint8_t ctrl, void * data, int len)
+        {
+            std::lock_guard<std::mutex> lock(device.control_mutex);
+            if (device.profile.protocol == firmware_protocol::ds && xu.unit == ds::lr_xu.unit && ctrl == static_cast<uint8_t>(ds::control::command_response))
+                return const_cast<uvc::device &>(device).read_command_response(data, len);
+
+            memset(data, 0, len);
+            auto it = device.xu_values.find(std::make_tuple(xu.subdevice, xu.unit, static_cast<int>(ctrl)));
+            if (it != device.xu_values.end()) memcpy(data, it->second.data(), std::min(static_cast<size_t>(len), it->second.size()));
+        }
+
+        void set_control(device & device, const extension_unit & xu, uint8_t ctrl, void * data, int len)
+        {
+            std::lock_guard<std::mutex> lock(device.control_mutex);
+            if (device.profile.protocol == firmware_protocol::ds && xu.unit == ds::lr_xu.unit)
+            {
+                switch (static_cast<ds::control>(ctrl))
+                {
+                case ds::control::command_response: return device.write_command(data, len);
+                case ds::control::lr_exposure_discovery:
+                case ds::control::lr_gain_discovery:
+                {
+                    // Discovery controls report the range of exposure (in tenths of a millisecond) or gain at the framerate written to them
+                    ds::discovery disc = {};
+                    memcpy(&disc, data, std::min(len, static_cast<int>(sizeof(disc))));
+                    auto fps = std::max(disc.fps, 1u);
+                    if (static_cast<ds::control>(ctrl) == ds::control::lr_exposure_discovery) disc = { fps, 1, 10000 / fps, 164, 1 };
+                    else disc = { fps, 100, 6399, 400, 1 };
+                    device.set_xu_default(xu, ctrl, disc);
+                    return;
+                }
+                default: break;
+                }
+            }
+
+            auto & value = device.xu_values[std::make_tuple(xu.subdevice, xu.unit, static_cast<int>(ctrl))];
+            value.assign(reinterpret_cast<const uint8_t *>(data), reinterpret_cast<const uint8_t *>(data) + len);
+        }
+
+        void claim_interface(device & /*device*/, const guid & /*interface_guid*/, int /*interface_number*/) {}
+        void claim_aux_interface(device & /*device*/, const guid & /*interface_guid*/, int /*interface_number*/) {}
+
+        void bulk_transfer(device & device, unsigned char endpoint, void * data, int length, int * actual_length, unsigned int /*timeout*/)
+        {
+            std::lock_guard<std::mutex> lock(device.control_mutex);
+            if (device.profile.protocol != firmware_protocol::ivcam) throw std::runtime_error(to_string() << "simulated " << device.profile.name << " has no bulk endpoints");
+
+            if (endpoint == IVCAM_MONITOR_ENDPOINT_OUT)
+            {
+                device.write_monitor_command(reinterpret_cast<const uint8_t *>(data), length);
+                *actual_length = length;
+            }
+            else if (endpoint == IVCAM_MONITOR_ENDPOINT_IN)
+            {
+                if (device.monitor_response.empty()) throw std::runtime_error("bulk transfer timed out, no hardware monitor response pending");
+                *actual_length = std::min(length, static_cast<int>(device.monitor_response.size()));
+                memcpy(data, device.monitor_response.data(), *actual_length);
+                device.monitor_response.clear();
+            }
+            else throw std::runtime_error(to_string() << "simulated " << device.profile.name << " has no endpoint 0x" << std::hex << (int)endpoint);
+        }
+
+        void set_subdevice_mode(device & device, int subdevice_index, int width, int height, uint32_t fourcc, int fps, video_channel_callback callback)
+        {
+            auto & sub = device.get_subdevice(subdevice_index);
+            auto format = std::find_if(begin(device.profile.formats), end(device.profile.formats), [fourcc](const native_pixel_format * pf) { return pf->fourcc == fourcc; });
+            if (format == end(device.profile.formats)) throw std::runtime_error(to_string() << "simulated " << device.profile.name << " does not stream fourcc " << fourcc_to_string(fourcc));
+            if (width <= 0 || height <= 0 || fps <= 0) throw std::runtime_error(to_string() << "simulated " << device.profile.name << " cannot stream " << width << "x" << height << " at " << fps << " fps");
+
+            sub.width = width;
+            sub.height = height;
+            sub.fps = fps;
+            sub.format = *format;
+            sub.callback = callback;
+        }
+
+        void set_subdevice_data_channel_handler(device & device, int subdevice_index, data_channel_callback callback)
+        {
+            device.get_subdevice(subdevice_index).data_callback = callback;
+        }
+
+        void start_data_acquisition(device & /*device*/) {} // There is no motion module to produce motion events
+        void stop_data_acquisition(device & /*device*/) {}
+
+        void start_streaming(device & device, const capture_settings & settings)
+        {
+            device.start_streaming(settings);
+        }
+
+        bool supports_zero_copy(const device & /*device*/)
+        {
+            return true; // Capture buffers are only reused once their continuation is invoked
+        }
+
+        void stop_streaming(device & device)
+        {
+            device.stop_streaming();
+        }
+
+        struct pu_control_range { rs_option option; int min, max, step, def; };
+        static const pu_control_range pu_control_ranges[] = {
+            { RS_OPTION_COLOR_BACKLIGHT_COMPENSATION,    0,     1,  1,    0 },
+            { RS_OPTION_COLOR_BRIGHTNESS,              -64,    64,  1,    0 },
+            { RS_OPTION_COLOR_CONTRAST,                  0,   100,  1,   50 },
+            { RS_OPTION_COLOR_EXPOSURE,                 39, 10000,  1,  156 },
+            { RS_OPTION_COLOR_GAIN,                      0,   128,  1,   64 },
+            { RS_OPTION_COLOR_GAMMA,                   100,   500,  1,  300 },
+            { RS_OPTION_COLOR_HUE,                    -180,   180,  1,    0 },
+            { RS_OPTION_COLOR_SATURATION,                0,   100,  1,   64 },
+            { RS_OPTION_COLOR_SHARPNESS,                 0,   100,  1,   50 },
+            { RS_OPTION_COLOR_WHITE_BALANCE,          2800,  6500, 10, 4600 },
+            { RS_OPTION_COLOR_ENABLE_AUTO_EXPOSURE,      0,     1,  1,    1 },
+            { RS_OPTION_COLOR_ENABLE_AUTO_WHITE_BALANCE, 0,     1,  1,    1 },
+        };
+
+        static const pu_control_range & get_pu_control_range(const device & device, rs_option option)
+        {
+            for (auto & r : pu_control_ranges) if (r.option == option) return r;
+            throw std::logic_error(to_string() << "simulated " << device.profile.name << " does not support " << option);
+        }
+
+        void get_pu_control_range(const device & device, int subdevice, rs_option option, int * min, int * max, int * step, int * def)
+        {
+            const_cast<uvc::device &>(device).get_subdevice(subdevice);
+            auto & r = get_pu_control_range(device, option);
+            if (min) *min = r.min;
+            if (max) *max = r.max;
+            if (step) *step = r.step;
+            if (def) *def = r.def;
+        }
+
+        void get_extension_control_range(const device & device, const extension_unit & xu, char control, int * min, int * max, int * step, int * def)
+        {
+            struct xu_range { int unit, control, min, max, def; };
+            static const xu_range ivcam_ranges[] = {
+                { ivcam::depth_xu.unit, IVCAM_DEPTH_LASER_POWER,       0,  16, 16 },
+                { ivcam::depth_xu.unit, IVCAM_DEPTH_ACCURACY,          1,   3,  1 },
+                { ivcam::depth_xu.unit, IVCAM_DEPTH_MOTION_RANGE,      0, 220,  9 },
+                { ivcam::depth_xu.unit, IVCAM_DEPTH_FILTER_OPTION,     0,   7,  5 },
+                { ivcam::depth_xu.unit, IVCAM_DEPTH_CONFIDENCE_THRESH, 0,  15,  3 },
+            };
+            if (device.profile.protocol == firmware_protocol::ivcam)
+            {
+                for (auto & r : ivcam_ranges)
+                {
+                    if (r.unit != xu.unit || r.control != control) continue;
+                    if (min) *min = r.min;
+                    if (max) *max = r.max;
+                    if (step) *step = 1;
+                    if (def) *def = r.def;
+                    return;
+                }
+            }
+            throw std::logic_error(to_string() << "simulated " << device.profile.name << " has no range for control " << (int)control << " of unit " << xu.unit);
+        }
+
+        void set_pu_control(device & device, int subdevice, rs_option option, int value)
+        {
+            device.get_subdevice(subdevice);
+            auto & r = get_pu_control_range(device, option);
+            std::lock_guard<std::mutex> lock(device.control_mutex);
+            device.pu_values[std::make_pair(subdevice, option)] = std::min(std::max(value, r.min), r.max);
+        }
+
+        int get_pu_control(const device & device, int subdevice, rs_option option)
+        {
+            const_cast<uvc::device &>(device).get_subdevice(subdevice);
+            auto & r = get_pu_control_range(device, option);
+            std::lock_guard<std::mutex> lock(device.control_mutex);
+            auto it = device.pu_values.find(std::make_pair(subdevice, option));
+            return it != device.pu_values.end() ? it->second : r.def;
+        }
+
+        /////////////
+        // context //
+        /////////////
+
+        std::shared_ptr<context> create_context()
+        {
+            return std::make_shared<context>();
+        }
+
+        bool is_device_connected(device & device, int vid, int pid)
+        {
+            return vid == VID_INTEL_CAMERA && pid == device.profile.pid;
+        }
+
+        std::vector<std::shared_ptr<device>> query_devices(std::shared_ptr<context> context)
+        {
+            std::vector<std::shared_ptr<device>> devices;
+            auto list = getenv("RS_SIMULATED_DEVICES");
+            std::istringstream names(list ? list : "r200");
+            for (std::string name; std::getline(names, name, ','); )
+            {
+                name.erase(0, name.find_first_not_of(' '));
+                name.erase(name.find_last_not_of(' ') + 1);
+                if (name.empty()) continue;
+
+                auto & profiles = get_camera_profiles();
+                auto profile = std::find_if(begin(profiles), end(profiles), [&name](const camera_profile & p) { return name == p.name; });
+                if (profile == end(profiles))
+                {
+                    LOG_WARNING("RS_SIMULATED_DEVICES names unknown camera " << name << ", expected r200, lr200, zr300 or sr300");
+                    continue;
+                }
+                devices.push_back(std::make_shared<device>(context, *profile, static_cast<int>(devices.size()) + 1));
+                LOG_INFO("Simulating " << name << " on port " << get_usb_port_id(*devices.back()));
+            }
+            return devices;
+        }
+    }
+}
+
+#endif
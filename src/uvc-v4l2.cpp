@@ -17,6 +17,9 @@
 #include <fstream>
 #include <regex>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <utility> // for pair
 #include <chrono>
 #include <thread>
@@ -28,6 +31,10 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/ioctl.h>
 #include <linux/usb/video.h>
 #include <linux/uvcvideo.h>
@@ -66,6 +73,84 @@ namespace rsimpl
 
         struct buffer { void * start; size_t length; };
 
+        // Tracks whether the driver buffers of the last streaming session of a subdevice have been freed. The driver refuses to free
+        // buffers which are still mapped, or to allocate new ones before they are freed, so both wait for the last frame holding them.
+        struct buffer_release
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool allocated = false;
+            bool closed = false;    // Closing the device frees the buffers along with their last mapping
+
+            void free_buffers(int fd)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(!closed)
+                    {
+                        v4l2_requestbuffers req = {};
+                        req.count = 0;
+                        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                        req.memory = V4L2_MEMORY_MMAP;
+                        if(xioctl(fd, VIDIOC_REQBUFS, &req) < 0) warn_error("VIDIOC_REQBUFS");
+                    }
+                    allocated = false;
+                }
+                cv.notify_all();
+            }
+
+            bool wait_freed(std::chrono::milliseconds timeout)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                return cv.wait_for(lock, timeout, [this]() { return !allocated; });
+            }
+
+            void close(int fd)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                if(::close(fd) < 0) warn_error("close");
+            }
+        };
+
+        // The memory mapped capture buffers of a single streaming session. Frames delivered without copying hold a reference to the ring,
+        // so that the mappings, and the driver buffers behind them, stay valid after stop_capture() until the last such frame has been released.
+        struct buffer_ring
+        {
+            int fd;
+            std::vector<buffer> buffers;
+            std::mutex mutex;
+            bool streaming;
+            std::shared_ptr<buffer_release> release;
+
+            buffer_ring(int fd, std::shared_ptr<buffer_release> release) : fd(fd), streaming(true), release(release)
+            {
+                std::lock_guard<std::mutex> lock(release->mutex);
+                release->allocated = true;
+            }
+            ~buffer_ring()
+            {
+                for(auto & b : buffers)
+                {
+                    if(munmap(b.start, b.length) < 0) warn_error("munmap");
+                }
+                release->free_buffers(fd);
+            }
+
+            // Hand a buffer back to the driver, unless streaming has stopped in the meantime
+            void requeue(v4l2_buffer & buf)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(streaming && xioctl(fd, VIDIOC_QBUF, &buf) < 0) warn_error("VIDIOC_QBUF");
+            }
+
+            void stop()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                streaming = false;
+            }
+        };
+
         struct context
         {
             libusb_context * usb_context;
@@ -81,13 +166,75 @@ namespace rsimpl
             }
         };
 
+        // A dequeued capture buffer, waiting to be handed to the frame callback
+        struct captured_frame
+        {
+            std::shared_ptr<buffer_ring> ring;
+            v4l2_buffer buf;
+        };
+
+        // Bounded hand-off between the capture thread, which only dequeues buffers, and the thread that unpacks them. When unpacking
+        // falls behind, the oldest waiting frame is returned to the driver, so that a slow consumer adds drops rather than latency.
+        class handoff_queue
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::deque<captured_frame> frames;
+            size_t capacity;
+            bool stopped;
+        public:
+            explicit handoff_queue(size_t capacity) : capacity(capacity), stopped(false) {}
+
+            void push(captured_frame && frame)
+            {
+                captured_frame dropped;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(frames.size() >= capacity)
+                    {
+                        dropped = std::move(frames.front());
+                        frames.pop_front();
+                    }
+                    frames.push_back(std::move(frame));
+                }
+                cv.notify_one();
+                if(dropped.ring)
+                {
+                    LOG_DEBUG("Hand-off queue full, dropping frame in buffer " << dropped.buf.index);
+                    dropped.ring->requeue(dropped.buf);
+                }
+            }
+
+            // Blocks until a frame is available, returns false once the queue is stopped
+            bool pop(captured_frame & frame)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return stopped || !frames.empty(); });
+                if(stopped) return false;
+                frame = std::move(frames.front());
+                frames.pop_front();
+                return true;
+            }
+
+            void stop()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopped = true;
+                    frames.clear();
+                }
+                cv.notify_all();
+            }
+        };
+
         struct subdevice
         {
             std::string dev_name;   // Device name (typically of the form /dev/video*)
             int busnum, devnum, parent_devnum;     // USB device bus number and device number (needed for F200/SR300 direct USB controls)
             int vid, pid, mi;       // Vendor ID, product ID, and multiple interface index
             int fd;                 // File descriptor for this device
-            std::vector<buffer> buffers;
+            std::shared_ptr<buffer_ring> ring;
+            std::shared_ptr<buffer_release> release = std::make_shared<buffer_release>();
 
             int width, height, format, fps;
             video_channel_callback callback = nullptr;
@@ -175,7 +322,7 @@ namespace rsimpl
             ~subdevice()
             {
                 stop_capture();
-                if(close(fd) < 0) warn_error("close");
+                release->close(fd);
             }
 
             int get_vid() const { return vid; }
@@ -208,7 +355,7 @@ namespace rsimpl
                 this->channel_data_callback = callback;
             }
 
-            void start_capture()
+            void start_capture(int ring_depth)
             {
                 if(!is_capturing)
                 {
@@ -227,9 +374,12 @@ namespace rsimpl
                     parm.parm.capture.timeperframe.denominator = fps;
                     if(xioctl(fd, VIDIOC_S_PARM, &parm) < 0) throw_error("VIDIOC_S_PARM");
 
+                    // Frames of the last session still held by the application keep its buffers allocated
+                    if(!release->wait_freed(std::chrono::seconds(1))) throw std::runtime_error(dev_name + " cannot restart streaming while frames of its last session are still held");
+
                     // Init memory mapped IO
                     v4l2_requestbuffers req = {};
-                    req.count = 4;
+                    req.count = ring_depth;
                     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
                     req.memory = V4L2_MEMORY_MMAP;
                     if(xioctl(fd, VIDIOC_REQBUFS, &req) < 0)
@@ -242,8 +392,9 @@ namespace rsimpl
                         throw std::runtime_error("Insufficient buffer memory on " + dev_name);
                     }
 
-                    buffers.resize(req.count);
-                    for(size_t i = 0; i < buffers.size(); ++i)
+                    ring = std::make_shared<buffer_ring>(fd, release);
+                    auto & buffers = ring->buffers;
+                    for(size_t i = 0; i < req.count; ++i)
                     {
                         v4l2_buffer buf = {};
                         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -251,9 +402,9 @@ namespace rsimpl
                         buf.index = i;
                         if(xioctl(fd, VIDIOC_QUERYBUF, &buf) < 0) throw_error("VIDIOC_QUERYBUF");
 
-                        buffers[i].length = buf.length;
-                        buffers[i].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
-                        if(buffers[i].start == MAP_FAILED) throw_error("mmap");
+                        buffer b = { mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset), buf.length };
+                        if(b.start == MAP_FAILED) throw_error("mmap");
+                        buffers.push_back(b);
                     }
 
                     // Start capturing
@@ -288,65 +439,47 @@ namespace rsimpl
                     v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
                     if(xioctl(fd, VIDIOC_STREAMOFF, &type) < 0) warn_error("VIDIOC_STREAMOFF");
 
-                    for(size_t i = 0; i < buffers.size(); i++)
-                    {
-                        if(munmap(buffers[i].start, buffers[i].length) < 0) warn_error("munmap");
-                    }
-
-                    // Close memory mapped IO
-                    struct v4l2_requestbuffers req = {};
-                    req.count = 0;
-                    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                    req.memory = V4L2_MEMORY_MMAP;
-                    if(xioctl(fd, VIDIOC_REQBUFS, &req) < 0)
-                    {
-                        if(errno == EINVAL) LOG_ERROR(dev_name + " does not support memory mapping");
-                        else warn_error("VIDIOC_REQBUFS");
-                    }
+                    // The buffers are unmapped and freed with the ring, once the frames still holding them are released
+                    ring->stop();
+                    if(ring.use_count() > 1) LOG_INFO(dev_name << " stopped while frames still reference its capture buffers, which are freed once released");
+                    ring.reset();
 
                     callback = nullptr;
                     is_capturing = false;
                 }
             }
 
-            static void poll(const std::vector<subdevice *> & subdevices)
+            // Dequeue the next filled buffer, returns false if the driver had none ready
+            bool dequeue(captured_frame & frame)
             {
-                int max_fd = 0;
-                fd_set fds;
-                FD_ZERO(&fds);
-                for(auto * sub : subdevices)
+                frame.buf = {};
+                frame.buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+                frame.buf.memory = V4L2_MEMORY_MMAP;
+                if(xioctl(fd, VIDIOC_DQBUF, &frame.buf) < 0)
                 {
-                    FD_SET(sub->fd, &fds);
-                    max_fd = std::max(max_fd, sub->fd);
+                    if(errno == EAGAIN) return false;
+                    throw_error("VIDIOC_DQBUF");
                 }
+                frame.ring = ring;
+                return true;
+            }
 
-                struct timeval tv = {0,10000};
-                if(select(max_fd + 1, &fds, NULL, NULL, &tv) < 0)
+            // Pass a dequeued buffer to the frame callback, the buffer is returned to the driver when its continuation runs
+            void dispatch(const captured_frame & frame)
+            {
+                auto ring = frame.ring;
+                auto buf = frame.buf;
+                try
                 {
-                    if (errno == EINTR) return;
-                    throw_error("select");
+                    callback(ring->buffers[buf.index].start, [ring, buf]() mutable {
+                        ring->requeue(buf);
+                    });
                 }
-
-                for(auto * sub : subdevices)
+                catch(const std::exception & e)
                 {
-                    if(FD_ISSET(sub->fd, &fds))
-                    {
-                        v4l2_buffer buf = {};
-                        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                        buf.memory = V4L2_MEMORY_MMAP;
-                        if(xioctl(sub->fd, VIDIOC_DQBUF, &buf) < 0)
-                        {
-                            if(errno == EAGAIN) return;
-                            throw_error("VIDIOC_DQBUF");
-                        }
-
-                        sub->callback(sub->buffers[buf.index].start,
-                                [sub, buf]() mutable {
-                                    if(xioctl(sub->fd, VIDIOC_QBUF, &buf) < 0) throw_error("VIDIOC_QBUF");
-                                });
-                    }
+                    LOG_ERROR("Frame callback of " << dev_name << " failed: " << e.what());
                 }
-            }            
+            }
 
             static void poll_interrupts(libusb_device_handle *handle, const std::vector<subdevice *> & subdevices, uint16_t timeout)
             {
@@ -382,9 +515,11 @@ namespace rsimpl
         {
             const std::shared_ptr<context> parent;
             std::vector<std::unique_ptr<subdevice>> subdevices;
-            std::thread thread;
+            std::vector<std::thread> capture_threads;
+            std::vector<std::thread> dispatch_threads;
+            std::vector<std::unique_ptr<handoff_queue>> handoff_queues;
+            int stop_event;         // eventfd signalled to wake the capture threads on stop_streaming()
             std::thread data_channel_thread;
-            volatile bool stop;
             volatile bool data_stop;
             //TODO: majd
             bool is_fisheye_present;
@@ -393,7 +528,7 @@ namespace rsimpl
             libusb_device_handle * usb_handle;
             std::vector<int> claimed_interfaces;
 
-            device(std::shared_ptr<context> parent) : parent(parent), stop(), data_stop(), usb_device(), usb_handle(),is_fisheye_present(false) {}
+            device(std::shared_ptr<context> parent) : parent(parent), stop_event(-1), data_stop(), usb_device(), usb_handle(),is_fisheye_present(false) {}
             ~device()
             {
                 stop_streaming();
@@ -417,32 +552,159 @@ namespace rsimpl
                 return false;
             }
 
-            void start_streaming()
+            static void configure_capture_thread(const capture_settings & settings)
             {
-                std::vector<subdevice *> subs;
+                if(settings.cpu_affinity)
+                {
+                    cpu_set_t cpus;
+                    CPU_ZERO(&cpus);
+                    for(int i = 0; i < 64 && i < CPU_SETSIZE; ++i)
+                    {
+                        if(settings.cpu_affinity & (1ull << i)) CPU_SET(i, &cpus);
+                    }
+                    if(int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) LOG_WARNING("pthread_setaffinity_np(...) error " << err << ", " << strerror(err));
+                }
+                if(settings.thread_priority > 0)
+                {
+                    sched_param param = {};
+                    param.sched_priority = std::min(settings.thread_priority, sched_get_priority_max(SCHED_FIFO));
+                    if(int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) LOG_WARNING("Cannot set SCHED_FIFO priority " << param.sched_priority << " for the capture thread, error " << err << ", " << strerror(err));
+                }
+            }
+
+            // Wait for filled buffers on the given subdevices until stop_event is signalled. Each buffer is either queued for
+            // the subdevice's dispatch thread or, without a hand-off queue, passed to the frame callback right here.
+            static void capture(int stop_event, const std::vector<subdevice *> & subs, const std::vector<handoff_queue *> & queues, const capture_settings & settings)
+            {
+                int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+                if(epoll_fd < 0) throw_error("epoll_create1");
 
+                try
+                {
+                    epoll_event ev = {};
+                    ev.events = EPOLLIN;
+                    ev.data.u32 = subs.size();
+                    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_event, &ev) < 0) throw_error("EPOLL_CTL_ADD");
+                    for(size_t i = 0; i < subs.size(); ++i)
+                    {
+                        ev.data.u32 = i;
+                        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, subs[i]->fd, &ev) < 0) throw_error("EPOLL_CTL_ADD");
+                    }
+
+                    std::vector<epoll_event> events(subs.size() + 1);
+                    for(bool stopping = false; !stopping; )
+                    {
+                        int count = epoll_wait(epoll_fd, events.data(), events.size(), -1);
+                        if(count < 0)
+                        {
+                            if(errno == EINTR) continue;
+                            throw_error("epoll_wait");
+                        }
+
+                        for(int i = 0; i < count; ++i)
+                        {
+                            auto index = events[i].data.u32;
+                            if(index == subs.size())
+                            {
+                                stopping = true;
+                                continue;
+                            }
+
+                            captured_frame frame;
+                            if(!subs[index]->dequeue(frame)) continue;
+                            if(queues[index]) queues[index]->push(std::move(frame));
+                            else subs[index]->dispatch(frame);
+                        }
+                    }
+                }
+                catch(const std::exception & e)
+                {
+                    LOG_ERROR("Capture thread stopped: " << e.what());
+                    if(settings.on_error) settings.on_error(to_string() << "capture stopped: " << e.what());
+                }
+                close(epoll_fd);
+            }
+
+            void start_streaming(const capture_settings & settings)
+            {
+                stop_event = eventfd(0, EFD_CLOEXEC);
+                if(stop_event < 0) throw_error("eventfd");
+
+                std::vector<subdevice *> subs;
                 for(auto & sub : subdevices)
                 {
                     if(sub->callback)
                     {
-                        sub->start_capture();
+                        sub->start_capture(settings.ring_depth);
                         subs.push_back(sub.get());
                     }                
                 }
 
-                thread = std::thread([this, subs]()
+                // Unpacking and user callbacks run on a dispatch thread per subdevice, so that they never delay dequeuing
+                std::vector<handoff_queue *> queues;
+                for(auto * sub : subs)
                 {
-                    while(!stop) subdevice::poll(subs);
-                });
+                    if(settings.handoff_queue_size <= 0)
+                    {
+                        queues.push_back(nullptr);
+                        continue;
+                    }
+
+                    handoff_queues.emplace_back(new handoff_queue(settings.handoff_queue_size));
+                    auto queue = handoff_queues.back().get();
+                    queues.push_back(queue);
+                    dispatch_threads.push_back(std::thread([sub, queue]()
+                    {
+                        for(;;)
+                        {
+                            captured_frame frame;
+                            if(!queue->pop(frame)) break;
+                            sub->dispatch(frame);
+                        }
+                    }));
+                }
+
+                auto stop_fd = stop_event;
+                if(settings.thread_per_subdevice)
+                {
+                    for(size_t i = 0; i < subs.size(); ++i)
+                    {
+                        std::vector<subdevice *> sub = { subs[i] };
+                        std::vector<handoff_queue *> queue = { queues[i] };
+                        capture_threads.push_back(std::thread([stop_fd, sub, queue, settings]()
+                        {
+                            configure_capture_thread(settings);
+                            capture(stop_fd, sub, queue, settings);
+                        }));
+                    }
+                }
+                else
+                {
+                    capture_threads.push_back(std::thread([stop_fd, subs, queues, settings]()
+                    {
+                        configure_capture_thread(settings);
+                        capture(stop_fd, subs, queues, settings);
+                    }));
+                }
             }
 
             void stop_streaming()
             {
-                if(thread.joinable())
+                if(stop_event >= 0)
                 {
-                    stop = true;
-                    thread.join();
-                    stop = false;
+                    // The eventfd stays readable once written, so a single write wakes every capture thread
+                    uint64_t signal = 1;
+                    if(write(stop_event, &signal, sizeof(signal)) < 0) warn_error("write");
+                    for(auto & thread : capture_threads) thread.join();
+                    capture_threads.clear();
+
+                    for(auto & queue : handoff_queues) queue->stop();
+                    for(auto & thread : dispatch_threads) thread.join();
+                    dispatch_threads.clear();
+                    handoff_queues.clear();
+
+                    close(stop_event);
+                    stop_event = -1;
 
                     for(auto & sub : subdevices) sub->stop_capture();
                 }                
@@ -548,9 +810,14 @@ namespace rsimpl
             device.subdevices[subdevice_index]->set_data_channel_cfg(callback);
         }
 
-        void start_streaming(device & device, int /*num_transfer_bufs*/)
+        bool supports_zero_copy(const device & /*device*/)
+        {
+            return true; // Capture buffers are only queued back to the driver once their continuation is invoked
+        }
+
+        void start_streaming(device & device, const capture_settings & settings)
         {
-            device.start_streaming();
+            device.start_streaming(settings);
         }
 
         void stop_streaming(device & device)
@@ -829,7 +829,12 @@ namespace rsimpl
             device.subdevices[subdevice_index].set_data_channel_cfg(callback);
         }
 
-        void start_streaming(device & device, int num_transfer_bufs) { device.start_streaming(); }
+        bool supports_zero_copy(const device & /*device*/)
+        {
+            return false; // Not measured yet: holding the sample buffers may starve the source reader, which ignores the capture ring depth
+        }
+
+        void start_streaming(device & device, const capture_settings & /*settings*/) { device.start_streaming(); }
         void stop_streaming(device & device) { device.stop_streaming(); }
 
         void start_data_acquisition(device & device)
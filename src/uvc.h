@@ -65,7 +65,19 @@ namespace rsimpl
         typedef std::function<void(const void * frame, std::function<void()> continuation)> video_channel_callback;
 
         void set_subdevice_mode(device & device, int subdevice_index, int width, int height, uint32_t fourcc, int fps, video_channel_callback callback);
-        void start_streaming(device & device, int num_transfer_bufs);
+        struct capture_settings
+        {
+            int num_transfer_bufs = 0;          // libuvc only: number of transfer buffers per stream
+            int ring_depth = 4;                 // V4L2 only: number of capture buffers per subdevice
+            bool thread_per_subdevice = false;  // V4L2 only: wait on each subdevice from its own capture thread
+            uint64_t cpu_affinity = 0;          // V4L2 only: bitmask of CPUs the capture threads may run on, 0 leaves it unchanged
+            int thread_priority = 0;            // V4L2 only: SCHED_FIFO priority of the capture threads, 0 keeps the default policy
+            int handoff_queue_size = 0;         // V4L2 only: captured frames that may wait for unpacking per subdevice, 0 unpacks on the capture thread
+            std::function<void(const std::string &)> on_error; // V4L2 only: called by a capture thread which stops on an error
+        };
+
+        void start_streaming(device & device, const capture_settings & settings);
+        bool supports_zero_copy(const device & device); // true if frame buffers stay valid until their continuation is invoked
         void stop_streaming(device & device);
         
         // Access CT, PU, and XU controls, and retry if failure occurs
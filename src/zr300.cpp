@@ -44,6 +44,8 @@ namespace rsimpl
 
     void zr300_camera::set_options(const rs_option options[], size_t count, const double values[])
     {
+        if (defer_options(options, count, values)) return;
+
         std::vector<rs_option>  base_opt;
         std::vector<double>     base_opt_val;
 
@@ -123,8 +125,8 @@ namespace rsimpl
         }
 
         // Merge the local data with values obtained by base class
-        for (auto i : base_opt_index)
-            values[i] = base_opt_val[i];
+        for (size_t j = 0; j < base_opt_index.size(); ++j)
+            values[base_opt_index[j]] = base_opt_val[j];
     }
 
     void zr300_camera::send_blob_to_device(rs_blob_type type, void * data, int size)
@@ -483,7 +485,7 @@ namespace rsimpl
                     info.options.push_back({ RS_OPTION_FISHEYE_EXPOSURE,                40, 331, 1,  40 });
                 else if (ver >= firmware_version("1.27.2.90"))
                 {
-                    info.supported_metadata_vector.push_back(RS_FRAME_METADATA_ACTUAL_EXPOSURE);
+                    info.supported_metadata |= 1 << RS_FRAME_METADATA_ACTUAL_EXPOSURE;
                     info.options.push_back({ RS_OPTION_FISHEYE_EXPOSURE,                2,  320, 1,  4 });
                 }
             }
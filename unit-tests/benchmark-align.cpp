@@ -0,0 +1,160 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// Microbenchmark of depth to color and color to depth alignment against the per pixel projection it replaces.
+// Usage: align-benchmark [threads [iterations]]
+
+#include "../src/image.h"
+#include "../src/thread-pool.h"
+#include "../include/librealsense/rsutil.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+using rsimpl::byte;
+
+namespace scalar
+{
+    // Copy of the per pixel alignment, kept here as the baseline to measure the table driven alignment against
+    template<class GET_DEPTH, class TRANSFER_PIXEL> void align_images(const rs_intrinsics & depth_intrin, const rs_extrinsics & depth_to_other, const rs_intrinsics & other_intrin, GET_DEPTH get_depth, TRANSFER_PIXEL transfer_pixel)
+    {
+        for(int depth_y = 0; depth_y < depth_intrin.height; ++depth_y)
+        {
+            int depth_pixel_index = depth_y * depth_intrin.width;
+            for(int depth_x = 0; depth_x < depth_intrin.width; ++depth_x, ++depth_pixel_index)
+            {
+                if(float depth = get_depth(depth_pixel_index))
+                {
+                    float depth_pixel[2] = {depth_x-0.5f, depth_y-0.5f}, depth_point[3], other_point[3], other_pixel[2];
+                    rs_deproject_pixel_to_point(depth_point, &depth_intrin, depth_pixel, depth);
+                    rs_transform_point_to_point(other_point, &depth_to_other, depth_point);
+                    rs_project_point_to_pixel(other_pixel, &other_intrin, other_point);
+                    const int other_x0 = static_cast<int>(other_pixel[0] + 0.5f);
+                    const int other_y0 = static_cast<int>(other_pixel[1] + 0.5f);
+
+                    depth_pixel[0] = depth_x+0.5f; depth_pixel[1] = depth_y+0.5f;
+                    rs_deproject_pixel_to_point(depth_point, &depth_intrin, depth_pixel, depth);
+                    rs_transform_point_to_point(other_point, &depth_to_other, depth_point);
+                    rs_project_point_to_pixel(other_pixel, &other_intrin, other_point);
+                    const int other_x1 = static_cast<int>(other_pixel[0] + 0.5f);
+                    const int other_y1 = static_cast<int>(other_pixel[1] + 0.5f);
+
+                    if(other_x0 < 0 || other_y0 < 0 || other_x1 >= other_intrin.width || other_y1 >= other_intrin.height) continue;
+                    for(int y=other_y0; y<=other_y1; ++y) for(int x=other_x0; x<=other_x1; ++x) transfer_pixel(depth_pixel_index, y * other_intrin.width + x);
+                }
+            }
+        }
+    }
+
+    void align_z_to_other(uint16_t * out_z, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin)
+    {
+        align_images(z_intrin, z_to_other, other_intrin,
+            [z_pixels, z_scale](int z_pixel_index) { return z_scale * z_pixels[z_pixel_index]; },
+            [out_z, z_pixels](int z_pixel_index, int other_pixel_index) { out_z[other_pixel_index] = out_z[other_pixel_index] ? std::min(out_z[other_pixel_index],z_pixels[z_pixel_index]) : z_pixels[z_pixel_index]; });
+    }
+
+    struct rgb { byte b[3]; };
+    void align_rgb_to_z(rgb * out_other, const uint16_t * z_pixels, float z_scale, const rs_intrinsics & z_intrin, const rs_extrinsics & z_to_other, const rs_intrinsics & other_intrin, const rgb * in_other)
+    {
+        align_images(z_intrin, z_to_other, other_intrin,
+            [z_pixels, z_scale](int z_pixel_index) { return z_scale * z_pixels[z_pixel_index]; },
+            [out_other, in_other](int z_pixel_index, int other_pixel_index) { out_other[z_pixel_index] = in_other[other_pixel_index]; });
+    }
+}
+
+// Returns the fastest of several calls in milliseconds, which is less sensitive to scheduling noise than the average
+template<class F> static double time_call(F f, int iterations)
+{
+    f(); // Warm up caches
+    double fastest = std::numeric_limits<double>::max();
+    for(int i = 0; i < iterations; ++i)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        fastest = std::min(fastest, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return fastest;
+}
+
+int main(int argc, char * argv[])
+{
+    const int threads = argc > 1 ? atoi(argv[1]) : 4;
+    const int iterations = argc > 2 ? atoi(argv[2]) : 20;
+    const float z_scale = 0.001f;
+
+    // Calibration in the style of an SR300, with an inverse distorted depth camera next to a forward distorted color camera
+    const rs_intrinsics depth_intrin = { 640, 480, 310.4f, 245.7f, 475.6f, 475.6f, RS_DISTORTION_INVERSE_BROWN_CONRADY, { 0.13f, 0.16f, 0.004f, 0.002f, 0.01f } };
+    const rs_extrinsics depth_to_color = { { 0.99998f, -0.00465f, 0.00395f, 0.00468f, 0.99997f, -0.00676f, -0.00392f, 0.00678f, 0.99997f }, { 0.0257f, 0.0004f, 0.0039f } };
+    std::vector<uint16_t> depth(depth_intrin.width * depth_intrin.height);
+    for(size_t i = 0; i < depth.size(); ++i) depth[i] = i % 97 ? static_cast<uint16_t>(400 + rand() % 2000) : 0;
+    const auto table = rsimpl::compute_alignment_table(depth_intrin);
+    rsimpl::thread_pool pool(threads);
+
+    struct { const char * name; rs_intrinsics color_intrin; } resolutions[] = {
+        { "480p", { 640, 480, 320.9f, 243.2f, 617.2f, 617.2f, RS_DISTORTION_MODIFIED_BROWN_CONRADY, { 0.07f, -0.16f, 0.001f, -0.001f, 0 } } },
+        { "1080p", { 1920, 1080, 962.7f, 547.3f, 1388.4f, 1388.4f, RS_DISTORTION_MODIFIED_BROWN_CONRADY, { 0.07f, -0.16f, 0.001f, -0.001f, 0 } } },
+    };
+
+    std::cout << "Aligning " << depth_intrin.width << "x" << depth_intrin.height << " depth, " << iterations << " iterations, " << threads << " worker threads" << std::endl;
+    std::cout << std::left << std::setw(24) << "direction" << std::right << std::setw(16) << "per pixel (ms)" << std::setw(14) << "table (ms)" << std::setw(10) << "speedup"
+              << std::setw(16) << "threaded (ms)" << std::setw(10) << "speedup" << std::endl;
+    auto report = [](const char * direction, const char * resolution, double baseline_ms, double table_ms, double threaded_ms, bool match)
+    {
+        std::cout << std::left << std::setw(24) << (std::string(direction) + " " + resolution) << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << baseline_ms << std::setw(14) << table_ms << std::setw(9) << baseline_ms / table_ms << "x"
+                  << std::setw(16) << threaded_ms << std::setw(9) << baseline_ms / threaded_ms << "x" << (match ? "" : "  OUTPUT MISMATCH") << std::endl;
+    };
+
+    int mismatches = 0;
+    for(auto & r : resolutions)
+    {
+        const int color_pixels = r.color_intrin.width * r.color_intrin.height;
+        std::vector<uint16_t> expected_z(color_pixels), actual_z(color_pixels);
+        const double z_baseline = time_call([&]() { std::fill(expected_z.begin(), expected_z.end(), 0); scalar::align_z_to_other(expected_z.data(), depth.data(), z_scale, depth_intrin, depth_to_color, r.color_intrin); }, iterations);
+        const double z_table = time_call([&]() { std::fill(actual_z.begin(), actual_z.end(), 0); rsimpl::align_z_to_other(reinterpret_cast<byte *>(actual_z.data()), table, depth.data(), z_scale, depth_intrin, depth_to_color, r.color_intrin); }, iterations);
+        bool z_match = expected_z == actual_z;
+        rsimpl::pixel_rectangles rectangles;
+        rectangles.resize(depth_intrin);
+        const double z_threaded = time_call([&]()
+        {
+            std::fill(actual_z.begin(), actual_z.end(), 0);
+            int bands = std::min(depth_intrin.height, (threads + 1) * 4);
+            pool.parallel_for(bands, [&](int band)
+            {
+                const int first_row = depth_intrin.height * band / bands;
+                rsimpl::find_z_rectangles(rectangles, table, depth.data(), z_scale, depth_intrin, depth_to_color, r.color_intrin, first_row, depth_intrin.height * (band + 1) / bands - first_row);
+            });
+            bands = std::min(r.color_intrin.height, (threads + 1) * 4);
+            pool.parallel_for(bands, [&](int band)
+            {
+                const int first_row = r.color_intrin.height * band / bands;
+                rsimpl::align_z_to_other(reinterpret_cast<byte *>(actual_z.data()), rectangles, depth.data(), depth_intrin, r.color_intrin, first_row, r.color_intrin.height * (band + 1) / bands - first_row);
+            });
+        }, iterations);
+        z_match = z_match && expected_z == actual_z;
+        if(!z_match) ++mismatches;
+        report("depth -> color", r.name, z_baseline, z_table, z_threaded, z_match);
+
+        std::vector<byte> color(color_pixels * 3), expected_color(depth.size() * 3), actual_color(depth.size() * 3);
+        for(auto & b : color) b = static_cast<byte>(rand());
+        const double c_baseline = time_call([&]() { scalar::align_rgb_to_z(reinterpret_cast<scalar::rgb *>(expected_color.data()), depth.data(), z_scale, depth_intrin, depth_to_color, r.color_intrin, reinterpret_cast<const scalar::rgb *>(color.data())); }, iterations);
+        const double c_table = time_call([&]() { rsimpl::align_other_to_z(actual_color.data(), table, depth.data(), z_scale, depth_intrin, depth_to_color, r.color_intrin, color.data(), RS_FORMAT_RGB8, 0, depth_intrin.height); }, iterations);
+        bool c_match = expected_color == actual_color;
+        std::fill(actual_color.begin(), actual_color.end(), 0);
+        const int bands = std::min(depth_intrin.height, (threads + 1) * 4);
+        const double c_threaded = time_call([&]() { pool.parallel_for(bands, [&](int band)
+        {
+            const int first_row = depth_intrin.height * band / bands;
+            rsimpl::align_other_to_z(actual_color.data(), table, depth.data(), z_scale, depth_intrin, depth_to_color, r.color_intrin, color.data(), RS_FORMAT_RGB8, first_row, depth_intrin.height * (band + 1) / bands - first_row);
+        }); }, iterations);
+        c_match = c_match && expected_color == actual_color;
+        if(!c_match) ++mismatches;
+        report("color -> depth", r.name, c_baseline, c_table, c_threaded, c_match);
+    }
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// Microbenchmark of the lossless depth codec on synthetic depth scenes, reporting how far each compresses and how fast.
+// Usage: depth-codec-benchmark [width height [iterations]]
+
+#include "../src/depth-codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// A room seen by the camera: a back wall, a floor sloping towards the camera and a box in front, with a little noise, and no depth
+// where the projector casts shadows beside the box
+static std::vector<uint16_t> make_room(int width, int height)
+{
+    std::vector<uint16_t> image(width * height);
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            int z = y > height * 2 / 3 ? 3000 - (y - height * 2 / 3) * 4000 / height : 3000;
+            if(x > width / 3 && x < width / 2 && y > height / 3) z = 1200 + (x - width / 3) / 2;
+            if(x >= width / 2 && x < width / 2 + width / 20 && y > height / 3) z = 0;
+            image[y * width + x] = static_cast<uint16_t>(z ? z + rand() % 3 - 1 : 0);
+        }
+    }
+    return image;
+}
+
+// Returns the fastest of several calls in microseconds, which is less sensitive to scheduling noise than the average
+static double time_call(const std::function<void()> & call, int iterations)
+{
+    call(); // Warm up caches
+    double fastest = std::numeric_limits<double>::max();
+    for(int i = 0; i < iterations; ++i)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        call();
+        fastest = std::min(fastest, std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return fastest;
+}
+
+int main(int argc, char * argv[])
+{
+    const int width = argc > 2 ? atoi(argv[1]) : 640, height = argc > 2 ? atoi(argv[2]) : 480;
+    const int iterations = argc > 3 ? atoi(argv[3]) : 200;
+    const int count = width * height;
+
+    std::vector<uint16_t> random(count);
+    for(auto & p : random) p = static_cast<uint16_t>(rand());
+    struct { const char * name; std::vector<uint16_t> image; } cases[] = {
+        { "room", make_room(width, height) },
+        { "no depth", std::vector<uint16_t>(count) },
+        { "random (worst case)", random },
+    };
+
+    std::cout << "Compressing " << width << "x" << height << " depth frames, " << iterations << " iterations per scene" << std::endl;
+    std::cout << std::left << std::setw(22) << "scene" << std::right << std::setw(10) << "ratio" << std::setw(16) << "encode (MB/s)" << std::setw(16) << "decode (MB/s)" << std::endl;
+    int mismatches = 0;
+    for(auto & c : cases)
+    {
+        std::vector<rsimpl::byte> compressed(rsimpl::depth_codec::get_max_size(count));
+        std::vector<uint16_t> restored(count);
+        size_t size = 0;
+        const double encode_us = time_call([&]() { size = rsimpl::depth_codec::compress(compressed.data(), c.image.data(), count); }, iterations);
+        const double decode_us = time_call([&]() { rsimpl::depth_codec::decompress(restored.data(), count, compressed.data(), size); }, iterations);
+        const bool match = restored == c.image;
+        if(!match) ++mismatches;
+
+        const double megabytes = count * sizeof(uint16_t) / 1e6;
+        std::cout << std::left << std::setw(22) << c.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(9) << static_cast<double>(count * sizeof(uint16_t)) / size << "x" << std::setw(16) << megabytes / encode_us * 1e6
+                  << std::setw(16) << megabytes / decode_us * 1e6 << (match ? "" : "  OUTPUT MISMATCH") << std::endl;
+    }
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// Microbenchmark of small_heap allocate/deallocate throughput under contention, against the locked linear scan it replaces.
+// Usage: heap-benchmark [max_threads [seconds]]
+
+#include "../src/types.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace locked
+{
+    // Copy of the mutex protected heap, kept here as the baseline to measure the lock-free heap against
+    template<class T>
+    class small_heap
+    {
+        const int capacity;
+        std::vector<T> buffer;
+        std::vector<bool> is_free;
+        std::mutex mutex;
+        int size = 0;
+
+    public:
+        explicit small_heap(int capacity) : capacity(capacity), buffer(capacity), is_free(capacity, true) {}
+
+        T * allocate()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (auto i = 0; i < capacity; i++)
+            {
+                if (is_free[i])
+                {
+                    is_free[i] = false;
+                    size++;
+                    return &buffer[i];
+                }
+            }
+            return nullptr;
+        }
+
+        void deallocate(T * item)
+        {
+            auto i = item - buffer.data();
+            buffer[i] = std::move(T());
+            std::unique_lock<std::mutex> lock(mutex);
+            is_free[i] = true;
+            size--;
+        }
+    };
+}
+
+// Item the size of a frame_ref, which is what the archive keeps in its heaps
+struct item { void * vtable; void * frame; };
+
+const int capacity = 30*RS_STREAM_COUNT; // As sized for the default frames queue size
+const int held_per_thread = 4; // Every thread holds on to a few items at a time, like an application holding on to a few frames
+
+// Returns allocate/deallocate pairs per second, summed over all threads
+template<class HEAP> static double measure(int threads, double seconds, bool & consistent)
+{
+    HEAP heap(capacity);
+    std::atomic<bool> stop(false);
+    std::vector<unsigned long long> counts(threads);
+    std::vector<std::thread> workers;
+    std::atomic<int> failures(0);
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            item * held[held_per_thread];
+            unsigned long long count = 0;
+            while (!stop)
+            {
+                for (auto & h : held)
+                {
+                    h = heap.allocate();
+                    if (!h) { ++failures; continue; }
+                    h->frame = &held; // Catch two threads holding the same slot
+                }
+                for (auto & h : held)
+                {
+                    if (!h) continue;
+                    if (h->frame != &held) ++failures;
+                    heap.deallocate(h);
+                    ++count;
+                }
+            }
+            counts[t] = count;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto & w : workers) w.join();
+
+    unsigned long long total = 0;
+    for (auto c : counts) total += c;
+    consistent = consistent && failures == 0;
+    return total / seconds;
+}
+
+int main(int argc, char * argv[])
+{
+    const int max_threads = argc > 1 ? atoi(argv[1]) : 8;
+    const double seconds = argc > 2 ? atof(argv[2]) : 1;
+
+    std::cout << "Allocating from a heap of " << capacity << " items, " << held_per_thread << " held per thread, " << seconds << " s per measurement" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads" << std::right << std::setw(18) << "locked (Mops/s)" << std::setw(20) << "lock-free (Mops/s)" << std::setw(10) << "speedup" << std::endl;
+    bool consistent = true;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        const double baseline = measure<locked::small_heap<item>>(threads, seconds, consistent);
+        const double lock_free = measure<rsimpl::small_heap<item>>(threads, seconds, consistent);
+        std::cout << std::left << std::setw(10) << threads << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(18) << baseline / 1e6 << std::setw(20) << lock_free / 1e6 << std::setw(9) << lock_free / baseline << "x" << std::endl;
+    }
+    if (!consistent) std::cout << "HEAP HANDED OUT A SLOT TWICE OR RAN OUT OF SLOTS" << std::endl;
+    return consistent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+// Microbenchmark of the library's pixel unpackers against the generic per pixel templates they replace.
+// Usage: unpack-benchmark [width height [iterations]]
+
+#include "../src/image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+using rsimpl::byte;
+
+#pragma pack(push, 1)
+namespace scalar
+{
+    // Copies of the generic converters, kept here as the baseline to measure the vectorized converters against
+    template<class SOURCE, class SPLIT_A, class SPLIT_B> void split_frame(byte * const dest[], int count, const SOURCE * source, SPLIT_A split_a, SPLIT_B split_b)
+    {
+        auto a = reinterpret_cast<decltype(split_a(SOURCE())) *>(dest[0]);
+        auto b = reinterpret_cast<decltype(split_b(SOURCE())) *>(dest[1]);
+        for(int i=0; i<count; ++i)
+        {
+            *a++ = split_a(*source);
+            *b++ = split_b(*source++);
+        }
+    }
+
+    struct y8i_pixel { uint8_t l, r; };
+    void unpack_y8_y8_from_y8i(byte * const dest[], const byte * source, int count)
+    {
+        split_frame(dest, count, reinterpret_cast<const y8i_pixel *>(source),
+            [](const y8i_pixel & p) -> uint8_t { return p.l; },
+            [](const y8i_pixel & p) -> uint8_t { return p.r; });
+    }
+
+    struct y12i_pixel { uint8_t rl : 8, rh : 4, ll : 4, lh : 8; int l() const { return lh << 4 | ll; } int r() const { return rh << 8 | rl; } };
+    void unpack_y16_y16_from_y12i_10(byte * const dest[], const byte * source, int count)
+    {
+        split_frame(dest, count, reinterpret_cast<const y12i_pixel *>(source),
+            [](const y12i_pixel & p) -> uint16_t { return p.l() << 6 | p.l() >> 4; },
+            [](const y12i_pixel & p) -> uint16_t { return p.r() << 6 | p.r() >> 4; });
+    }
+
+    struct f200_inzi_pixel { uint16_t z16; uint8_t y8; };
+    void unpack_z16_y8_from_f200_inzi(byte * const dest[], const byte * source, int count)
+    {
+        split_frame(dest, count, reinterpret_cast<const f200_inzi_pixel *>(source),
+            [](const f200_inzi_pixel & p) -> uint16_t { return p.z16; },
+            [](const f200_inzi_pixel & p) -> uint8_t { return p.y8; });
+    }
+
+    void unpack_z16_y16_from_f200_inzi(byte * const dest[], const byte * source, int count)
+    {
+        split_frame(dest, count, reinterpret_cast<const f200_inzi_pixel *>(source),
+            [](const f200_inzi_pixel & p) -> uint16_t { return p.z16; },
+            [](const f200_inzi_pixel & p) -> uint16_t { return p.y8 | p.y8 << 8; });
+    }
+
+    void unpack_z16_y8_from_sr300_inzi(byte * const dest[], const byte * source, int count)
+    {
+        auto in = reinterpret_cast<const uint16_t *>(source);
+        auto out_ir = reinterpret_cast<uint8_t *>(dest[1]);
+        for(int i=0; i<count; ++i) *out_ir++ = *in++ >> 2;
+        memcpy(dest[0], in, count*2);
+    }
+
+    void unpack_z16_y16_from_sr300_inzi(byte * const dest[], const byte * source, int count)
+    {
+        auto in = reinterpret_cast<const uint16_t *>(source);
+        auto out_ir = reinterpret_cast<uint16_t *>(dest[1]);
+        for(int i=0; i<count; ++i) *out_ir++ = *in++ << 6;
+        memcpy(dest[0], in, count*2);
+    }
+}
+#pragma pack(pop)
+
+typedef void (* unpack_function)(byte * const dest[], const byte * source, int count);
+
+// Returns the fastest of several calls in microseconds, which is less sensitive to scheduling noise than the average
+static double time_unpacker(unpack_function unpack, byte * const dest[], const byte * source, int count, int iterations)
+{
+    unpack(dest, source, count); // Warm up caches and select the converter
+    double fastest = std::numeric_limits<double>::max();
+    for(int i = 0; i < iterations; ++i)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        unpack(dest, source, count);
+        fastest = std::min(fastest, std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return fastest;
+}
+
+int main(int argc, char * argv[])
+{
+    const int width = argc > 2 ? atoi(argv[1]) : 640, height = argc > 2 ? atoi(argv[2]) : 480;
+    const int iterations = argc > 3 ? atoi(argv[3]) : 200;
+    const int count = width * height;
+
+    struct { const char * name; const rsimpl::native_pixel_format & format; size_t unpacker; unpack_function baseline; } cases[] = {
+        { "Y8I -> Y8 + Y8", rsimpl::pf_y8i,         0, &scalar::unpack_y8_y8_from_y8i },
+        { "Y12I -> Y16 + Y16", rsimpl::pf_y12i,        0, &scalar::unpack_y16_y16_from_y12i_10 },
+        { "F200 INZI -> Z16 + Y8", rsimpl::pf_f200_inzi,  0, &scalar::unpack_z16_y8_from_f200_inzi },
+        { "F200 INZI -> Z16 + Y16", rsimpl::pf_f200_inzi,  1, &scalar::unpack_z16_y16_from_f200_inzi },
+        { "SR300 INZI -> Z16 + Y8", rsimpl::pf_sr300_inzi, 0, &scalar::unpack_z16_y8_from_sr300_inzi },
+        { "SR300 INZI -> Z16 + Y16", rsimpl::pf_sr300_inzi, 1, &scalar::unpack_z16_y16_from_sr300_inzi },
+    };
+
+    std::cout << "Unpacking " << width << "x" << height << " frames, " << iterations << " iterations per converter" << std::endl;
+    std::cout << std::left << std::setw(26) << "format" << std::right << std::setw(14) << "generic (us)" << std::setw(14) << "library (us)" << std::setw(10) << "speedup" << std::endl;
+    int mismatches = 0;
+    for(auto & c : cases)
+    {
+        std::vector<byte> source(c.format.get_image_size(width, height));
+        for(size_t i = 0; i < source.size(); ++i) source[i] = static_cast<byte>(rand());
+
+        std::vector<byte> expected[2], actual[2];
+        for(int i = 0; i < 2; ++i) { expected[i].resize(count * 2); actual[i].resize(count * 2); }
+        byte * expected_dest[] = { expected[0].data(), expected[1].data() }, * actual_dest[] = { actual[0].data(), actual[1].data() };
+
+        const double baseline_us = time_unpacker(c.baseline, expected_dest, source.data(), count, iterations);
+        const double library_us = time_unpacker(c.format.unpackers[c.unpacker].unpack, actual_dest, source.data(), count, iterations);
+        const bool match = expected[0] == actual[0] && expected[1] == actual[1];
+        if(!match) ++mismatches;
+
+        std::cout << std::left << std::setw(26) << c.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << baseline_us << std::setw(14) << library_us << std::setw(9) << baseline_us / library_us << "x"
+                  << (match ? "" : "  OUTPUT MISMATCH") << std::endl;
+    }
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
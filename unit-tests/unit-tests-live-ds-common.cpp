@@ -112,7 +112,17 @@ TEST_CASE("DS-device devices support all required options", "[live] [DS-device]"
                 RS_OPTION_R200_DEPTH_CONTROL_SECOND_PEAK_THRESHOLD,
                 RS_OPTION_R200_DEPTH_CONTROL_NEIGHBOR_THRESHOLD,
                 RS_OPTION_R200_DEPTH_CONTROL_LR_THRESHOLD,
-                RS_OPTION_FRAMES_QUEUE_SIZE
+                RS_OPTION_FRAMES_QUEUE_SIZE,
+                RS_OPTION_ZERO_COPY_ENABLED,
+                RS_OPTION_CAPTURE_RING_DEPTH,
+                RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE,
+                RS_OPTION_CAPTURE_THREAD_AFFINITY,
+                RS_OPTION_CAPTURE_THREAD_PRIORITY,
+                RS_OPTION_CAPTURE_QUEUE_SIZE,
+                RS_OPTION_UNPACK_THREADS,
+                RS_OPTION_UNPACK_ROW_BANDS,
+                RS_OPTION_PROCESSING_THREADS,
+                RS_OPTION_COMPRESS_RECORDED_DEPTH
             };
 
             std::stringstream ss;
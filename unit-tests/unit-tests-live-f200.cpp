@@ -89,7 +89,17 @@ TEST_CASE( "F200 devices support all required options", "[live] [f200]" )
                 RS_OPTION_F200_FILTER_OPTION,
                 RS_OPTION_F200_CONFIDENCE_THRESHOLD,
                 RS_OPTION_F200_DYNAMIC_FPS,
-                RS_OPTION_FRAMES_QUEUE_SIZE
+                RS_OPTION_FRAMES_QUEUE_SIZE,
+                RS_OPTION_ZERO_COPY_ENABLED,
+                RS_OPTION_CAPTURE_RING_DEPTH,
+                RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE,
+                RS_OPTION_CAPTURE_THREAD_AFFINITY,
+                RS_OPTION_CAPTURE_THREAD_PRIORITY,
+                RS_OPTION_CAPTURE_QUEUE_SIZE,
+                RS_OPTION_UNPACK_THREADS,
+                RS_OPTION_UNPACK_ROW_BANDS,
+                RS_OPTION_PROCESSING_THREADS,
+                RS_OPTION_COMPRESS_RECORDED_DEPTH
             };
 
             for(int i=0; i<RS_OPTION_COUNT; ++i)
@@ -110,6 +110,16 @@ TEST_CASE("ZR300 devices support all required options", "[live] [DS-device]")
                 RS_OPTION_FISHEYE_AUTO_EXPOSURE_PIXEL_SAMPLE_RATE,
                 RS_OPTION_FISHEYE_AUTO_EXPOSURE_SKIP_FRAMES,
                 RS_OPTION_FRAMES_QUEUE_SIZE,
+                RS_OPTION_ZERO_COPY_ENABLED,
+                RS_OPTION_CAPTURE_RING_DEPTH,
+                RS_OPTION_CAPTURE_THREAD_PER_SUBDEVICE,
+                RS_OPTION_CAPTURE_THREAD_AFFINITY,
+                RS_OPTION_CAPTURE_THREAD_PRIORITY,
+                RS_OPTION_CAPTURE_QUEUE_SIZE,
+                RS_OPTION_UNPACK_THREADS,
+                RS_OPTION_UNPACK_ROW_BANDS,
+                RS_OPTION_PROCESSING_THREADS,
+                RS_OPTION_COMPRESS_RECORDED_DEPTH,
                 RS_OPTION_HARDWARE_LOGGER_ENABLED
             };
 
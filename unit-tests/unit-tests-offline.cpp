@@ -8,8 +8,16 @@
 
 #include "unit-tests-common.h"
 #include "../src/device.h"
+#include "../src/thread-pool.h"
+#include "../src/image.h"
+#include "../src/recorder.h"
+#include "../src/playback.h"
+#include "../src/depth-codec.h"
+#include "../include/librealsense/rsutil.h"
+#include "../include/librealsense/rs.hpp"
 
 #include <sstream>
+#include <algorithm>
 
 static std::string unknown = "UNKNOWN"; 
 
@@ -35,6 +43,1409 @@ TEST_CASE("wraparound_mechanism produces correct output", "[offline] [validation
     }
 }
 
+TEST_CASE("frame_buffer_pool recycles buffers of its size class", "[offline] [validation]")
+{
+    rsimpl::frame_buffer_pool pool(4);
+    pool.reserve(RS_STREAM_DEPTH, 640 * 480 * 2, 2);
+
+    auto a = pool.acquire(640 * 480 * 2);
+    auto b = pool.acquire(640 * 480 * 2);
+    auto c = pool.acquire(640 * 480 * 2);
+    auto d = pool.acquire(320 * 240 * 2);
+    REQUIRE(a.size() == 640 * 480 * 2);
+    REQUIRE(c.size() == 640 * 480 * 2);
+    REQUIRE(d.size() == 320 * 240 * 2);
+
+    auto stats = pool.get_stats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.allocations == 4);
+
+    // Buffers of a foreign size class are never pooled
+    auto recycled = a.data();
+    pool.release(std::move(a));
+    pool.release(std::move(d));
+    auto e = pool.acquire(640 * 480 * 2);
+    REQUIRE(e.data() == recycled);
+    REQUIRE(pool.get_stats().hits == 3);
+    REQUIRE(pool.get_stats().allocations == 4);
+
+    // Buffers in excess of the pool capacity are freed
+    for (auto i = 0; i < 6; ++i) pool.release(rsimpl::frame_buffer(640 * 480 * 2, RS_STREAM_DEPTH, nullptr));
+    for (auto i = 0; i < 4; ++i) pool.acquire(640 * 480 * 2);
+    REQUIRE(pool.get_stats().hits == 7);
+    pool.acquire(640 * 480 * 2);
+    REQUIRE(pool.get_stats().misses == 3);
+}
+
+TEST_CASE("frame_buffer_pool obtains its buffers from the user allocator", "[offline] [validation]")
+{
+    struct counting_allocator : rs_frame_allocator
+    {
+        int allocated = 0, deallocated = 0;
+        void * allocate(rs_stream stream, size_t size) override
+        {
+            REQUIRE(stream == RS_STREAM_COLOR);
+            ++allocated;
+            if (size > 1024) return nullptr;
+            auto buffer = new rsimpl::byte[size];
+            memset(buffer, 0xff, size);
+            return buffer;
+        }
+        void deallocate(rs_stream stream, void * buffer, size_t) override { REQUIRE(stream == RS_STREAM_COLOR); ++deallocated; delete[] static_cast<rsimpl::byte *>(buffer); }
+        void release() override {}
+    };
+    auto allocator = std::make_shared<counting_allocator>();
+
+    {
+        rsimpl::frame_buffer_pool pool(2);
+        pool.reserve(RS_STREAM_COLOR, 1024, 2, allocator);
+        REQUIRE(allocator->allocated == 2);
+
+        auto a = pool.acquire(1024);
+        auto b = pool.acquire(1024);
+        auto c = pool.acquire(1024);
+        REQUIRE(allocator->allocated == 3);
+        REQUIRE(allocator->deallocated == 0);
+
+        // Buffers start out zeroed, wherever they come from
+        auto is_zero = [](const rsimpl::frame_buffer & buffer) { return std::all_of(buffer.data(), buffer.data() + buffer.size(), [](rsimpl::byte x) { return x == 0; }); };
+        REQUIRE(is_zero(c));
+
+        // Failed user allocations fall back to library memory, which is never handed to deallocate
+        auto d = pool.acquire(2048);
+        REQUIRE(d.size() == 2048);
+        REQUIRE(is_zero(d));
+        REQUIRE(allocator->allocated == 4);
+
+        pool.release(std::move(a));
+        pool.release(std::move(b));
+        pool.release(std::move(c));
+        REQUIRE(allocator->deallocated == 1);
+    }
+    REQUIRE(allocator->deallocated == 3);
+}
+
+TEST_CASE("frame allocator hands a null device to deallocate once the device is gone", "[offline] [validation]")
+{
+    static rs_device * last_device;
+    auto allocate = [](rs_device * dev, rs_stream, int size, void *) -> void * { last_device = dev; return new rsimpl::byte[size]; };
+    auto deallocate = [](rs_device * dev, rs_stream, void * buffer, int, void *) { last_device = dev; delete[] static_cast<rsimpl::byte *>(buffer); };
+    rs_device * device = fake_object_pointer();
+    rsimpl::frame_allocator allocator(device, allocate, deallocate, nullptr);
+
+    void * buffer = allocator.allocate(RS_STREAM_DEPTH, 16);
+    REQUIRE(last_device == device);
+    allocator.detach_device();
+    allocator.deallocate(RS_STREAM_DEPTH, buffer, 16);
+    REQUIRE(last_device == nullptr);
+}
+
+TEST_CASE("ordered_dispatcher runs completions in ticket order", "[offline] [validation]")
+{
+    std::vector<int> delivered;
+    rsimpl::ordered_dispatcher dispatcher;
+    {
+        rsimpl::thread_pool pool(4);
+        for (int i = 0; i < 200; ++i)
+        {
+            auto ticket = dispatcher.issue_ticket();
+            pool.submit([&dispatcher, &delivered, ticket, i]()
+            {
+                // Finish out of order on purpose
+                std::this_thread::sleep_for(std::chrono::microseconds((i * 7919) % 500));
+                dispatcher.complete(ticket, i % 10 == 9 ? std::function<void()>() : [&delivered, i]() { delivered.push_back(i); });
+            });
+        }
+        pool.wait_idle();
+        REQUIRE(delivered.size() == 180);
+    }
+
+    for (size_t i = 1; i < delivered.size(); ++i) REQUIRE(delivered[i - 1] < delivered[i]);
+}
+
+TEST_CASE("timestamp_ring finds the latest timestamps by frame number", "[offline] [validation]")
+{
+    rsimpl::timestamp_ring ring;
+    double timestamp = 0;
+
+    SECTION("only frames within the requested depth are found")
+    {
+        for (unsigned long long i = 1; i <= 1000; ++i) ring.push({ i * 10.0, RS_EVENT_IMU_DEPTH_CAM, i });
+        REQUIRE(ring.find(1000, timestamp, 100));
+        REQUIRE(timestamp == 10000);
+        REQUIRE(ring.find(901, timestamp, 100));
+        REQUIRE(timestamp == 9010);
+        REQUIRE_FALSE(ring.find(900, timestamp, 100));
+        REQUIRE_FALSE(ring.find(1001, timestamp, 100));
+        REQUIRE_FALSE(ring.find(1000 - rsimpl::timestamp_ring::capacity, timestamp, 100000));
+    }
+
+    SECTION("frame numbers are matched across a wraparound of the frame counter")
+    {
+        for (unsigned long long i = std::numeric_limits<unsigned long long>::max() - 5; i != 5; ++i) ring.push({ static_cast<double>(i % 100), RS_EVENT_IMU_DEPTH_CAM, i });
+        REQUIRE(ring.find(std::numeric_limits<unsigned long long>::max() - 1, timestamp, 100));
+        REQUIRE(timestamp == static_cast<double>((std::numeric_limits<unsigned long long>::max() - 1) % 100));
+        REQUIRE(ring.find(4, timestamp, 100));
+        REQUIRE(timestamp == 4);
+    }
+
+    SECTION("a frame counter restarting from a lower number hides the timestamps numbered above it")
+    {
+        for (unsigned long long i = 100; i < 120; ++i) ring.push({ static_cast<double>(i), RS_EVENT_IMU_DEPTH_CAM, i });
+        ring.push({ 1, RS_EVENT_IMU_DEPTH_CAM, 1 });
+        REQUIRE(ring.find(1, timestamp, 100));
+        REQUIRE_FALSE(ring.find(119, timestamp, 100));
+    }
+
+    SECTION("lookups racing with pushes never return the timestamp of another frame")
+    {
+        std::atomic<bool> done(false);
+        std::thread writer([&]()
+        {
+            for (unsigned long long i = 1; i < 200000; ++i) ring.push({ i * 0.5, RS_EVENT_IMU_DEPTH_CAM, i });
+            done = true;
+        });
+        int mismatches = 0;
+        for (unsigned long long i = 0; !done; ++i)
+        {
+            auto frame_number = i % 199999 + 1;
+            if (ring.find(frame_number, timestamp, 400) && timestamp != frame_number * 0.5) ++mismatches;
+        }
+        writer.join();
+        REQUIRE(mismatches == 0);
+    }
+}
+
+TEST_CASE("tagged_index_stack pops the indices last pushed first", "[offline] [validation]")
+{
+    rsimpl::tagged_index_stack full(3, true), empty(3, false);
+    REQUIRE(empty.pop() == -1);
+    REQUIRE(full.pop() == 0);
+    REQUIRE(full.pop() == 1);
+    full.push(0);
+    REQUIRE(full.pop() == 0);
+    REQUIRE(full.pop() == 2);
+    REQUIRE(full.pop() == -1);
+    empty.push(2);
+    empty.push(1);
+    REQUIRE(empty.pop() == 1);
+    REQUIRE(empty.pop() == 2);
+    REQUIRE(empty.pop() == -1);
+}
+
+TEST_CASE("small_heap hands each slot to one thread at a time", "[offline] [validation]")
+{
+    rsimpl::small_heap<std::unique_ptr<int>> heap(8);
+
+    SECTION("the heap is bounded, and slots are reset when they are handed back")
+    {
+        std::vector<std::unique_ptr<int> *> items;
+        while (auto item = heap.allocate()) items.push_back(item);
+        REQUIRE(items.size() == 8);
+        *items[3] = std::unique_ptr<int>(new int(3));
+        heap.deallocate(items[3]);
+        auto item = heap.allocate();
+        REQUIRE(item == items[3]);
+        REQUIRE_FALSE(*item);
+        REQUIRE_THROWS(heap.deallocate(nullptr));
+    }
+
+    SECTION("no slot is held by two threads at once")
+    {
+        std::atomic<int> collisions(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&heap, &collisions, t]()
+            {
+                for (int i = 0; i < 20000; ++i)
+                {
+                    auto item = heap.allocate();
+                    if (!item) continue;
+                    if (*item) ++collisions;
+                    item->reset(new int(t));
+                    if (**item != t) ++collisions;
+                    heap.deallocate(item);
+                }
+            });
+        }
+        for (auto & thread : threads) thread.join();
+        REQUIRE(collisions == 0);
+    }
+
+    SECTION("wait_until_empty returns once the last slot is handed back, and nothing is allocated after stop_allocation")
+    {
+        auto item = heap.allocate();
+        heap.stop_allocation();
+        REQUIRE(heap.allocate() == nullptr);
+        std::thread releaser([&heap, item]() { std::this_thread::sleep_for(std::chrono::milliseconds(10)); heap.deallocate(item); });
+        heap.wait_until_empty();
+        releaser.join();
+    }
+}
+
+TEST_CASE("spsc_queue hands items over in order between a producer and a consumer thread", "[offline] [validation]")
+{
+    rsimpl::spsc_queue<std::unique_ptr<int>, 4> queue;
+
+    SECTION("the queue is bounded, and pushing to a full queue leaves the item with the caller")
+    {
+        for (int i = 0; i < 4; ++i) REQUIRE(queue.push(std::unique_ptr<int>(new int(i))));
+        REQUIRE(queue.full());
+        std::unique_ptr<int> rejected(new int(4));
+        REQUIRE_FALSE(queue.push(std::move(rejected)));
+        REQUIRE(rejected);
+        REQUIRE(*queue.front() == 0);
+        REQUIRE(*queue.back() == 3);
+        REQUIRE(*queue[2] == 2);
+
+        queue.front().reset();
+        queue.pop_front();
+        REQUIRE(queue.push(std::move(rejected)));
+        REQUIRE(queue.size() == 4);
+        REQUIRE(*queue.front() == 1);
+        REQUIRE(*queue.back() == 4);
+    }
+
+    SECTION("items pushed by one thread are popped by another in order")
+    {
+        const int count = 100000;
+        std::thread producer([&]()
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                std::unique_ptr<int> item(new int(i));
+                while (!queue.push(std::move(item))) std::this_thread::yield();
+            }
+        });
+        int expected = 0;
+        bool in_order = true;
+        while (expected < count)
+        {
+            if (queue.empty()) { std::this_thread::yield(); continue; }
+            auto item = std::move(queue.front());
+            queue.pop_front();
+            in_order = in_order && *item == expected++;
+        }
+        producer.join();
+        REQUIRE(in_order);
+        REQUIRE(queue.empty());
+    }
+}
+
+TEST_CASE("frame metadata is only reported where the frame carries it", "[offline] [validation]")
+{
+    rsimpl::frame_archive::frame with_exposure, without_exposure;
+    with_exposure.additional_data = rsimpl::frame_archive::frame_additional_data(0, 1, 0, 640, 480, 30, 640, 480, 2, RS_FORMAT_Z16, RS_STREAM_DEPTH, 0, 1 << RS_FRAME_METADATA_ACTUAL_EXPOSURE, 12.5);
+    without_exposure.additional_data = rsimpl::frame_archive::frame_additional_data(0, 1, 0, 640, 480, 30, 640, 480, 2, RS_FORMAT_Z16, RS_STREAM_DEPTH, 0, 0, 12.5);
+
+    REQUIRE(with_exposure.supports_frame_metadata(RS_FRAME_METADATA_ACTUAL_EXPOSURE));
+    REQUIRE(with_exposure.get_frame_metadata(RS_FRAME_METADATA_ACTUAL_EXPOSURE) == 12.5);
+    REQUIRE_FALSE(with_exposure.supports_frame_metadata(RS_FRAME_METADATA_COUNT));
+    REQUIRE_FALSE(without_exposure.supports_frame_metadata(RS_FRAME_METADATA_ACTUAL_EXPOSURE));
+    REQUIRE_THROWS(without_exposure.get_frame_metadata(RS_FRAME_METADATA_ACTUAL_EXPOSURE));
+}
+
+TEST_CASE("object_pool hands out aligned objects which keep their address", "[offline] [validation]")
+{
+    REQUIRE(alignof(rsimpl::frame_archive::frame) == RS_CACHE_LINE_SIZE);
+
+    rsimpl::object_pool<rsimpl::frame_archive::frame, 4> pool;
+    std::vector<rsimpl::frame_archive::frame *> frames;
+    for (int i = 0; i < 6; ++i)
+    {
+        auto frame = pool.allocate();
+        REQUIRE(reinterpret_cast<uintptr_t>(frame) % RS_CACHE_LINE_SIZE == 0);
+        REQUIRE(std::find(frames.begin(), frames.end(), frame) == frames.end());
+        frames.push_back(frame);
+    }
+    REQUIRE(pool.capacity() == 8);
+
+    // Released objects are handed out again before the pool grows
+    for (auto frame : frames) pool.deallocate(frame);
+    for (int i = 0; i < 8; ++i)
+    {
+        auto frame = pool.allocate();
+        REQUIRE(reinterpret_cast<uintptr_t>(frame) % RS_CACHE_LINE_SIZE == 0);
+    }
+    REQUIRE(pool.capacity() == 8);
+}
+
+struct fake_frame : rsimpl::frame_interface
+{
+    unsigned long long number;
+    rs_stream stream;
+    double timestamp;
+    rs_timestamp_domain domain;
+
+    fake_frame(unsigned long long number, rs_stream stream) : number(number), stream(stream), timestamp(-static_cast<double>(number)), domain(RS_TIMESTAMP_DOMAIN_CAMERA) {}
+    double get_frame_metadata(rs_frame_metadata) const override { return 0; }
+    bool supports_frame_metadata(rs_frame_metadata) const override { return false; }
+    unsigned long long get_frame_number() const override { return number; }
+    void set_timestamp(double new_ts) override { timestamp = new_ts; }
+    void set_timestamp_domain(rs_timestamp_domain timestamp_domain) override { domain = timestamp_domain; }
+    rs_stream get_stream_type() const override { return stream; }
+};
+
+TEST_CASE("timestamp_corrector releases frames without blocking the caller", "[offline] [validation]")
+{
+    std::atomic<uint32_t> queue_size(4), timeout(60000);
+    rsimpl::timestamp_correction_stats stats;
+    std::mutex mutex;
+    std::vector<std::pair<unsigned long long, bool>> released;
+    auto release = [&](fake_frame & f) { return [&](bool keep) { std::lock_guard<std::mutex> lock(mutex); released.push_back({ f.number, keep }); }; };
+    auto wait_for_releases = [&](size_t count)
+    {
+        for (int i = 0; i < 2000; ++i)
+        {
+            { std::lock_guard<std::mutex> lock(mutex); if (released.size() >= count) return released.size(); }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        return released.size();
+    };
+    fake_frame f1(1, RS_STREAM_DEPTH), f2(2, RS_STREAM_DEPTH), f3(3, RS_STREAM_DEPTH), f4(4, RS_STREAM_DEPTH);
+
+    SECTION("frames of a source that never reported a timestamp pass straight through")
+    {
+        rsimpl::timestamp_corrector corrector(&queue_size, &timeout, &stats);
+        corrector.correct_timestamp(f1, RS_STREAM_DEPTH, release(f1));
+        REQUIRE(released.size() == 1);
+        REQUIRE(released[0].second);
+        REQUIRE(f1.domain == RS_TIMESTAMP_DOMAIN_CAMERA);
+        REQUIRE(stats.late == 1);
+    }
+
+    SECTION("parked frames are released in order once their timestamps arrive")
+    {
+        rsimpl::timestamp_corrector corrector(&queue_size, &timeout, &stats);
+        corrector.on_timestamp({ 10, RS_EVENT_IMU_DEPTH_CAM, 1 });
+        corrector.correct_timestamp(f1, RS_STREAM_DEPTH, release(f1));
+        auto start = std::chrono::steady_clock::now();
+        corrector.correct_timestamp(f2, RS_STREAM_DEPTH, release(f2));
+        corrector.correct_timestamp(f3, RS_STREAM_DEPTH, release(f3));
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+        REQUIRE(wait_for_releases(1) == 1);
+
+        corrector.on_timestamp({ 30, RS_EVENT_IMU_DEPTH_CAM, 3 }); // The timestamp of frame 2 never arrives
+        REQUIRE(wait_for_releases(3) == 3);
+        REQUIRE(released[1].first == 2);
+        REQUIRE(released[2].first == 3);
+        REQUIRE(f1.timestamp == 10);
+        REQUIRE(f2.timestamp == -2);
+        REQUIRE(f3.timestamp == 30);
+        REQUIRE(f3.domain == RS_TIMESTAMP_DOMAIN_MICROCONTROLLER);
+        REQUIRE(stats.matched == 2);
+        REQUIRE(stats.late == 1);
+    }
+
+    SECTION("parked frames keep their camera timestamp once their deadline passes")
+    {
+        timeout = 20;
+        rsimpl::timestamp_corrector corrector(&queue_size, &timeout, &stats);
+        corrector.on_timestamp({ 10, RS_EVENT_IMU_DEPTH_CAM, 1 });
+        corrector.correct_timestamp(f2, RS_STREAM_DEPTH, release(f2));
+        REQUIRE(wait_for_releases(1) == 1);
+        REQUIRE(released[0].second);
+        REQUIRE(f2.domain == RS_TIMESTAMP_DOMAIN_CAMERA);
+        REQUIRE(stats.late == 1);
+    }
+
+    SECTION("frames whose timestamp goes back in time are dropped")
+    {
+        rsimpl::timestamp_corrector corrector(&queue_size, &timeout, &stats);
+        corrector.on_timestamp({ 20, RS_EVENT_IMU_DEPTH_CAM, 1 });
+        corrector.on_timestamp({ 10, RS_EVENT_IMU_DEPTH_CAM, 2 });
+        corrector.correct_timestamp(f1, RS_STREAM_DEPTH, release(f1));
+        corrector.correct_timestamp(f2, RS_STREAM_DEPTH, release(f2));
+        REQUIRE(wait_for_releases(2) == 2);
+        REQUIRE(released[0].second);
+        REQUIRE_FALSE(released[1].second);
+        REQUIRE(stats.matched == 1);
+        REQUIRE(stats.dropped == 1);
+    }
+
+    SECTION("the oldest parked frame gives way once too many frames wait, and flush discards the rest")
+    {
+        queue_size = 2;
+        rsimpl::timestamp_corrector corrector(&queue_size, &timeout, &stats);
+        corrector.on_timestamp({ 0, RS_EVENT_IMU_DEPTH_CAM, 0 });
+        corrector.correct_timestamp(f1, RS_STREAM_DEPTH, release(f1));
+        corrector.correct_timestamp(f2, RS_STREAM_DEPTH, release(f2));
+        corrector.correct_timestamp(f3, RS_STREAM_DEPTH, release(f3));
+        REQUIRE(wait_for_releases(1) == 1);
+        REQUIRE(released[0].first == 1);
+        REQUIRE(released[0].second);
+
+        corrector.flush();
+        REQUIRE(released.size() == 3);
+        REQUIRE_FALSE(released[1].second);
+        REQUIRE_FALSE(released[2].second);
+        REQUIRE(stats.late == 1);
+        REQUIRE(stats.dropped == 2);
+
+        corrector.correct_timestamp(f4, RS_STREAM_DEPTH, release(f4)); // Left parked for the destructor to discard
+    }
+}
+
+struct fake_frame_ref : rs_frame_ref
+{
+    rs_stream stream;
+    double timestamp;
+    rs_timestamp_domain domain;
+
+    fake_frame_ref(rs_stream stream, double timestamp, rs_timestamp_domain domain = RS_TIMESTAMP_DOMAIN_CAMERA) : stream(stream), timestamp(timestamp), domain(domain) {}
+    const uint8_t * get_frame_data() const override { return nullptr; }
+    double get_frame_timestamp() const override { return timestamp; }
+    rs_timestamp_domain get_frame_timestamp_domain() const override { return domain; }
+    unsigned long long get_frame_number() const override { return 0; }
+    long long get_frame_system_time() const override { return 0; }
+    int get_frame_width() const override { return 0; }
+    int get_frame_height() const override { return 0; }
+    int get_frame_framerate() const override { return 30; }
+    int get_frame_stride() const override { return 0; }
+    int get_frame_bpp() const override { return 0; }
+    rs_format get_frame_format() const override { return RS_FORMAT_ANY; }
+    rs_stream get_stream_type() const override { return stream; }
+    double get_frame_metadata(rs_frame_metadata) const override { return 0; }
+    bool supports_frame_metadata(rs_frame_metadata) const override { return false; }
+};
+
+TEST_CASE("frameset_synchronizer matches frames within the tolerance of each pair of streams", "[offline] [validation]")
+{
+    double tolerances[RS_STREAM_NATIVE_COUNT][RS_STREAM_NATIVE_COUNT];
+    for (auto & row : tolerances) for (auto & t : row) t = 5;
+    std::mutex mutex;
+    std::atomic<bool> handler_blocked(false);
+    std::atomic<int> handler_calls(0);
+    std::vector<std::vector<rs_frame_ref *>> framesets; // Filled from the dispatch thread
+    std::vector<rs_frame_ref *> released;
+    auto make_synchronizer = [&](rs_frameset_policy policy)
+    {
+        return std::make_shared<rsimpl::frameset_synchronizer>(std::vector<rs_stream>{ RS_STREAM_DEPTH, RS_STREAM_COLOR, RS_STREAM_INFRARED }, RS_STREAM_DEPTH, tolerances, policy,
+            [&](std::vector<rs_frame_ref *> & frames)
+            {
+                ++handler_calls;
+                while (handler_blocked) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock(mutex);
+                framesets.push_back(frames);
+            },
+            [&](rs_frame_ref * frame) { released.push_back(frame); });
+    };
+    auto wait_for_framesets = [&](size_t count)
+    {
+        for (int i = 0; i < 2000; ++i)
+        {
+            { std::lock_guard<std::mutex> lock(mutex); if (framesets.size() >= count) return framesets.size(); }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        return framesets.size();
+    };
+    fake_frame_ref depth(RS_STREAM_DEPTH, 100), color(RS_STREAM_COLOR, 102), infrared(RS_STREAM_INFRARED, 99);
+
+    SECTION("a frame of every stream forms a complete frameset, with the key frame first")
+    {
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_WAIT);
+        REQUIRE(sync->is_synchronized(RS_STREAM_COLOR));
+        REQUIRE_FALSE(sync->is_synchronized(RS_STREAM_FISHEYE));
+        sync->add(&color);
+        sync->add(&depth);
+        REQUIRE(framesets.empty());
+        sync->add(&infrared);
+        REQUIRE(wait_for_framesets(1) == 1);
+        REQUIRE(framesets[0] == std::vector<rs_frame_ref *>({ &depth, &color, &infrared }));
+        auto stats = sync->get_stats();
+        REQUIRE(stats.complete_framesets == 1);
+        REQUIRE(stats.max_sync_error == 3);
+        REQUIRE(stats.mean_sync_error == 3);
+        REQUIRE(released.empty());
+    }
+
+    SECTION("waiting policy drops the frameset once a stream skipped the key frame")
+    {
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_WAIT);
+        fake_frame_ref late_infrared(RS_STREAM_INFRARED, 133);
+        sync->add(&depth);
+        sync->add(&color);
+        sync->add(&late_infrared);
+        REQUIRE(framesets.empty());
+        REQUIRE(released == std::vector<rs_frame_ref *>({ &depth, &color }));
+        REQUIRE(sync->get_stats().dropped_framesets == 1);
+    }
+
+    SECTION("incomplete framesets are emitted once the stream fell behind by more than the allowed key frames")
+    {
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_EMIT_INCOMPLETE);
+        fake_frame_ref depth2(RS_STREAM_DEPTH, 133), depth3(RS_STREAM_DEPTH, 166);
+        sync->add(&depth);
+        sync->add(&color);
+        sync->add(&depth2);
+        REQUIRE(framesets.empty());
+        sync->add(&depth3);
+        REQUIRE(wait_for_framesets(1) == 1);
+        REQUIRE(framesets[0] == std::vector<rs_frame_ref *>({ &depth, &color }));
+        REQUIRE(sync->get_stats().incomplete_framesets == 1);
+
+        sync->flush();
+        REQUIRE(released == std::vector<rs_frame_ref *>({ &depth2, &depth3 }));
+        REQUIRE(sync->get_stats().dropped_framesets == 2);
+    }
+
+    SECTION("drop policy discards incomplete framesets")
+    {
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_DROP);
+        fake_frame_ref depth2(RS_STREAM_DEPTH, 133), depth3(RS_STREAM_DEPTH, 166);
+        sync->add(&depth);
+        sync->add(&color);
+        sync->add(&depth2);
+        sync->add(&depth3);
+        REQUIRE(framesets.empty());
+        REQUIRE(released == std::vector<rs_frame_ref *>({ &depth, &color }));
+        REQUIRE(sync->get_stats().dropped_framesets == 1);
+    }
+
+    SECTION("stale frames are dropped, and frames of another timestamp domain never match")
+    {
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_WAIT);
+        fake_frame_ref stale_color(RS_STREAM_COLOR, 60), other_domain_infrared(RS_STREAM_INFRARED, 100, RS_TIMESTAMP_DOMAIN_MICROCONTROLLER);
+        sync->add(&stale_color);
+        sync->add(&other_domain_infrared);
+        sync->add(&color);
+        sync->add(&depth);
+        REQUIRE(framesets.empty());
+        REQUIRE(released == std::vector<rs_frame_ref *>({ &stale_color }));
+        sync->add(&infrared);
+        REQUIRE(wait_for_framesets(1) == 1);
+        REQUIRE(framesets[0] == std::vector<rs_frame_ref *>({ &depth, &color, &infrared }));
+        REQUIRE(sync->get_stats().dropped_frames == 1);
+    }
+
+    SECTION("frames close to the key frame but not to each other leave out the one further from the key frame")
+    {
+        tolerances[RS_STREAM_COLOR][RS_STREAM_INFRARED] = tolerances[RS_STREAM_INFRARED][RS_STREAM_COLOR] = 2;
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_EMIT_INCOMPLETE);
+        fake_frame_ref far_color(RS_STREAM_COLOR, 104), near_infrared(RS_STREAM_INFRARED, 97);
+        sync->add(&far_color);
+        sync->add(&near_infrared);
+        sync->add(&depth);
+        REQUIRE(wait_for_framesets(1) == 1);
+        REQUIRE(framesets[0] == std::vector<rs_frame_ref *>({ &depth, &near_infrared }));
+        REQUIRE(sync->get_stats().incomplete_framesets == 1);
+        REQUIRE(sync->get_stats().max_sync_error == 3);
+
+        sync->flush();
+        REQUIRE(released == std::vector<rs_frame_ref *>({ &far_color }));
+        REQUIRE(sync->get_stats().dropped_frames == 1);
+    }
+
+    SECTION("a slow frameset handler holds up neither the caller nor the matching, and only the newest framesets wait for it")
+    {
+        handler_blocked = true;
+        auto sync = make_synchronizer(RS_FRAMESET_POLICY_WAIT);
+        const size_t count = rsimpl::frameset_synchronizer::max_ready_framesets + 2;
+        std::vector<std::unique_ptr<fake_frame_ref>> frames;
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (auto stream : { RS_STREAM_DEPTH, RS_STREAM_COLOR, RS_STREAM_INFRARED }) frames.emplace_back(new fake_frame_ref(stream, 100 + 33.0 * i));
+            for (size_t j = frames.size() - 3; j < frames.size(); ++j) sync->add(frames[j].get());
+            while (handler_calls == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1)); // The first frameset keeps the handler busy
+        }
+        auto stats = sync->get_stats();
+        REQUIRE(stats.complete_framesets == count);
+        REQUIRE(stats.dropped_framesets == 1);
+        REQUIRE(released == std::vector<rs_frame_ref *>({ frames[3].get(), frames[4].get(), frames[5].get() }));
+
+        handler_blocked = false;
+        REQUIRE(wait_for_framesets(count - 1) == count - 1);
+        REQUIRE(framesets[0][0] == frames[0].get());
+        REQUIRE(framesets[1][0] == frames[6].get());
+        REQUIRE(framesets.back()[0] == frames[3 * count - 3].get());
+    }
+}
+
+TEST_CASE("capture errors wake and fail the waits for frames", "[offline] [validation]")
+{
+    const rs_intrinsics intrin = { 32, 16, 16, 8, 20, 20, RS_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+    const rsimpl::subdevice_mode mode = { 0, { 32, 16 }, rsimpl::pf_z16, 30, intrin, {}, { 0 } };
+    std::atomic<uint32_t> queue_size(4), event_queue_size(4), events_timeout(60000);
+    rsimpl::timestamp_correction_stats stats;
+    rsimpl::syncronizing_archive archive({ rsimpl::subdevice_mode_selection(mode, 0, 0) }, RS_STREAM_DEPTH, &queue_size, &event_queue_size, &events_timeout, &stats, std::chrono::high_resolution_clock::now());
+
+    REQUIRE_FALSE(archive.poll_for_frames());
+    REQUIRE_FALSE(archive.wait_for_frames(std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+
+    std::thread capture([&]() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); archive.report_capture_error("capture stopped: VIDIOC_DQBUF error 5, Input/output error"); });
+    const auto started = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(archive.wait_for_frames(started + std::chrono::seconds(60)), const std::runtime_error &);
+    REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(60));
+    capture.join();
+
+    REQUIRE_THROWS_AS(archive.poll_for_frames(), const std::runtime_error &);
+    REQUIRE_THROWS_AS(archive.wait_for_frames_safe(), const std::runtime_error &);
+}
+
+TEST_CASE("frames not taken over after timestamp correction go back to the pools", "[offline] [validation]")
+{
+    const rs_intrinsics intrin = { 32, 16, 16, 8, 20, 20, RS_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+    const rsimpl::subdevice_mode mode = { 0, { 32, 16 }, rsimpl::pf_z16, 30, intrin, {}, { 0 } };
+    std::atomic<uint32_t> queue_size(4), event_queue_size(4), events_timeout(60000);
+    rsimpl::timestamp_correction_stats stats;
+    rsimpl::syncronizing_archive archive({ rsimpl::subdevice_mode_selection(mode, 0, 0) }, RS_STREAM_DEPTH, &queue_size, &event_queue_size, &events_timeout, &stats, std::chrono::high_resolution_clock::now());
+
+    int released = 0, delivered = 0;
+    for (bool taken : { false, true })
+    {
+        archive.alloc_frame(RS_STREAM_DEPTH, rsimpl::frame_archive::frame_additional_data(0, 1, 0, 32, 16, 30, 32, 16, 2, RS_FORMAT_Z16, RS_STREAM_DEPTH, 0, 0, 0), true);
+        archive.attach_continuation(RS_STREAM_DEPTH, rsimpl::frame_continuation([&]() { ++released; }, nullptr));
+        archive.set_frame_delivery(RS_STREAM_DEPTH, [&, taken](rsimpl::frame_archive::frame * frame)
+        {
+            ++delivered;
+            if (taken) archive.commit_frame(RS_STREAM_DEPTH, frame);
+            return taken;
+        });
+        archive.correct_timestamp(RS_STREAM_DEPTH);
+    }
+    REQUIRE(delivered == 2);
+    REQUIRE(released == 1); // The frame handed back ran its continuation, the committed one still holds it
+
+    REQUIRE(archive.poll_for_frames());
+    archive.flush();
+}
+
+TEST_CASE("holding as many frames as the frame queue size allows allocates nothing", "[offline] [validation]")
+{
+    const rs_intrinsics intrin = { 32, 16, 16, 8, 20, 20, RS_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+    const rsimpl::subdevice_mode mode = { 0, { 32, 16 }, rsimpl::pf_z16, 30, intrin, {}, { 0 } };
+    const uint32_t held_frames = 12;
+    std::atomic<uint32_t> queue_size(held_frames), event_queue_size(4), events_timeout(60000);
+    rsimpl::timestamp_correction_stats stats;
+    rsimpl::syncronizing_archive archive({ rsimpl::subdevice_mode_selection(mode, 0, 0) }, RS_STREAM_DEPTH, &queue_size, &event_queue_size, &events_timeout, &stats, std::chrono::high_resolution_clock::now());
+
+    // The pools make room for the frames parked by the timestamp corrector and queued by the frameset synchronizer as well
+    REQUIRE(archive.get_frames_per_stream() > held_frames + 1 + event_queue_size.load() + rsimpl::frameset_synchronizer::max_queued_frames);
+    REQUIRE(archive.get_frame_pool_capacity() >= archive.get_frames_per_stream() * RS_STREAM_NATIVE_COUNT);
+
+    // Preallocated like the device does it, a buffer for each frame the user may hold and one for the backbuffer
+    archive.reserve_frame_buffers(RS_STREAM_DEPTH, 32 * 16 * 2, held_frames + 1, nullptr);
+    const auto reserved = archive.get_frame_buffer_stats(RS_STREAM_DEPTH);
+    const auto frame_pool_capacity = archive.get_frame_pool_capacity();
+
+    unsigned long long frame_number = 0;
+    for (int round = 0; round < 3; ++round)
+    {
+        std::vector<rsimpl::frame_archive::frame_ref *> held;
+        for (uint32_t i = 0; i < held_frames; ++i)
+        {
+            archive.alloc_frame(RS_STREAM_DEPTH, rsimpl::frame_archive::frame_additional_data(0, ++frame_number, 0, 32, 16, 30, 32, 16, 2, RS_FORMAT_Z16, RS_STREAM_DEPTH, 0, 0, 0), true);
+            auto ref = archive.track_frame(RS_STREAM_DEPTH);
+            REQUIRE(ref);
+            held.push_back(ref);
+        }
+
+        // One frame more than the user may hold is dropped, and its buffer recycled
+        archive.alloc_frame(RS_STREAM_DEPTH, rsimpl::frame_archive::frame_additional_data(0, ++frame_number, 0, 32, 16, 30, 32, 16, 2, RS_FORMAT_Z16, RS_STREAM_DEPTH, 0, 0, 0), true);
+        REQUIRE_FALSE(archive.track_frame(RS_STREAM_DEPTH));
+
+        for (auto ref : held) archive.release_frame_ref(ref);
+
+        const auto current = archive.get_frame_buffer_stats(RS_STREAM_DEPTH);
+        REQUIRE(current.allocations == reserved.allocations);
+        REQUIRE(current.misses == reserved.misses);
+        REQUIRE(archive.get_frame_pool_capacity() == frame_pool_capacity);
+    }
+    archive.flush();
+}
+
+TEST_CASE("recorder writes aligned chunks followed by an index of them", "[offline] [validation]")
+{
+    using namespace rsimpl::capture_file;
+    const char * filename = "recorder-test.rscap";
+    std::vector<uint8_t> frame(1000);
+    for (size_t i = 0; i < frame.size(); ++i) frame[i] = static_cast<uint8_t>(i * 31);
+    {
+        rsimpl::stream_request requests[RS_STREAM_NATIVE_COUNT] = {};
+        rsimpl::recorder r(filename);
+        r.record_stream_config({}, requests, 0.001f);
+        for (int i = 0; i < 3; ++i) r.record_frame(1, 'Z16 ', 25, 20, frame.data(), frame.size(), 100.0 + i, i + 1);
+        r.record_motion({ { 12.5, RS_EVENT_IMU_GYRO, 7 }, 1, { 1, 2, 3 } });
+        r.record_timestamp({ 13.5, RS_EVENT_IMU_DEPTH_CAM, 8 });
+        r.close();
+        REQUIRE(r.get_dropped_chunks() == 0);
+    }
+
+    std::ifstream in(filename, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(filename);
+
+    // Walk the chunks from the start of the file
+    std::vector<chunk_type> types;
+    std::vector<uint64_t> offsets;
+    for (uint64_t offset = 0; offset < file.size(); )
+    {
+        REQUIRE(offset % CHUNK_ALIGNMENT == 0);
+        chunk_header header;
+        memcpy(&header, file.data() + offset, sizeof(header));
+        REQUIRE(header.header_size % CHUNK_ALIGNMENT == 0);
+        if (header.type == chunk_type::video_frame) REQUIRE(memcmp(file.data() + offset + header.header_size, frame.data(), frame.size()) == 0);
+        types.push_back(header.type);
+        offsets.push_back(offset);
+        offset += header.header_size + align(header.payload_size);
+    }
+    REQUIRE(types == std::vector<chunk_type>({ chunk_type::file_header, chunk_type::stream_config, chunk_type::video_frame, chunk_type::video_frame, chunk_type::video_frame,
+                                               chunk_type::motion_event, chunk_type::timestamp_event, chunk_type::index, chunk_type::trailer }));
+
+    // The trailer leads to the index, which lists every chunk but the header and the index itself
+    trailer t;
+    memcpy(&t, file.data() + offsets.back() + sizeof(chunk_header), sizeof(t));
+    REQUIRE(t.magic == MAGIC);
+    REQUIRE(t.index_offset == offsets[7]);
+    REQUIRE(t.index_size == 6 * sizeof(index_entry));
+    std::vector<index_entry> entries(6);
+    memcpy(entries.data(), file.data() + t.index_offset + get_header_size<index_table>(), t.index_size);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        REQUIRE(entries[i].offset == offsets[i + 1]);
+        REQUIRE(entries[i].type == types[i + 1]);
+        REQUIRE(entries[i].subdevice == (entries[i].type == chunk_type::video_frame ? 1 : -1));
+    }
+
+    video_frame last;
+    memcpy(&last, file.data() + offsets[4] + sizeof(chunk_header), sizeof(last));
+    REQUIRE(last.frame_number == 2);
+    REQUIRE(last.frame_counter == 3);
+    REQUIRE(last.timestamp == 102.0);
+    REQUIRE(last.width == 25);
+    REQUIRE(last.fourcc == 'Z16 ');
+}
+
+TEST_CASE("playback device delivers recorded frames through the stream callbacks", "[offline] [validation]")
+{
+    const char * filename = "playback-test.rscap";
+    const int width = 32, height = 16, frame_count = 10;
+    rsimpl::static_device_info info;
+    info.name = "Recorded camera";
+    info.serial = "1234";
+    info.firmware_version = "1.0";
+    info.stream_subdevices[RS_STREAM_DEPTH] = 0;
+    const rs_intrinsics intrin = { width, height, width / 2.0f, height / 2.0f, 20, 20, RS_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+    const rsimpl::subdevice_mode mode = { 0, { width, height }, rsimpl::pf_z16, 30, intrin, {}, { 0 } };
+    info.subdevice_modes.push_back(mode);
+
+    rsimpl::stream_request requests[RS_STREAM_NATIVE_COUNT] = {};
+    requests[RS_STREAM_DEPTH] = { true, width, height, RS_FORMAT_Z16, 30, RS_OUTPUT_BUFFER_FORMAT_CONTINUOUS };
+    {
+        rsimpl::recorder r(filename);
+        r.record_device_info(info, { RS_CAPABILITIES_DEPTH }, nullptr, nullptr);
+        r.record_stream_config({ rsimpl::subdevice_mode_selection(mode, 0, 0) }, requests, 0.002f);
+        std::vector<uint16_t> frame(width * height);
+        for (int i = 0; i < frame_count; ++i)
+        {
+            std::fill(frame.begin(), frame.end(), static_cast<uint16_t>(1000 + i));
+            r.record_frame(0, rsimpl::pf_z16.fourcc, width, height, frame.data(), frame.size() * sizeof(uint16_t), 100.0 + 33.0 * i, i + 1);
+        }
+        r.close();
+    }
+
+    struct received_frames { std::vector<uint16_t> values; std::vector<double> timestamps; std::vector<unsigned long long> numbers; } received;
+    auto on_frame = [](rs_device * device, rs_frame_ref * frame, void * user)
+    {
+        auto r = static_cast<received_frames *>(user);
+        r->values.push_back(reinterpret_cast<const uint16_t *>(frame->get_frame_data())[width * height - 1]);
+        r->timestamps.push_back(frame->get_frame_timestamp());
+        r->numbers.push_back(frame->get_frame_number());
+        device->release_frame(frame);
+    };
+
+    SECTION("stepping and seeking")
+    {
+        auto device = rsimpl::make_playback_device(filename);
+        REQUIRE(device->get_name() == std::string("Recorded camera"));
+        REQUIRE(device->get_stream_interface(RS_STREAM_DEPTH).is_enabled());
+        REQUIRE(device->get_depth_scale() == 0.001f);
+        REQUIRE(!device->supports_option(RS_OPTION_COLOR_GAIN));
+
+        device->set_stream_callback(RS_STREAM_DEPTH, on_frame, &received);
+        device->set_playback_mode(RS_PLAYBACK_MODE_STEPPED);
+        device->start(RS_SOURCE_VIDEO);
+        REQUIRE(device->get_depth_scale() == 0.002f);
+        REQUIRE(device->step_playback());
+        REQUIRE(device->step_playback());
+        device->seek_playback(1e9);
+        REQUIRE(!device->step_playback());
+        device->seek_playback(0);
+        REQUIRE(device->step_playback());
+        device->stop(RS_SOURCE_VIDEO);
+
+        REQUIRE(received.values == std::vector<uint16_t>({ 1000, 1001, 1000 }));
+        REQUIRE(received.timestamps == std::vector<double>({ 100.0, 133.0, 100.0 }));
+        REQUIRE(received.numbers == std::vector<unsigned long long>({ 1, 2, 1 }));
+    }
+
+    SECTION("frames unpacked on worker threads arrive in capture order")
+    {
+        struct held_frames { std::mutex mutex; std::vector<rs_frame_ref *> frames; std::vector<uint16_t> values; } held;
+        auto device = rsimpl::make_playback_device(filename);
+        const rs_option option = RS_OPTION_UNPACK_THREADS;
+        const double threads = 2;
+        device->set_options(&option, 1, &threads);
+        device->set_stream_callback(RS_STREAM_DEPTH, [](rs_device *, rs_frame_ref * frame, void * user)
+        {
+            auto h = static_cast<held_frames *>(user);
+            std::lock_guard<std::mutex> lock(h->mutex);
+            h->values.push_back(reinterpret_cast<const uint16_t *>(frame->get_frame_data())[width * height - 1]);
+            h->frames.push_back(frame);
+        }, &held);
+        device->set_playback_mode(RS_PLAYBACK_MODE_STEPPED);
+        device->start(RS_SOURCE_VIDEO);
+        for (int i = 0; i < frame_count - 1; ++i) REQUIRE(device->step_playback());
+        for (int i = 0; i < 2000; ++i)
+        {
+            { std::lock_guard<std::mutex> lock(held.mutex); if (held.frames.size() == frame_count - 1) break; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        {
+            std::lock_guard<std::mutex> lock(held.mutex);
+            for (auto frame : held.frames) device->release_frame(frame); // Stopping waits for the application to release its frames
+        }
+        device->stop(RS_SOURCE_VIDEO);
+
+        REQUIRE(held.values.size() == frame_count - 1);
+        for (int i = 0; i < frame_count - 1; ++i) REQUIRE(held.values[i] == 1000 + i);
+    }
+
+    SECTION("unpack workers get a capture buffer for every job with the default capture options")
+    {
+        auto device = rsimpl::make_playback_device(filename);
+        double min, max, step, ring_depth, queue_size, max_threads, def;
+        device->get_option_range(RS_OPTION_CAPTURE_RING_DEPTH, min, max, step, ring_depth);
+        device->get_option_range(RS_OPTION_CAPTURE_QUEUE_SIZE, min, max, step, queue_size);
+        device->get_option_range(RS_OPTION_UNPACK_THREADS, min, max_threads, step, def);
+
+        // Without workers, the ring is left as requested
+        rsimpl::capture_buffer_budget capture_thread_only(static_cast<int>(ring_depth), static_cast<int>(queue_size), 0);
+        REQUIRE(capture_thread_only.ring_depth == ring_depth);
+        REQUIRE(capture_thread_only.queue_size == queue_size);
+
+        // Otherwise a frame is only unpacked on the capture thread once every job in flight holds a capture buffer
+        for (int threads = 1; threads <= 8; ++threads)
+        {
+            INFO("unpack threads: " << threads);
+            rsimpl::capture_buffer_budget budget(static_cast<int>(ring_depth), static_cast<int>(queue_size), threads);
+            REQUIRE(budget.unpack_jobs >= threads);
+            REQUIRE(budget.max_held_buffers >= budget.unpack_jobs);
+            REQUIRE(budget.queue_size == queue_size);
+        }
+
+        // The ring never grows beyond what the option allows
+        rsimpl::capture_buffer_budget most_threads(static_cast<int>(ring_depth), static_cast<int>(queue_size), static_cast<int>(max_threads));
+        device->get_option_range(RS_OPTION_CAPTURE_RING_DEPTH, min, max, step, def);
+        REQUIRE(most_threads.ring_depth == max);
+        REQUIRE(most_threads.max_held_buffers > 0);
+    }
+
+    SECTION("capture thread affinity keeps CPUs beyond the first 32")
+    {
+        auto device = rsimpl::make_playback_device(filename);
+        const rs_option option = RS_OPTION_CAPTURE_THREAD_AFFINITY;
+        const double mask = static_cast<double>((1ull << 40) | 1ull);
+        device->set_options(&option, 1, &mask);
+        double value = 0;
+        device->get_options(&option, 1, &value);
+        REQUIRE(static_cast<uint64_t>(value) == ((1ull << 40) | 1ull));
+
+        const double too_wide = static_cast<double>(1ull << 53), fraction = 1.5;
+        REQUIRE_THROWS_AS(device->set_options(&option, 1, &too_wide), const std::logic_error &);
+        REQUIRE_THROWS_AS(device->set_options(&option, 1, &fraction), const std::logic_error &);
+    }
+
+    SECTION("recordings cut short play up to the last complete frame")
+    {
+        std::vector<char> file;
+        {
+            std::ifstream in(filename, std::ios::binary);
+            file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        {
+            // Lose the trailer, the index, and the end of the last frame
+            std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+            out.write(file.data(), file.size() - rsimpl::capture_file::get_chunk_size<rsimpl::capture_file::trailer>(0)
+                                   - rsimpl::capture_file::get_chunk_size<rsimpl::capture_file::index_table>(11 * sizeof(rsimpl::capture_file::index_entry)) - 100);
+        }
+
+        auto device = rsimpl::make_playback_device(filename);
+        device->set_stream_callback(RS_STREAM_DEPTH, on_frame, &received);
+        device->set_playback_mode(RS_PLAYBACK_MODE_STEPPED);
+        device->start(RS_SOURCE_VIDEO);
+        while (device->step_playback()) {}
+        device->stop(RS_SOURCE_VIDEO);
+        REQUIRE(received.values.size() == frame_count - 1);
+        REQUIRE(received.values.back() == 1000 + frame_count - 2);
+    }
+
+    SECTION("waits for frames end at their timeout while no frame arrives")
+    {
+        auto device = rsimpl::make_playback_device(filename);
+        device->set_playback_mode(RS_PLAYBACK_MODE_STEPPED);
+        device->start(RS_SOURCE_VIDEO);
+
+        for (unsigned int timeout_ms : { 0u, 1u, 50u })
+        {
+            INFO(timeout_ms << " ms timeout");
+            const auto started = std::chrono::steady_clock::now();
+            REQUIRE(rs_wait_for_frames_timeout(device.get(), timeout_ms, require_no_error()) == 0);
+            const auto elapsed = std::chrono::steady_clock::now() - started;
+            REQUIRE(elapsed >= std::chrono::milliseconds(timeout_ms));
+            REQUIRE(elapsed < std::chrono::milliseconds(timeout_ms + 500));
+        }
+
+        // The C++ wrapper rounds a timeout up to whole milliseconds, so that a fraction of one still waits
+        auto & wrapped_device = *reinterpret_cast<rs::device *>(device.get());
+        const auto started = std::chrono::steady_clock::now();
+        REQUIRE_FALSE(wrapped_device.wait_for_frames(std::chrono::microseconds(1500)));
+        REQUIRE(std::chrono::steady_clock::now() - started >= std::chrono::microseconds(1500));
+        REQUIRE_FALSE(wrapped_device.wait_for_frames(std::chrono::steady_clock::now() + std::chrono::microseconds(500)));
+
+        REQUIRE(device->step_playback());
+        REQUIRE(rs_wait_for_frames_timeout(device.get(), 60000, require_no_error()) == 1);
+        device->stop(RS_SOURCE_VIDEO);
+    }
+    std::remove(filename);
+}
+
+TEST_CASE("depth codec restores any image exactly, and rejects corrupted ones", "[offline] [validation]")
+{
+    // Smooth slopes, an invalid region, noise and full range jumps, over pixel counts which end on a partial block
+    std::vector<uint16_t> image(4000);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        if (i < 1000) image[i] = static_cast<uint16_t>(2000 + i / 3);
+        else if (i < 2000) image[i] = 0;
+        else if (i < 3000) image[i] = static_cast<uint16_t>(1500 + (seed >> 28));
+        else image[i] = static_cast<uint16_t>(seed >> 16);
+    }
+
+    for (int count : { 0, 1, 15, 16, 17, 1000, 1999, 2048, 4000 })
+    {
+        std::vector<uint8_t> compressed(rsimpl::depth_codec::get_max_size(count));
+        const auto size = rsimpl::depth_codec::compress(compressed.data(), image.data(), count);
+        REQUIRE(size <= compressed.size());
+        REQUIRE(rsimpl::depth_codec::get_compressed_size(compressed.data(), compressed.size()) == size);
+
+        // Rows handed over one at a time compress to the same bytes
+        std::vector<uint8_t> appended(compressed.size());
+        rsimpl::depth_codec::encoder e(appended.data());
+        for (int i = 0; i < count; i += 37) e.append(image.data() + i, std::min(37, count - i));
+        REQUIRE(e.finish() == size);
+        REQUIRE(std::equal(compressed.begin(), compressed.begin() + size, appended.begin()));
+
+        std::vector<uint16_t> restored(count);
+        rsimpl::depth_codec::decompress(restored.data(), count, compressed.data(), size);
+        REQUIRE(std::equal(restored.begin(), restored.end(), image.begin()));
+        REQUIRE_THROWS(rsimpl::depth_codec::decompress(restored.data(), count + 1, compressed.data(), size));
+        REQUIRE_THROWS(rsimpl::depth_codec::decompress(restored.data(), count, compressed.data(), size - 1));
+    }
+
+    // The invalid region takes a couple of bytes, the noise a few bits per pixel
+    std::vector<uint8_t> compressed(rsimpl::depth_codec::get_max_size(3000));
+    REQUIRE(rsimpl::depth_codec::compress(compressed.data(), image.data(), 3000) < 3000 * sizeof(uint16_t) / 3);
+
+    // Every corruption of the control bytes is either caught or decodes to the right number of pixels
+    const auto size = rsimpl::depth_codec::compress(compressed.data(), image.data(), 3000);
+    std::vector<uint16_t> restored(3000);
+    for (size_t i = sizeof(rsimpl::depth_codec::header); i < size; i += 7)
+    {
+        auto corrupted = compressed;
+        corrupted[i] ^= 0xa5;
+        try { rsimpl::depth_codec::decompress(restored.data(), 3000, corrupted.data(), size); }
+        catch (const std::runtime_error &) {}
+    }
+    compressed[0] ^= 1;
+    REQUIRE_THROWS(rsimpl::depth_codec::get_compressed_size(compressed.data(), size));
+}
+
+TEST_CASE("playback device delivers depth recorded with compression", "[offline] [validation]")
+{
+    const char * filename = "playback-compressed-test.rscap";
+    const int width = 40, height = 20, frame_count = 3;
+    rsimpl::static_device_info info;
+    info.name = "Recorded camera";
+    info.stream_subdevices[RS_STREAM_DEPTH] = 0;
+    const rs_intrinsics intrin = { width, height, width / 2.0f, height / 2.0f, 20, 20, RS_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
+    const rsimpl::subdevice_mode mode = { 0, { width, height }, rsimpl::pf_z16, 30, intrin, {}, { 0 } };
+    info.subdevice_modes.push_back(mode);
+
+    auto make_frame = [](int i)
+    {
+        std::vector<uint16_t> frame(width * height);
+        for (int y = 0; y < height; ++y) for (int x = 0; x < width; ++x) frame[y * width + x] = y < 5 ? 0 : static_cast<uint16_t>(1000 + i * 10 + x / 4 + y * 3);
+        return frame;
+    };
+
+    rsimpl::stream_request requests[RS_STREAM_NATIVE_COUNT] = {};
+    requests[RS_STREAM_DEPTH] = { true, width, height, RS_FORMAT_Z16, 30, RS_OUTPUT_BUFFER_FORMAT_CONTINUOUS };
+    auto record = [&](const char * name, bool compress_depth)
+    {
+        rsimpl::recorder r(name, rsimpl::DEFAULT_RECORDER_QUEUE_BYTES, compress_depth);
+        r.record_device_info(info, { RS_CAPABILITIES_DEPTH }, nullptr, nullptr);
+        r.record_stream_config({ rsimpl::subdevice_mode_selection(mode, 0, 0) }, requests, 0.001f);
+        for (int i = 0; i < frame_count; ++i)
+        {
+            auto frame = make_frame(i);
+            r.record_frame(0, rsimpl::pf_z16.fourcc, width, height, frame.data(), frame.size() * sizeof(uint16_t), 100.0 + 33.0 * i, i + 1);
+        }
+        r.close();
+        return static_cast<std::streamoff>(std::ifstream(name, std::ios::binary | std::ios::ate).tellg());
+    };
+
+    // Compression saves well over half of every frame
+    const char * uncompressed_filename = "playback-uncompressed-test.rscap";
+    REQUIRE(record(filename, true) < record(uncompressed_filename, false) - frame_count * width * height);
+    std::remove(uncompressed_filename);
+
+    struct received_frames { rs_format format; std::vector<std::vector<uint16_t>> images; double timestamp; } received = {};
+    auto on_frame = [](rs_device * device, rs_frame_ref * frame, void * user)
+    {
+        auto r = static_cast<received_frames *>(user);
+        std::vector<uint16_t> image(width * height);
+        if (r->format == RS_FORMAT_Z16) memcpy(image.data(), frame->get_frame_data(), image.size() * sizeof(uint16_t));
+        else
+        {
+            auto size = static_cast<int>(rsimpl::get_image_size(width, height, r->format));
+            rs_decompress_depth(frame->get_frame_data(), rs_get_compressed_depth_size(frame->get_frame_data(), size, nullptr), image.data(), width * height, nullptr);
+        }
+        r->images.push_back(image);
+        r->timestamp = frame->get_frame_timestamp();
+        device->release_frame(frame);
+    };
+
+    for (auto format : { RS_FORMAT_Z16, RS_FORMAT_Z16_COMPRESSED })
+    {
+        received.format = format;
+        received.images.clear();
+        auto device = rsimpl::make_playback_device(filename);
+        device->enable_stream(RS_STREAM_DEPTH, width, height, format, 30, RS_OUTPUT_BUFFER_FORMAT_CONTINUOUS);
+        device->set_stream_callback(RS_STREAM_DEPTH, on_frame, &received);
+        device->set_playback_mode(RS_PLAYBACK_MODE_STEPPED);
+        device->start(RS_SOURCE_VIDEO);
+        while (device->step_playback()) {}
+        device->stop(RS_SOURCE_VIDEO);
+
+        REQUIRE(received.images.size() == frame_count);
+        for (int i = 0; i < frame_count; ++i) REQUIRE(received.images[i] == make_frame(i));
+        REQUIRE(received.timestamp == 100.0 + 33.0 * (frame_count - 1));
+    }
+    std::remove(filename);
+}
+
+TEST_CASE("control cache skips reading cached controls and writing unchanged values", "[offline] [validation]")
+{
+    struct range { uint32_t min, max; }; // Like the depth clamp of R200 cameras
+    rsimpl::control_cache cache;
+    int reads = 0, writes = 0;
+    range camera = { 100, 2000 };
+    auto reader = [&]() { ++reads; return camera; };
+    auto writer = [&](range & value) { ++writes; camera = value; };
+
+    REQUIRE(cache.read(RS_OPTION_R200_DEPTH_CLAMP_MIN, reader).max == 2000);
+    REQUIRE(cache.read(RS_OPTION_R200_DEPTH_CLAMP_MIN, reader).min == 100);
+    REQUIRE(reads == 1);
+
+    range value = { 100, 2000 };
+    cache.write(RS_OPTION_R200_DEPTH_CLAMP_MIN, value, writer);
+    REQUIRE(writes == 0);
+    value.max = 3000;
+    cache.write(RS_OPTION_R200_DEPTH_CLAMP_MIN, value, writer);
+    REQUIRE(writes == 1);
+    REQUIRE(cache.read(RS_OPTION_R200_DEPTH_CLAMP_MIN, reader).max == 3000);
+    REQUIRE(reads == 1);
+
+    // A failed write leaves the control uncached, so that the next read asks the camera
+    value.max = 4000;
+    REQUIRE_THROWS(cache.write(RS_OPTION_R200_DEPTH_CLAMP_MIN, value, [](range &) { throw std::runtime_error("xu_write failed"); }));
+    REQUIRE(!cache.contains(RS_OPTION_R200_DEPTH_CLAMP_MIN));
+    REQUIRE(cache.read(RS_OPTION_R200_DEPTH_CLAMP_MIN, reader).max == 3000);
+    REQUIRE(reads == 2);
+
+    cache.clear();
+    REQUIRE(cache.read(RS_OPTION_R200_DEPTH_CLAMP_MIN, reader).max == 3000);
+    REQUIRE(reads == 3);
+}
+
+TEST_CASE("options set in a batch take effect when the batch is committed", "[offline] [validation]")
+{
+    const char * filename = "options-batch-test.rscap";
+    {
+        rsimpl::static_device_info info;
+        info.name = "Recorded camera";
+        rsimpl::recorder r(filename);
+        r.record_device_info(info, {}, nullptr, nullptr);
+        r.close();
+    }
+    auto device = rsimpl::make_playback_device(filename);
+    rs_option option = RS_OPTION_FRAMES_QUEUE_SIZE;
+    double value = 0;
+    device->get_options(&option, 1, &value);
+    const double before = value;
+
+    device->begin_options_batch();
+    REQUIRE_THROWS(device->begin_options_batch());
+    for (double v : { 5.0, 6.0 }) device->set_options(&option, 1, &v);
+    device->get_options(&option, 1, &value);
+    REQUIRE(value == before);
+    device->commit_options_batch();
+    device->get_options(&option, 1, &value);
+    REQUIRE(value == 6.0);
+    REQUIRE_THROWS(device->commit_options_batch());
+
+    // Options are validated when the batch is committed
+    device->begin_options_batch();
+    value = 0;
+    device->set_options(&option, 1, &value);
+    REQUIRE_THROWS(device->commit_options_batch());
+    device->get_options(&option, 1, &value);
+    REQUIRE(value == 6.0);
+
+    device.reset();
+    std::remove(filename);
+}
+
+// Straightforward BT.601 conversion using the same fixed point arithmetic as the library's converters
+static void reference_yuy2_to_rgb(uint8_t * dest, const uint8_t * source, int count, bool bgr, bool alpha)
+{
+    auto term = [](int x, int k) { return (x * k) >> 8; };
+    auto clamp = [](int x) { return static_cast<uint8_t>(std::min(std::max(x, 0), 255)); };
+    for (int i = 0; i < count; ++i)
+    {
+        const uint8_t * macropixel = source + (i / 2) * 4;
+        int c = term(macropixel[(i % 2) * 2] - 16, 298), d = macropixel[1] - 128, e = macropixel[3] - 128;
+        uint8_t r = clamp(c + term(e, 409)), g = clamp(c - term(d, 100) - term(e, 208)), b = clamp(c + term(d, 516));
+        *dest++ = bgr ? b : r;
+        *dest++ = g;
+        *dest++ = bgr ? r : b;
+        if (alpha) *dest++ = 255;
+    }
+}
+
+TEST_CASE("YUY2 unpackers match the reference conversion for any even pixel count", "[offline] [validation]")
+{
+    std::vector<uint8_t> source(2 * 1922);
+    for (size_t i = 0; i < source.size(); ++i) source[i] = static_cast<uint8_t>(i * 7919 >> 3);
+
+    for (auto & unpacker : rsimpl::pf_yuy2.unpackers)
+    {
+        const rs_format format = unpacker.outputs[0].second;
+        if (format == RS_FORMAT_YUYV) continue;
+        const bool bgr = format == RS_FORMAT_BGR8 || format == RS_FORMAT_BGRA8, alpha = format == RS_FORMAT_RGBA8 || format == RS_FORMAT_BGRA8;
+        const int bytes_per_pixel = alpha ? 4 : 3;
+
+        // Cover pixel counts below, at and between the widths of every vectorized converter
+        for (int count : { 2, 14, 16, 30, 32, 46, 64, 98, 130, 640, 1922 })
+        {
+            std::vector<uint8_t> actual(count * bytes_per_pixel + 64, 0xCD), expected(count * bytes_per_pixel);
+            uint8_t * dest[] = { actual.data() };
+            unpacker.unpack(dest, source.data(), count);
+            reference_yuy2_to_rgb(expected.data(), source.data(), count, bgr, alpha);
+
+            INFO("format " << rs_format_to_string(format) << ", " << count << " pixels");
+            REQUIRE(std::equal(expected.begin(), expected.end(), actual.begin()));
+            REQUIRE(std::count(actual.begin() + expected.size(), actual.end(), 0xCD) == 64);
+        }
+    }
+}
+
+TEST_CASE("Every vectorized YUY2 converter this CPU runs matches the reference conversion", "[offline] [validation]")
+{
+    std::vector<uint8_t> source(2 * 1922);
+    for (size_t i = 0; i < source.size(); ++i) source[i] = static_cast<uint8_t>(i * 7919 >> 3);
+
+    for (rs_format format : { RS_FORMAT_RGB8, RS_FORMAT_RGBA8, RS_FORMAT_BGR8, RS_FORMAT_BGRA8 })
+    {
+        const bool bgr = format == RS_FORMAT_BGR8 || format == RS_FORMAT_BGRA8, alpha = format == RS_FORMAT_RGBA8 || format == RS_FORMAT_BGRA8;
+        const int bytes_per_pixel = alpha ? 4 : 3;
+
+        for (auto & kernel : rsimpl::get_yuy2_kernels(format))
+        {
+            for (int count : { 2, 14, 16, 30, 32, 46, 64, 98, 130, 640, 1922 })
+            {
+                std::vector<uint8_t> actual(count * bytes_per_pixel + 64, 0xCD), expected(count * bytes_per_pixel);
+                const int converted = kernel.second(actual.data(), source.data(), count);
+                reference_yuy2_to_rgb(expected.data(), source.data(), converted, bgr, alpha);
+
+                INFO(kernel.first << " converter, format " << rs_format_to_string(format) << ", " << count << " pixels");
+                REQUIRE(converted >= 0);
+                REQUIRE(converted <= count);
+                REQUIRE(converted % 2 == 0);
+                REQUIRE(std::equal(actual.begin(), actual.begin() + converted * bytes_per_pixel, expected.begin()));
+                REQUIRE(std::count(actual.begin() + converted * bytes_per_pixel, actual.end(), 0xCD) == (count - converted) * bytes_per_pixel + 64);
+            }
+        }
+    }
+}
+
+TEST_CASE("Y8I and Y12I unpackers split every pixel for any pixel count", "[offline] [validation]")
+{
+    std::vector<uint8_t> source(3 * 1000);
+    for (size_t i = 0; i < source.size(); ++i) source[i] = static_cast<uint8_t>(i * 7919 >> 3);
+
+    for (int count : { 1, 15, 16, 17, 63, 64, 65, 1000 })
+    {
+        INFO(count << " pixels");
+
+        std::vector<uint8_t> left8(count), right8(count);
+        uint8_t * y8_dest[] = { left8.data(), right8.data() };
+        rsimpl::pf_y8i.unpackers[0].unpack(y8_dest, source.data(), count);
+        for (int i = 0; i < count; ++i)
+        {
+            REQUIRE(left8[i] == source[i * 2]);
+            REQUIRE(right8[i] == source[i * 2 + 1]);
+        }
+
+        std::vector<uint16_t> left16(count), right16(count);
+        uint8_t * y16_dest[] = { reinterpret_cast<uint8_t *>(left16.data()), reinterpret_cast<uint8_t *>(right16.data()) };
+        rsimpl::pf_y12i.unpackers[0].unpack(y16_dest, source.data(), count);
+        for (int i = 0; i < count; ++i)
+        {
+            const uint8_t * pixel = source.data() + i * 3;
+            const int left = pixel[2] << 4 | pixel[1] >> 4, right = (pixel[1] & 0xf) << 8 | pixel[0];
+            REQUIRE(left16[i] == static_cast<uint16_t>(left << 6 | left >> 4));
+            REQUIRE(right16[i] == static_cast<uint16_t>(right << 6 | right >> 4));
+        }
+    }
+}
+
+TEST_CASE("Table driven deprojection matches rs_deproject_pixel_to_point over any range of pixels", "[offline] [validation]")
+{
+    const rs_intrinsics intrin = { 37, 21, 18.3f, 10.1f, 31.2f, 30.7f, RS_DISTORTION_INVERSE_BROWN_CONRADY, { 0.12f, -0.08f, 0.003f, -0.002f, 0.01f } };
+    const int count = intrin.width * intrin.height;
+    const float scale = 0.001f;
+    std::vector<uint16_t> depth(count);
+    for (int i = 0; i < count; ++i) depth[i] = static_cast<uint16_t>(1 + i * 7919 % 4000);
+
+    std::vector<float> expected_z(count * 3), expected_disparity(count * 3);
+    for (int i = 0; i < count; ++i)
+    {
+        const float pixel[] = { static_cast<float>(i % intrin.width), static_cast<float>(i / intrin.width) };
+        rs_deproject_pixel_to_point(&expected_z[i * 3], &intrin, pixel, scale * depth[i]);
+        rs_deproject_pixel_to_point(&expected_disparity[i * 3], &intrin, pixel, scale / depth[i]);
+    }
+
+    const auto table = rsimpl::compute_deprojection_table(intrin);
+    std::vector<float> z(count * 3), disparity(count * 3);
+    rsimpl::deproject_z(z.data(), intrin, depth.data(), scale);
+    rsimpl::deproject_disparity(disparity.data(), intrin, depth.data(), scale);
+
+    // Optimizing builds (-Ofast, FMA contraction) may round the two paths differently, so the points agree to within float precision
+    auto same_points = [](const std::vector<float> & a, const std::vector<float> & b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](float x, float y) { return x == Approx(y).epsilon(1e-5); });
+    };
+    REQUIRE(same_points(z, expected_z));
+    REQUIRE(same_points(disparity, expected_disparity));
+
+    // Ranges of any length and alignment, converted concurrently, produce the same points
+    std::fill(z.begin(), z.end(), 0.0f);
+    std::fill(disparity.begin(), disparity.end(), 0.0f);
+    const int ranges = 13;
+    rsimpl::thread_pool pool(3);
+    pool.parallel_for(ranges, [&](int range)
+    {
+        const int first = count * range / ranges, last = count * (range + 1) / ranges;
+        rsimpl::deproject_z(z.data(), table, depth.data(), scale, first, last - first);
+        rsimpl::deproject_disparity(disparity.data(), table, depth.data(), scale, first, last - first);
+    });
+    REQUIRE(same_points(z, expected_z));
+    REQUIRE(same_points(disparity, expected_disparity));
+}
+
+TEST_CASE("Table driven alignment matches per pixel projection for any band of rows", "[offline] [validation]")
+{
+    const rs_intrinsics depth_intrin = { 37, 21, 18.3f, 10.1f, 31.2f, 30.7f, RS_DISTORTION_INVERSE_BROWN_CONRADY, { 0.12f, -0.08f, 0.003f, -0.002f, 0.01f } };
+    const rs_intrinsics other_intrin = { 80, 60, 41.5f, 29.2f, 62.3f, 62.1f, RS_DISTORTION_MODIFIED_BROWN_CONRADY, { 0.07f, -0.16f, 0.001f, -0.001f, 0.02f } };
+    const rs_extrinsics depth_to_other = { { 0.99998f, -0.00465f, 0.00395f, 0.00468f, 0.99997f, -0.00676f, -0.00392f, 0.00678f, 0.99997f }, { 0.0257f, 0.0004f, 0.0039f } };
+    const float scale = 0.001f;
+    const int count = depth_intrin.width * depth_intrin.height;
+    std::vector<uint16_t> depth(count), other(other_intrin.width * other_intrin.height);
+    for (int i = 0; i < count; ++i) depth[i] = i % 11 ? static_cast<uint16_t>(100 + i * 7919 % 3000) : 0;
+    for (size_t i = 0; i < other.size(); ++i) other[i] = static_cast<uint16_t>(i);
+
+    // Each depth pixel receives the bottom-right other pixel of the rectangle its corners project to
+    std::vector<uint16_t> expected(count);
+    for (int i = 0; i < count; ++i)
+    {
+        if (!depth[i]) continue;
+        int corner[2][2];
+        for (int c = 0; c < 2; ++c)
+        {
+            const float pixel[] = { i % depth_intrin.width + c - 0.5f, i / depth_intrin.width + c - 0.5f };
+            float depth_point[3], other_point[3], other_pixel[2];
+            rs_deproject_pixel_to_point(depth_point, &depth_intrin, pixel, scale * depth[i]);
+            rs_transform_point_to_point(other_point, &depth_to_other, depth_point);
+            rs_project_point_to_pixel(other_pixel, &other_intrin, other_point);
+            corner[c][0] = static_cast<int>(other_pixel[0] + 0.5f);
+            corner[c][1] = static_cast<int>(other_pixel[1] + 0.5f);
+        }
+        if (corner[0][0] < 0 || corner[0][1] < 0 || corner[1][0] >= other_intrin.width || corner[1][1] >= other_intrin.height) continue;
+        expected[i] = other[corner[1][1] * other_intrin.width + corner[1][0]];
+    }
+    REQUIRE(std::count(expected.begin(), expected.end(), 0) < count / 4);
+
+    const auto table = rsimpl::compute_alignment_table(depth_intrin);
+    std::vector<uint16_t> actual(count);
+    for (int first_row = 0, rows = 1; first_row < depth_intrin.height; first_row += rows, rows += 2)
+    {
+        rsimpl::align_other_to_z(reinterpret_cast<rsimpl::byte *>(actual.data()), table, depth.data(), scale, depth_intrin, depth_to_other, other_intrin,
+            reinterpret_cast<const rsimpl::byte *>(other.data()), RS_FORMAT_Y16, first_row, std::min(rows, depth_intrin.height - first_row));
+    }
+    REQUIRE(actual == expected);
+}
+
+TEST_CASE("Two pass alignment of depth matches the single pass alignment however it is split", "[offline] [validation]")
+{
+    const rs_intrinsics depth_intrin = { 37, 21, 18.3f, 10.1f, 31.2f, 30.7f, RS_DISTORTION_INVERSE_BROWN_CONRADY, { 0.12f, -0.08f, 0.003f, -0.002f, 0.01f } };
+    const rs_intrinsics other_intrin = { 80, 60, 41.5f, 29.2f, 82.3f, 82.1f, RS_DISTORTION_MODIFIED_BROWN_CONRADY, { 0.07f, -0.16f, 0.001f, -0.001f, 0.02f } };
+    const rs_extrinsics depth_to_other = { { 0.99998f, -0.00465f, 0.00395f, 0.00468f, 0.99997f, -0.00676f, -0.00392f, 0.00678f, 0.99997f }, { 0.0257f, 0.0004f, 0.0039f } };
+    const float scale = 0.001f;
+    const int count = depth_intrin.width * depth_intrin.height, other_count = other_intrin.width * other_intrin.height;
+    std::vector<uint16_t> depth(count);
+    for (int i = 0; i < count; ++i) depth[i] = i % 11 ? static_cast<uint16_t>(100 + i * 7919 % 3000) : 0;
+
+    const auto table = rsimpl::compute_alignment_table(depth_intrin);
+    std::vector<uint16_t> serial_z(other_count, 0), serial_disparity(other_count, 0xFFFF);
+    rsimpl::align_z_to_other(reinterpret_cast<rsimpl::byte *>(serial_z.data()), table, depth.data(), scale, depth_intrin, depth_to_other, other_intrin);
+    rsimpl::align_disparity_to_other(reinterpret_cast<rsimpl::byte *>(serial_disparity.data()), table, depth.data(), scale, depth_intrin, depth_to_other, other_intrin);
+    REQUIRE(std::count(serial_z.begin(), serial_z.end(), 0) < other_count / 2);
+
+    rsimpl::thread_pool pool(3);
+    for (int bands : { 1, 4, 7, 21 })
+    {
+        INFO(bands << " bands");
+        rsimpl::pixel_rectangles z_rectangles, disparity_rectangles;
+        z_rectangles.resize(depth_intrin);
+        disparity_rectangles.resize(depth_intrin);
+        pool.parallel_for(bands, [&](int band)
+        {
+            const int first_row = depth_intrin.height * band / bands, row_count = depth_intrin.height * (band + 1) / bands - first_row;
+            rsimpl::find_z_rectangles(z_rectangles, table, depth.data(), scale, depth_intrin, depth_to_other, other_intrin, first_row, row_count);
+            rsimpl::find_disparity_rectangles(disparity_rectangles, table, depth.data(), scale, depth_intrin, depth_to_other, other_intrin, first_row, row_count);
+        });
+
+        std::vector<uint16_t> z(other_count, 0), disparity(other_count, 0xFFFF);
+        pool.parallel_for(bands, [&](int band)
+        {
+            const int first_row = other_intrin.height * band / bands, row_count = other_intrin.height * (band + 1) / bands - first_row;
+            rsimpl::align_z_to_other(reinterpret_cast<rsimpl::byte *>(z.data()), z_rectangles, depth.data(), depth_intrin, other_intrin, first_row, row_count);
+            rsimpl::align_disparity_to_other(reinterpret_cast<rsimpl::byte *>(disparity.data()), disparity_rectangles, depth.data(), depth_intrin, other_intrin, first_row, row_count);
+        });
+        REQUIRE(z == serial_z);
+        REQUIRE(disparity == serial_disparity);
+    }
+}
+
 TEST_CASE( "rs_create_context() validates input", "[offline] [validation]" )
 {
     REQUIRE(rs_create_context(RS_API_VERSION - 100, require_error("", false)) == nullptr);
@@ -211,6 +1622,66 @@ TEST_CASE( "rs_stop_device() validates input", "[offline] [validation]" )
     rs_stop_device(nullptr, require_error("null pointer passed for argument \"device\""));
 }
 
+TEST_CASE( "rs_start_recording() validates input", "[offline] [validation]" )
+{
+    rs_start_recording(nullptr,               "capture.rscap", require_error("null pointer passed for argument \"device\""));
+    rs_start_recording(fake_object_pointer(), nullptr,         require_error("null pointer passed for argument \"filename\""));
+}
+
+TEST_CASE( "rs_stop_recording() validates input", "[offline] [validation]" )
+{
+    rs_stop_recording(nullptr, require_error("null pointer passed for argument \"device\""));
+}
+
+TEST_CASE( "rs_add_playback_device() validates input", "[offline] [validation]" )
+{
+    REQUIRE(rs_add_playback_device(nullptr,               "capture.rscap", require_error("null pointer passed for argument \"context\"")) == nullptr);
+    REQUIRE(rs_add_playback_device(fake_object_pointer(), nullptr,         require_error("null pointer passed for argument \"filename\"")) == nullptr);
+}
+
+TEST_CASE( "rs_set_playback_mode() validates input", "[offline] [validation]" )
+{
+    rs_set_playback_mode(nullptr,               RS_PLAYBACK_MODE_FAST,                    require_error("null pointer passed for argument \"device\""));
+    rs_set_playback_mode(fake_object_pointer(), (rs_playback_mode)-1,                     require_error("bad enum value for argument \"mode\""));
+    rs_set_playback_mode(fake_object_pointer(), RS_PLAYBACK_MODE_COUNT,                   require_error("bad enum value for argument \"mode\""));
+}
+
+TEST_CASE( "rs_step_playback() validates input", "[offline] [validation]" )
+{
+    REQUIRE(rs_step_playback(nullptr, require_error("null pointer passed for argument \"device\"")) == 0);
+}
+
+TEST_CASE( "rs_seek_playback() validates input", "[offline] [validation]" )
+{
+    rs_seek_playback(nullptr, 0, require_error("null pointer passed for argument \"device\""));
+}
+
+TEST_CASE( "rs_compress_depth() and rs_decompress_depth() validate input", "[offline] [validation]" )
+{
+    uint16_t pixels[16] = {};
+    uint8_t compressed[64] = {};
+    REQUIRE(rs_get_max_compressed_depth_size(-1, require_error("out of range value for argument \"pixel_count\"")) == 0);
+    REQUIRE(rs_get_max_compressed_depth_size(16, require_no_error()) <= (int)sizeof(compressed));
+
+    REQUIRE(rs_compress_depth(nullptr, 16, compressed, sizeof(compressed), require_error("null pointer passed for argument \"pixels\"")) == 0);
+    REQUIRE(rs_compress_depth(pixels,  -1, compressed, sizeof(compressed), require_error("out of range value for argument \"pixel_count\"")) == 0);
+    REQUIRE(rs_compress_depth(pixels,  16, nullptr,    sizeof(compressed), require_error("null pointer passed for argument \"compressed\"")) == 0);
+    REQUIRE(rs_compress_depth(pixels,  16, compressed, 8,                  require_error("out of range value for argument \"compressed_size\"")) == 0);
+    const int size = rs_compress_depth(pixels, 16, compressed, sizeof(compressed), require_no_error());
+
+    REQUIRE(rs_get_compressed_depth_size(nullptr,    size, require_error("null pointer passed for argument \"compressed\"")) == 0);
+    REQUIRE(rs_get_compressed_depth_size(compressed, -1,   require_error("out of range value for argument \"compressed_size\"")) == 0);
+    REQUIRE(rs_get_compressed_depth_size(compressed, 4,    require_error("compressed depth image is truncated")) == 0);
+    REQUIRE(rs_get_compressed_depth_size(compressed, size, require_no_error()) == size);
+
+    rs_decompress_depth(nullptr,    size, pixels,  16, require_error("null pointer passed for argument \"compressed\""));
+    rs_decompress_depth(compressed, -1,   pixels,  16, require_error("out of range value for argument \"compressed_size\""));
+    rs_decompress_depth(compressed, size, nullptr, 16, require_error("null pointer passed for argument \"pixels\""));
+    rs_decompress_depth(compressed, size, pixels,  -1, require_error("out of range value for argument \"pixel_count\""));
+    rs_decompress_depth(compressed, size, pixels,  15, require_error("compressed depth image holds 16 pixels, not 15"));
+    rs_decompress_depth(compressed, size, pixels,  16, require_no_error());
+}
+
 TEST_CASE( "rs_is_device_streaming() validates input", "[offline] [validation]" )
 {
     REQUIRE(rs_is_device_streaming(nullptr, require_error("null pointer passed for argument \"device\"")) == 0);
@@ -227,6 +1698,20 @@ TEST_CASE( "rs_set_device_option() validates input", "[offline] [validation]" )
     // todo - Add some basic validation for parameter sanity (gain/exposure cannot be negative, depth clamping must be in uint16_t range, etc...)
 }
 
+TEST_CASE( "rs_begin_device_options_batch() and rs_commit_device_options_batch() validate input", "[offline] [validation]" )
+{
+    rs_begin_device_options_batch(nullptr, require_error("null pointer passed for argument \"device\""));
+    rs_commit_device_options_batch(nullptr, require_error("null pointer passed for argument \"device\""));
+}
+
+TEST_CASE( "rs_set_frameset_tolerance() validates input", "[offline] [validation]" )
+{
+    rs_set_frameset_tolerance(nullptr,               RS_STREAM_DEPTH, RS_STREAM_COLOR,                  10, require_error("null pointer passed for argument \"device\""));
+    rs_set_frameset_tolerance(fake_object_pointer(), (rs_stream)-1,   RS_STREAM_COLOR,                  10, require_error("bad enum value for argument \"a\""));
+    rs_set_frameset_tolerance(fake_object_pointer(), RS_STREAM_DEPTH, RS_STREAM_COLOR_ALIGNED_TO_DEPTH, 10, require_error("argument \"b\" must be a native stream"));
+    rs_set_frameset_tolerance(fake_object_pointer(), RS_STREAM_DEPTH, RS_STREAM_COLOR,                  -1, require_error("out of range value for argument \"milliseconds\""));
+}
+
 TEST_CASE( "rs_get_device_option() validates input", "[offline] [validation]" )
 {
     REQUIRE(rs_get_device_option(nullptr,               RS_OPTION_COLOR_GAIN, require_error("null pointer passed for argument \"device\"")) == 0);
@@ -240,6 +1725,11 @@ TEST_CASE( "rs_wait_for_frames() validates input", "[offline] [validation]" )
     rs_wait_for_frames(nullptr, require_error("null pointer passed for argument \"device\""));
 }
 
+TEST_CASE( "rs_wait_for_frames_timeout() validates input", "[offline] [validation]" )
+{
+    REQUIRE(rs_wait_for_frames_timeout(nullptr, 10, require_error("null pointer passed for argument \"device\"")) == 0);
+}
+
 TEST_CASE( "rs_get_frame_timestamp() validates input", "[offline] [validation]" )
 {
     REQUIRE(rs_get_frame_timestamp(nullptr,               RS_STREAM_DEPTH,    require_error("null pointer passed for argument \"device\"")) == 0);
@@ -308,6 +1798,8 @@ TEST_CASE( "rs_format_to_string() produces correct output", "[offline] [validati
     REQUIRE(rs_format_to_string(RS_FORMAT_Y8) == std::string("Y8"));
     REQUIRE(rs_format_to_string(RS_FORMAT_Y16) == std::string("Y16"));
     REQUIRE(rs_format_to_string(RS_FORMAT_RAW10) == std::string("RAW10"));
+    REQUIRE(rs_format_to_string(RS_FORMAT_Z16_COMPRESSED) == std::string("Z16_COMPRESSED"));
+    REQUIRE(rs_format_to_string(RS_FORMAT_DISPARITY16_COMPRESSED) == std::string("DISPARITY16_COMPRESSED"));
 
     // Invalid enum values should return nullptr
     REQUIRE(rs_format_to_string((rs_format)-1) == unknown);
@@ -0,0 +1,104 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2015 Intel Corporation. All Rights Reserved.
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// This set of tests streams from the simulated backend, and needs no camera to be present //
+////////////////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(MAKEFILE) || ( defined(SIMULATED_TEST) )
+
+#define CATCH_CONFIG_MAIN
+#include "catch/catch.hpp"
+
+#include "unit-tests-common.h"
+
+#include <cstdlib>
+#include <string>
+
+// The simulated cameras are chosen when the context enumerates them
+static void simulate_devices(const char * devices)
+{
+#ifdef WIN32
+    _putenv_s("RS_SIMULATED_DEVICES", devices);
+#else
+    setenv("RS_SIMULATED_DEVICES", devices, 1);
+#endif
+}
+
+static rs_device * find_device(rs_context * ctx, const std::string & name)
+{
+    const int device_count = rs_get_device_count(ctx, require_no_error());
+    for (int i = 0; i < device_count; ++i)
+    {
+        rs_device * dev = rs_get_device(ctx, i, require_no_error());
+        if (rs_get_device_name(dev, require_no_error()) == name) return dev;
+    }
+    return nullptr;
+}
+
+TEST_CASE( "Simulated cameras enumerate as configured", "[simulated]" )
+{
+    simulate_devices("r200,sr300");
+    safe_context ctx;
+    REQUIRE(rs_get_device_count(ctx, require_no_error()) == 2);
+
+    for (auto name : { "Intel RealSense R200", "Intel RealSense SR300" })
+    {
+        INFO(name);
+        rs_device * dev = find_device(ctx, name);
+        REQUIRE(dev != nullptr);
+        REQUIRE( rs_get_device_serial(dev, require_no_error()) != nullptr );
+        REQUIRE( rs_get_device_firmware_version(dev, require_no_error()) != nullptr );
+    }
+}
+
+TEST_CASE( "Simulated R200 streams", "[simulated] [r200]" )
+{
+    simulate_devices("r200");
+    safe_context ctx;
+    rs_device * dev = find_device(ctx, "Intel RealSense R200");
+    REQUIRE(dev != nullptr);
+
+    SECTION( "streaming depth" )
+    {
+        test_streaming(dev, {
+            { RS_STREAM_DEPTH, 480, 360, RS_FORMAT_Z16, 60 }
+        });
+    }
+
+    SECTION( "streaming depth, infrared and color" )
+    {
+        test_streaming(dev, {
+            { RS_STREAM_DEPTH, 480, 360, RS_FORMAT_Z16, 60 },
+            { RS_STREAM_INFRARED, 480, 360, RS_FORMAT_Y8, 60 },
+            { RS_STREAM_COLOR, 640, 480, RS_FORMAT_RGB8, 60 }
+        });
+    }
+}
+
+TEST_CASE( "Simulated SR300 streams", "[simulated] [sr300]" )
+{
+    simulate_devices("sr300");
+    safe_context ctx;
+    rs_device * dev = find_device(ctx, "Intel RealSense SR300");
+    REQUIRE(dev != nullptr);
+
+    SECTION( "streaming depth and color" )
+    {
+        test_streaming(dev, {
+            { RS_STREAM_DEPTH, 640, 480, RS_FORMAT_Z16, 60 },
+            { RS_STREAM_COLOR, 640, 480, RS_FORMAT_RGB8, 60 }
+        });
+    }
+
+    SECTION( "streaming depth, infrared and color" )
+    {
+        test_streaming(dev, {
+            { RS_STREAM_DEPTH, 640, 480, RS_FORMAT_Z16, 60 },
+            { RS_STREAM_COLOR, 640, 480, RS_FORMAT_RGB8, 60 },
+            { RS_STREAM_INFRARED, 640, 480, RS_FORMAT_Y16, 60 }
+        });
+    }
+}
+
+#endif /* !defined(MAKEFILE) || ( defined(SIMULATED_TEST) ) */